@@ -3,5 +3,6 @@
 
 #cmakedefine RESOURCES_PATH "@RESOURCES_PATH@"
 #cmakedefine MQTT_HOST "@MQTT_HOST@"
+#define OPERA_DIAGNOSTICS_LEVEL @OPERA_DIAGNOSTICS_LEVEL@
 
 #endif /* OPERA_CONFIG_HPP */
@@ -0,0 +1,233 @@
+/***************************************************************************
+ *            binary_serialisation.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPERA_BINARY_SERIALISATION_HPP
+#define OPERA_BINARY_SERIALISATION_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include "body.hpp"
+#include "message.hpp"
+#include "serialisation.hpp"
+#include "macros.hpp"
+
+namespace Opera {
+
+//! \brief The current version of the binary encoding of messages
+//! \details A payload is decoded only if its version is not greater than this one
+const uint8_t BINARY_ENCODING_VERSION = 1;
+
+//! \brief The kind of message in a binary payload
+enum class BinaryMessageKind : uint8_t { BODY_PRESENTATION = 1, HUMAN_STATE = 2, ROBOT_STATE = 3, COLLISION_NOTIFICATION = 4 };
+
+//! \brief Writer of a little-endian binary content, where strings and lists are prefixed with their length
+class BinaryWriter {
+  public:
+    //! \brief Construct by appending to the \a buffer
+    BinaryWriter(String& buffer);
+
+    void write_uint8(uint8_t const& value);
+    void write_uint32(uint32_t const& value);
+    void write_uint64(uint64_t const& value);
+    void write_float(FloatType const& value);
+    //! \brief Write a length, which must fit into 32 bits
+    void write_size(SizeType const& value);
+    void write_string(String const& value);
+    void write_point(Point const& value);
+
+    //! \brief Write the header of a payload of the given \a kind
+    void write_header(BinaryMessageKind const& kind);
+
+  private:
+    String& _buffer;
+};
+
+//! \brief Reader of a binary content produced by BinaryWriter, checking for overruns
+class BinaryReader {
+  public:
+    //! \brief Construct from the \a data of the given \a size
+    BinaryReader(const char* data, SizeType const& size);
+
+    uint8_t read_uint8();
+    uint32_t read_uint32();
+    uint64_t read_uint64();
+    FloatType read_float();
+    SizeType read_size();
+    //! \brief Read the number of elements of a list, checking that the remaining content can hold them given their \a minimum_element_size
+    SizeType read_count(SizeType const& minimum_element_size);
+    String read_string();
+    //! \brief Read a string as a view on the payload, hence without allocating
+    std::string_view read_string_view();
+    Point read_point();
+    //! \brief Skip \a num_bytes without reading them
+    void skip(SizeType const& num_bytes);
+
+    //! \brief Read the header of a payload, checking that it has a supported version and the given \a kind
+    void read_header(BinaryMessageKind const& kind);
+
+    //! \brief Whether the whole content has been read
+    bool at_end() const;
+
+  private:
+    //! \brief Reserve \a num_bytes for reading, returning the position of the first one
+    const unsigned char* _consume(SizeType const& num_bytes);
+
+  private:
+    const unsigned char* _data;
+    SizeType const _size;
+    SizeType _position;
+};
+
+//! \brief A string buffer local to each thread, reused across binary serialisations
+class BinarySerialisationBuffer {
+  public:
+    //! \brief The cleared buffer of the current thread
+    static String& acquire();
+};
+
+//! \brief Base implementation of serialisation into a binary payload
+template<class T> class BinarySerialiserBase : public SerialiserInterface<T> {
+  public:
+    //! \brief Pass the object by const reference
+    BinarySerialiserBase(T const& o) : obj(o) { }
+
+    //! \brief Write the content, including the header
+    virtual void write(BinaryWriter& writer) const = 0;
+
+    //! \brief Serialise into the buffer of the current thread
+    //! \details The view is valid until the next binary serialisation on the same thread, hence it must be consumed right away
+    std::string_view to_view() const {
+        auto& buffer = BinarySerialisationBuffer::acquire();
+        BinaryWriter writer(buffer);
+        write(writer);
+        return buffer;
+    }
+
+  public:
+    void to_file(FilePath const& file) const override {
+        std::ofstream ofs(file, std::ios::binary);
+        OPERA_ASSERT_MSG(ofs.is_open(), "Could not open file '" << file << "' for writing.")
+        auto payload = to_view();
+        ofs.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    }
+
+    std::string to_string() const override {
+        return std::string(to_view());
+    }
+
+  protected:
+    T const& obj;
+};
+
+template<class T> class BinarySerialiser;
+
+//! \brief Utility for making a binary payload from a presentation message
+template<> class BinarySerialiser<BodyPresentationMessage> : public BinarySerialiserBase<BodyPresentationMessage> {
+  public:
+    using BinarySerialiserBase::BinarySerialiserBase;
+    void write(BinaryWriter& writer) const override;
+};
+
+//! \brief Utility for making a binary payload from a human state message
+template<> class BinarySerialiser<HumanStateMessage> : public BinarySerialiserBase<HumanStateMessage> {
+  public:
+    using BinarySerialiserBase::BinarySerialiserBase;
+    void write(BinaryWriter& writer) const override;
+};
+
+//! \brief Utility for making a binary payload from a robot state message
+template<> class BinarySerialiser<RobotStateMessage> : public BinarySerialiserBase<RobotStateMessage> {
+  public:
+    using BinarySerialiserBase::BinarySerialiserBase;
+    void write(BinaryWriter& writer) const override;
+};
+
+//! \brief Utility for making a binary payload from a notification message
+template<> class BinarySerialiser<CollisionNotificationMessage> : public BinarySerialiserBase<CollisionNotificationMessage> {
+  public:
+    using BinarySerialiserBase::BinarySerialiserBase;
+    void write(BinaryWriter& writer) const override;
+};
+
+//! \brief Base for a class deserialising a binary payload
+template<class T> class BinaryDeserialiserBase {
+  public:
+    //! \brief Construct from the \a data of the given \a size, which must outlive this object
+    BinaryDeserialiserBase(const char* data, SizeType const& size) : _data(data), _size(size) { }
+
+    //! \brief Make the object
+    virtual T make() const = 0;
+
+    virtual ~BinaryDeserialiserBase() = default;
+
+  protected:
+    //! \brief Create a reader for the content
+    BinaryReader _reader() const { return BinaryReader(_data,_size); }
+
+  private:
+    const char* _data;
+    SizeType const _size;
+};
+
+template<class T> class BinaryDeserialiser;
+
+//! \brief Converter to a BodyPresentationMessage from a binary payload
+template<> class BinaryDeserialiser<BodyPresentationMessage> : public BinaryDeserialiserBase<BodyPresentationMessage> {
+  public:
+    using BinaryDeserialiserBase::BinaryDeserialiserBase;
+    BodyPresentationMessage make() const override;
+};
+
+//! \brief Converter to a HumanStateMessage from a binary payload
+template<> class BinaryDeserialiser<HumanStateMessage> : public BinaryDeserialiserBase<HumanStateMessage> {
+  public:
+    using BinaryDeserialiserBase::BinaryDeserialiserBase;
+    HumanStateMessage make() const override;
+    //! \brief Extract the header only, skipping the samples
+    MessageHeader peek() const;
+};
+
+//! \brief Converter to a RobotStateMessage from a binary payload
+template<> class BinaryDeserialiser<RobotStateMessage> : public BinaryDeserialiserBase<RobotStateMessage> {
+  public:
+    using BinaryDeserialiserBase::BinaryDeserialiserBase;
+    RobotStateMessage make() const override;
+    //! \brief Extract the header only, skipping the samples
+    MessageHeader peek() const;
+};
+
+//! \brief Converter to a CollisionNotificationMessage from a binary payload
+template<> class BinaryDeserialiser<CollisionNotificationMessage> : public BinaryDeserialiserBase<CollisionNotificationMessage> {
+  public:
+    using BinaryDeserialiserBase::BinaryDeserialiserBase;
+    CollisionNotificationMessage make() const override;
+};
+
+}
+
+#endif //OPERA_BINARY_SERIALISATION_HPP
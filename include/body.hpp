@@ -29,6 +29,7 @@
 #ifndef OPERA_BODY_HPP
 #define OPERA_BODY_HPP
 
+#include <span>
 #include "declarations.hpp"
 #include "mode.hpp"
 #include "geometry.hpp"
@@ -194,6 +195,8 @@ class BodySegmentSample: public BodySegmentSampleInterface {
     bool is_empty() const override;
 
     void update(List<Point> const& heads, List<Point> const& tails) override;
+    //! \brief Update the head and tail bounds from the given spans of points
+    void update(std::span<Point const> const& heads, std::span<Point const> const& tails);
 
     bool intersects(BodySegmentSampleInterface const& other) const override;
 
@@ -29,6 +29,8 @@
 #ifndef OPERA_BODY_REGISTRY_HPP
 #define OPERA_BODY_REGISTRY_HPP
 
+#include <array>
+#include <shared_mutex>
 #include "state.hpp"
 #include "message.hpp"
 
@@ -48,7 +50,7 @@ class HumanRegistryEntry {
     //! \brief Whether there are instances with a given \a timestamp
     bool has_instances_within(TimestampType const& timestamp) const;
     //! \brief Return the instance within a given \a timestamp
-    HumanStateInstance const& latest_instance_within(TimestampType const& timestamp) const;
+    SharedPointer<HumanStateInstance const> latest_instance_within(TimestampType const& timestamp) const;
     //! \brief Get the number of instances between two timestamps \a lower and \a upper
     //! \details Used to acknowledge if some instance has been skipped between two awaken-ups of a given job
     SizeType instance_distance(TimestampType const& lower, TimestampType const& upper) const;
@@ -64,10 +66,12 @@ class HumanRegistryEntry {
     TimestampType latest_timestamp() const;
 
     //! \brief Return the instance at \a idx
-    HumanStateInstance const& at(SizeType const& idx) const;
+    SharedPointer<HumanStateInstance const> at(SizeType const& idx) const;
 
     //! \brief Add a new instance from \a points and \a timestamp
     void add(Map<KeypointIdType,List<Point>> const& points, TimestampType const& timestamp);
+    //! \brief Add a new instance from the \a body of a \a message
+    void add(HumanStateMessage const& message, SizeType const& body);
   private:
     Human const _body;
     HumanStateHistory _history;
@@ -88,8 +92,20 @@ struct RobotRegistryEntry {
     RobotStateHistory _history;
 };
 
+//! \brief A handle to a human entry, which remains valid even after removal of the human from the registry
+using HumanRegistryEntryHandle = SharedPointer<HumanRegistryEntry>;
+//! \brief A handle to a robot entry, which remains valid even after removal of the robot from the registry
+using RobotRegistryEntryHandle = SharedPointer<RobotRegistryEntry>;
+
+//! \brief The number of shards in which bodies of the registry are distributed
+const SizeType BODY_REGISTRY_NUM_SHARDS = 8;
+
 //! \brief A registry for bodies introduced by presentation
-//! \details Used as a synchronised source for body data instead of passing bodies around
+//! \details Used as a synchronised source for body data instead of passing bodies around.
+//! Bodies are distributed into shards, each one with its own shared mutex: lookups only take a shared lock
+//! on the shard of the body, hence lookups of bodies in different shards never contend with each other
+//! or with insertions/removals. Data of an entry is returned as handles that keep the entry alive,
+//! so that it can still be read after the removal of the body from the registry.
 class BodyRegistry {
   public:
     BodyRegistry() = default;
@@ -112,9 +128,14 @@ class BodyRegistry {
     List<BodyIdType> human_ids() const;
 
     //! \brief The robot having the given \a id
-    Robot const& robot(BodyIdType const& id) const;
+    SharedPointer<Robot const> robot(BodyIdType const& id) const;
     //! \brief The human having the given \a id
-    Human const& human(BodyIdType const& id) const;
+    SharedPointer<Human const> human(BodyIdType const& id) const;
+
+    //! \brief The entry of the human having the given \a id, or nullptr if not registered
+    HumanRegistryEntryHandle human_entry(BodyIdType const& id) const;
+    //! \brief The entry of the robot having the given \a id, or nullptr if not registered
+    RobotRegistryEntryHandle robot_entry(BodyIdType const& id) const;
 
     //! \brief Whether the registry has the human with given \a id
     bool has_human(BodyIdType const& id) const;
@@ -122,19 +143,20 @@ class BodyRegistry {
     bool has_robot(BodyIdType const& id) const;
 
     //! \brief The history of the robot having the given \a id
-    RobotStateHistory& robot_history(BodyIdType const& id);
-    RobotStateHistory const & robot_history(BodyIdType const& id) const;
+    SharedPointer<RobotStateHistory> robot_history(BodyIdType const& id);
+    SharedPointer<RobotStateHistory const> robot_history(BodyIdType const& id) const;
 
     //! \brief The history of the human having the given \a id
-    HumanStateHistory& human_history(BodyIdType const& id);
-    HumanStateHistory const & human_history(BodyIdType const& id) const;
+    SharedPointer<HumanStateHistory> human_history(BodyIdType const& id);
+    SharedPointer<HumanStateHistory const> human_history(BodyIdType const& id) const;
 
     //! \brief Whether the human with given \a id has instances within a given \a timestamp
     bool has_human_instances_within(BodyIdType const& id, TimestampType const& timestamp) const;
 
     //! \brief The most recent instance of the human having the given \a id within a \a timestamp
-    //! \details There is no check for the existence of instances, since it would be performed before using this method
-    HumanStateInstance const& latest_human_instance_within(BodyIdType const& id, TimestampType const& timestamp) const;
+    //! \details There is no check for the existence of instances, since it would be performed before using this method;
+    //! the instance stays valid even after being removed from the history
+    SharedPointer<HumanStateInstance const> latest_human_instance_within(BodyIdType const& id, TimestampType const& timestamp) const;
 
     //! \brief Return the size of the human history for the given \a id
     SizeType human_history_size(BodyIdType const& id) const;
@@ -150,10 +172,13 @@ class BodyRegistry {
     SizeType instance_number(BodyIdType const& id, TimestampType const& timestamp) const;
 
     //! \brief Return the human instance at \a idx
-    HumanStateInstance const& instance_at(BodyIdType const& id, SizeType const& idx) const;
+    SharedPointer<HumanStateInstance const> instance_at(BodyIdType const& id, SizeType const& idx) const;
 
     //! \brief Acquire state from a human state \a msg
     void acquire_state(HumanStateMessage const& msg);
+    //! \brief Acquire the state of one human \a body from a human state \a msg
+    //! \details Ignored if not more recent than the latest instance of the human
+    void acquire_state(HumanStateMessage const& msg, SizeType const& body);
     //! \brief Acquire state from a robot state \a msg
     void acquire_state(RobotStateMessage const& msg);
 
@@ -174,13 +199,21 @@ class BodyRegistry {
     void clear();
 
   private:
+    //! \brief The bodies in a shard, read under a shared lock and modified under an exclusive lock
+    struct Shard {
+        Map<BodyIdType,HumanRegistryEntryHandle> humans;
+        Map<BodyIdType,RobotRegistryEntryHandle> robots;
+        mutable std::shared_mutex mux;
+    };
+
+    //! \brief The shard for the body with the given \a id
+    Shard& _shard(BodyIdType const& id);
+    Shard const& _shard(BodyIdType const& id) const;
 
-    void _add_human_instance(BodyIdType const& id, Map<KeypointIdType,List<Point>> const& points, TimestampType const& timestamp);
+    void _add_human_instance(HumanStateMessage const& msg, SizeType const& body);
 
   private:
-    Map<BodyIdType,SharedPointer<RobotRegistryEntry>> _robots;
-    Map<BodyIdType,SharedPointer<HumanRegistryEntry>> _humans;
-    mutable std::mutex _content_mux;
+    std::array<Shard,BODY_REGISTRY_NUM_SHARDS> _shards;
 };
 
 }
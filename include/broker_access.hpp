@@ -81,8 +81,10 @@ class BrokerAccessInterface {
     virtual PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic) const = 0;
 
     virtual SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic) const = 0;
-    virtual SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic) const = 0;
-    virtual SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic) const = 0;
+    //! \brief Make a subscriber to human states, where the optional \a filter on the header tells which messages are to be decoded and delivered
+    virtual SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic, MessageFilter const& filter) const = 0;
+    //! \brief Make a subscriber to robot states, where the optional \a filter on the header tells which messages are to be decoded and delivered
+    virtual SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic, MessageFilter const& filter) const = 0;
     virtual SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic) const = 0;
 
     //! \brief Default destructor to avoid destructor not being called on objects of this type
@@ -98,8 +100,8 @@ class BrokerAccess : public Handle<BrokerAccessInterface> {
     PublisherInterface<RobotStateMessage>* make_robot_state_publisher(RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const { return _ptr->make_robot_state_publisher(topic); }
     PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const { return _ptr->make_collision_notification_publisher(topic); }
     SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const { return _ptr->make_body_presentation_subscriber(callback,topic); }
-    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const { return _ptr->make_human_state_subscriber(callback,topic); }
-    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const { return _ptr->make_robot_state_subscriber(callback,topic); }
+    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const { return _ptr->make_human_state_subscriber(callback,topic,filter); }
+    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const { return _ptr->make_robot_state_subscriber(callback,topic,filter); }
     SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const { return _ptr->make_collision_notification_subscriber(callback,topic); }
 };
 
@@ -30,6 +30,7 @@
 #define OPERA_BROKER_ACCESS_MANAGER_HPP
 
 #include "memory.hpp"
+#include "shm.hpp"
 #include "mqtt.hpp"
 #include "kafka.hpp"
 
@@ -48,11 +49,22 @@ class BrokerAccessManager {
         return manager;
     }
 
-    //! \brief Configure to assign the access
+    //! \brief Configure to assign the access, replacing any previous one
+    //! \details For "shm", the \a address is the prefix of the shared memory rings
     void configure(std::string broker_type, std::string address, int arg) {
-        //if (broker_type == "kafka") _access = new BrokerAccess(KafkaBrokerAccess(arg,address,RdKafka::Topic::OFFSET_END));
-        if (broker_type == "memory") _access = new BrokerAccess(MemoryBrokerAccess());
-        else if (broker_type == "mqtt") _access = new BrokerAccess(MqttBrokerAccess(address,arg));
+        BrokerAccess* access = nullptr;
+        //if (broker_type == "kafka") access = new BrokerAccess(KafkaBrokerAccess(arg,address,RdKafka::Topic::OFFSET_END));
+        if (broker_type == "memory") access = new BrokerAccess(MemoryBrokerAccess());
+        else if (broker_type == "shm") access = new BrokerAccess(ShmBrokerAccess(address));
+        else if (broker_type == "mqtt") access = new BrokerAccess(MqttBrokerAccess(address,arg));
+        OPERA_ASSERT_MSG(access != nullptr,"Unsupported broker type '" << broker_type << "'.")
+        delete _access;
+        _access = access;
+    }
+
+    //! \brief Whether an access has been configured
+    bool is_configured() const {
+        return _access != nullptr;
     }
 
     BrokerAccess const& get_access() const {
@@ -60,6 +72,9 @@ class BrokerAccessManager {
         return *_access;
     }
 
+  private:
+    BrokerAccessManager() : _access(nullptr) { }
+
   private:
     BrokerAccess* _access;
 };
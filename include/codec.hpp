@@ -0,0 +1,95 @@
+/***************************************************************************
+ *            codec.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPERA_CODEC_HPP
+#define OPERA_CODEC_HPP
+
+#include <ostream>
+#include <functional>
+#include "serialisation.hpp"
+#include "deserialisation.hpp"
+#include "binary_serialisation.hpp"
+#include "metrics.hpp"
+
+namespace Opera {
+
+//! \brief The encoding of the payload of messages exchanged through a broker
+enum class MessageEncoding { JSON, BINARY };
+
+inline std::ostream& operator<<(std::ostream& os, MessageEncoding const& encoding) {
+    switch (encoding) {
+        case MessageEncoding::JSON: return os << "JSON";
+        case MessageEncoding::BINARY: return os << "BINARY";
+        default: OPERA_FAIL_MSG("Unhandled MessageEncoding value for printing")
+    }
+}
+
+//! \brief The label identifying the kind of message in metrics
+template<class T> constexpr const char* message_label() {
+    if constexpr (std::is_same_v<T,BodyPresentationMessage>) return "body_presentation";
+    else if constexpr (std::is_same_v<T,HumanStateMessage>) return "human_state";
+    else if constexpr (std::is_same_v<T,RobotStateMessage>) return "robot_state";
+    else return "collision_notification";
+}
+
+//! \brief Encode the \a obj into a payload with the given \a encoding
+//! \details The payload is held by a buffer of the current thread, hence it is valid until the next encoding on the same thread
+template<class T> std::string_view encode(T const& obj, MessageEncoding const& encoding) {
+    if (encoding == MessageEncoding::BINARY) return BinarySerialiser<T>(obj).to_view();
+    else return Serialiser<T>(obj).to_view();
+}
+
+//! \brief Decode an object from the payload of the given \a size, with the given \a encoding
+//! \details The payload is read where it lies, hence it can be the buffer owned by the broker client
+template<class T> T decode(const char* payload, SizeType const& size, MessageEncoding const& encoding) {
+    static MetricsHistogram& decoding_seconds = MetricsRegistry::instance().histogram("opera_deserialisation_seconds","Time to decode an inbound message",
+                                                                                     MetricsRegistry::duration_bounds(),std::string("kind=\"")+message_label<T>()+"\"");
+    MetricsTimer timer(decoding_seconds);
+    if (encoding == MessageEncoding::BINARY) return BinaryDeserialiser<T>(payload,size).make();
+    else return StreamingDeserialiser<T>(payload,size).make();
+}
+
+//! \brief Extract the header of a state message from the payload of the given \a size, with the given \a encoding, without decoding the samples
+template<class T> MessageHeader peek(const char* payload, SizeType const& size, MessageEncoding const& encoding) {
+    if (encoding == MessageEncoding::BINARY) return BinaryDeserialiser<T>(payload,size).peek();
+    else return StreamingDeserialiser<T>(payload,size).peek();
+}
+
+//! \brief A predicate on the raw payload of a message, telling whether the message is to be decoded and delivered
+using PayloadFilter = std::function<bool(const char*,SizeType const&)>;
+
+//! \brief Make a filter on payloads of \a T with the given \a encoding that applies \a filter to their peeked header
+//! \details An empty filter gives an empty result, so that no payload is peeked
+template<class T> PayloadFilter make_payload_filter(MessageFilter const& filter, MessageEncoding const& encoding) {
+    if (not filter) return PayloadFilter();
+    return [filter,encoding](const char* payload, SizeType const& size) { return filter(peek<T>(payload,size,encoding)); };
+}
+
+}
+
+#endif //OPERA_CODEC_HPP
@@ -30,10 +30,13 @@
 #define OPERA_DESERIALISATION_HPP
 
 #include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/memorystream.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/istreamwrapper.h>
 #include <filesystem>
 #include <fstream>
+#include <cstring>
 #include "body.hpp"
 #include "message.hpp"
 #include "macros.hpp"
@@ -58,6 +61,12 @@ template<class T> class DeserialiserBase {
         OPERA_ASSERT_MSG(not _document.HasParseError(),"Parse error '" << _document.GetParseError() << "' at offset " << _document.GetErrorOffset())
     }
 
+    //! \brief Construct from the \a size characters of \a text, which needs not be null-terminated nor outlive the construction
+    DeserialiserBase(const char* text, SizeType const& size) {
+        _document.Parse(text,size);
+        OPERA_ASSERT_MSG(not _document.HasParseError(),"Parse error '" << _document.GetParseError() << "' at offset " << _document.GetErrorOffset())
+    }
+
     //! \brief Convert to string
     std::string to_string() const {
         rapidjson::StringBuffer buffer;
@@ -77,8 +86,89 @@ template<class T> class DeserialiserBase {
     rapidjson::Document _document;
 };
 
+//! \brief A pool of memory local to each thread, used as the parsing stack of streaming deserialisers
+//! \details The pool is cleared on destruction, hence in steady state parsing does not allocate
+class DeserialisationMemoryPool {
+  public:
+    //! \brief The size of the buffer reserved for each thread
+    static const SizeType BUFFER_SIZE = 4096;
+
+    //! \brief Acquire the pool of the current thread
+    DeserialisationMemoryPool();
+    DeserialisationMemoryPool(DeserialisationMemoryPool const&) = delete;
+    void operator=(DeserialisationMemoryPool const&) = delete;
+
+    //! \brief The allocator to use
+    rapidjson::MemoryPoolAllocator<>& allocator();
+
+    //! \brief Release the pool, clearing it
+    ~DeserialisationMemoryPool();
+  private:
+    rapidjson::MemoryPoolAllocator<>& _allocator;
+};
+
+//! \brief Base for a class deserialising a JSON file or string by streaming it into a handler, hence without building a document
+template<class T> class StreamingDeserialiserBase {
+  public:
+    StreamingDeserialiserBase(FilePath const& file) {
+        std::ifstream ifs(file);
+        OPERA_ASSERT_MSG(ifs.is_open(), "Could not open '" << file << "' file for reading.")
+        _buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        _text = _buffer.c_str();
+        _size = _buffer.size();
+    }
+
+    StreamingDeserialiserBase(const char* text) : _text(text), _size(std::strlen(text)) { }
+
+    //! \brief Construct from the \a size characters of \a text, which needs not be null-terminated
+    //! \details The text is parsed in place, hence it must outlive the deserialiser
+    StreamingDeserialiserBase(const char* text, SizeType const& size) : _text(text), _size(size) { }
+
+    StreamingDeserialiserBase(StreamingDeserialiserBase const&) = delete;
+    void operator=(StreamingDeserialiserBase const&) = delete;
+
+    //! \brief Make the object
+    virtual T make() const = 0;
+
+    virtual ~StreamingDeserialiserBase() = default;
+
+  protected:
+    //! \brief Parse the text by sending its events to the \a handler, which must be complete afterwards
+    template<class H> void _parse(H& handler) const {
+        DeserialisationMemoryPool pool;
+        rapidjson::GenericReader<rapidjson::UTF8<>,rapidjson::UTF8<>,rapidjson::MemoryPoolAllocator<>> reader(&pool.allocator());
+        rapidjson::MemoryStream stream(_text,_size);
+        reader.Parse(stream, handler);
+        OPERA_ASSERT_MSG(not reader.HasParseError(),"Parse error '" << reader.GetParseErrorCode() << "' at offset " << reader.GetErrorOffset())
+        OPERA_ASSERT_MSG(handler.complete(),"The description is incomplete.")
+    }
+
+    //! \brief Parse the text by sending its events to the \a handler, which may terminate the parsing as soon as it is complete
+    template<class H> void _peek(H& handler) const {
+        DeserialisationMemoryPool pool;
+        rapidjson::GenericReader<rapidjson::UTF8<>,rapidjson::UTF8<>,rapidjson::MemoryPoolAllocator<>> reader(&pool.allocator());
+        rapidjson::MemoryStream stream(_text,_size);
+        reader.Parse(stream, handler);
+        OPERA_ASSERT_MSG(not reader.HasParseError() or (reader.GetParseErrorCode() == rapidjson::kParseErrorTermination and handler.complete()),
+                         "Parse error '" << reader.GetParseErrorCode() << "' at offset " << reader.GetErrorOffset())
+        OPERA_ASSERT_MSG(handler.complete(),"The header is incomplete.")
+    }
+
+  private:
+    String _buffer;
+    const char* _text;
+    SizeType _size;
+};
+
 template<class T> class Deserialiser;
 
+//! \brief Converter to a message from a JSON description, streaming the text into the message where supported
+//! \details Falls back to the document-based deserialiser otherwise
+template<class T> class StreamingDeserialiser : public Deserialiser<T> {
+  public:
+    using Deserialiser<T>::Deserialiser;
+};
+
 //! \brief Converter to a BodyPresentationMessage from a JSON description file
 template<> class Deserialiser<BodyPresentationMessage> : public DeserialiserBase<BodyPresentationMessage> {
   public:
@@ -107,6 +197,24 @@ template<> class Deserialiser<CollisionNotificationMessage> : public Deserialise
     CollisionNotificationMessage make() const override;
 };
 
+//! \brief Converter to a HumanStateMessage from a JSON description, without building a document
+template<> class StreamingDeserialiser<HumanStateMessage> : public StreamingDeserialiserBase<HumanStateMessage> {
+  public:
+    using StreamingDeserialiserBase::StreamingDeserialiserBase;
+    HumanStateMessage make() const override;
+    //! \brief Extract the header only, skipping the samples
+    MessageHeader peek() const;
+};
+
+//! \brief Converter to a RobotStateMessage from a JSON description, without building a document
+template<> class StreamingDeserialiser<RobotStateMessage> : public StreamingDeserialiserBase<RobotStateMessage> {
+  public:
+    using StreamingDeserialiserBase::StreamingDeserialiserBase;
+    RobotStateMessage make() const override;
+    //! \brief Extract the header only, skipping the samples
+    MessageHeader peek() const;
+};
+
 }
 
 #endif //OPERA_DESERIALISATION_HPP
@@ -0,0 +1,154 @@
+/***************************************************************************
+ *            job_trace.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPERA_JOB_TRACE_HPP
+#define OPERA_JOB_TRACE_HPP
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "lookahead_job.hpp"
+#include "metrics.hpp"
+
+namespace Opera {
+
+//! \brief The transitions in the lifecycle of a job
+enum class JobEvent { CREATED, ENQUEUED, RESERVED, PROCESSED, SPLIT, SLEPT, AWAKENED, NOTIFIED };
+
+//! \brief The default number of events retained for each thread
+constexpr SizeType JOB_TRACE_DEFAULT_CAPACITY = 65536;
+
+//! \brief An event recorded for a job
+struct JobTraceEntry {
+    JobEvent event;
+    //! \brief The time in nanoseconds since tracing was enabled
+    uint64_t time;
+    //! \brief The key of the job, identifying it along with its initial time and path
+    std::string job;
+    //! \brief A value specific to the event, e.g., the number of jobs resulting from a split
+    SizeType value;
+};
+
+//! \brief A ring of the latest events recorded by one thread
+//! \details Only the owning thread records, hence the mutex is contended only when writing out
+class JobTraceBuffer {
+  public:
+    JobTraceBuffer(SizeType const& thread_index, std::string const& thread_name);
+
+    //! \brief Clear and size for \a capacity events
+    void reset(SizeType const& capacity);
+    //! \brief Record an \a entry, replacing the oldest one if full
+    void record(JobTraceEntry&& entry);
+    //! \brief The events retained, from the oldest
+    List<JobTraceEntry> entries() const;
+    //! \brief The number of events replaced since the last reset
+    SizeType num_dropped() const;
+
+    SizeType const& thread_index() const;
+    std::string const& thread_name() const;
+
+  private:
+    SizeType const _thread_index;
+    std::string const _thread_name;
+    List<JobTraceEntry> _entries;
+    SizeType _next;
+    SizeType _num_recorded;
+    mutable std::mutex _mux;
+};
+
+//! \brief A static tracer of the lifecycle of jobs, written in the Chrome trace-event format
+//! \details Perfetto and chrome://tracing load the output: waiting and sleeping are asynchronous spans
+//! for each job, processing is a span on the worker thread, and the other transitions are instants.
+//! Recording when disabled costs a relaxed atomic load only.
+class JobTracer {
+  private:
+    JobTracer();
+  public:
+    JobTracer(JobTracer const&) = delete;
+    void operator=(JobTracer const&) = delete;
+
+    //! \brief The singleton instance of this class
+    static JobTracer& instance() {
+        static JobTracer instance;
+        return instance;
+    }
+
+    //! \brief Start recording, retaining up to \a capacity events for each thread and discarding any previous event
+    void enable(SizeType const& capacity = JOB_TRACE_DEFAULT_CAPACITY);
+    //! \brief Stop recording, retaining the events
+    void disable();
+    //! \brief Whether recording
+    bool is_enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    //! \brief Record an \a event for the \a job, with an optional event-specific \a value
+    void record(JobEvent const& event, LookAheadJob const& job, SizeType const& value = 0) {
+        if (is_enabled()) _record(event, job, value);
+    }
+
+    //! \brief The number of events retained across threads
+    SizeType num_entries() const;
+    //! \brief The number of events replaced across threads since enabled
+    SizeType num_dropped() const;
+
+    //! \brief The events retained, in the Chrome trace-event JSON format
+    std::string to_json() const;
+    //! \brief Write the events retained to the file at \a path, replacing its content atomically
+    void write(std::string const& path) const;
+    //! \brief Write the events retained to the file at \a path every \a period_ms milliseconds, until stopped
+    void export_to_file(std::string const& path, SizeType const& period_ms = 1000);
+    //! \brief Stop any exporting
+    void stop_exporting();
+
+  private:
+    void _record(JobEvent const& event, LookAheadJob const& job, SizeType const& value);
+    //! \brief The buffer of the current thread, created on first use
+    JobTraceBuffer& _buffer();
+
+  private:
+    std::atomic<bool> _enabled;
+    std::atomic<SizeType> _capacity;
+    //! \brief The time when enabled, in nanoseconds since the epoch of the steady clock
+    std::atomic<int64_t> _start;
+    List<SharedPointer<JobTraceBuffer>> _buffers;
+    mutable std::mutex _mux;
+    SharedPointer<PeriodicFileExporter> _exporter;
+};
+
+//! \brief Records a job as reserved on construction and as processed on destruction
+class JobTraceScope {
+  public:
+    JobTraceScope(LookAheadJob const& job) : _job(job) { JobTracer::instance().record(JobEvent::RESERVED,_job); }
+    ~JobTraceScope() { JobTracer::instance().record(JobEvent::PROCESSED,_job); }
+  private:
+    LookAheadJob const& _job;
+};
+
+}
+
+#endif // OPERA_JOB_TRACE_HPP
@@ -37,11 +37,15 @@
 #include <cstring>
 #include <tuple>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <memory>
 #include <librdkafka/rdkafkacpp.h>
 
 #include "broker_access.hpp"
-#include "serialisation.hpp"
-#include "deserialisation.hpp"
+#include "codec.hpp"
 #include "thread.hpp"
 #include "conclog/include/logging.hpp"
 
@@ -49,11 +53,73 @@ using namespace ConcLog;
 
 namespace Opera {
 
+//! \brief The timeout in milliseconds when waiting for messages or delivery reports from Kafka
+//! \details It bounds the time taken by a publisher or subscriber to stop, while not spinning when there is nothing to serve
+static constexpr int KAFKA_POLL_TIMEOUT_MS = 100;
+
+//! \brief The compression codec for batches of messages produced to Kafka
+enum class KafkaCompression { NONE, GZIP, SNAPPY, LZ4, ZSTD };
+
+inline std::ostream& operator<<(std::ostream& os, KafkaCompression const& compression) {
+    switch (compression) {
+        case KafkaCompression::NONE: return os << "none";
+        case KafkaCompression::GZIP: return os << "gzip";
+        case KafkaCompression::SNAPPY: return os << "snappy";
+        case KafkaCompression::LZ4: return os << "lz4";
+        case KafkaCompression::ZSTD: return os << "zstd";
+        default: OPERA_FAIL_MSG("Unhandled KafkaCompression value for printing")
+    }
+}
+
+//! \brief Options for publishers to Kafka
+struct KafkaProducerOptions {
+    //! \brief The time in milliseconds to wait for accumulating messages into a batch
+    SizeType linger_ms = 5;
+    //! \brief The maximum number of messages in a batch
+    SizeType batch_num_messages = 10000;
+    //! \brief The compression of batches
+    KafkaCompression compression = KafkaCompression::NONE;
+    //! \brief Whether messages are keyed by body, leaving the choice of the partition to Kafka
+    //! \details When false, messages are published on the partition of the broker access
+    bool keyed = false;
+};
+
+//! \brief The key of a message for partitioning in Kafka, where an empty key means no key
+inline std::string_view kafka_key(BodyPresentationMessage const& msg) { return msg.id(); }
+inline std::string_view kafka_key(HumanStateMessage const& msg) { return msg.num_bodies() == 1 ? std::string_view(msg.body_id(0)) : std::string_view(); }
+inline std::string_view kafka_key(RobotStateMessage const& msg) { return msg.id(); }
+inline std::string_view kafka_key(CollisionNotificationMessage const& msg) { return msg.robot_id(); }
+
+//! \brief Callback for the delivery reports of a publisher, keeping track of the outcomes
+class KafkaDeliveryReportCallback : public RdKafka::DeliveryReportCb {
+  public:
+    void dr_cb(RdKafka::Message& message) override {
+        if (message.err() == RdKafka::ERR_NO_ERROR) ++_num_delivered;
+        else {
+            ++_num_failed;
+            CONCLOG_PRINTLN("Failed to deliver message to Kafka: " << message.errstr())
+        }
+    }
+
+    //! \brief The number of messages delivered
+    SizeType num_delivered() const { return _num_delivered; }
+    //! \brief The number of messages that failed delivery
+    SizeType num_failed() const { return _num_failed; }
+
+  private:
+    std::atomic<SizeType> _num_delivered = 0;
+    std::atomic<SizeType> _num_failed = 0;
+};
+
 //! \brief The publisher of objects to the Kafka broker
+//! \details Messages are produced asynchronously, while a background loop serves delivery reports and frees queue space
 template<class T> class KafkaPublisher : public PublisherInterface<T> {
   public:
-    KafkaPublisher(std::string const& topic, std::string const& brokers, std::string const& sasl_mechanism, std::string const& security_protocol,
-                   std::string const& sasl_username, std::string const& sasl_password) : _topic(topic) {
+    KafkaPublisher(std::string const& topic, int partition, std::string const& brokers, std::string const& sasl_mechanism, std::string const& security_protocol,
+                   std::string const& sasl_username, std::string const& sasl_password, MessageEncoding const& encoding = MessageEncoding::JSON,
+                   KafkaProducerOptions const& options = KafkaProducerOptions())
+        : _topic(topic), _partition(options.keyed ? RdKafka::Topic::PARTITION_UA : partition), _encoding(encoding), _keyed(options.keyed),
+          _num_dropped(0), _stopped(false) {
         RdKafka::Conf *conf = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
 
         std::string errstr;
@@ -63,34 +129,88 @@ template<class T> class KafkaPublisher : public PublisherInterface<T> {
         conf->set("security.protocol", security_protocol, errstr);
         conf->set("sasl.username", sasl_username, errstr);
         conf->set("sasl.password", sasl_password, errstr);
+        conf->set("linger.ms", std::to_string(options.linger_ms), errstr);
+        conf->set("batch.num.messages", std::to_string(options.batch_num_messages), errstr);
+        conf->set("compression.codec", to_string(options.compression), errstr);
+        conf->set("dr_cb", &_delivery_report, errstr);
 
         _producer = RdKafka::Producer::create(conf, errstr);
+        delete conf;
         OPERA_ASSERT_MSG(_producer,"Failed to create producer: " << errstr)
+
+        _thr = new Thread([this]{
+            while (not _stopped)
+                _producer->poll(KAFKA_POLL_TIMEOUT_MS);
+        }, "prdc");
     }
 
     void put(T const& obj) override {
-        auto s_obj = Serialiser<T>(obj).to_string();
-        auto resp = _producer->produce(_topic, 0, RdKafka::Producer::RK_MSG_COPY, const_cast<char *>(s_obj.c_str()), s_obj.size(),NULL, 0, 0, NULL);
-        OPERA_ASSERT_MSG(resp == RdKafka::ErrorCode::ERR_NO_ERROR,"Failed to publish: " << RdKafka::err2str(resp))
+        auto payload = encode(obj,_encoding);
+        _produce(payload,_key_of(obj));
     }
 
+    //! \brief The number of messages delivered
+    SizeType num_delivered() const { return _delivery_report.num_delivered(); }
+    //! \brief The number of messages that failed delivery
+    SizeType num_failed() const { return _delivery_report.num_failed(); }
+    //! \brief The number of messages dropped since the queue of the producer was full
+    SizeType num_dropped() const { return _num_dropped; }
+
     ~KafkaPublisher() {
+        _stopped = true;
+        delete _thr;
         _producer->flush(10000);
         delete _producer;
     }
 
+  private:
+    std::string_view _key_of(T const& obj) const { return _keyed ? kafka_key(obj) : std::string_view(); }
+
+    //! \brief Produce the \a payload, copied by the producer since encoding reuses its buffer, dropping it if the queue is still full after serving delivery reports
+    void _produce(std::string_view const& payload, std::string_view const& key) {
+        auto const* key_data = (key.empty() ? nullptr : key.data());
+        auto* data = const_cast<char*>(payload.data());
+        auto resp = _producer->produce(_topic, _partition, RdKafka::Producer::RK_MSG_COPY, data, payload.size(), key_data, key.size(), 0, nullptr);
+        if (resp == RdKafka::ERR__QUEUE_FULL) {
+            _producer->poll(0);
+            resp = _producer->produce(_topic, _partition, RdKafka::Producer::RK_MSG_COPY, data, payload.size(), key_data, key.size(), 0, nullptr);
+        }
+        if (resp == RdKafka::ERR__QUEUE_FULL) {
+            ++_num_dropped;
+            CONCLOG_PRINTLN("Dropped message to Kafka topic '" << _topic << "' since the queue is full")
+            return;
+        }
+        OPERA_ASSERT_MSG(resp == RdKafka::ErrorCode::ERR_NO_ERROR,"Failed to publish: " << RdKafka::err2str(resp))
+    }
+
   private:
     std::string const _topic;
+    int32_t const _partition;
+    MessageEncoding const _encoding;
+    bool const _keyed;
+    KafkaDeliveryReportCallback _delivery_report;
+    std::atomic<SizeType> _num_dropped;
+    std::atomic<bool> _stopped;
     RdKafka::Producer* _producer;
+    Thread* _thr;
 };
 
-//! \brief The subscriber to objects published to Kafka
+//! \brief Decode a message from Kafka, unless its payload is rejected by \a filter
+template<class T> std::optional<T> decode_kafka_message(RdKafka::Message const& message, MessageEncoding const& encoding, PayloadFilter const& filter) {
+    auto payload = static_cast<const char*>(message.payload());
+    if (filter and not filter(payload,message.len())) return std::nullopt;
+    return decode<T>(payload,message.len(),encoding);
+}
+
+//! \brief The subscriber to objects published to Kafka on a given partition
 template<class T> class KafkaSubscriber : public SubscriberInterface<T> {
   public:
     //! \brief Connects and starts the main asynchronous loop for getting messages
+    //! \details Payloads rejected by the optional \a filter are not decoded
     KafkaSubscriber(std::string const& topic, int partition, int64_t start_offset, CallbackFunction<T> const& callback,
                     std::string const& brokers, std::string const& sasl_mechanism, std::string const& security_protocol,
-                    std::string const& sasl_username, std::string const& sasl_password)
+                    std::string const& sasl_username, std::string const& sasl_password, MessageEncoding const& encoding = MessageEncoding::JSON,
+                    PayloadFilter const& filter = PayloadFilter())
         : _stopped(false), _partition(partition)
     {
         RdKafka::Conf *conf = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
@@ -114,12 +234,11 @@ template<class T> class KafkaSubscriber : public SubscriberInterface<T> {
         OPERA_ASSERT_MSG(resp == RdKafka::ERR_NO_ERROR,"Failed to start consumer: " << RdKafka::err2str(resp))
 
         _thr = new Thread([=,this]{
-            int timeout_ms = 1;
             while (not _stopped) {
-                RdKafka::Message* message = _consumer->consume(_topic,_partition,timeout_ms);
+                RdKafka::Message* message = _consumer->consume(_topic,_partition,KAFKA_POLL_TIMEOUT_MS);
                 if (message->err() == RdKafka::ERR_NO_ERROR) {
-                    Deserialiser<T> deserialiser(std::string((char *)message->payload(),message->len()).c_str());
-                    callback(deserialiser.make());
+                    auto obj = decode_kafka_message<T>(*message,encoding,filter);
+                    if (obj) callback(*obj);
                 }
                 delete message;
             }
@@ -135,13 +254,202 @@ template<class T> class KafkaSubscriber : public SubscriberInterface<T> {
     }
 
   protected:
-    bool _stopped;
+    std::atomic<bool> _stopped;
     Thread* _thr;
     int const _partition;
     RdKafka::Consumer* _consumer;
     RdKafka::Topic* _topic;
 };
 
+//! \brief Options for subscribers that are members of a Kafka consumer group
+struct KafkaConsumerGroupOptions {
+    //! \brief The id of the group, where an empty value means that no group is used
+    std::string group_id;
+    //! \brief The maximum number of messages consumed at once
+    SizeType batch_size;
+    //! \brief The minimum number of bytes that the broker should return for a fetch, where zero uses the Kafka default
+    SizeType fetch_min_bytes;
+    //! \brief The maximum number of bytes that the broker should return for a fetch, where zero uses the Kafka default
+    SizeType fetch_max_bytes;
+    //! \brief The number of threads decoding a batch along with the consumer thread
+    SizeType num_decoding_workers;
+};
+
+//! \brief A pool of threads for decoding batches of messages from Kafka
+//! \details The calling thread also takes part in decoding, while the results keep the order of the batch
+template<class T> class KafkaDecodingPool {
+    //! \brief The state of the batch being decoded, shared with the workers that may outlive its decoding
+    struct Batch {
+        Batch(List<RdKafka::Message*> const& msgs) : messages(msgs), results(msgs.size()), next(0), pending(msgs.size()) { }
+        List<RdKafka::Message*> const messages;
+        List<std::optional<T>> results;
+        std::atomic<SizeType> next;
+        std::atomic<SizeType> pending;
+    };
+  public:
+    KafkaDecodingPool(SizeType const& num_workers, MessageEncoding const& encoding, PayloadFilter const& filter)
+        : _encoding(encoding), _filter(filter), _generation(0), _stop(false) {
+        for (SizeType i=0; i<num_workers; ++i)
+            _workers.emplace_back(new Thread([this]{ _work(); }, "kdec" + std::to_string(i)));
+    }
+
+    //! \brief Decode the \a messages, with no value for those that have been filtered out
+    List<std::optional<T>> decode(List<RdKafka::Message*> const& messages) {
+        auto batch = std::make_shared<Batch>(messages);
+        {
+            std::lock_guard<std::mutex> lock(_mux);
+            _batch = batch;
+            ++_generation;
+        }
+        _work_available.notify_all();
+        _process(*batch);
+        {
+            std::unique_lock<std::mutex> lock(_mux);
+            _batch_done.wait(lock, [&batch]{ return batch->pending == 0; });
+            _batch.reset();
+        }
+        return std::move(batch->results);
+    }
+
+    ~KafkaDecodingPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mux);
+            _stop = true;
+        }
+        _work_available.notify_all();
+        _workers.clear();
+    }
+
+  private:
+    void _work() {
+        SizeType generation = 0;
+        while (true) {
+            SharedPointer<Batch> batch;
+            {
+                std::unique_lock<std::mutex> lock(_mux);
+                _work_available.wait(lock, [&]{ return _stop or (_batch != nullptr and _generation != generation); });
+                if (_stop) return;
+                generation = _generation;
+                batch = _batch;
+            }
+            _process(*batch);
+        }
+    }
+
+    void _process(Batch& batch) {
+        for (SizeType i = batch.next++; i < batch.messages.size(); i = batch.next++) {
+            auto obj = decode_kafka_message<T>(*batch.messages[i],_encoding,_filter);
+            if (obj) batch.results[i].emplace(std::move(*obj));
+            if (--batch.pending == 0) {
+                std::lock_guard<std::mutex> lock(_mux);
+                _batch_done.notify_all();
+            }
+        }
+    }
+
+  private:
+    MessageEncoding const _encoding;
+    PayloadFilter const _filter;
+    List<std::unique_ptr<Thread>> _workers;
+    SharedPointer<Batch> _batch;
+    SizeType _generation;
+    bool _stop;
+    std::mutex _mux;
+    std::condition_variable _work_available;
+    std::condition_variable _batch_done;
+};
+
+//! \brief The subscriber to objects published to Kafka, as a member of a consumer group
+//! \details Messages are consumed in batches from all the partitions assigned to the member, hence the order is
+//! preserved only within each partition; the callback is always called from the consumer thread
+template<class T> class KafkaGroupSubscriber : public SubscriberInterface<T> {
+  public:
+    //! \brief Connects, subscribes to the \a topic and starts the main asynchronous loop for getting messages
+    //! \details Payloads rejected by the optional \a filter are not decoded; the \a start_offset is used only
+    //! when the group has no committed offset
+    KafkaGroupSubscriber(std::string const& topic, int64_t start_offset, CallbackFunction<T> const& callback,
+                         std::string const& brokers, std::string const& sasl_mechanism, std::string const& security_protocol,
+                         std::string const& sasl_username, std::string const& sasl_password, KafkaConsumerGroupOptions const& options,
+                         MessageEncoding const& encoding = MessageEncoding::JSON, PayloadFilter const& filter = PayloadFilter())
+        : _stopped(false)
+    {
+        OPERA_PRECONDITION(not options.group_id.empty())
+        OPERA_PRECONDITION(options.batch_size > 0)
+        RdKafka::Conf *conf = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
+
+        std::string errstr;
+
+        conf->set("metadata.broker.list", brokers, errstr);
+        conf->set("sasl.mechanism", sasl_mechanism, errstr);
+        conf->set("security.protocol", security_protocol, errstr);
+        conf->set("sasl.username", sasl_username, errstr);
+        conf->set("sasl.password", sasl_password, errstr);
+        conf->set("group.id", options.group_id, errstr);
+        conf->set("auto.offset.reset", (start_offset == RdKafka::Topic::OFFSET_BEGINNING ? "earliest" : "latest"), errstr);
+        if (options.fetch_min_bytes > 0) conf->set("fetch.min.bytes", std::to_string(options.fetch_min_bytes), errstr);
+        if (options.fetch_max_bytes > 0) conf->set("fetch.max.bytes", std::to_string(options.fetch_max_bytes), errstr);
+
+        _consumer = RdKafka::KafkaConsumer::create(conf, errstr);
+        delete conf;
+        OPERA_ASSERT_MSG(_consumer, "Failed to create consumer: " << errstr)
+
+        RdKafka::ErrorCode resp = _consumer->subscribe({topic});
+        OPERA_ASSERT_MSG(resp == RdKafka::ERR_NO_ERROR,"Failed to subscribe to topic: " << RdKafka::err2str(resp))
+
+        if (options.num_decoding_workers > 0)
+            _pool.reset(new KafkaDecodingPool<T>(options.num_decoding_workers,encoding,filter));
+
+        _thr = new Thread([=,this]{
+            List<RdKafka::Message*> batch;
+            while (not _stopped) {
+                _consume_batch(batch,options.batch_size);
+                if (batch.empty()) continue;
+                if (_pool != nullptr) {
+                    for (auto const& obj : _pool->decode(batch))
+                        if (obj) callback(*obj);
+                } else {
+                    for (auto const& message : batch) {
+                        auto obj = decode_kafka_message<T>(*message,encoding,filter);
+                        if (obj) callback(*obj);
+                    }
+                }
+                for (auto const& message : batch) delete message;
+                batch.clear();
+            }
+        }, "cnsm");
+    }
+
+    virtual ~KafkaGroupSubscriber() {
+        _stopped = true;
+        delete _thr;
+        _pool.reset();
+        _consumer->close();
+        delete _consumer;
+    }
+
+  private:
+    //! \brief Fill \a batch with up to \a batch_size messages, waiting only for the first one
+    //! \details The following messages are taken from those already fetched by the client, without waiting
+    void _consume_batch(List<RdKafka::Message*>& batch, SizeType const& batch_size) {
+        int timeout_ms = KAFKA_POLL_TIMEOUT_MS;
+        while (batch.size() < batch_size) {
+            RdKafka::Message* message = _consumer->consume(timeout_ms);
+            if (message->err() != RdKafka::ERR_NO_ERROR) {
+                delete message;
+                return;
+            }
+            batch.push_back(message);
+            timeout_ms = 0;
+        }
+    }
+
+  protected:
+    std::atomic<bool> _stopped;
+    Thread* _thr;
+    RdKafka::KafkaConsumer* _consumer;
+    std::unique_ptr<KafkaDecodingPool<T>> _pool;
+};
+
 class KafkaBrokerAccess;
 
 //! \brief A builder class for the Kafka broker access,
@@ -165,6 +473,23 @@ class KafkaBrokerAccessBuilder {
     KafkaBrokerAccessBuilder& set_sasl_username(std::string const& sasl_username);
     //! \brief Set the SASL password
     KafkaBrokerAccessBuilder& set_sasl_password(std::string const& sasl_password);
+    //! \brief Set the encoding of the payload of messages (default: MessageEncoding::JSON)
+    KafkaBrokerAccessBuilder& set_encoding(MessageEncoding const& encoding);
+    //! \brief Set the consumer group for subscribers, which then consume from all the partitions assigned to them
+    //! \details The partition is ignored for subscribers in a group (default: no group)
+    KafkaBrokerAccessBuilder& set_consumer_group(std::string const& group_id);
+    //! \brief Set the maximum number of messages consumed at once by subscribers in a group (default: 64)
+    KafkaBrokerAccessBuilder& set_batch_size(SizeType const& batch_size);
+    //! \brief Set the minimum and maximum number of bytes returned by a fetch for subscribers in a group (default: Kafka defaults)
+    KafkaBrokerAccessBuilder& set_fetch_bytes(SizeType const& min_bytes, SizeType const& max_bytes);
+    //! \brief Set the number of threads decoding messages for each subscriber in a group (default: 0, i.e., decoding on the consumer thread)
+    KafkaBrokerAccessBuilder& set_num_decoding_workers(SizeType const& num_workers);
+    //! \brief Set the batching of publishers, waiting up to \a linger_ms milliseconds for accumulating up to \a batch_num_messages (default: 5, 10000)
+    KafkaBrokerAccessBuilder& set_batching(SizeType const& linger_ms, SizeType const& batch_num_messages);
+    //! \brief Set the compression of batches produced by publishers (default: KafkaCompression::NONE)
+    KafkaBrokerAccessBuilder& set_compression(KafkaCompression const& compression);
+    //! \brief Set whether publishers key messages by body, letting Kafka choose the partition from the key (default: false)
+    KafkaBrokerAccessBuilder& set_keyed(bool keyed);
 
     //! \brief Build the object
     KafkaBrokerAccess build() const;
@@ -178,6 +503,9 @@ class KafkaBrokerAccessBuilder {
     std::string _security_protocol;
     std::string _sasl_username;
     std::string _sasl_password;
+    MessageEncoding _encoding;
+    KafkaConsumerGroupOptions _group_options;
+    KafkaProducerOptions _producer_options;
 };
 
 //! \brief Access to a broker to handle Opera-specific messages using Kafka
@@ -185,17 +513,24 @@ class KafkaBrokerAccess : public BrokerAccessInterface {
     friend class KafkaBrokerAccessBuilder;
   protected:
     KafkaBrokerAccess(std::string const& brokers, int partition, int64_t start_offset, std::string const& topic_prefix,
-                      std::string const& sasl_mechanism, std::string const& security_protocol, std::string const& sasl_username, std::string const& sasl_password);
+                      std::string const& sasl_mechanism, std::string const& security_protocol, std::string const& sasl_username, std::string const& sasl_password,
+                      MessageEncoding const& encoding, KafkaConsumerGroupOptions const& group_options, KafkaProducerOptions const& producer_options);
   public:
     PublisherInterface<BodyPresentationMessage>* make_body_presentation_publisher(BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
     PublisherInterface<HumanStateMessage>* make_human_state_publisher(HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
     PublisherInterface<RobotStateMessage>* make_robot_state_publisher(RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
     PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
     SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
-    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
-    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
+    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
     SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
 
+  private:
+    //! \brief Make a publisher to \a topic
+    template<class T> PublisherInterface<T>* _make_publisher(std::string const& topic) const;
+    //! \brief Make a subscriber to \a topic, in the consumer group if any
+    template<class T> SubscriberInterface<T>* _make_subscriber(std::string const& topic, CallbackFunction<T> const& callback, PayloadFilter const& filter = PayloadFilter()) const;
+
   private:
     std::string const _brokers;
     int const _partition;
@@ -205,6 +540,9 @@ class KafkaBrokerAccess : public BrokerAccessInterface {
     std::string const _security_protocol;
     std::string const _sasl_username;
     std::string const _sasl_password;
+    MessageEncoding const _encoding;
+    KafkaConsumerGroupOptions const _group_options;
+    KafkaProducerOptions const _producer_options;
 };
 
 }
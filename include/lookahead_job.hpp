@@ -152,6 +152,10 @@ class LookAheadJobInterface {
     //! \details Returns -1 if no collision is found
     virtual int earliest_collision_index(RobotStateHistory const& robot_history) const = 0;
 
+    //! \brief Pin the snapshot time into the \a robot_history, so that its samples are not reclaimed while the job is alive
+    //! \details Must be called before the job is enqueued; has no effect if already pinned
+    virtual void pin_snapshot_time(SharedPointer<RobotStateHistory const> const& robot_history) const = 0;
+
     //! \brief Default virtual destructor
     virtual ~LookAheadJobInterface() = default;
 };
@@ -169,6 +173,7 @@ class LookAheadJobBase : public LookAheadJobInterface {
     BodySegmentSample const& human_sample() const;
     ModeTrace const& prediction_trace() const;
     LookAheadJobPath const& path() const;
+    void pin_snapshot_time(SharedPointer<RobotStateHistory const> const& robot_history) const override;
 
   protected:
     LookAheadJobIdentifier const _id;
@@ -177,6 +182,10 @@ class LookAheadJobBase : public LookAheadJobInterface {
     BodySegmentSample const _human_sample;
     ModeTrace const _prediction_trace;
     LookAheadJobPath const _path;
+  private:
+    //! \brief The history pinned, declared before the pin so that it outlives it
+    SharedPointer<RobotStateHistory const> mutable _pinned_history;
+    SnapshotTimePin mutable _snapshot_time_pin;
 };
 
 //! \brief A simple implementation where we restart from scratch each time, discarding prediction data from the previous iteration
@@ -187,15 +196,21 @@ class DiscardLookAheadJob : public LookAheadJobBase {
     int earliest_collision_index(RobotStateHistory const& robot_history) const override;
 };
 
+class LookAheadJobRegistryEntry;
+
 //! \brief Reuses prediction data by storing the segment sample representation in a barrier trace
+//! \details The job shares the job registry entry for its initial time, if any, so that the entry is kept as long as the job is alive
 class ReuseLookAheadJob : public LookAheadJobBase {
   public:
     ReuseLookAheadJob(LookAheadJobIdentifier const& id, TimestampType const& initial_time, TimestampType const& snapshot_time, BodySegmentSample const& human_sample, ModeTrace const& prediction_trace,
-                      LookAheadJobPath const& path, MinimumDistanceBarrierSequence const& barrier_sequence);
+                      LookAheadJobPath const& path, MinimumDistanceBarrierSequence const& barrier_sequence,
+                      SharedPointer<LookAheadJobRegistryEntry> const& registry_entry = nullptr);
     MinimumDistanceBarrierSequence const& barrier_sequence() const;
+    SharedPointer<LookAheadJobRegistryEntry> const& registry_entry() const;
     int earliest_collision_index(RobotStateHistory const& robot_history) const override;
   private:
     MinimumDistanceBarrierSequence mutable _barrier_sequence;
+    SharedPointer<LookAheadJobRegistryEntry> const _registry_entry;
 };
 
 //! \brief Enumeration for the available equivalence guarantee when reusing prediction data
@@ -220,6 +235,7 @@ class LookAheadJob : public Handle<LookAheadJobInterface> {
     LookAheadJobPath const& path() const { return _ptr->path(); }
 
     int earliest_collision_index(RobotStateHistory const& robot_history) const { return _ptr->earliest_collision_index(robot_history); };
+    void pin_snapshot_time(SharedPointer<RobotStateHistory const> const& robot_history) const { _ptr->pin_snapshot_time(robot_history); }
 
     friend std::ostream& operator<<(std::ostream& os, LookAheadJob const& j) {
         return os << "{id=" << j.id() << ", time=" << j.initial_time() << ", human_sample: " << j.human_sample() << ", trace: " << j.prediction_trace() << ", path: " << j.path() << "}"; }
@@ -51,6 +51,9 @@ class LookAheadJobFactoryInterface {
     virtual List<Pair<LookAheadJob,JobAwakeningResult>> awaken(LookAheadJob const& job, TimestampType const& time, BodySegmentSample const& human_sample, RobotStateHistory const& robot_history) const = 0;
     //! \brief Check if the \a path at \a id and \a timestamp has been registered
     virtual bool has_registered(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path) const = 0;
+    //! \brief Check if the path of \a job has been registered at its identifier and initial time
+    //! \details Differently from the timestamp-based lookup, this may use information held by the job to avoid searching the registry
+    virtual bool has_registered(LookAheadJob const& job) const = 0;
 
     //! \brief Default virtual destructor
     virtual ~LookAheadJobFactoryInterface() = default;
@@ -65,6 +68,7 @@ public:
     List<LookAheadJob> create_next_jobs(LookAheadJob const& job, RobotStateHistory const& robot_history) const { return _ptr->create_next(job, robot_history); }
     List<Pair<LookAheadJob,JobAwakeningResult>> awaken(LookAheadJob const& job, TimestampType const& time, BodySegmentSample const& human_sample, RobotStateHistory const& robot_history) const { return _ptr->awaken(job, time, human_sample, robot_history); }
     bool has_registered(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path) const { return _ptr->has_registered(timestamp,id,path); }
+    bool has_registered(LookAheadJob const& job) const { return _ptr->has_registered(job); }
 };
 
 //! \brief Base functionality for a look ahead job factory
@@ -81,6 +85,7 @@ class DiscardLookAheadJobFactory : public LookAheadJobFactoryBase {
     LookAheadJob create_new(LookAheadJobIdentifier const& id, TimestampType const& initial_time, BodySegmentSample const& human_sample, ModeTrace const& mode_trace, LookAheadJobPath const& path) const override;
     List<Pair<LookAheadJob,JobAwakeningResult>> awaken(LookAheadJob const& job, TimestampType const& time, BodySegmentSample const& human_sample, RobotStateHistory const& robot_history) const override;
     bool has_registered(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path) const override;
+    bool has_registered(LookAheadJob const& job) const override;
   protected:
     LookAheadJob create_from_existing(LookAheadJob const& job, ModeTrace const& new_mode_trace, LookAheadJobPath const& new_path) const override;
 };
@@ -92,6 +97,7 @@ class ReuseLookAheadJobFactory : public LookAheadJobFactoryBase {
     LookAheadJob create_new(LookAheadJobIdentifier const& id, TimestampType const& initial_time, BodySegmentSample const& human_sample, ModeTrace const& mode_trace, LookAheadJobPath const& path) const override;
     List<Pair<LookAheadJob,JobAwakeningResult>> awaken(LookAheadJob const& job, TimestampType const& time, BodySegmentSample const& human_sample, RobotStateHistory const& robot_history) const override;
     bool has_registered(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path) const override;
+    bool has_registered(LookAheadJob const& job) const override;
   protected:
     LookAheadJob create_from_existing(LookAheadJob const& job, ModeTrace const& new_mode_trace, LookAheadJobPath const& new_path) const override;
   private:
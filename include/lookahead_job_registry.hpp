@@ -29,16 +29,26 @@
 #ifndef OPERA_LOOKAHEAD_JOB_REGISTRY_HPP
 #define OPERA_LOOKAHEAD_JOB_REGISTRY_HPP
 
+#include <unordered_map>
+#include <atomic>
+#include <shared_mutex>
 #include "lookahead_job.hpp"
 
 namespace Opera {
 
+//! \brief The minimum number of entries in the job registry for which eviction is attempted
+const SizeType LOOKAHEAD_JOB_REGISTRY_MIN_EVICTION_SIZE = 2;
+
 //! \brief A node for a tree describing jobs that process a given human sample
+//! \details Children are held in a list that only grows, with insertion by compare-and-swap on its head:
+//! registration and lookup hence never lock. Nodes are released only when the tree is destroyed.
 class LookAheadJobTreeNode {
     using PriorityType = LookAheadJobPath::PriorityType;
   public:
     //! \brief Construct with a \a priority
     LookAheadJobTreeNode(PriorityType const& priority);
+    LookAheadJobTreeNode(LookAheadJobTreeNode const&) = delete;
+    void operator=(LookAheadJobTreeNode const&) = delete;
 
     //! \brief Try to register the element at \a depth according to the given \a path
     //! \return Whether the node can be registered
@@ -51,14 +61,22 @@ class LookAheadJobTreeNode {
     //! \brief Return the priority
     PriorityType priority() const;
 
+    //! \brief Destroy along with the children
+    ~LookAheadJobTreeNode();
+
   private:
-    PriorityType _priority;
-    bool _registered;
-    Set<LookAheadJobTreeNode> _children;
-};
+    //! \brief Find the child with the given \a priority starting \a from a child and stopping before \a until
+    LookAheadJobTreeNode* _find_child(PriorityType const& priority, LookAheadJobTreeNode* from, LookAheadJobTreeNode const* until) const;
+    //! \brief Find the child with the given \a priority, inserting it if not present
+    LookAheadJobTreeNode* _find_or_insert_child(PriorityType const& priority);
 
-//! \brief Comparison used for set ordering
-bool operator<(LookAheadJobTreeNode const& first, LookAheadJobTreeNode const& second);
+  private:
+    PriorityType const _priority;
+    std::atomic<bool> _registered;
+    std::atomic<LookAheadJobTreeNode*> _first_child;
+    //! \brief Assigned before the node is published as the first child of its parent, then never modified
+    LookAheadJobTreeNode* _next_sibling;
+};
 
 //! \brief A tree for the job registry for a given job id
 class LookAheadJobIdTree {
@@ -75,12 +93,13 @@ class LookAheadJobIdTree {
 
   private:
     LookAheadJobTreeNode _root;
-    std::mutex mutable _mux;
 };
 
 //! \brief An entry for the job registry
+//! \details The map of trees is guarded by a shared mutex that is taken exclusively only when a new identifier
+//! is added; once found, a tree is queried and modified without holding the mutex
 class LookAheadJobRegistryEntry {
-public:
+  public:
     //! \brief Create empty
     LookAheadJobRegistryEntry(TimestampType const& timestamp);
 
@@ -94,26 +113,50 @@ public:
     //! \brief Check if the \a path is registered at the given \a id
     bool has_registered(LookAheadJobIdentifier const& id, LookAheadJobPath const& path) const;
 
-private:
+  private:
+    //! \brief Find the tree for the given \a id, nullptr if not present
+    SharedPointer<LookAheadJobIdTree> _find_tree(LookAheadJobIdentifier const& id) const;
+
+  private:
     TimestampType _timestamp;
     Map<LookAheadJobIdentifier,SharedPointer<LookAheadJobIdTree>> _id_trees;
-    std::mutex mutable _mux;
+    mutable std::shared_mutex _mux;
 };
 
 //! \brief A registry that tracks valid jobs created from a job factory
 //! \details Given LookAheadJobPath information, the registry avoids to end up running
 //! the same working job(s) multiple times while keeping the remaining job manipulations
-//! fully distributed.
+//! fully distributed. Entries are indexed by timestamp and are shared with the jobs registered in them:
+//! when a new timestamp is added, entries older than the oldest one still shared with some job are evicted,
+//! or all entries but the latest if none is shared. Eviction scans the entries only once their number
+//! doubled since the previous eviction, so that its cost is amortised over the insertions.
 class LookAheadJobRegistry {
   public:
+    //! \brief Create empty
+    LookAheadJobRegistry();
+
+    //! \brief Get the entry at the given \a timestamp, creating it if necessary
+    //! \details Fails if the timestamp is older than the latest one, still not evicted and not present, since
+    //! jobs should be registered in order of time
+    SharedPointer<LookAheadJobRegistryEntry> entry(TimestampType const& timestamp);
+
     //! \brief Try to register the given \a path at the given \a timestamp and job \a id
     //! \return True if registered successfully, false if the job should not be created
     bool try_register(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path);
 
     //! \brief Check if the \a path is registered at the given \a id and \a timestamp
     bool has_registered(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path) const;
+
+    //! \brief The number of entries currently held
+    SizeType size() const;
+  private:
+    //! \brief Remove the entries older than the oldest one shared with some job, or older than the latest if none is shared
+    void _evict_unused_entries();
   private:
-    Deque<LookAheadJobRegistryEntry> _entries;
+    std::unordered_map<TimestampType,SharedPointer<LookAheadJobRegistryEntry>> _entries;
+    TimestampType _latest_timestamp;
+    TimestampType _evicted_before;
+    SizeType _eviction_size;
     std::mutex mutable _mux;
 };
 
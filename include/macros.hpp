@@ -31,6 +31,7 @@
 
 #include <sstream>
 #include <stdexcept>
+#include "config.hpp"
 
 using StringStream = std::stringstream;
 
@@ -135,6 +136,40 @@ using StringStream = std::stringstream;
         } \
     } \
 
+//! \brief The diagnostics retained in designated hot paths: 0 removes logging and contract checks,
+//! 1 retains contract checks only, 2 retains both
+#ifndef OPERA_DIAGNOSTICS_LEVEL
+#define OPERA_DIAGNOSTICS_LEVEL 2
+#endif
+
+#if OPERA_DIAGNOSTICS_LEVEL >= 1
+#define OPERA_HOT_PRECONDITION(expression) \
+    OPERA_PRECONDITION(expression)
+#define OPERA_HOT_ASSERT_MSG(expression,error) \
+    OPERA_ASSERT_MSG(expression,error)
+#else
+#define OPERA_HOT_PRECONDITION(expression) \
+    { }
+#define OPERA_HOT_ASSERT_MSG(expression,error) \
+    { }
+#endif
+
+#if OPERA_DIAGNOSTICS_LEVEL >= 2
+#define OPERA_HOT_SCOPE_CREATE \
+    CONCLOG_SCOPE_CREATE
+#define OPERA_HOT_PRINTLN(text) \
+    CONCLOG_PRINTLN(text)
+#define OPERA_HOT_PRINTLN_AT(level,text) \
+    CONCLOG_PRINTLN_AT(level,text)
+#else
+#define OPERA_HOT_SCOPE_CREATE \
+    { }
+#define OPERA_HOT_PRINTLN(text) \
+    { }
+#define OPERA_HOT_PRINTLN_AT(level,text) \
+    { }
+#endif
+
 #define OPERA_ASSERT_EQUAL(expression1,expression2)    \
     { \
         bool assertion_result = static_cast<bool>((expression1) == (expression2));       \
@@ -37,17 +37,101 @@
 #include <cstring>
 #include <tuple>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "thread.hpp"
 
 #include "broker_access.hpp"
 
 namespace Opera {
 
+//! \brief A bounded ring of shared messages, each identified by an increasing sequence number
+//! \details When the ring is full, putting a message discards the oldest one
+template<class T> class MemoryRing {
+  public:
+    //! \brief Construct with the maximum number of messages held
+    MemoryRing(SizeType const& capacity) : _messages(capacity), _begin(0), _end(0), _num_skipped(0) {
+        OPERA_PRECONDITION(capacity > 0)
+    }
+
+    //! \brief Put a message, waking the waiting subscribers
+    void put(SharedPointer<T const> const& msg) {
+        {
+            std::lock_guard<std::mutex> lock(_mux);
+            _messages[_end % _messages.size()] = msg;
+            ++_end;
+            if (_end - _begin > _messages.size()) ++_begin;
+        }
+        _available.notify_all();
+    }
+
+    //! \brief The number of messages held
+    SizeType size() const { std::lock_guard<std::mutex> lock(_mux); return _end - _begin; }
+    //! \brief The sequence number of the next message put
+    SizeType end() const { std::lock_guard<std::mutex> lock(_mux); return _end; }
+    //! \brief The maximum number of messages held
+    SizeType capacity() const { std::lock_guard<std::mutex> lock(_mux); return _messages.size(); }
+    //! \brief The number of messages skipped by subscribers since already discarded, summed across subscribers
+    SizeType num_skipped() const { std::lock_guard<std::mutex> lock(_mux); return _num_skipped; }
+
+    //! \brief Wait until there are messages from \a cursor or \a stopped holds, then append them to \a messages
+    //! while moving the \a cursor past them
+    //! \returns The number of messages skipped since they had already been discarded
+    SizeType take(SizeType& cursor, List<SharedPointer<T const>>& messages, std::atomic<bool> const& stopped) {
+        std::unique_lock<std::mutex> lock(_mux);
+        _available.wait(lock, [&]{ return stopped or _end > cursor; });
+        SizeType skipped = 0;
+        if (cursor < _begin) {
+            skipped = _begin - cursor;
+            cursor = _begin;
+            _num_skipped += skipped;
+        }
+        for (; cursor < _end; ++cursor)
+            messages.push_back(_messages[cursor % _messages.size()]);
+        return skipped;
+    }
+
+    //! \brief Wake all the waiting subscribers, e.g., for them to check if they are stopped
+    void wake() {
+        { std::lock_guard<std::mutex> lock(_mux); }
+        _available.notify_all();
+    }
+
+    //! \brief Discard all messages and reset the number of skipped ones, while preserving the sequence numbers
+    void clear() {
+        std::lock_guard<std::mutex> lock(_mux);
+        for (auto& msg : _messages) msg.reset();
+        _begin = _end;
+        _num_skipped = 0;
+    }
+
+    //! \brief Change the \a capacity, discarding all messages
+    void set_capacity(SizeType const& capacity) {
+        OPERA_PRECONDITION(capacity > 0)
+        std::lock_guard<std::mutex> lock(_mux);
+        _messages = List<SharedPointer<T const>>(capacity);
+        _begin = _end;
+        _num_skipped = 0;
+    }
+
+  private:
+    List<SharedPointer<T const>> _messages;
+    SizeType _begin;
+    SizeType _end;
+    SizeType _num_skipped;
+    mutable std::mutex _mux;
+    std::condition_variable _available;
+};
+
+//! \brief The default number of messages held by the memory broker for each type
+static constexpr SizeType MEMORY_BROKER_DEFAULT_CAPACITY = 4096;
+
 //! \brief A static class to hold messages synchronously using memory
-//! \details Messages are accumulated indefinitely
+//! \details Messages are held in bounded rings, one for each message type
 class MemoryBroker {
   private:
-    MemoryBroker() = default;
+    MemoryBroker();
   public:
     MemoryBroker(MemoryBroker const&) = delete;
     void operator=(MemoryBroker const&) = delete;
@@ -58,25 +142,30 @@ class MemoryBroker {
         return instance;
     }
 
-    //! \brief Put a message in memory
-    template<class T> void put(T const& msg);
+    //! \brief Put a message in memory, shared by all the subscribers
+    template<class T> void put(T const& msg) { ring<T>().put(std::make_shared<T const>(msg)); }
 
-    //! \brief Get the \a idx element in the template argument list
-    template<class T> T get(SizeType const& idx) const;
+    //! \brief Number of messages held of the template argument type
+    template<class T> SizeType size() const { return ring<T>().size(); }
+    //! \brief Number of messages of the template argument type skipped by subscribers that fell behind
+    template<class T> SizeType num_skipped() const { return ring<T>().num_skipped(); }
 
-    //! \brief Size of template argument list
-    template<class T> SizeType size() const;
+    //! \brief The ring for the template argument type
+    template<class T> MemoryRing<T>& ring();
+    template<class T> MemoryRing<T> const& ring() const;
 
     //! \brief Remove all content
     //! \details Useful to clean up between tests
     void clear();
 
+    //! \brief Set the maximum number of messages held for each type, removing all content
+    void set_capacity(SizeType const& capacity);
+
   private:
-    List<BodyPresentationMessage> _body_presentations;
-    List<HumanStateMessage> _human_states;
-    List<RobotStateMessage> _robot_states;
-    List<CollisionNotificationMessage> _collision_notifications;
-    mutable std::mutex _mux;
+    MemoryRing<BodyPresentationMessage> _body_presentations;
+    MemoryRing<HumanStateMessage> _human_states;
+    MemoryRing<RobotStateMessage> _robot_states;
+    MemoryRing<CollisionNotificationMessage> _collision_notifications;
 };
 
 //! \brief The publisher of objects to memory
@@ -86,30 +175,40 @@ template<class T> class MemoryPublisher : public PublisherInterface<T> {
 };
 
 //! \brief The subscriber to objects published to memory
-//! \details The advancement of acquisition is local to the subscriber, but for simplicity
-//! a new subscriber starts from the beginning of memory content
+//! \details The subscriber waits for new messages and receives those published since its construction;
+//! if it falls behind by more than the capacity of the broker, the oldest messages are skipped
 template<class T> class MemorySubscriber : public SubscriberInterface<T> {
   public:
     //! \brief Constructor
-    MemorySubscriber(CallbackFunction<T> const& callback) : _next_index(MemoryBroker::instance().size<T>()), _exit_future(_exit_promise.get_future()), _callback(callback),
+    //! \details Messages rejected by the optional \a accept predicate are not delivered
+    MemorySubscriber(CallbackFunction<T> const& callback, std::function<bool(T const&)> const& accept = std::function<bool(T const&)>()) :
+                                                            _cursor(MemoryBroker::instance().ring<T>().end()), _num_skipped(0), _stopped(false), _callback(callback), _accept(accept),
                                                             _thr(Thread([&] {
-            while (_exit_future.wait_for(std::chrono::microseconds(100)) == std::future_status::timeout) {
-                while (MemoryBroker::instance().size<T>() > _next_index) {
-                    _callback(MemoryBroker::instance().get<T>(_next_index));
-                    _next_index++;
-                }
+            auto& ring = MemoryBroker::instance().ring<T>();
+            List<SharedPointer<T const>> messages;
+            while (true) {
+                _num_skipped += ring.take(_cursor,messages,_stopped);
+                if (_stopped) return;
+                for (auto const& msg : messages)
+                    if (not _accept or _accept(*msg)) _callback(*msg);
+                messages.clear();
             }
         },"mem_sub")) { }
 
+    //! \brief The number of messages skipped since already discarded by the broker
+    SizeType num_skipped() const { return _num_skipped; }
+
     ~MemorySubscriber() {
-        _exit_promise.set_value();
+        _stopped = true;
+        MemoryBroker::instance().ring<T>().wake();
     }
 
   protected:
-    SizeType _next_index;
-    std::promise<void> _exit_promise;
-    std::future<void> _exit_future;
+    SizeType _cursor;
+    std::atomic<SizeType> _num_skipped;
+    std::atomic<bool> _stopped;
     CallbackFunction<T> const _callback;
+    std::function<bool(T const&)> const _accept;
     Thread const _thr;
 };
 
@@ -121,8 +220,8 @@ class MemoryBrokerAccess : public BrokerAccessInterface {
     PublisherInterface<RobotStateMessage>* make_robot_state_publisher(RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
     PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
     SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
-    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
-    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
+    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
     SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
 };
 
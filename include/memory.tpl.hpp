@@ -33,35 +33,15 @@
 
 namespace Opera {
 
-template<> void MemoryBroker::put<BodyPresentationMessage>(BodyPresentationMessage const& msg) {
-    std::lock_guard<std::mutex> lock(_mux);
-    _body_presentations.push_back(msg);
-}
-
-template<> void MemoryBroker::put<HumanStateMessage>(HumanStateMessage const& msg) {
-    std::lock_guard<std::mutex> lock(_mux);
-    _human_states.push_back(msg);
-}
-
-template<> void MemoryBroker::put<RobotStateMessage>(RobotStateMessage const& msg) {
-    std::lock_guard<std::mutex> lock(_mux);
-    _robot_states.push_back(msg);
-}
-
-template<> void MemoryBroker::put<CollisionNotificationMessage>(CollisionNotificationMessage const& msg) {
-    std::lock_guard<std::mutex> lock(_mux);
-    _collision_notifications.push_back(msg);
-}
-
-template<> BodyPresentationMessage MemoryBroker::get<BodyPresentationMessage>(SizeType const& idx) const { std::lock_guard<std::mutex> lock(_mux); return _body_presentations.at(idx); }
-template<> HumanStateMessage MemoryBroker::get<HumanStateMessage>(SizeType const& idx) const { std::lock_guard<std::mutex> lock(_mux); return _human_states.at(idx); }
-template<> RobotStateMessage MemoryBroker::get<RobotStateMessage>(SizeType const& idx) const { std::lock_guard<std::mutex> lock(_mux); return _robot_states.at(idx); }
-template<> CollisionNotificationMessage MemoryBroker::get<CollisionNotificationMessage>(SizeType const& idx) const { std::lock_guard<std::mutex> lock(_mux); return _collision_notifications.at(idx); }
-
-template<> SizeType MemoryBroker::size<BodyPresentationMessage>() const { std::lock_guard<std::mutex> lock(_mux); return _body_presentations.size(); }
-template<> SizeType MemoryBroker::size<HumanStateMessage>() const { std::lock_guard<std::mutex> lock(_mux); return _human_states.size(); }
-template<> SizeType MemoryBroker::size<RobotStateMessage>() const { std::lock_guard<std::mutex> lock(_mux); return _robot_states.size(); }
-template<> SizeType MemoryBroker::size<CollisionNotificationMessage>() const { std::lock_guard<std::mutex> lock(_mux); return _collision_notifications.size(); }
+template<> MemoryRing<BodyPresentationMessage>& MemoryBroker::ring<BodyPresentationMessage>() { return _body_presentations; }
+template<> MemoryRing<HumanStateMessage>& MemoryBroker::ring<HumanStateMessage>() { return _human_states; }
+template<> MemoryRing<RobotStateMessage>& MemoryBroker::ring<RobotStateMessage>() { return _robot_states; }
+template<> MemoryRing<CollisionNotificationMessage>& MemoryBroker::ring<CollisionNotificationMessage>() { return _collision_notifications; }
+
+template<> MemoryRing<BodyPresentationMessage> const& MemoryBroker::ring<BodyPresentationMessage>() const { return _body_presentations; }
+template<> MemoryRing<HumanStateMessage> const& MemoryBroker::ring<HumanStateMessage>() const { return _human_states; }
+template<> MemoryRing<RobotStateMessage> const& MemoryBroker::ring<RobotStateMessage>() const { return _robot_states; }
+template<> MemoryRing<CollisionNotificationMessage> const& MemoryBroker::ring<CollisionNotificationMessage>() const { return _collision_notifications; }
 
 }
 
@@ -29,6 +29,9 @@
 #ifndef OPERA_MESSAGE_HPP
 #define OPERA_MESSAGE_HPP
 
+#include <functional>
+#include <span>
+#include <string_view>
 #include "handle.hpp"
 #include "geometry.hpp"
 #include "interval.hpp"
@@ -68,38 +71,120 @@ class BodyPresentationMessage {
 
 using HumanStateMessageBodyType = Pair<BodyIdType,Map<KeypointIdType,List<Point>>>;
 
+//! \brief The fields identifying a state message, which can be read before fully decoding the message
+struct MessageHeader {
+    //! \brief The ids of the bodies whose state is carried
+    List<BodyIdType> body_ids;
+    //! \brief The timestamp associated with the message
+    TimestampType timestamp;
+};
+
+//! \brief A predicate on the header of a state message, telling whether the message is to be decoded and delivered
+using MessageFilter = std::function<bool(MessageHeader const&)>;
+
+//! \brief The names of the keypoints of a body, shared among all the bodies that list the same names in the same order
+using KeypointIdsType = SharedPointer<List<KeypointIdType> const>;
+
 //! \brief A representation of an inbound message for the state of a human
+//! \details The samples of all the keypoints of all the bodies are held in one buffer, with offset tables
+//! for bodies and keypoints, while keypoint names are shared between bodies with the same template
 class HumanStateMessage {
+    friend class HumanStateMessageBuilder;
   public:
     //! \brief Construct from fields
     HumanStateMessage(List<HumanStateMessageBodyType> const& bodies, TimestampType const& timestamp);
-    //! \brief The bodies
-    List<Pair<BodyIdType,Map<KeypointIdType,List<Point>>>> const& bodies() const;
+    //! \brief The number of bodies
+    SizeType num_bodies() const;
+    //! \brief The id of the \a body
+    BodyIdType const& body_id(SizeType const& body) const;
+    //! \brief The names of the keypoints of the \a body, in the order of their indices
+    List<KeypointIdType> const& keypoint_ids(SizeType const& body) const;
+    //! \brief The shared names of the keypoints of the \a body
+    //! \details Bodies with the same template recently decoded by the same thread share the same pointer,
+    //! allowing to cache what is resolved from the names
+    KeypointIdsType const& shared_keypoint_ids(SizeType const& body) const;
+    //! \brief The samples of the \a keypoint of the \a body
+    std::span<Point const> samples(SizeType const& body, SizeType const& keypoint) const;
+    //! \brief The bodies, rebuilt as keypoint maps
+    //! \details This allocates each body, hence it is meant for inspection rather than ingestion
+    List<HumanStateMessageBodyType> bodies() const;
     //! \brief The timestamp associated with the message
     TimestampType const& timestamp() const;
+    //! \brief The header of the message
+    MessageHeader header() const;
+  private:
+    HumanStateMessage(List<BodyIdType>&& body_ids, List<KeypointIdsType>&& keypoint_ids, List<SizeType>&& keypoint_offsets,
+                      List<SizeType>&& sample_offsets, List<Point>&& samples, TimestampType const& timestamp);
   private:
-    List<HumanStateMessageBodyType> const _bodies;
-    TimestampType const _timestamp;
+    List<BodyIdType> _body_ids;
+    List<KeypointIdsType> _keypoint_ids;
+    List<SizeType> _keypoint_offsets;
+    List<SizeType> _sample_offsets;
+    List<Point> _samples;
+    TimestampType _timestamp;
+};
+
+//! \brief Incremental construction of a HumanStateMessage, body by body and keypoint by keypoint
+//! \details Keypoint names are resolved against the names of the previous body, hence they are allocated
+//! only when a body with a different template is found
+class HumanStateMessageBuilder {
+  public:
+    //! \brief Construct empty
+    HumanStateMessageBuilder();
+    //! \brief Start a new body with the given \a id
+    void add_body(BodyIdType const& id);
+    //! \brief Set the \a id of the current body, when known only after its keypoints
+    void set_body_id(BodyIdType const& id);
+    //! \brief Start a new keypoint with the given \a id for the current body
+    void add_keypoint(std::string_view const& id);
+    //! \brief Add a sample to the current keypoint
+    void add_sample(Point const& point);
+    //! \brief Build the message with the given \a timestamp, consuming the content
+    HumanStateMessage build(TimestampType const& timestamp);
+  private:
+    void _close_body();
+  private:
+    List<BodyIdType> _body_ids;
+    List<KeypointIdsType> _keypoint_ids;
+    List<SizeType> _keypoint_offsets;
+    List<SizeType> _sample_offsets;
+    List<Point> _samples;
+    KeypointIdsType _candidate_keypoint_ids;
+    SizeType _num_body_keypoints;
+    bool _candidate_matches;
+    List<KeypointIdType> _body_keypoint_ids;
 };
 
 //! \brief A representation of an inbound message for the state of a robot
+//! \details The samples of all the points are held in one buffer, with an offset table for points
 class RobotStateMessage {
   public:
     //! \brief Construct from an id, a mode, a list of samples for each point, and a \a timestamp
     RobotStateMessage(BodyIdType const& id, Mode const& mode, List<List<Point>> const& points, TimestampType const& timestamp);
+    //! \brief Construct from an id, a mode, the \a samples of all points, the offsets of each point within the samples, and a \a timestamp
+    //! \details The offsets include the end of the samples, hence there is one more offset than points
+    RobotStateMessage(BodyIdType const& id, Mode const& mode, List<Point>&& samples, List<SizeType>&& offsets, TimestampType const& timestamp);
     //! \brief The id of the related body
     BodyIdType const& id() const;
     //! \brief The mode
     Mode const& mode() const;
-    //! \brief The samples for each point
-    List<List<Point>> const& points() const;
+    //! \brief The number of points
+    SizeType num_points() const;
+    //! \brief The samples of the \a point
+    std::span<Point const> samples(SizeType const& point) const;
+    //! \brief The samples for each point, rebuilt as lists
+    //! \details This allocates each point, hence it is meant for inspection rather than ingestion
+    List<List<Point>> points() const;
     //! \brief The timestamp associated with the message
     TimestampType const& timestamp() const;
+    //! \brief The header of the message
+    MessageHeader header() const;
   private:
-    BodyIdType const _id;
-    Mode const _mode;
-    List<List<Point>> const _points;
-    TimestampType const _timestamp;
+    BodyIdType _id;
+    Mode _mode;
+    List<Point> _samples;
+    List<SizeType> _offsets;
+    TimestampType _timestamp;
 };
 
 //! \brief A representation of an outbound message for a detected collision
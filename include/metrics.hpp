@@ -0,0 +1,199 @@
+/***************************************************************************
+ *            metrics.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPERA_METRICS_HPP
+#define OPERA_METRICS_HPP
+
+#include <string>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "thread.hpp"
+#include "declarations.hpp"
+#include "utility.hpp"
+
+namespace Opera {
+
+//! \brief The number of shards of each metric, among which threads are distributed to avoid contention on updates
+constexpr SizeType METRICS_NUM_SHARDS = 16;
+
+//! \brief The index of the shard for the current thread
+//! \details Threads are assigned shards in a round-robin fashion on their first update of any metric
+SizeType metrics_shard_index();
+
+//! \brief A monotonically increasing counter, with one value for each shard
+class MetricsCounter {
+  public:
+    //! \brief Increase by \a amount
+    void add(uint64_t const& amount = 1) { _shards[metrics_shard_index()].value.fetch_add(amount,std::memory_order_relaxed); }
+    //! \brief The total value across shards
+    uint64_t value() const;
+  private:
+    struct alignas(64) Shard { std::atomic<uint64_t> value = 0; };
+    std::array<Shard,METRICS_NUM_SHARDS> _shards;
+};
+
+//! \brief A histogram of observed values over fixed buckets, with counts and sums for each shard
+class MetricsHistogram {
+  public:
+    //! \brief Construct with the increasing upper \a bounds of the buckets, to which a bucket for larger values is added
+    MetricsHistogram(List<FloatType> const& bounds);
+
+    //! \brief Observe the \a value
+    void observe(FloatType const& value);
+
+    //! \brief The upper bounds of the buckets
+    List<FloatType> const& bounds() const;
+    //! \brief The number of values observed within each bound, cumulatively, followed by the total number of values
+    List<uint64_t> cumulative_counts() const;
+    //! \brief The sum of the values observed
+    FloatType sum() const;
+
+  private:
+    struct alignas(64) Shard {
+        Shard(SizeType const& num_buckets);
+        std::unique_ptr<std::atomic<uint64_t>[]> counts;
+        std::atomic<FloatType> sum;
+    };
+    List<FloatType> const _bounds;
+    List<std::unique_ptr<Shard>> _shards;
+};
+
+//! \brief Observes into a histogram the time in seconds from its construction to its destruction
+class MetricsTimer {
+  public:
+    MetricsTimer(MetricsHistogram& histogram) : _histogram(histogram), _start(std::chrono::steady_clock::now()) { }
+    ~MetricsTimer() { _histogram.observe(std::chrono::duration<FloatType>(std::chrono::steady_clock::now() - _start).count()); }
+  private:
+    MetricsHistogram& _histogram;
+    std::chrono::steady_clock::time_point const _start;
+};
+
+class PeriodicFileExporter;
+class MetricsHttpEndpoint;
+
+//! \brief A static registry of the metrics of the process, exported in the Prometheus text format
+//! \details Counters and histograms live as long as the process, hence references to them can be kept in static variables;
+//! gauges are instead sampled at export time and are removed by their owner
+class MetricsRegistry {
+  private:
+    MetricsRegistry() = default;
+  public:
+    MetricsRegistry(MetricsRegistry const&) = delete;
+    void operator=(MetricsRegistry const&) = delete;
+
+    //! \brief The singleton instance of this class
+    static MetricsRegistry& instance() {
+        static MetricsRegistry instance;
+        return instance;
+    }
+
+    //! \brief The counter with the given \a name and \a labels, created with the given \a help if not existing
+    //! \details Labels are given in the exposition format, e.g., kind="human"
+    MetricsCounter& counter(std::string const& name, std::string const& help, std::string const& labels = std::string());
+    //! \brief The histogram with the given \a name and \a labels, created with the given \a help and \a bounds if not existing
+    MetricsHistogram& histogram(std::string const& name, std::string const& help, List<FloatType> const& bounds, std::string const& labels = std::string());
+
+    //! \brief Add a gauge with the given \a name and \a labels, whose value is obtained from \a sampler at export time
+    //! \returns The identifier to remove the gauge with
+    SizeType add_gauge(std::string const& name, std::string const& help, std::function<FloatType()> const& sampler, std::string const& labels = std::string());
+    //! \brief Remove the gauge with the given \a identifier
+    //! \details Waits for any sampling in progress to complete, so that the sampler is not called afterwards
+    void remove_gauge(SizeType const& identifier);
+
+    //! \brief All the metrics in the Prometheus text format
+    //! \details Gauges are sampled without holding the lock on the registry, hence samplers may acquire locks under which metrics are resolved
+    std::string to_text() const;
+    //! \brief Write all the metrics to the file at \a path, replacing its content atomically
+    void write(std::string const& path) const;
+
+    //! \brief Write all the metrics to the file at \a path every \a period_ms milliseconds, until stopped
+    void export_to_file(std::string const& path, SizeType const& period_ms = 1000);
+    //! \brief Serve all the metrics over HTTP on the local \a port, until stopped
+    void serve(int port);
+    //! \brief Stop any exporting
+    void stop_exporting();
+
+    //! \brief Bounds for durations in seconds, exponentially spaced from 1 microsecond to about 10 seconds
+    static List<FloatType> duration_bounds();
+    //! \brief Bounds for sizes, exponentially spaced from 1 to about one million
+    static List<FloatType> size_bounds();
+
+  private:
+    struct Family {
+        std::string help;
+        std::string type;
+        Map<std::string,SharedPointer<MetricsCounter>> counters;
+        Map<std::string,SharedPointer<MetricsHistogram>> histograms;
+        Map<SizeType,Pair<std::string,std::function<FloatType()>>> gauges;
+    };
+    //! \brief The family with the given \a name, created with the given \a help and \a type if not existing
+    Family& _family(std::string const& name, std::string const& help, std::string const& type);
+
+  private:
+    Map<std::string,Family> _families;
+    SizeType _next_gauge_identifier = 0;
+    mutable std::mutex _mux;
+    //! \brief The number of exports currently sampling gauges
+    mutable SizeType _num_samplings = 0;
+    mutable std::condition_variable _sampling_condition;
+    SharedPointer<PeriodicFileExporter> _file_exporter;
+    SharedPointer<MetricsHttpEndpoint> _http_endpoint;
+};
+
+//! \brief Writes to a file periodically, from construction and once more on destruction
+class PeriodicFileExporter {
+  public:
+    //! \brief Construct from the \a writer to the file at \a path, every \a period_ms milliseconds
+    PeriodicFileExporter(std::function<void(std::string const&)> const& writer, std::string const& path, SizeType const& period_ms);
+    ~PeriodicFileExporter();
+  private:
+    bool _stop;
+    std::mutex _mux;
+    std::condition_variable _stop_condition;
+    Thread const _thr;
+};
+
+//! \brief Serves the metrics of the registry over HTTP on a local port, for any request
+class MetricsHttpEndpoint {
+  public:
+    MetricsHttpEndpoint(int port);
+    ~MetricsHttpEndpoint();
+  private:
+    int _descriptor;
+    std::atomic<bool> _stop;
+    Thread const _thr;
+};
+
+}
+
+#endif // OPERA_METRICS_HPP
@@ -37,131 +37,151 @@
 #include <cstring>
 #include <tuple>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 #include <mosquitto.h>
 
 #include "broker_access.hpp"
-#include "serialisation.hpp"
-#include "deserialisation.hpp"
+#include "codec.hpp"
 #include "conclog/include/logging.hpp"
 
 using namespace ConcLog;
 
 namespace Opera {
 
-//! \brief The publisher of objects to the MQTT broker
-template<class T> class MqttPublisher : public PublisherInterface<T> {
+//! \brief A function handling the payload of a message received from MQTT
+using MqttPayloadHandler = std::function<void(const char*,SizeType const&)>;
+
+//! \brief A connection to the MQTT broker, multiplexing the topics of publishers and subscribers with a single network loop
+class MqttConnection {
+    //! \brief A subscription to a topic, possibly with wildcards
+    struct Subscription {
+        std::string topic;
+        int qos;
+        SharedPointer<MqttPayloadHandler const> handler;
+    };
   public:
-    MqttPublisher(std::string const& topic, std::string const& hostname, int port) : _topic(topic) {
-        int rc = mosquitto_lib_init();
-        OPERA_ASSERT_MSG(rc == MOSQ_ERR_SUCCESS, "Error initialising Mosquito library: " << mosquitto_strerror(rc))
+    //! \brief Connect to the broker at \a hostname and \a port, then start the network loop
+    MqttConnection(std::string const& hostname, int port);
+
+    //! \brief Publish the \a payload to \a topic with the given \a qos
+    void publish(std::string const& topic, std::string_view const& payload, int qos);
+    //! \brief Subscribe to \a topic with the given \a qos, having \a handler called from the network loop on each payload
+    //! \details Handlers are called without holding the lock on the subscriptions, hence they may subscribe or publish;
+    //! exceptions thrown by a handler are logged, without affecting the other handlers for the same payload
+    //! \returns The id of the subscription, for later unsubscribing
+    SizeType subscribe(std::string const& topic, int qos, MqttPayloadHandler const& handler);
+    //! \brief Remove the subscription with the given \a id
+    //! \details The broker subscription is removed only when no other subscription uses the same topic.
+    //! Unless called from a handler, waits for handlers being called to return, so that the handler is not called afterwards
+    void unsubscribe(SizeType const& id);
+
+    ~MqttConnection();
 
-        _publisher = mosquitto_new(nullptr, true, nullptr);
-        OPERA_ASSERT_MSG(_publisher != nullptr, "Error: Out of memory.")
+  private:
+    static void _on_connect(struct mosquitto*, void* obj, int rc);
+    static void _on_message(struct mosquitto*, void* obj, const struct mosquitto_message* msg);
 
-        rc = mosquitto_connect_bind_v5(_publisher, hostname.c_str(), port, 60, nullptr, nullptr);
-        if (rc != MOSQ_ERR_SUCCESS){
-            mosquitto_destroy(_publisher);
-            OPERA_THROW_RTE("Error connecting: " << mosquitto_strerror(rc))
-        }
+  private:
+    struct mosquitto* _client;
+    std::mutex _mux;
+    std::condition_variable _dispatch_condition;
+    //! \brief The thread calling handlers, if any
+    std::thread::id _dispatching_thread;
+    Map<SizeType,Subscription> _subscriptions;
+    SizeType _next_subscription_id;
+    int const _parent_logger_level;
+    std::string const _parent_thread_name;
+    std::thread::id _loop_thread_id;
+    bool _registered;
+};
 
-        mosquitto_loop_start(_publisher);
-    }
+//! \brief A pool of connections to the MQTT broker, each topic being assigned to one connection
+//! \details Connections are established on first use
+class MqttConnectionPool {
+  public:
+    MqttConnectionPool(std::string const& hostname, int port, SizeType const& num_connections);
+    //! \brief The connection for the given \a topic
+    SharedPointer<MqttConnection> connection_for(std::string const& topic);
+  private:
+    std::string const _hostname;
+    int const _port;
+    std::mutex _mux;
+    List<SharedPointer<MqttConnection>> _connections;
+};
 
-    void put(T const& obj) override {
-        std::string payload = Serialiser<T>(obj).to_string();
-        int rc = mosquitto_publish_v5(_publisher, nullptr, _topic.c_str(), static_cast<int>(payload.size()), payload.c_str(), 2, false, nullptr);
-        OPERA_ASSERT_MSG(rc == MOSQ_ERR_SUCCESS,"Error publishing: " << mosquitto_strerror(rc))
-    }
+//! \brief The publisher of objects to the MQTT broker
+template<class T> class MqttPublisher : public PublisherInterface<T> {
+  public:
+    MqttPublisher(std::string const& topic, SharedPointer<MqttConnection> const& connection, int qos, MessageEncoding const& encoding = MessageEncoding::JSON)
+        : _topic(topic), _connection(connection), _qos(qos), _encoding(encoding) { }
 
-    ~MqttPublisher() {
-        if (_publisher != nullptr) {
-            mosquitto_disconnect(_publisher);
-            mosquitto_loop_stop(_publisher,true);
-            mosquitto_destroy(_publisher);
-        }
+    void put(T const& obj) override {
+        _connection->publish(_topic,encode(obj,_encoding),_qos);
     }
 
   private:
     std::string const _topic;
-    struct mosquitto* _publisher;
+    SharedPointer<MqttConnection> const _connection;
+    int const _qos;
+    MessageEncoding const _encoding;
 };
 
-//! \brief Callback for an MQTT message, used for running the actual callback on the deserialised message
-template<class T> void subscriber_on_message(struct mosquitto*, void *obj, const struct mosquitto_message *msg) {
-    auto callback_context = static_cast<CallbackContext<T>*>(obj);
-    if (not callback_context->registered) {
-        callback_context->thread_id = std::this_thread::get_id();
-        Logger::instance().register_self_thread(callback_context->parent_thread_name, callback_context->parent_logger_level);
-        callback_context->registered = true;
-    }
-
-    Deserialiser<T> deserialiser(std::string((char *)msg->payload,static_cast<SizeType>(msg->payloadlen)).c_str());
-    callback_context->function(deserialiser.make());
-}
-
 //! \brief The subscriber to objects published to MQTT
 template<class T> class MqttSubscriber : public SubscriberInterface<T> {
   public:
-    //! \brief Connects and starts the main asynchronous loop for getting messages
-    MqttSubscriber(std::string const& topic, std::string const& hostname, int port, CallbackFunction<T> const& callback)
-        : _topic(topic), _hostname(hostname), _port(port),
-          _callback_context(callback, Logger::instance().current_level(), Logger::instance().current_thread_name())
+    //! \brief Subscribe to the topic on the \a connection, whose loop calls the \a callback
+    //! \details Payloads rejected by the optional \a filter are not decoded
+    MqttSubscriber(std::string const& topic, SharedPointer<MqttConnection> const& connection, int qos, CallbackFunction<T> const& callback,
+                   MessageEncoding const& encoding = MessageEncoding::JSON, PayloadFilter const& filter = PayloadFilter())
+        : _connection(connection)
     {
-        int rc = mosquitto_lib_init();
-        OPERA_ASSERT_MSG(rc == MOSQ_ERR_SUCCESS, "Error initialising Mosquito library: " << mosquitto_strerror(rc))
-
-	      _subscriber = mosquitto_new(nullptr, true, (void*)&_callback_context);
-        OPERA_ASSERT_MSG(_subscriber != nullptr,"Error: out of memory.")
-
-        mosquitto_message_callback_set(_subscriber, subscriber_on_message<T>);
-
-        rc = mosquitto_connect_bind_v5(_subscriber, _hostname.c_str(), _port, 60, nullptr, nullptr);
-        if (rc != MOSQ_ERR_SUCCESS) {
-            mosquitto_destroy(_subscriber);
-            OPERA_THROW_RTE("Error connecting: " << mosquitto_strerror(rc))
-        }
-
-        mosquitto_subscribe_v5(_subscriber, nullptr, _topic.c_str(), 2, 0, nullptr);
-        mosquitto_loop_start(_subscriber);
+        _subscription_id = _connection->subscribe(topic, qos, [callback,encoding,filter](const char* payload, SizeType const& size){
+            if (filter and not filter(payload,size)) return;
+            callback(decode<T>(payload,size,encoding));
+        });
     }
 
     virtual ~MqttSubscriber() {
-        if (_subscriber != nullptr) {
-            mosquitto_disconnect(_subscriber);
-            mosquitto_loop_stop(_subscriber,true);
-            mosquitto_destroy(_subscriber);
-        }
-        if (_callback_context.registered) {
-            Logger::instance().unregister_thread(_callback_context.thread_id);
-        }
-            
+        _connection->unsubscribe(_subscription_id);
     }
 
   protected:
-    std::string const _topic;
-    std::string const _hostname;
-    int const _port;
-    CallbackContext<T> const _callback_context;
-    struct mosquitto* _subscriber;
+    SharedPointer<MqttConnection> const _connection;
+    SizeType _subscription_id;
+};
+
+//! \brief The quality of service levels used for the topics of each message kind
+//! \details The level is fixed per message kind, hence all the topics of a kind share it.
+//! States are streamed at a high rate and become obsolete quickly, hence they are delivered at most once by default
+struct MqttQualityOfService {
+    int body_presentation = 1;
+    int human_state = 0;
+    int robot_state = 0;
+    int collision_notification = 1;
 };
 
 //! \brief Access to a broker to handle Opera-specific messages using MQTT
 class MqttBrokerAccess : public BrokerAccessInterface {
   public:
-    MqttBrokerAccess(std::string const& hostname, int port);
+    //! \brief Construct from the \a hostname and \a port, using the given \a encoding for the payload of messages
+    //! \details Publishers and subscribers share \a num_connections connections, with the given \a qos for each message kind
+    MqttBrokerAccess(std::string const& hostname, int port, MessageEncoding const& encoding = MessageEncoding::JSON,
+                     MqttQualityOfService const& qos = MqttQualityOfService(), SizeType const& num_connections = 1);
     PublisherInterface<BodyPresentationMessage>* make_body_presentation_publisher(BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
     PublisherInterface<HumanStateMessage>* make_human_state_publisher(HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
     PublisherInterface<RobotStateMessage>* make_robot_state_publisher(RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
     PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
     SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
-    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
-    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
+    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
     SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
-    ~MqttBrokerAccess();
 
   private:
-    std::string const _hostname;
-    int const _port;
+    MessageEncoding const _encoding;
+    MqttQualityOfService const _qos;
+    SharedPointer<MqttConnectionPool> const _connections;
 };
 
 }
@@ -0,0 +1,264 @@
+/***************************************************************************
+ *            record.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPERA_RECORD_HPP
+#define OPERA_RECORD_HPP
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "broker_access.hpp"
+#include "codec.hpp"
+#include "memory.hpp"
+
+namespace Opera {
+
+//! \brief The current version of the layout of message logs
+const uint8_t MESSAGE_LOG_VERSION = 1;
+
+//! \brief The kind of message of the template argument type
+template<class T> constexpr BinaryMessageKind message_kind() {
+    if constexpr (std::is_same_v<T,BodyPresentationMessage>) return BinaryMessageKind::BODY_PRESENTATION;
+    else if constexpr (std::is_same_v<T,HumanStateMessage>) return BinaryMessageKind::HUMAN_STATE;
+    else if constexpr (std::is_same_v<T,RobotStateMessage>) return BinaryMessageKind::ROBOT_STATE;
+    else return BinaryMessageKind::COLLISION_NOTIFICATION;
+}
+
+//! \brief An entry of a message log, viewing the content of the log
+struct MessageLogEntry {
+    //! \brief The kind of message
+    BinaryMessageKind kind;
+    //! \brief The topic the message was received from
+    std::string_view topic;
+    //! \brief The time elapsed from the start of the recording when the message was received
+    std::chrono::nanoseconds elapsed;
+    //! \brief The encoded message
+    std::string_view payload;
+};
+
+//! \brief A writer of messages to an append-only log file, mapped in memory
+//! \details The file starts with a header holding the encoding of payloads, followed by entries each prefixed with its length;
+//! the length is written last, so that a zero length terminates the valid content even if recording is interrupted
+class MessageLogWriter {
+  public:
+    //! \brief Create the log at \a path, replacing any existing file, for payloads with the given \a encoding
+    MessageLogWriter(String const& path, MessageEncoding const& encoding);
+    MessageLogWriter(MessageLogWriter const&) = delete;
+    void operator=(MessageLogWriter const&) = delete;
+
+    //! \brief Append the \a payload of a message of the given \a kind received from \a topic
+    //! \details Can be called concurrently
+    void append(BinaryMessageKind const& kind, String const& topic, std::string_view const& payload);
+
+    //! \brief The encoding of payloads
+    MessageEncoding const& encoding() const;
+    //! \brief The number of entries appended
+    SizeType num_entries() const;
+    //! \brief The size in bytes of the valid content
+    SizeType size() const;
+
+    //! \brief Truncate the file to the valid content
+    ~MessageLogWriter();
+
+  private:
+    //! \brief Make room for \a num_bytes after the valid content, growing the file and its mapping if necessary
+    void _reserve(SizeType const& num_bytes);
+
+  private:
+    String const _path;
+    MessageEncoding const _encoding;
+    std::chrono::steady_clock::time_point const _start;
+    int _descriptor;
+    char* _data;
+    SizeType _capacity;
+    SizeType _size;
+    SizeType _num_entries;
+    mutable std::mutex _mux;
+};
+
+//! \brief A reader of a log file produced by MessageLogWriter, mapped in memory
+class MessageLogReader {
+  public:
+    //! \brief Open the log at \a path
+    MessageLogReader(String const& path);
+    MessageLogReader(MessageLogReader const&) = delete;
+    void operator=(MessageLogReader const&) = delete;
+
+    //! \brief The encoding of payloads
+    MessageEncoding const& encoding() const;
+
+    //! \brief The offset of the first entry
+    SizeType begin() const;
+
+    //! \brief Read into \a entry the entry at \a offset, moving the offset to the next entry
+    //! \returns Whether an entry was available
+    bool next(SizeType& offset, MessageLogEntry& entry) const;
+
+    ~MessageLogReader();
+
+  private:
+    String const _path;
+    MessageEncoding _encoding;
+    char* _data;
+    SizeType _size;
+};
+
+//! \brief Access that records the inbound messages received by its subscribers to a log, while delivering them as usual
+//! \details Body presentations, human states and robot states are received from a wrapped access, and recorded in their order
+//! of arrival across topics; publishers and subscribers to collision notifications are those of the wrapped access, without recording
+class RecordingBrokerAccess : public BrokerAccessInterface {
+  public:
+    //! \brief Construct by wrapping \a access, recording to the log at \a path using the given \a encoding for payloads
+    //! \details The log is finalised when all copies of this access and its subscribers are destroyed
+    RecordingBrokerAccess(BrokerAccess const& access, String const& path, MessageEncoding const& encoding = MessageEncoding::BINARY);
+
+    PublisherInterface<BodyPresentationMessage>* make_body_presentation_publisher(BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
+    PublisherInterface<HumanStateMessage>* make_human_state_publisher(HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
+    PublisherInterface<RobotStateMessage>* make_robot_state_publisher(RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
+    PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
+    SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
+    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
+
+    //! \brief The log written
+    MessageLogWriter const& log() const;
+
+  private:
+    //! \brief Wrap the \a callback on \a topic so that messages are recorded before being filtered with \a filter and delivered
+    template<class T> CallbackFunction<T> _recording(CallbackFunction<T> const& callback, String const& topic, MessageFilter const& filter = MessageFilter()) const {
+        return [writer=_writer,callback,topic,filter](T const& msg) {
+            writer->append(message_kind<T>(),topic,encode(msg,writer->encoding()));
+            if constexpr (std::is_same_v<T,HumanStateMessage> or std::is_same_v<T,RobotStateMessage>)
+                if (filter and not filter(msg.header())) return;
+            callback(msg);
+        };
+    }
+
+  private:
+    BrokerAccess const _access;
+    SharedPointer<MessageLogWriter> const _writer;
+};
+
+//! \brief The timing for replaying a log
+//! \details ORIGINAL delivers messages with the same delays as when recorded, while MAXIMUM delivers them as soon as
+//! each one has been consumed by its subscribers, including any asynchronous processing they acknowledge as drained
+enum class ReplayTiming { ORIGINAL, MAXIMUM };
+
+//! \brief A player of a log to the subscribers registered for each kind of message and topic
+//! \details Messages are delivered in the order of the log from one thread, hence deterministically across topics
+class MessageLogPlayer {
+  public:
+    //! \brief The handler of the payload of a message
+    using HandlerFunction = std::function<void(const char*,SizeType const&)>;
+    //! \brief The acknowledgement that the messages delivered have been fully processed, e.g., Runtime::ingestion_drained
+    using DrainedFunction = std::function<bool()>;
+
+    //! \brief Open the log at \a path
+    MessageLogPlayer(String const& path);
+
+    //! \brief The encoding of payloads
+    MessageEncoding const& encoding() const;
+
+    //! \brief Register the \a handler of messages of the given \a kind on \a topic, returning its identifier
+    SizeType add(BinaryMessageKind const& kind, String const& topic, HandlerFunction const& handler);
+    //! \brief Unregister the handler with the given \a identifier
+    //! \details Unless called from a handler, waits for handlers being called to return, so that the handler is not called afterwards
+    void remove(SizeType const& identifier);
+
+    //! \brief Deliver all the messages of the log with the given \a timing, returning the number of messages delivered
+    //! \details Handlers are called without holding the lock on the registrations. With MAXIMUM timing and a \a drained function,
+    //! each message is delivered only once \a drained acknowledges the previous one. Returns after the last message has been consumed
+    SizeType play(ReplayTiming const& timing, DrainedFunction const& drained = DrainedFunction());
+
+  private:
+    struct Registration {
+        BinaryMessageKind kind;
+        String topic;
+        SharedPointer<HandlerFunction const> handler;
+    };
+
+  private:
+    MessageLogReader const _reader;
+    Map<SizeType,Registration> _registrations;
+    SizeType _next_identifier;
+    std::mutex _mux;
+    std::condition_variable _dispatch_condition;
+    //! \brief The thread calling handlers, if any
+    std::thread::id _dispatching_thread;
+};
+
+//! \brief The subscriber to objects replayed from a log
+template<class T> class ReplaySubscriber : public SubscriberInterface<T> {
+  public:
+    //! \brief Register to the \a player for messages on \a topic, with payloads rejected by the optional \a filter not being decoded
+    ReplaySubscriber(SharedPointer<MessageLogPlayer> const& player, String const& topic, CallbackFunction<T> const& callback, PayloadFilter const& filter = PayloadFilter()) :
+        _player(player), _identifier(player->add(message_kind<T>(),topic,[callback,filter,encoding=player->encoding()](const char* payload, SizeType const& size) {
+            if (filter and not filter(payload,size)) return;
+            callback(decode<T>(payload,size,encoding));
+        })) { }
+
+    ~ReplaySubscriber() { _player->remove(_identifier); }
+
+  private:
+    SharedPointer<MessageLogPlayer> const _player;
+    SizeType const _identifier;
+};
+
+//! \brief Access that replays a log recorded by RecordingBrokerAccess
+//! \details Subscribers to body presentations, human states and robot states receive the recorded messages on their topic
+//! when the log is played; publishers, along with subscribers to collision notifications, use the memory broker
+class ReplayBrokerAccess : public BrokerAccessInterface {
+  public:
+    //! \brief Construct from the log at \a path
+    ReplayBrokerAccess(String const& path);
+
+    PublisherInterface<BodyPresentationMessage>* make_body_presentation_publisher(BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
+    PublisherInterface<HumanStateMessage>* make_human_state_publisher(HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
+    PublisherInterface<RobotStateMessage>* make_robot_state_publisher(RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
+    PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
+    SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
+    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
+
+    //! \brief Deliver all the messages of the log to the current subscribers with the given \a timing, returning the number of messages delivered
+    //! \details Copies of this access share the same player, hence the log can be played from the access given to a Runtime;
+    //! with MAXIMUM timing, the \a drained function (e.g., Runtime::ingestion_drained) paces delivery to the processing of each message
+    SizeType play(ReplayTiming const& timing = ReplayTiming::MAXIMUM, MessageLogPlayer::DrainedFunction const& drained = MessageLogPlayer::DrainedFunction()) const;
+
+  private:
+    SharedPointer<MessageLogPlayer> const _player;
+};
+
+}
+
+#endif // OPERA_RECORD_HPP
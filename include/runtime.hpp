@@ -46,11 +46,13 @@ class RuntimeConfiguration {
     TimestampType const& get_history_retention() const;
     TimestampType const& get_history_purge_period() const;
     SizeType const& get_concurrency() const;
+    SizeType const& get_ingestion_concurrency() const;
 
     RuntimeConfiguration& set_job_factory(LookAheadJobFactory const& factory);
     RuntimeConfiguration& set_history_retention(TimestampType const& retention);
     RuntimeConfiguration& set_history_purge_period(TimestampType const& purge_period);
     RuntimeConfiguration& set_concurrency(SizeType const& concurrency);
+    RuntimeConfiguration& set_ingestion_concurrency(SizeType const& concurrency);
 
   private:
     //! \brief The factory for look-ahead jobs
@@ -67,6 +69,10 @@ class RuntimeConfiguration {
     //! \details A value of zero is allowed for testing purposes, where no processing
     //! can be done automatically
     SizeType _concurrency;
+
+    //! \brief The number of threads used for acquiring body states
+    //! \details States of a given body are always acquired by the same thread
+    SizeType _ingestion_concurrency;
 };
 
 //! \brief The runtime for performing collision detection
@@ -85,6 +91,9 @@ class Runtime {
     //! \brief Get the number of registered pairs pending promotion to waiting jobs
     SizeType num_pending_human_robot_pairs() const;
 
+    //! \brief Whether all the states received have been acquired into the registry
+    bool ingestion_drained() const;
+
     //! \brief Get the number of segment pairs that would need to be processed, given the registered bodies
     SizeType num_segment_pairs() const;
 
@@ -134,6 +143,9 @@ class Runtime {
     std::atomic<SizeType> _num_collisions;
 
     RuntimeConfiguration const _configuration;
+
+    //! \brief The identifiers of the metrics gauges registered
+    List<SizeType> _gauges;
 };
 
 }
@@ -36,7 +36,11 @@
 #include <csignal>
 #include <cstring>
 #include <tuple>
+#include <algorithm>
 #include <thread>
+#include <shared_mutex>
+#include <chrono>
+#include <optional>
 #include "thread.hpp"
 #include "macros.hpp"
 
@@ -44,27 +48,83 @@
 #include "body_registry.hpp"
 #include "lookahead_job_factory.hpp"
 #include "synchronised_queue.hpp"
+#include "metrics.hpp"
 
 namespace Opera {
 
 //! \brief The time without state updates over which a human is removed (in ms)
 const TimestampType HUMAN_RETENTION_TIMEOUT = 10000;
 
+//! \brief The number of human state reception times retained for measuring the notification latency
+const SizeType HUMAN_STATE_RECEPTION_TIMES_CAPACITY = 1024;
+
+//! \brief The default number of ingestion shards, i.e., of threads acquiring states into the registry
+//! \details At least two, so that different bodies are acquired concurrently by default
+const SizeType DEFAULT_INGESTION_CONCURRENCY = std::max<SizeType>(2,std::thread::hardware_concurrency()/2);
+
+//! \brief A stage of the ingestion pipeline that executes tasks in order of submission on its own thread
+//! \details Tasks related to a given body are always submitted to the same shard, so that ordering is
+//! preserved for each body while different bodies proceed concurrently
+class IngestionShard {
+  public:
+    //! \brief Construct with a thread \a name
+    IngestionShard(std::string const& name);
+
+    //! \brief Add a \a task to be executed after the ones already enqueued
+    void enqueue(VoidFunction const& task);
+
+    //! \brief The number of tasks not yet started
+    SizeType num_pending() const;
+    //! \brief The number of tasks not yet completed, including the one being executed
+    SizeType num_unfinished() const;
+
+    //! \brief Stop the thread, discarding any pending task
+    ~IngestionShard() noexcept;
+
+  private:
+    std::queue<VoidFunction> _tasks;
+    SizeType _num_unfinished;
+    mutable std::mutex _mux;
+    std::condition_variable _availability_condition;
+    bool _stop;
+    Thread _thr;
+};
+
 //! \brief Utility class to receive messages and apply them
+//! \details Ingestion is staged: subscribers decode the messages, then the acquisition into the registry is performed
+//! on a shard chosen from the body id, and finally job-side effects are applied by a dedicated thread,
+//! coalescing the requests coming from acquisitions that completed in the meantime
 class RuntimeReceiver {
     struct HumanRobotIdPair {
         HumanRobotIdPair(BodyIdType const& h, BodyIdType const& r) : human(h), robot(r) { }
         BodyIdType human;
         BodyIdType robot;
     };
+    //! \brief A sleeping job along with the human instance it may be awakened with
+    struct SleepingJobState {
+        LookAheadJob job;
+        SharedPointer<RobotStateHistory const> robot_history;
+        SharedPointer<HumanStateInstance const> human_instance;
+        SizeType instance_distance;
+    };
+    //! \brief A pending human-robot pair along with the human instance it may be promoted with, if any
+    struct PendingPairState {
+        HumanRobotIdPair pair;
+        SharedPointer<Human const> human;
+        SharedPointer<Robot const> robot;
+        SharedPointer<RobotStateHistory const> robot_history;
+        SharedPointer<HumanStateInstance const> human_instance;
+    };
   public:
     //! \brief Create starting from subscribers and a \a registry to fill, along with \a waiting_jobs
     //! to populate as soon as the registry has history for the corresponding human-robot pair, and \a sleeping_jobs
-    //! to move to waiting_jobs as soon as a new human state is received
+    //! to move to waiting_jobs as soon as a new human state is received; state acquisition is distributed
+    //! over \a num_ingestion_shards threads
     RuntimeReceiver(Pair<BrokerAccess,BodyPresentationTopic> const& bp_subscriber, Pair<BrokerAccess,HumanStateTopic> const& hs_subscriber,
                     Pair<BrokerAccess,RobotStateTopic> const& rs_subscriber,
                     LookAheadJobFactory const& factory, TimestampType const& history_retention, TimestampType  const& history_purge_period,
-                    BodyRegistry& registry, SynchronisedQueue<LookAheadJob>& waiting_jobs, SynchronisedQueue<LookAheadJob>& sleeping_jobs);
+                    BodyRegistry& registry, SynchronisedQueue<LookAheadJob>& waiting_jobs, SynchronisedQueue<LookAheadJob>& sleeping_jobs,
+                    SizeType const& num_ingestion_shards = DEFAULT_INGESTION_CONCURRENCY);
 
     //! \brief The current number of created human-robot pairs, not yet put into the waiting jobs
     SizeType num_pending_human_robot_pairs() const;
@@ -72,6 +132,17 @@ class RuntimeReceiver {
     //! \brief The oldest time in history across all humans and robots
     TimestampType oldest_history_time() const;
 
+    //! \brief The number of ingestion shards
+    SizeType num_ingestion_shards() const;
+    //! \brief The index of the ingestion shard acquiring the states of the body with the given \a id
+    SizeType ingestion_shard_index(BodyIdType const& id) const;
+
+    //! \brief Whether all the acquisitions submitted to the ingestion shards have completed
+    bool ingestion_drained() const;
+
+    //! \brief The time of reception of the human state message with the given \a timestamp, if still retained
+    std::optional<std::chrono::steady_clock::time_point> human_state_reception_time(TimestampType const& timestamp) const;
+
     //! \brief Return the factory
     LookAheadJobFactory const& factory() const { return _factory; }
 
@@ -82,33 +153,94 @@ class RuntimeReceiver {
     ~RuntimeReceiver() noexcept;
 
   private:
-    //! \brief Remove old history from \a registry for humans in the \a msg
-    void _remove_old_history(BodyRegistry& registry, HumanStateMessage const& msg);
-    //! \brief Remove old history from \a registry for robot in the \a msg
-    void _remove_old_history(BodyRegistry& registry, RobotStateMessage const& msg);
-    //! \brief Possibly move any human-robot pair into a mix of sleeping jobs (if the specific human sample is empty) or waiting jobs (otherwise)
-    void _promote_pairs_to_jobs(BodyRegistry const& registry, SynchronisedQueue<LookAheadJob>& sleeping_jobs, SynchronisedQueue<LookAheadJob>& waiting_jobs);
+    //! \brief The shard responsible for the body with the given \a id
+    IngestionShard& _shard_for(BodyIdType const& id);
+    //! \brief Whether a human state message with the given \a header is to be decoded
+    //! \details False when all its humans already received a message at a later or equal time, since acquisition would ignore it
+    bool _accepts_human_state(MessageHeader const& header) const;
+    //! \brief Whether a robot state message with the given \a header is to be decoded, i.e., whether the robot is registered
+    bool _accepts_robot_state(MessageHeader const& header) const;
+    //! \brief Register the humans in \a msg that are not known yet, using the default human
+    void _register_unknown_humans(HumanStateMessage const& msg);
+    //! \brief Acquire the state of the \a body of \a msg, on the shard of the human
+    void _acquire_human_state(HumanStateMessage const& msg, SizeType const& body);
+    //! \brief Acquire the robot state from \a msg, on the shard of the robot
+    void _acquire_robot_state(RobotStateMessage const& msg);
+    //! \brief Request the job-side effects to be applied as a result of a message at \a timestamp
+    void _request_job_effects(TimestampType const& timestamp);
+    //! \brief Apply the job-side effects, considering \a latest_msg_timestamp as the current time
+    void _apply_job_effects(TimestampType const& latest_msg_timestamp);
+
+    //! \brief Remove old history from the registry for the human with the given \a id, according to the \a timestamp of the message
+    void _remove_old_human_history(BodyIdType const& id, TimestampType const& timestamp);
+    //! \brief Remove old history from the registry for the robot with the given \a id, according to the \a timestamp of the message
+    void _remove_old_robot_history(BodyIdType const& id, TimestampType const& timestamp);
+    //! \brief The pending human-robot pairs with the latest human instances within the robot histories
+    //! \details To be called under the exclusive ingestion lock
+    List<PendingPairState> _pending_pair_states() const;
+    //! \brief Possibly move any of the \a pairs into a mix of sleeping jobs (if the specific human sample is empty) or waiting jobs (otherwise)
+    //! \details Does not require the ingestion lock, since the states read have been taken already
+    void _promote_pairs_to_jobs(List<PendingPairState> const& pairs);
     //! \brief Remove all humans and their sleeping jobs if no human messages have been received for enough time with respect to \a latest_msg_timestamp
     //! \details The current time is not used since this would not work when simulating
-    void _remove_unresponding_humans(TimestampType const& latest_msg_timestamp, BodyRegistry& registry, SynchronisedQueue<LookAheadJob>& sleeping_jobs);
-    //! \brief Move sleeping jobs to waiting jobs or discard them, as a result of a new human state
-    void _move_sleeping_jobs_to_waiting_jobs(BodyRegistry const& registry, SynchronisedQueue<LookAheadJob>& sleeping_jobs, SynchronisedQueue<LookAheadJob>& waiting_jobs);
+    void _remove_unresponding_humans(TimestampType const& latest_msg_timestamp);
+    //! \brief Dequeue all the sleeping jobs, along with the latest human instances within the robot histories
+    //! \details To be called under the exclusive ingestion lock
+    List<SleepingJobState> _take_sleeping_jobs();
+    //! \brief Move the \a jobs to waiting jobs or back to sleeping jobs, as a result of a new human state
+    //! \details Does not require the ingestion lock, since the states read have been taken already
+    void _move_sleeping_jobs_to_waiting_jobs(List<SleepingJobState> const& jobs);
 
   private:
     List<HumanRobotIdPair> _pending_human_robot_pairs;
     mutable std::mutex _pairs_mux;
-    mutable std::mutex _state_received_mux;
+    //! \brief Shared by acquisitions, since each body is handled by one shard only, exclusive for registry insertions/removals and job-side effects
+    mutable std::shared_mutex _ingestion_mux;
 
     LookAheadJobFactory const _factory;
     TimestampType const _history_retention;
     TimestampType const _history_purge_period;
 
+    BodyRegistry& _registry;
+    SynchronisedQueue<LookAheadJob>& _waiting_jobs;
+    SynchronisedQueue<LookAheadJob>& _sleeping_jobs;
+
+    std::mutex _effects_mux;
+    std::condition_variable _effects_condition;
+    bool _effects_requested;
+    TimestampType _effects_timestamp;
+    bool _stop;
+
+    // The members below are used by the subscriber callbacks and ingestion tasks, hence they must be initialised before the subscribers start
+
+    //! \brief The latest timestamp received for each human, written by the human state subscriber and erased on human removal
+    Map<BodyIdType,TimestampType> _latest_human_timestamps;
+    mutable std::mutex _latest_human_timestamps_mux;
+
+    //! \brief The latest reception times of human state messages, by message timestamp
+    Map<TimestampType,std::chrono::steady_clock::time_point> _human_state_reception_times;
+    mutable std::mutex _reception_times_mux;
+
+    std::atomic<SizeType> _num_state_messages_received = 0;
+    std::atomic<TimestampType> _oldest_history_time = 0;
+
+    //! \brief The metrics updated during ingestion, resolved at construction so that the metrics registry is never locked under an ingestion lock
+    MetricsCounter& _human_messages_received;
+    MetricsCounter& _robot_messages_received;
+    MetricsHistogram& _human_history_size;
+    MetricsHistogram& _robot_history_size;
+    MetricsHistogram& _awakening_seconds;
+
+    List<SharedPointer<IngestionShard>> _shards;
+
     SubscriberInterface<BodyPresentationMessage>* _bp_subscriber;
     SubscriberInterface<HumanStateMessage>* _hs_subscriber;
     SubscriberInterface<RobotStateMessage>* _rs_subscriber;
 
-    std::atomic<SizeType> _num_state_messages_received = 0;
-    std::atomic<TimestampType> _oldest_history_time = 0;
+    //! \brief The identifiers of the metrics gauges registered
+    List<SizeType> _gauges;
+
+    Thread _effects_thr;
 };
 
 //! \brief Utility class to send messages from the runtime
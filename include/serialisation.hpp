@@ -29,11 +29,11 @@
 #ifndef OPERA_SERIALISATION_HPP
 #define OPERA_SERIALISATION_HPP
 
-#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
-#include <rapidjson/ostreamwrapper.h>
 #include <filesystem>
 #include <fstream>
+#include <string_view>
 #include "body.hpp"
 #include "message.hpp"
 #include "macros.hpp"
@@ -51,31 +51,55 @@ template<class T> class SerialiserInterface {
     virtual std::string to_string() const = 0;
 };
 
-//! \brief Base implementation of serialisation, from a rapidjson Document
+//! \brief A JSON writer into a string buffer local to each thread
+//! \details The buffer is reused across serialisations, hence in steady state writing does not allocate
+class SerialisationBuffer {
+  public:
+    using WriterType = rapidjson::Writer<rapidjson::StringBuffer>;
+
+    //! \brief Acquire the buffer of the current thread, clearing it and resetting its writer
+    SerialisationBuffer();
+    SerialisationBuffer(SerialisationBuffer const&) = delete;
+    void operator=(SerialisationBuffer const&) = delete;
+
+    //! \brief The writer into the buffer
+    WriterType& writer();
+
+    //! \brief The content written, valid until the buffer is acquired again on the same thread
+    std::string_view view() const;
+
+  private:
+    rapidjson::StringBuffer& _buffer;
+    WriterType& _writer;
+};
+
+//! \brief Base implementation of serialisation, streaming into a rapidjson Writer
 template<class T> class SerialiserBase : public SerialiserInterface<T> {
   public:
     //! \brief Pass the object by const reference
     SerialiserBase(T const& o) : obj(o) { }
 
-    //! \brief Convert the object into a rapidjson document
-    virtual rapidjson::Document to_document() const = 0;
+    //! \brief Write the object into the JSON \a writer
+    virtual void write(SerialisationBuffer::WriterType& writer) const = 0;
+
+    //! \brief Serialise into the buffer of the current thread
+    //! \details The view is valid until the next serialisation on the same thread, hence it must be consumed right away
+    std::string_view to_view() const {
+        SerialisationBuffer buffer;
+        write(buffer.writer());
+        return buffer.view();
+    }
 
   public:
     void to_file(FilePath const& file) const override {
-        auto document = to_document();
         std::ofstream ofs(file);
         OPERA_ASSERT_MSG(ofs.is_open(), "Could not open file '" << file << "' for writing.")
-        rapidjson::OStreamWrapper osw(ofs);
-        rapidjson::Writer<rapidjson::OStreamWrapper> writer(osw);
-        document.Accept(writer);
+        auto payload = to_view();
+        ofs.write(payload.data(), static_cast<std::streamsize>(payload.size()));
     }
 
     std::string to_string() const override {
-        auto document = to_document();
-        rapidjson::StringBuffer buffer;
-        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
-        document.Accept(writer);
-        return buffer.GetString();
+        return std::string(to_view());
     }
 
   protected:
@@ -88,32 +112,28 @@ template<class T> class Serialiser;
 template<> class Serialiser<BodyPresentationMessage> : public SerialiserBase<BodyPresentationMessage> {
   public:
     using SerialiserBase::SerialiserBase;
-  protected:
-    rapidjson::Document to_document() const override;
+    void write(SerialisationBuffer::WriterType& writer) const override;
 };
 
 //! \brief Utility for making a JSON description from a human state message
 template<> class Serialiser<HumanStateMessage> : public SerialiserBase<HumanStateMessage> {
   public:
     using SerialiserBase::SerialiserBase;
-  protected:
-    rapidjson::Document to_document() const override;
+    void write(SerialisationBuffer::WriterType& writer) const override;
 };
 
 //! \brief Utility for making a JSON description from a robot state message
 template<> class Serialiser<RobotStateMessage> : public SerialiserBase<RobotStateMessage> {
-public:
+  public:
     using SerialiserBase::SerialiserBase;
-protected:
-    rapidjson::Document to_document() const override;
+    void write(SerialisationBuffer::WriterType& writer) const override;
 };
 
 //! \brief Utility for making a JSON description from a notification message
 template<> class Serialiser<CollisionNotificationMessage> : public SerialiserBase<CollisionNotificationMessage> {
   public:
     using SerialiserBase::SerialiserBase;
-  protected:
-    rapidjson::Document to_document() const override;
+    void write(SerialisationBuffer::WriterType& writer) const override;
 };
 
 }
@@ -0,0 +1,195 @@
+/***************************************************************************
+ *            shm.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPERA_SHM_HPP
+#define OPERA_SHM_HPP
+
+#include <string>
+#include <atomic>
+#include "thread.hpp"
+
+#include "broker_access.hpp"
+#include "codec.hpp"
+
+namespace Opera {
+
+//! \brief The header of a ring in shared memory, followed by the slots
+//! \details Fields are accessed atomically by all the processes mapping the ring
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t futex_word;
+    uint32_t num_waiters;
+    uint32_t padding;
+    uint64_t capacity;
+    uint64_t slot_size;
+    uint64_t reserved_sequence;
+};
+
+//! \brief A ring of payloads in POSIX shared memory, with a slot for each message
+//! \details Publishers reserve slots with increasing sequence numbers, while each subscriber has its own cursor.
+//! Each slot is guarded by a sequence lock, so that a subscriber detects whether a slot has been overwritten while reading it.
+//! Waiting subscribers are woken with a futex shared between processes.
+class ShmRing {
+  public:
+    //! \brief Open the ring with the given \a name, creating it with \a capacity slots of \a slot_size bytes if not existing
+    //! \details If the ring exists, it must have the same capacity and slot size
+    ShmRing(std::string const& name, SizeType const& capacity, SizeType const& slot_size);
+    ShmRing(ShmRing const&) = delete;
+    void operator=(ShmRing const&) = delete;
+
+    //! \brief The name of the ring
+    std::string const& name() const;
+    //! \brief The sequence number of the next message put
+    SizeType end() const;
+
+    //! \brief Put the \a payload in the next slot, waking the waiting subscribers
+    //! \details The slot is claimed by compare-and-swap on its sequence word, waiting for the writer of an older message
+    //! in the same slot to finish; the payload is dropped if a newer message already claimed the slot.
+    //! A claim still not completed after SHM_STALE_CLAIM_TIMEOUT_US is taken over, so that a publisher that died
+    //! while writing does not block the others
+    void put(std::string_view const& payload);
+
+    //! \brief Take the message at \a cursor into \a payload, waiting up to \a timeout_us microseconds for it
+    //! \details The \a cursor is moved past the message taken; if messages have been overwritten before being taken,
+    //! the cursor jumps to the oldest message available and \a num_skipped is increased accordingly.
+    //! Waiting for a slot being written is also bounded by the timeout, so that the caller can check whether to stop
+    //! \returns Whether a message has been taken
+    bool take(SizeType& cursor, String& payload, SizeType& num_skipped, SizeType const& timeout_us);
+
+    //! \brief Wake all the waiting subscribers
+    void wake();
+
+    //! \brief Remove the ring with the given \a name from the system
+    //! \details Processes already mapping it keep using it
+    static void remove(std::string const& name);
+
+    ~ShmRing();
+
+  private:
+    //! \brief The maximum time waited for the claim of an older message on a slot before taking it over
+    static constexpr SizeType SHM_STALE_CLAIM_TIMEOUT_US = 100000;
+
+    //! \brief The sequence word of the slot for \a sequence
+    uint64_t& _slot_sequence(SizeType const& sequence) const;
+    //! \brief The size of the payload in the slot for \a sequence
+    uint64_t& _slot_payload_size(SizeType const& sequence) const;
+    //! \brief The payload data in the slot for \a sequence
+    char* _slot_payload(SizeType const& sequence) const;
+    //! \brief Wait for a change of the futex word from \a value, for up to \a timeout_us microseconds
+    void _wait(uint32_t value, SizeType const& timeout_us);
+
+  private:
+    std::string const _name;
+    SizeType _mapped_size;
+    ShmRingHeader* _header;
+    char* _slots;
+    SizeType _slot_stride;
+};
+
+//! \brief The publisher of objects to a ring in shared memory
+template<class T> class ShmPublisher : public PublisherInterface<T> {
+  public:
+    ShmPublisher(SharedPointer<ShmRing> const& ring, MessageEncoding const& encoding) : _ring(ring), _encoding(encoding) { }
+    void put(T const& obj) override { _ring->put(encode(obj,_encoding)); }
+  private:
+    SharedPointer<ShmRing> const _ring;
+    MessageEncoding const _encoding;
+};
+
+//! \brief The subscriber to objects published to a ring in shared memory
+//! \details The subscriber receives messages published since its construction
+template<class T> class ShmSubscriber : public SubscriberInterface<T> {
+  public:
+    //! \brief Start waiting for messages, with payloads rejected by the optional \a filter not being decoded
+    ShmSubscriber(SharedPointer<ShmRing> const& ring, CallbackFunction<T> const& callback, MessageEncoding const& encoding, PayloadFilter const& filter = PayloadFilter()) :
+        _ring(ring), _cursor(ring->end()), _num_skipped(0), _stopped(false), _thr([=,this]{
+            String payload;
+            SizeType num_skipped = 0;
+            while (not _stopped) {
+                if (not _ring->take(_cursor,payload,num_skipped,SHM_WAIT_TIMEOUT_US)) continue;
+                _num_skipped = num_skipped;
+                if (filter and not filter(payload.data(),payload.size())) continue;
+                callback(decode<T>(payload.data(),payload.size(),encoding));
+            }
+        },"shm_sub") { }
+
+    //! \brief The number of messages skipped since overwritten before being taken
+    SizeType num_skipped() const { return _num_skipped; }
+
+    ~ShmSubscriber() {
+        _stopped = true;
+        _ring->wake();
+    }
+
+  private:
+    //! \brief The maximum time waited for a message before checking whether the subscriber is stopped
+    static constexpr SizeType SHM_WAIT_TIMEOUT_US = 100000;
+
+    SharedPointer<ShmRing> const _ring;
+    SizeType _cursor;
+    std::atomic<SizeType> _num_skipped;
+    std::atomic<bool> _stopped;
+    Thread const _thr;
+};
+
+//! \brief Access to a broker to handle Opera-specific messages using rings in shared memory
+//! \details Each topic has its own ring, named after the topic with the given prefix, for exchanging messages between
+//! processes on the same host; rings persist until removed, and all the processes must use the same geometry
+class ShmBrokerAccess : public BrokerAccessInterface {
+  public:
+    //! \brief Construct with the \a prefix for the names of the rings, their \a capacity and \a slot_size in bytes,
+    //! and the \a encoding for the payload of messages
+    ShmBrokerAccess(std::string const& prefix = "opera", SizeType const& capacity = 256, SizeType const& slot_size = 65536,
+                    MessageEncoding const& encoding = MessageEncoding::BINARY);
+
+    PublisherInterface<BodyPresentationMessage>* make_body_presentation_publisher(BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
+    PublisherInterface<HumanStateMessage>* make_human_state_publisher(HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
+    PublisherInterface<RobotStateMessage>* make_robot_state_publisher(RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
+    PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
+    SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
+    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
+
+    //! \brief The name of the ring for the given \a topic
+    std::string ring_name(std::string const& topic) const;
+
+  private:
+    //! \brief Open the ring for the given \a topic
+    SharedPointer<ShmRing> _ring(std::string const& topic) const;
+
+  private:
+    std::string const _prefix;
+    SizeType const _capacity;
+    SizeType const _slot_size;
+    MessageEncoding const _encoding;
+};
+
+}
+
+#endif // OPERA_SHM_HPP
@@ -31,10 +31,13 @@
 
 #include <deque>
 #include <mutex>
+#include <atomic>
+#include <array>
 #include "body.hpp"
 #include "utility.hpp"
 #include "interval.hpp"
 #include "mode.hpp"
+#include "message.hpp"
 
 namespace Opera {
 
@@ -46,6 +49,9 @@ class HumanStateInstance {
   public:
     //! \brief Construct from a human, points and timestamp
     HumanStateInstance(Human const& human, Map<KeypointIdType,List<Point>> const& points, TimestampType const& timestamp);
+    //! \brief Construct from a human, the \a body of a \a message and the indices of the head and tail keypoints of each segment within the body
+    //! \details An index equal to the number of keypoints of the body denotes a keypoint with no samples
+    HumanStateInstance(Human const& human, HumanStateMessage const& message, SizeType const& body, List<Pair<SizeType,SizeType>> const& segment_keypoints);
 
     //! \brief The timestamp of the instance
     TimestampType const& timestamp() const;
@@ -57,6 +63,8 @@ class HumanStateInstance {
 };
 
 //! \brief Holds the states reached by a human up to now
+//! \details Instances are returned as handles that keep them alive even after their removal from the history;
+//! reading must still not be concurrent with acquiring or removing instances
 class HumanStateHistory {
   public:
     //! \brief Construct from a human
@@ -65,6 +73,9 @@ class HumanStateHistory {
 
     //! \brief Add an instance
     void acquire(Map<KeypointIdType,List<Point>> const& points, TimestampType const& timestamp);
+    //! \brief Add an instance from the \a body of a \a message
+    //! \details The keypoints of the segments are resolved once for each keypoint template of the body
+    void acquire(HumanStateMessage const& message, SizeType const& body);
 
     //! \brief Check if there are instances with timestamp within \a timestamp
     bool has_instances_within(TimestampType const& timestamp) const;
@@ -72,7 +83,7 @@ class HumanStateHistory {
     //! \brief Get the latest instance with timestamp lesser or equal than \a timestamp
     //! \details This is necessary to choose an instance for which we have a defined
     //! robot mode to check against, instead of an unbounded one
-    HumanStateInstance const& latest_within(TimestampType const& timestamp) const;
+    SharedPointer<HumanStateInstance const> latest_within(TimestampType const& timestamp) const;
     //! \brief Return the latest time
     TimestampType const& latest_time() const;
     //! \brief Return the earliest time
@@ -89,13 +100,15 @@ class HumanStateHistory {
     SizeType instance_number(TimestampType const& timestamp) const;
 
     //! \brief Return the instance at \a idx
-    HumanStateInstance const& at(SizeType const& idx) const;
+    SharedPointer<HumanStateInstance const> at(SizeType const& idx) const;
 
     //! \brief The number of instances
     SizeType size() const;
   private:
     Human const _human;
-    Deque<HumanStateInstance> _instances;
+    Deque<SharedPointer<HumanStateInstance const>> _instances;
+    KeypointIdsType _resolved_keypoint_ids;
+    List<Pair<SizeType,SizeType>> _segment_keypoints;
 };
 
 //! \brief The presence of a robot in a given mode
@@ -122,6 +135,7 @@ class RobotModePresence {
 };
 
 //! \brief Holds the continuous history for a given mode
+//! \details Samples of each entry are shared, so that copies of the history are cheap
 class SamplesHistory {
     typedef List<BodySegmentSample> SegmentTemporalSamplesType;
     typedef List<SegmentTemporalSamplesType> BodySamplesType;
@@ -139,61 +153,161 @@ class SamplesHistory {
 
     //! \brief The number of samples at the given \a timestamp
     SizeType size_at(TimestampType const& timestamp) const;
+
+    //! \brief The number of entries
+    SizeType num_entries() const;
+
+    //! \brief Whether some entry is superseded by a later one still not greater than \a timestamp
+    bool has_superseded_entries(TimestampType const& timestamp) const;
+    //! \brief Remove the entries superseded by a later one still not greater than \a timestamp
+    //! \details Samples at \a timestamp and later are unaffected
+    void remove_superseded_entries(TimestampType const& timestamp);
   private:
-    List<TimedBodySamplesType> _entries;
+    ChunkedSequence<Pair<TimestampType,SharedPointer<BodySamplesType const>>> _entries;
+};
+
+//! \brief The number of slots for pinning snapshot times without locking
+const SizeType NUM_SNAPSHOT_TIME_PIN_SLOTS = 64;
+
+//! \brief Keeps track of the snapshot times currently in use
+//! \details Each slot holds a distinct timestamp along with the number of its pins: pinning joins the slot already
+//! holding the timestamp, or claims a free slot, falling back to a synchronised overflow only if all slots are taken
+//! by other timestamps; the oldest pinned time is hence found by scanning a fixed number of slots
+class SnapshotTimePins {
+  public:
+    SnapshotTimePins();
+    SnapshotTimePins(SnapshotTimePins const& other) = delete;
+
+    //! \brief Pin \a timestamp, returning the slot used
+    SizeType pin(TimestampType const& timestamp);
+    //! \brief Unpin \a timestamp from the given \a slot
+    void unpin(SizeType const& slot, TimestampType const& timestamp);
+
+    //! \brief The oldest pinned time, or the maximum timestamp value if nothing is pinned
+    TimestampType oldest() const;
+  private:
+    //! \brief Try to add a pin to the \a slot if holding \a timestamp
+    bool _try_join(SizeType const& slot, TimestampType const& timestamp);
+    //! \brief Remove a pin from the \a slot, freeing it if it was the last one
+    void _leave(SizeType const& slot);
+  private:
+    std::array<std::atomic<TimestampType>,NUM_SNAPSHOT_TIME_PIN_SLOTS> _slots;
+    //! \brief The number of pins for each slot, where a slot can be joined only while its count is positive
+    std::array<std::atomic<SizeType>,NUM_SNAPSHOT_TIME_PIN_SLOTS> _counts;
+    Map<TimestampType,SizeType> _overflow;
+    std::mutex mutable _overflow_mux;
+};
+
+//! \brief A pin of a snapshot time, released on destruction
+//! \details Held by value: a copy pins the same time again, a move transfers the pin
+class SnapshotTimePin {
+  public:
+    //! \brief Construct with no time pinned
+    SnapshotTimePin();
+    //! \brief Pin \a timestamp into \a pins
+    SnapshotTimePin(SnapshotTimePins& pins, TimestampType const& timestamp);
+    SnapshotTimePin(SnapshotTimePin const& other);
+    SnapshotTimePin(SnapshotTimePin&& other) noexcept;
+    SnapshotTimePin& operator=(SnapshotTimePin const& other);
+    SnapshotTimePin& operator=(SnapshotTimePin&& other) noexcept;
+    ~SnapshotTimePin();
+
+    //! \brief Whether a time is pinned
+    bool is_pinned() const;
+  private:
+    //! \brief Unpin the time, if any
+    void _release();
+  private:
+    SnapshotTimePins* _pins;
+    TimestampType _timestamp;
+    SizeType _slot;
 };
 
 class RobotStateHistorySnapshot;
 
 //! \brief Holds the states reached by a robot up to now
+//! \details Each acquisition publishes a new immutable version of the history: readers lock only to take
+//! the current version, then read it (through snapshots) without locking; acquisition and removal of old entries
+//! are expected from one thread at a time
 class RobotStateHistory {
     friend class RobotStateHistorySnapshot;
     typedef List<BodySegmentSample> SegmentTemporalSamplesType;
     typedef List<SegmentTemporalSamplesType> BodySamplesType;
-    typedef Map<Mode,SamplesHistory> ModeSamplesHistoryType;
+    typedef Map<Mode,SharedPointer<SamplesHistory const>> ModeSamplesHistoryType;
+    typedef ChunkedSequence<RobotModePresence> ModePresencesType;
+    typedef ChunkedSequence<Pair<TimestampType,ModeTrace>> ModeTracesType;
+
+    //! \brief An immutable version of the history, whose containers are shared with the following versions until changed
+    //! \details Changed sequences still share all their chunks but the last with the previous version
+    struct Version {
+        SharedPointer<ModePresencesType const> mode_presences;
+        SharedPointer<ModeSamplesHistoryType const> mode_states;
+        SharedPointer<ModeTracesType const> mode_traces;
+        Mode latest_mode;
+        TimestampType latest_time;
+
+        //! \brief The mode at the given \a timestamp, or the latest mode if no presence is found
+        Mode const& mode_at(TimestampType const& timestamp) const;
+    };
   public:
     RobotStateHistory(Robot const& robot);
     RobotStateHistory(RobotStateHistory const& other) = delete;
   public:
 
     //! \brief The most recent time of a state acquired
-    TimestampType const& latest_time() const;
+    TimestampType latest_time() const;
     //! brief The least recent time of a state acquired
-    TimestampType const& earliest_time() const;
+    TimestampType earliest_time() const;
 
     //! \brief The most recent mode according to the latest time
-    Mode const& latest_mode() const;
+    Mode latest_mode() const;
 
     //! \brief Acquire the \a state to be ultimately held into the hystory
     //! \details Hystory will not be effectively updated till the mode changes
     void acquire(Mode const& mode, Map<KeypointIdType,List<Point>> const& points, TimestampType const& timestamp);
+    //! \brief Acquire the state from a \a message, whose point indices are the keypoint ids of the robot
+    //! \details The point indices of the segments are parsed from the keypoint ids once, on construction
+    void acquire(RobotStateMessage const& message);
 
     //! \brief The mode of the robot at the given \a timestamp
     //! \details If the time is greater than the received last sample, then the current mode is returned
-    Mode const& mode_at(TimestampType const& timestamp) const;
+    Mode mode_at(TimestampType const& timestamp) const;
 
-    //! \brief Return a snapshot at the given \a timestamp
+    //! \brief Return a snapshot at the given \a timestamp, pinning the current version
     RobotStateHistorySnapshot snapshot_at(TimestampType const& timestamp) const;
 
+    //! \brief Pin the snapshot time \a timestamp, so that samples at that time are not reclaimed while the pin is alive
+    SnapshotTimePin pin_snapshot_time(TimestampType const& timestamp) const;
+
     //! \brief Remove all entries timed previously from \a timestamp
-    //! \details Mode states are not modified, since they are a fusion of the continuous values
+    //! \details Mode states are a fusion of the continuous values, hence only their entries superseded
+    //! before both \a timestamp and the oldest pinned snapshot time are removed
     void remove_older_than(TimestampType const& timestamp);
 
+    //! \brief The oldest time of a snapshot currently alive, or the maximum timestamp value if none
+    TimestampType oldest_pinned_snapshot_time() const;
+
     //! \brief Return the number of presences
     SizeType size() const;
 
-  public:
-    Deque<RobotModePresence> _mode_presences;
-  private:
-    ModeSamplesHistoryType _mode_states;
-    Mode _latest_mode;
-    TimestampType _latest_time;
-    BodySamplesType _current_mode_states_buffer;
+    //! \brief [TEST] The number of samples entries for \a mode
+    SizeType __num_samples_entries(Mode const& mode) const;
 
-    std::mutex mutable _states_mux;
-    std::mutex mutable _presences_mux;
+  private:
+    //! \brief The currently published version
+    SharedPointer<Version const> _current() const;
+    //! \brief Publish a new \a version, replacing the current one
+    void _publish(SharedPointer<Version const> const& version);
+    //! \brief Acquire the state given the samples of head and tail of each segment returned by \a segment_points
+    template<class F> void _acquire(Mode const& mode, SizeType const& num_points, F const& segment_points, TimestampType const& timestamp);
 
-    Deque<Pair<TimestampType,ModeTrace>> _mode_traces;
+  private:
+    SharedPointer<Version const> _version;
+    std::mutex mutable _version_mux;
+    BodySamplesType _current_mode_states_buffer;
+    List<Pair<SizeType,SizeType>> _segment_points;
+    std::mutex _writing_mux;
+    SnapshotTimePins mutable _snapshot_pins;
 
   protected:
     Robot const _robot;
@@ -205,8 +319,10 @@ class RobotStateHistorySnapshot {
     typedef List<BodySegmentSample> SegmentTemporalSamplesType;
     typedef List<SegmentTemporalSamplesType> BodySamplesType;
   protected:
-    //! \brief Construct from a \a history and a \a snapshot_time
+    //! \brief Construct from a \a history and a \a snapshot_time, pinning the current version of the history
     RobotStateHistorySnapshot(RobotStateHistory const& history, TimestampType const& snapshot_time);
+    //! \brief Construct from a \a history, a specific \a version of it and a \a snapshot_time
+    RobotStateHistorySnapshot(RobotStateHistory const& history, SharedPointer<RobotStateHistory::Version const> const& version, TimestampType const& snapshot_time);
   public:
 
     //! \brief The mode trace
@@ -256,7 +372,9 @@ class RobotStateHistorySnapshot {
 
   private:
     RobotStateHistory const& _history;
+    SharedPointer<RobotStateHistory::Version const> _version;
     TimestampType _snapshot_time;
+    SnapshotTimePin _pin;
 };
 
 }
@@ -0,0 +1,157 @@
+/***************************************************************************
+ *            udp.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPERA_UDP_HPP
+#define OPERA_UDP_HPP
+
+#include <string>
+#include <atomic>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "thread.hpp"
+
+#include "broker_access.hpp"
+#include "codec.hpp"
+
+namespace Opera {
+
+//! \brief The maximum size of the payload of a UDP datagram
+constexpr SizeType UDP_MAX_PAYLOAD_SIZE = 65507;
+
+//! \brief A UDP socket, closed on destruction
+class UdpSocket {
+  public:
+    //! \brief Open a socket for sending datagrams
+    UdpSocket();
+    //! \brief Open a socket bound to the given \a address and \a port, with a receive buffer of \a receive_buffer_size bytes
+    //! \details The socket times out receiving after \a timeout_ms milliseconds, in order to check for stopping
+    UdpSocket(std::string const& address, int port, SizeType const& receive_buffer_size, SizeType const& timeout_ms);
+    UdpSocket(UdpSocket const&) = delete;
+    void operator=(UdpSocket const&) = delete;
+
+    //! \brief The file descriptor
+    int descriptor() const;
+
+    //! \brief Interrupt any blocking receive
+    void shutdown();
+
+    ~UdpSocket();
+  private:
+    int _descriptor;
+};
+
+//! \brief The publisher of human states as datagrams to a UDP endpoint
+//! \details Mostly useful for testing, or for relaying from trackers that do not send datagrams themselves
+class UdpHumanStatePublisher : public PublisherInterface<HumanStateMessage> {
+  public:
+    UdpHumanStatePublisher(std::string const& address, int port, MessageEncoding const& encoding);
+    void put(HumanStateMessage const& obj) override;
+  private:
+    UdpSocket const _socket;
+    MessageEncoding const _encoding;
+    struct sockaddr_in _destination;
+};
+
+//! \brief The subscriber to human states received as datagrams on a UDP endpoint
+//! \details Datagrams are received in batches, and each one is decoded only if it carries a sample of some body
+//! newer than those already delivered; stale datagrams, e.g., reordered by the network, are dropped by peeking their header
+class UdpHumanStateSubscriber : public SubscriberInterface<HumanStateMessage> {
+  public:
+    //! \brief Start receiving on the \a address and \a port, with at most \a batch_size datagrams per receive call
+    UdpHumanStateSubscriber(std::string const& address, int port, CallbackFunction<HumanStateMessage> const& callback, MessageEncoding const& encoding,
+                            MessageFilter const& filter, SizeType const& batch_size);
+
+    //! \brief The number of datagrams received
+    SizeType num_received() const;
+    //! \brief The number of datagrams dropped since stale
+    SizeType num_stale() const;
+    //! \brief The number of datagrams dropped since not decodable
+    SizeType num_invalid() const;
+
+    ~UdpHumanStateSubscriber();
+
+  private:
+    //! \brief Receive a batch of datagrams into the buffers, returning their number while their sizes are held in the sizes
+    SizeType _receive_batch();
+    //! \brief Handle the \a payload of the given \a size
+    void _handle(const char* payload, SizeType const& size);
+    //! \brief Remove the latest timestamps of the bodies not received for a while, with datagrams older than them considered stale
+    //! \details Attempted only once the number of bodies doubled since the previous pruning, so that its cost is amortised
+    void _prune_latest_timestamps();
+
+  private:
+    CallbackFunction<HumanStateMessage> const _callback;
+    MessageEncoding const _encoding;
+    MessageFilter const _filter;
+    List<List<char>> _buffers;
+    List<SizeType> _sizes;
+#if defined(__linux__)
+    //! \brief The headers and vectors for receiving into the buffers, prepared once by the receiving thread
+    List<struct mmsghdr> _messages;
+    List<struct iovec> _vectors;
+#endif
+    Map<BodyIdType,TimestampType> _latest_timestamps;
+    TimestampType _newest_timestamp;
+    TimestampType _pruned_before;
+    SizeType _pruning_size;
+    std::atomic<SizeType> _num_received;
+    std::atomic<SizeType> _num_stale;
+    std::atomic<SizeType> _num_invalid;
+    std::atomic<bool> _stopped;
+    UdpSocket _socket;
+    Thread const _thr;
+};
+
+//! \brief Access to human states sent as UDP datagrams, each holding one message
+//! \details Only human states are supported, with the topic being ignored since the endpoint identifies the stream;
+//! other kinds of messages should be accessed through a different broker, see the Runtime constructor taking an access for each topic
+class UdpBrokerAccess : public BrokerAccessInterface {
+  public:
+    //! \brief Construct with the \a address and \a port of the endpoint, the \a encoding for the payload of messages
+    //! and the maximum number of datagrams to receive in a \a batch
+    UdpBrokerAccess(std::string const& address, int port, MessageEncoding const& encoding = MessageEncoding::JSON, SizeType const& batch_size = 32);
+
+    PublisherInterface<BodyPresentationMessage>* make_body_presentation_publisher(BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
+    PublisherInterface<HumanStateMessage>* make_human_state_publisher(HumanStateTopic const& topic = HumanStateTopic::DEFAULT) const override;
+    PublisherInterface<RobotStateMessage>* make_robot_state_publisher(RobotStateTopic const& topic = RobotStateTopic::DEFAULT) const override;
+    PublisherInterface<CollisionNotificationMessage>* make_collision_notification_publisher(CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
+    SubscriberInterface<BodyPresentationMessage>* make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic = BodyPresentationTopic::DEFAULT) const override;
+    SubscriberInterface<HumanStateMessage>* make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic = HumanStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<RobotStateMessage>* make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic = RobotStateTopic::DEFAULT, MessageFilter const& filter = MessageFilter()) const override;
+    SubscriberInterface<CollisionNotificationMessage>* make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic = CollisionNotificationTopic::DEFAULT) const override;
+
+  private:
+    std::string const _address;
+    int const _port;
+    MessageEncoding const _encoding;
+    SizeType const _batch_size;
+};
+
+}
+
+#endif // OPERA_UDP_HPP
@@ -32,6 +32,7 @@
 #include <filesystem>
 #include <map>
 #include <sstream>
+#include <stdexcept>
 #include "declarations.hpp"
 #include "config.hpp"
 
@@ -81,6 +82,78 @@ template<class K, class V> class Map : public std::map<K,V> {
     bool has_key(K const& key) const { return this->find(key) != this->end(); }
 };
 
+//! \brief A sequence stored as immutable chunks of up to \a C elements, shared between copies
+//! \details Appending copies at most the last chunk and removing from the front never copies elements,
+//! hence changing a copy of a sequence of N elements costs O(N/C+C) instead of O(N)
+template<class T, SizeType C = 32> class ChunkedSequence {
+    using ChunkType = List<T>;
+  public:
+    //! \brief A forward iterator on the elements
+    class const_iterator {
+      public:
+        const_iterator(ChunkedSequence const& sequence, SizeType const& index) : _sequence(&sequence), _index(index) { }
+        T const& operator*() const { return _sequence->at(_index); }
+        T const* operator->() const { return &_sequence->at(_index); }
+        const_iterator& operator++() { ++_index; return *this; }
+        bool operator==(const_iterator const& other) const { return _index == other._index; }
+        bool operator!=(const_iterator const& other) const { return _index != other._index; }
+      private:
+        ChunkedSequence const* _sequence;
+        SizeType _index;
+    };
+
+    //! \brief The number of elements
+    SizeType size() const { return _size; }
+    //! \brief Whether there are no elements
+    bool empty() const { return _size == 0; }
+
+    //! \brief The element at index \a i
+    T const& at(SizeType const& i) const {
+        if (i >= _size) throw std::out_of_range("ChunkedSequence index " + std::to_string(i) + " out of range for size " + std::to_string(_size));
+        auto const j = _offset + i;
+        return (*_chunks[j/C])[j%C];
+    }
+    T const& front() const { return at(0); }
+    T const& back() const { return at(_size-1); }
+
+    const_iterator begin() const { return const_iterator(*this,0); }
+    const_iterator end() const { return const_iterator(*this,_size); }
+
+    //! \brief Append \a value, copying the last chunk only if not full
+    void push_back(T const& value) {
+        if (_chunks.empty() or _chunks.back()->size() == C) {
+            auto chunk = std::make_shared<ChunkType>();
+            chunk->reserve(C);
+            chunk->push_back(value);
+            _chunks.push_back(chunk);
+        } else {
+            auto chunk = std::make_shared<ChunkType>(*_chunks.back());
+            chunk->push_back(value);
+            _chunks.back() = chunk;
+        }
+        ++_size;
+    }
+    template<class... AS> void emplace_back(AS&&... args) { push_back(T(std::forward<AS>(args)...)); }
+
+    //! \brief Remove the first element, releasing its chunk when exhausted
+    void pop_front() {
+        if (_size == 0) throw std::out_of_range("ChunkedSequence is empty");
+        ++_offset;
+        --_size;
+        if (_size == 0) {
+            _chunks.clear();
+            _offset = 0;
+        } else if (_offset == C) {
+            _chunks.pop_front();
+            _offset = 0;
+        }
+    }
+  private:
+    Deque<SharedPointer<ChunkType const>> _chunks;
+    SizeType _offset = 0;
+    SizeType _size = 0;
+};
+
 template<class T> std::ostream& operator<<(std::ostream& os, List<T> const& l) {
     if (l.empty()) return os << "[]";
     os << "[" << l.at(0);
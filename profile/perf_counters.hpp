@@ -0,0 +1,163 @@
+/***************************************************************************
+ *            perf_counters.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPERA_PERF_COUNTERS_HPP
+#define OPERA_PERF_COUNTERS_HPP
+
+#include <array>
+#include <string>
+#include <cstring>
+#include <cerrno>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Opera {
+
+//! \brief A group of hardware performance counters for the calling thread, counting user space only
+//! \details Uses perf_event_open on Linux and is never available elsewhere; counters not supported
+//! by the processor are left out of the group, with their values reported as zero.
+//! Threads created by the calling thread after construction are also counted, unless the kernel does not support
+//! inheritance for groups, in which case only the calling thread is counted. The counts of such a thread are added to
+//! the group only when the thread exits, hence threads must be joined before stopping to be accounted for
+class PerfCounters {
+  public:
+    static constexpr std::size_t NUM_COUNTERS = 4;
+    using ValuesType = std::array<double,NUM_COUNTERS>;
+
+    //! \brief The names of the counters, in the order of the values
+    static char const* name(std::size_t i) {
+        static constexpr char const* names[NUM_COUNTERS] = {"cycles","instructions","cache_misses","branch_misses"};
+        return names[i];
+    }
+
+    PerfCounters() {
+        _fds.fill(-1);
+#if defined(__linux__)
+        // Older kernels reject reading a group of inherited counters
+        if (_open(true) == EINVAL) {
+            _error.clear();
+            _open(false);
+        }
+#else
+        _error = "not supported on this platform";
+#endif
+    }
+
+    PerfCounters(PerfCounters const&) = delete;
+    PerfCounters& operator=(PerfCounters const&) = delete;
+
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (auto fd : _fds) if (fd != -1) close(fd);
+#endif
+    }
+
+    //! \brief Whether at least the cycles can be counted
+    bool is_available() const { return _fds[0] != -1; }
+    //! \brief Whether the counter \a i is in the group
+    bool has(std::size_t i) const { return _fds[i] != -1; }
+    //! \brief Whether threads created after construction are counted too, once they exit, rather than the calling thread only
+    bool is_inherited() const { return _inherited; }
+    //! \brief The reason why the counters are not available, empty if available
+    std::string const& error() const { return _error; }
+
+    //! \brief Reset the counts to zero and start counting
+    void start() {
+#if defined(__linux__)
+        if (not is_available()) return;
+        ioctl(_fds[0],PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+        ioctl(_fds[0],PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    //! \brief Stop counting and return the counts since the start, scaled up if the group was multiplexed
+    //! \details The counts include the inheriting threads that already exited, not those still running
+    ValuesType stop() {
+        ValuesType result;
+        result.fill(0);
+#if defined(__linux__)
+        if (not is_available()) return result;
+        ioctl(_fds[0],PERF_EVENT_IOC_DISABLE,PERF_IOC_FLAG_GROUP);
+        struct { __u64 nr; __u64 time_enabled; __u64 time_running; struct { __u64 value; __u64 id; } values[NUM_COUNTERS]; } data;
+        if (read(_fds[0],&data,sizeof(data)) <= 0 or data.time_running == 0) return result;
+        double const scaling = static_cast<double>(data.time_enabled)/static_cast<double>(data.time_running);
+        for (__u64 v=0; v<data.nr and v<NUM_COUNTERS; ++v)
+            for (std::size_t i=0; i<NUM_COUNTERS; ++i)
+                if (has(i) and _ids[i] == data.values[v].id)
+                    result[i] = static_cast<double>(data.values[v].value)*scaling;
+#endif
+        return result;
+    }
+
+  private:
+#if defined(__linux__)
+    //! \brief Open the group for the calling thread, with the counters being \a inherited by the threads it creates
+    //! \returns The error number if the group could not be opened, zero otherwise
+    int _open(bool inherited) {
+        static constexpr unsigned long long configs[NUM_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES,PERF_COUNT_HW_INSTRUCTIONS,
+                                                                     PERF_COUNT_HW_CACHE_MISSES,PERF_COUNT_HW_BRANCH_MISSES};
+        for (std::size_t i=0; i<NUM_COUNTERS; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr,0,sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = (_fds[0] == -1 ? 1 : 0);
+            // The counts of an inheriting thread reach the group only on its exit: threads still running on stop() are missed
+            attr.inherit = (inherited ? 1 : 0);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            auto fd = static_cast<int>(syscall(SYS_perf_event_open,&attr,0,-1,_fds[0],0));
+            if (fd == -1) {
+                if (_fds[0] == -1) { auto const error_number = errno; _error = std::strerror(error_number); return error_number; }
+                continue;
+            }
+            _fds[i] = fd;
+            ioctl(fd,PERF_EVENT_IOC_ID,&_ids[i]);
+        }
+        _inherited = inherited;
+        return 0;
+    }
+#endif
+
+  private:
+    std::array<int,NUM_COUNTERS> _fds;
+    std::array<unsigned long long,NUM_COUNTERS> _ids = {};
+    bool _inherited = false;
+    std::string _error;
+};
+
+} // namespace Opera
+
+#endif /* OPERA_PERF_COUNTERS_HPP */
@@ -29,25 +29,126 @@
 #include <functional>
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
 #include "stopwatch.hpp"
+#include "perf_counters.hpp"
 #include "declarations.hpp"
+#include "utility.hpp"
 
 using namespace Opera;
 
+//! \brief The settings of profiling, shared by the profilers of an executable
+struct ProfileSettings {
+    //! \brief The number of measured trials for each profiled function
+    SizeType num_trials = 10;
+    //! \brief The number of trials run before the measured ones, whose times are discarded
+    SizeType num_warmup_trials = 1;
+    //! \brief The seed of the randomiser, fixed so that runs are reproducible
+    unsigned int seed = 42;
+    //! \brief The file where to write the results in JSON, if any
+    std::string json_path;
+    //! \brief The file where to write the results in CSV, if any
+    std::string csv_path;
+    //! \brief The JSON file of results from a previous run to compare against, if any
+    std::string baseline_path;
+    //! \brief The relative increase of the median over the baseline beyond which a result is a regression
+    double regression_threshold = 0.05;
+    //! \brief Whether to sample the hardware performance counters around each trial
+    bool hardware_counters = false;
+
+    //! \brief The settings in use
+    static ProfileSettings& instance() {
+        static ProfileSettings instance;
+        return instance;
+    }
+};
+
 struct Randomiser {
+    static std::mt19937& generator() {
+        static std::mt19937 generator(ProfileSettings::instance().seed);
+        return generator;
+    }
+
+    static void seed(unsigned int value) {
+        generator().seed(value);
+    }
+
     static FloatType get(double min, double max) {
-        return (max-min)*rand()/RAND_MAX + min;
+        return std::uniform_real_distribution<FloatType>(min,max)(generator());
     }
 };
 
-inline bool _init_randomiser() {
-    srand(static_cast<unsigned int>(time(nullptr)));
-    return true;
-}
-static const bool init_randomiser = _init_randomiser();
-
 using NsCount = long long unsigned int;
 
+//! \brief The statistics of the time for one iteration of a profiled function, over trials
+struct ProfileResult {
+    std::string name;
+    //! \brief The number of iterations in each trial
+    SizeType num_iterations;
+    //! \brief The time for one iteration in each trial, in nanoseconds and sorted
+    List<FloatType> samples;
+    //! \brief The hardware counts for one iteration over all trials, empty if not sampled
+    List<Pair<std::string,FloatType>> counters;
+
+    ProfileResult(std::string const& n, SizeType const& iterations, List<FloatType> const& s) : name(n), num_iterations(iterations), samples(s) {
+        std::sort(samples.begin(),samples.end());
+    }
+
+    //! \brief The sample at the given \a fraction of the sorted samples, interpolating linearly
+    FloatType percentile(double fraction) const {
+        if (samples.empty()) return 0;
+        auto position = fraction*static_cast<double>(samples.size()-1);
+        auto lower = static_cast<SizeType>(std::floor(position));
+        auto upper = std::min(lower+1,samples.size()-1);
+        return samples.at(lower) + (samples.at(upper)-samples.at(lower))*(position-static_cast<double>(lower));
+    }
+    FloatType median() const { return percentile(0.5); }
+    FloatType mean() const {
+        if (samples.empty()) return 0;
+        FloatType result = 0;
+        for (auto const& s : samples) result += s;
+        return result/static_cast<FloatType>(samples.size());
+    }
+    FloatType stddev() const {
+        if (samples.size() < 2) return 0;
+        auto m = mean();
+        FloatType result = 0;
+        for (auto const& s : samples) result += (s-m)*(s-m);
+        return std::sqrt(result/static_cast<FloatType>(samples.size()-1));
+    }
+};
+
+//! \brief Acquire the profile settings from the command line, returning the arguments not recognised
+//! \details Recognised are --trials, --warmup, --seed, --json, --csv, --baseline, --threshold (in percent) and --counters
+inline List<std::string> acquire_profile_settings(int argc, const char* argv[]) {
+    auto& settings = ProfileSettings::instance();
+    List<std::string> remaining;
+    for (int i=1; i<argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--counters") { settings.hardware_counters = true; continue; }
+        bool const recognised = (arg == "--trials" or arg == "--warmup" or arg == "--seed" or arg == "--json" or arg == "--csv" or arg == "--baseline" or arg == "--threshold");
+        if (not recognised) { remaining.push_back(arg); continue; }
+        if (i+1 == argc) throw std::invalid_argument("Missing value for argument '" + arg + "'");
+        std::string value = argv[++i];
+        if (arg == "--trials") settings.num_trials = std::max<SizeType>(1,std::stoul(value));
+        else if (arg == "--warmup") settings.num_warmup_trials = std::stoul(value);
+        else if (arg == "--seed") settings.seed = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--json") settings.json_path = value;
+        else if (arg == "--csv") settings.csv_path = value;
+        else if (arg == "--baseline") settings.baseline_path = value;
+        else settings.regression_threshold = std::stod(value)/100;
+    }
+    Randomiser::seed(settings.seed);
+    return remaining;
+}
+
 class Profiler {
   public:
     Profiler(SizeType num_tries) : _num_tries(num_tries) { }
@@ -56,37 +157,228 @@ class Profiler {
 
     Randomiser const& rnd() const { return _rnd; }
 
+    //! \brief Profile \a function over \a num_tries iterations, returning the median time for one iteration
+    //! \details The iterations are split into consecutive trials, the first ones for warm-up, so that each index is run exactly once
+    //! and functions that consume their inputs keep their semantics. Hardware counts include the threads started by
+    //! \a function only if they are joined before it returns
     NsCount profile(std::function<void(SizeType)> function, SizeType num_tries) {
-        _sw.restart();
-        for (SizeType i=0; i<num_tries; ++i) function(i);
-        _sw.click();
-        return static_cast<NsCount>(((double)_sw.duration().count())/num_tries*1000);
+        return static_cast<NsCount>(std::round(_profile(std::string(),function,num_tries).median()));
     }
 
     NsCount profile(std::string msg, std::function<void(SizeType)> function, SizeType num_tries) {
-        auto cnt = profile(function,num_tries);
-        std::cout << msg << " completed in " << _pretty_print(cnt) << " on average" << std::endl;
-        return cnt;
+        auto const& result = _profile(msg,function,num_tries);
+        std::ostringstream ss;
+        ss << msg << " completed in " << _pretty_print(result.median()) << " on median (p10 " << _pretty_print(result.percentile(0.1))
+           << ", p90 " << _pretty_print(result.percentile(0.9)) << ", stddev " << _pretty_print(result.stddev()) << ", " << result.samples.size() << " trials)";
+        for (SizeType c=0; c<result.counters.size(); ++c)
+            ss << (c == 0 ? " | " : ", ") << result.counters.at(c).second << " " << result.counters.at(c).first;
+        std::cout << ss.str() << _compare_with_baseline(result) << std::endl;
+        return static_cast<NsCount>(std::round(result.median()));
     }
 
     NsCount profile(std::string msg, std::function<void(SizeType)> function) {
         return profile(msg,function,_num_tries);
     }
 
-  private:
+    //! \brief Write the results to the files in the settings, returning a nonzero value if there are regressions against the baseline
+    int conclude() const {
+        auto const& settings = ProfileSettings::instance();
+        if (not settings.json_path.empty()) _write_json(settings.json_path);
+        if (not settings.csv_path.empty()) _write_csv(settings.csv_path);
+        if (_num_regressions > 0) std::cout << _num_regressions << " regressions against the baseline" << std::endl;
+        return (_num_regressions > 0 ? 1 : 0);
+    }
+
+  protected:
+
+    //! \brief Add a result from externally measured \a samples in nanoseconds, with \a num_iterations for each sample
+    ProfileResult& _record(std::string const& name, SizeType const& num_iterations, List<FloatType> const& samples) {
+        _results.emplace_back(name,num_iterations,samples);
+        return _results.back();
+    }
 
-    std::string _pretty_print(NsCount const& cnt) const {
+    //! \brief A description of the comparison of \a result with the baseline, empty if the baseline has no such result
+    //! \details A difference is significant when exceeding both the threshold and twice the relative standard deviation of the result
+    std::string _compare_with_baseline(ProfileResult const& result) const {
+        auto const& baseline = _baseline();
+        if (not baseline.has_key(result.name) or baseline.at(result.name) <= 0) return std::string();
+        auto const median = result.median();
+        auto const relative_difference = (median - baseline.at(result.name))/baseline.at(result.name);
+        auto const noise = (median > 0 ? 2*result.stddev()/median : 0.0);
+        auto const& threshold = ProfileSettings::instance().regression_threshold;
+        std::ostringstream ss;
+        ss << " [" << (relative_difference >= 0 ? "+" : "") << std::round(relative_difference*1000)/10 << "% vs baseline";
+        if (std::abs(relative_difference) > threshold and std::abs(relative_difference) > noise) {
+            if (relative_difference > 0) { ss << ", REGRESSION"; ++_num_regressions; }
+            else ss << ", improvement";
+        } else ss << ", within noise";
+        ss << "]";
+        return ss.str();
+    }
+
+    std::string _pretty_print(FloatType const& ns) const {
         std::stringstream ss;
-        if (cnt < 1000) ss << cnt << " ns";
-        else if (cnt < 1000000) ss << static_cast<FloatType>(cnt)/1000 << " us";
-        else if (cnt < 1000000000) ss << static_cast<FloatType>(cnt)/1000000 << " ms";
-        else if (cnt < 1000000000000) ss << static_cast<FloatType>(cnt)/1000000000 << " sec";
-        else ss << static_cast<FloatType>(cnt)/60000000000 << " min";
+        if (ns < 1000) ss << ns << " ns";
+        else if (ns < 1000000) ss << ns/1000 << " us";
+        else if (ns < 1000000000) ss << ns/1000000 << " ms";
+        else if (ns < 1000000000000) ss << ns/1000000000 << " sec";
+        else ss << ns/60000000000 << " min";
         return ss.str();
     }
 
   private:
-    Stopwatch<Microseconds> _sw;
+
+    ProfileResult const& _profile(std::string const& name, std::function<void(SizeType)> const& function, SizeType num_tries) {
+        auto const& settings = ProfileSettings::instance();
+        SizeType num_trials = std::min(num_tries,settings.num_warmup_trials+settings.num_trials);
+        SizeType num_warmup_trials = (num_trials > settings.num_trials ? num_trials - settings.num_trials : 0);
+        auto* counters = _counters();
+        PerfCounters::ValuesType counts;
+        counts.fill(0);
+        SizeType num_measured_tries = 0;
+        List<FloatType> samples;
+        for (SizeType t=0; t<num_trials; ++t) {
+            SizeType const begin = t*num_tries/num_trials;
+            SizeType const end = (t+1)*num_tries/num_trials;
+            if (counters != nullptr) counters->start();
+            _sw.restart();
+            for (SizeType i=begin; i<end; ++i) function(i);
+            _sw.click();
+            if (t >= num_warmup_trials) {
+                samples.push_back(static_cast<FloatType>(_sw.duration().count())/static_cast<FloatType>(end-begin));
+                num_measured_tries += end-begin;
+            }
+            if (counters != nullptr) {
+                auto const trial_counts = counters->stop();
+                if (t >= num_warmup_trials)
+                    for (SizeType c=0; c<PerfCounters::NUM_COUNTERS; ++c) counts[c] += trial_counts[c];
+            }
+        }
+        auto& result = _record(name,num_tries/std::max<SizeType>(1,num_trials),samples);
+        if (counters != nullptr and num_measured_tries > 0)
+            for (SizeType c=0; c<PerfCounters::NUM_COUNTERS; ++c)
+                if (counters->has(c))
+                    result.counters.push_back({PerfCounters::name(c),counts[c]/static_cast<FloatType>(num_measured_tries)});
+        return result;
+    }
+
+    //! \brief The hardware counters if enabled and available, opened on first use
+    PerfCounters* _counters() {
+        if (not ProfileSettings::instance().hardware_counters) return nullptr;
+        if (_perf_counters == nullptr) {
+            _perf_counters = std::make_unique<PerfCounters>();
+            if (not _perf_counters->is_available())
+                std::cerr << "Hardware counters not available (" << _perf_counters->error() << "), reporting times only" << std::endl;
+            else if (not _perf_counters->is_inherited())
+                std::cerr << "Hardware counters cannot be inherited by threads, reporting counts for the main thread only" << std::endl;
+        }
+        return (_perf_counters->is_available() ? _perf_counters.get() : nullptr);
+    }
+
+    //! \brief The medians of the baseline results by name, loaded on first use
+    Map<std::string,FloatType> const& _baseline() const {
+        if (not _baseline_loaded) {
+            _baseline_loaded = true;
+            auto const& path = ProfileSettings::instance().baseline_path;
+            if (not path.empty()) {
+                std::ifstream ifs(path);
+                if (not ifs.is_open()) { std::cerr << "Could not open baseline '" << path << "'" << std::endl; return _baseline_medians; }
+                std::string content((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+                rapidjson::Document document;
+                document.Parse(content.c_str());
+                if (document.HasParseError() or not document.IsObject() or not document.HasMember("results") or not document["results"].IsArray()) {
+                    std::cerr << "Invalid baseline '" << path << "'" << std::endl;
+                    return _baseline_medians;
+                }
+                SizeType num_invalid = 0;
+                for (auto const& r : document["results"].GetArray()) {
+                    if (not r.IsObject() or not r.HasMember("name") or not r["name"].IsString() or not r.HasMember("median_ns") or not r["median_ns"].IsNumber()) {
+                        ++num_invalid;
+                        continue;
+                    }
+                    _baseline_medians[r["name"].GetString()] = r["median_ns"].GetDouble();
+                }
+                if (num_invalid > 0)
+                    std::cerr << "Ignored " << num_invalid << " invalid results in baseline '" << path << "'" << std::endl;
+            }
+        }
+        return _baseline_medians;
+    }
+
+    void _write_json(std::string const& path) const {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("seed"); writer.Uint(ProfileSettings::instance().seed);
+        writer.Key("results");
+        writer.StartArray();
+        for (auto const& r : _results) {
+            writer.StartObject();
+            writer.Key("name"); writer.String(r.name.c_str(),static_cast<rapidjson::SizeType>(r.name.size()));
+            writer.Key("iterations"); writer.Uint64(r.num_iterations);
+            writer.Key("trials"); writer.Uint64(r.samples.size());
+            writer.Key("median_ns"); writer.Double(r.median());
+            writer.Key("mean_ns"); writer.Double(r.mean());
+            writer.Key("stddev_ns"); writer.Double(r.stddev());
+            writer.Key("p10_ns"); writer.Double(r.percentile(0.1));
+            writer.Key("p90_ns"); writer.Double(r.percentile(0.9));
+            writer.Key("p99_ns"); writer.Double(r.percentile(0.99));
+            writer.Key("min_ns"); writer.Double(r.samples.empty() ? 0 : r.samples.front());
+            writer.Key("max_ns"); writer.Double(r.samples.empty() ? 0 : r.samples.back());
+            if (not r.counters.empty()) {
+                writer.Key("counters");
+                writer.StartObject();
+                for (auto const& c : r.counters) { writer.Key(c.first.c_str()); writer.Double(c.second); }
+                writer.EndObject();
+            }
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+        std::ofstream ofs(path, std::ios::trunc);
+        ofs << std::string(buffer.GetString(),buffer.GetSize()) << std::endl;
+    }
+
+    void _write_csv(std::string const& path) const {
+        std::ofstream ofs(path, std::ios::trunc);
+        ofs << "name,iterations,trials,median_ns,mean_ns,stddev_ns,p10_ns,p90_ns,p99_ns,min_ns,max_ns";
+        for (SizeType c=0; c<PerfCounters::NUM_COUNTERS; ++c) ofs << "," << PerfCounters::name(c);
+        ofs << std::endl;
+        for (auto const& r : _results) {
+            std::string name = r.name;
+            for (std::string::size_type pos = name.find('"'); pos != std::string::npos; pos = name.find('"',pos+2)) name.insert(pos,1,'"');
+            ofs << "\"" << name << "\"," << r.num_iterations << "," << r.samples.size() << "," << r.median() << "," << r.mean() << "," << r.stddev() << ","
+                << r.percentile(0.1) << "," << r.percentile(0.9) << "," << r.percentile(0.99) << ","
+                << (r.samples.empty() ? 0 : r.samples.front()) << "," << (r.samples.empty() ? 0 : r.samples.back());
+            for (SizeType c=0; c<PerfCounters::NUM_COUNTERS; ++c) {
+                ofs << ",";
+                for (auto const& counter : r.counters) if (counter.first == PerfCounters::name(c)) ofs << counter.second;
+            }
+            ofs << std::endl;
+        }
+    }
+
+  private:
+    Stopwatch<Nanoseconds> _sw;
     Randomiser _rnd;
     const SizeType _num_tries;
+    Deque<ProfileResult> _results;
+    mutable SizeType _num_regressions = 0;
+    mutable bool _baseline_loaded = false;
+    mutable Map<std::string,FloatType> _baseline_medians;
+    std::unique_ptr<PerfCounters> _perf_counters;
 };
+
+//! \brief Run the profiler \a P after acquiring the settings from the command line, returning the exit code
+template<class P> int profile_main(int argc, const char* argv[]) {
+    try {
+        auto remaining = acquire_profile_settings(argc,argv);
+        if (not remaining.empty()) { std::cerr << "Unrecognised argument '" << remaining.front() << "'" << std::endl; return 1; }
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    P profiler;
+    profiler.run();
+    return profiler.conclude();
+}
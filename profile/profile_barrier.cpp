@@ -156,6 +156,6 @@ struct ProfileBarrier : public Profiler {
     }
 };
 
-int main() {
-    ProfileBarrier().run();
+int main(int argc, const char* argv[]) {
+    return profile_main<ProfileBarrier>(argc,argv);
 }
@@ -97,6 +97,6 @@ struct ProfileBody : public Profiler {
     }
 };
 
-int main() {
-    ProfileBody().run();
+int main(int argc, const char* argv[]) {
+    return profile_main<ProfileBody>(argc,argv);
 }
@@ -30,6 +30,7 @@
 
 #include "utility.hpp"
 #include "deserialisation.hpp"
+#include "binary_serialisation.hpp"
 
 using namespace Opera;
 
@@ -57,6 +58,20 @@ class ProfileDeserialisation : public Profiler {
         profile("Deserialisation of a human sample JSON String into HumanStateMessage",[&](SizeType i){
             Deserialiser<HumanStateMessage>(json_texts.at(i).c_str()).make();
         });
+
+        profile("Streaming deserialisation of a human sample JSON String into HumanStateMessage",[&](SizeType i){
+            StreamingDeserialiser<HumanStateMessage>(json_texts.at(i).c_str()).make();
+        });
+
+        profile("Header peek of a human sample JSON String",[&](SizeType i){
+            StreamingDeserialiser<HumanStateMessage>(json_texts.at(i).c_str()).peek();
+        });
+
+        auto message = Deserialiser<HumanStateMessage>(Resources::path("json/examples/state/humans.json")).make();
+        auto binary_payload = BinarySerialiser<HumanStateMessage>(message).to_string();
+        profile("Deserialisation of a human sample binary payload into HumanStateMessage",[&](auto){
+            BinaryDeserialiser<HumanStateMessage>(binary_payload.data(),binary_payload.size()).make();
+        });
     }
 
     void profile_robotstatemessage() {
@@ -72,6 +87,20 @@ class ProfileDeserialisation : public Profiler {
         profile("Deserialisation of a robot sample JSON String into RobotStateMessage",[&](SizeType i){
             Deserialiser<RobotStateMessage>(json_texts.at(i).c_str()).make();
         });
+
+        profile("Streaming deserialisation of a robot sample JSON String into RobotStateMessage",[&](SizeType i){
+            StreamingDeserialiser<RobotStateMessage>(json_texts.at(i).c_str()).make();
+        });
+
+        profile("Header peek of a robot sample JSON String",[&](SizeType i){
+            StreamingDeserialiser<RobotStateMessage>(json_texts.at(i).c_str()).peek();
+        });
+
+        auto message = Deserialiser<RobotStateMessage>(Resources::path("json/examples/state/robot0.json")).make();
+        auto binary_payload = BinarySerialiser<RobotStateMessage>(message).to_string();
+        profile("Deserialisation of a robot sample binary payload into RobotStateMessage",[&](auto){
+            BinaryDeserialiser<RobotStateMessage>(binary_payload.data(),binary_payload.size()).make();
+        });
     }
 
     void profile_bodypresentationmessage() {
@@ -87,6 +116,12 @@ class ProfileDeserialisation : public Profiler {
         profile("Deserialisation of a robot presentation JSON String into BodyPresentationMessage",[&](SizeType i){
             Deserialiser<BodyPresentationMessage>(json_texts.at(i).c_str()).make();
             });
+
+        auto message = Deserialiser<BodyPresentationMessage>(Resources::path("json/examples/presentation/robot0.json")).make();
+        auto binary_payload = BinarySerialiser<BodyPresentationMessage>(message).to_string();
+        profile("Deserialisation of a robot presentation binary payload into BodyPresentationMessage",[&](auto){
+            BinaryDeserialiser<BodyPresentationMessage>(binary_payload.data(),binary_payload.size()).make();
+        });
     }
 
     void profile_collisionnotificationmessage() {
@@ -102,10 +137,16 @@ class ProfileDeserialisation : public Profiler {
         profile("Deserialisation of a collision notification JSON String into CollisionNotificationMessage",[&](SizeType i){
             Deserialiser<CollisionNotificationMessage>(json_texts.at(i).c_str()).make();
             });
+
+        auto message = Deserialiser<CollisionNotificationMessage>(Resources::path("json/examples/notification/notification0.json")).make();
+        auto binary_payload = BinarySerialiser<CollisionNotificationMessage>(message).to_string();
+        profile("Deserialisation of a collision notification binary payload into CollisionNotificationMessage",[&](auto){
+            BinaryDeserialiser<CollisionNotificationMessage>(binary_payload.data(),binary_payload.size()).make();
+        });
     }
 
 };
 
-int main() {
-    ProfileDeserialisation().run();
+int main(int argc, const char* argv[]) {
+    return profile_main<ProfileDeserialisation>(argc,argv);
 }
@@ -174,6 +174,6 @@ struct ProfileGeometry : public Profiler {
 };
 
 
-int main() {
-    ProfileGeometry().run();
+int main(int argc, const char* argv[]) {
+    return profile_main<ProfileGeometry>(argc,argv);
 }
@@ -0,0 +1,139 @@
+/***************************************************************************
+ *            profile_barrier.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <set>
+#include <mutex>
+#include <thread>
+#include "lookahead_job_registry.hpp"
+#include "profile.hpp"
+
+using namespace Opera;
+
+//! \brief The tree node based on a set of children, used before lock-free nodes were introduced
+class LockedLookAheadJobTreeNode {
+    using PriorityType = LookAheadJobPath::PriorityType;
+  public:
+    LockedLookAheadJobTreeNode(PriorityType const& priority) : _priority(priority), _registered(false) { }
+
+    bool try_register(SizeType const& depth, LookAheadJobPath const& path) {
+        if (_registered) return false;
+        if (depth == 0) {
+            _registered = true;
+            return true;
+        }
+        auto child_it = _children.emplace(path.priority(path.size() - depth)).first;
+        return const_cast<LockedLookAheadJobTreeNode&>(*child_it).try_register(depth - 1, path);
+    }
+
+    bool has_registered(SizeType const& depth, LookAheadJobPath const& path) const {
+        if (depth == 0) return _registered;
+        auto child_it = _children.find(LockedLookAheadJobTreeNode(path.priority(path.size() - depth)));
+        if (child_it == _children.end()) return false;
+        return child_it->has_registered(depth - 1, path);
+    }
+
+    friend bool operator<(LockedLookAheadJobTreeNode const& first, LockedLookAheadJobTreeNode const& second) {
+        return first._priority < second._priority;
+    }
+
+  private:
+    PriorityType const _priority;
+    bool _registered;
+    std::set<LockedLookAheadJobTreeNode> _children;
+};
+
+//! \brief The tree serialising all accesses with a mutex, used before lock-free nodes were introduced
+class LockedLookAheadJobIdTree {
+  public:
+    LockedLookAheadJobIdTree() : _root(0) { }
+
+    bool try_register(LookAheadJobPath const& path) {
+        std::lock_guard<std::mutex> lock(_mux);
+        return _root.try_register(path.size(), path);
+    }
+
+    bool has_registered(LookAheadJobPath const& path) const {
+        std::lock_guard<std::mutex> lock(_mux);
+        return _root.has_registered(path.size(), path);
+    }
+
+  private:
+    LockedLookAheadJobTreeNode _root;
+    mutable std::mutex _mux;
+};
+
+struct ProfileLookAheadJobRegistry : public Profiler {
+
+    ProfileLookAheadJobRegistry() : Profiler(100) { }
+
+    void run() {
+        profile_contended_registration();
+    }
+
+    void profile_contended_registration() {
+        const SizeType num_paths = 4096;
+        const SizeType max_depth = 6;
+        const SizeType max_priority = 4;
+
+        List<LookAheadJobPath> paths;
+        for (SizeType i=0; i<num_paths; ++i) {
+            LookAheadJobPath path;
+            auto depth = static_cast<SizeType>(rnd().get(1.0,static_cast<double>(max_depth)+0.99));
+            for (SizeType d=0; d<depth; ++d)
+                path.add(static_cast<SizeType>(rnd().get(0.0,static_cast<double>(max_priority)-0.01)),d+1);
+            paths.push_back(path);
+        }
+
+        for (SizeType num_threads : {1u, 2u, 4u, 8u}) {
+            profile("Register and check paths with locked set-based tree ("+std::to_string(num_threads)+" threads)",[&](auto){
+                contend<LockedLookAheadJobIdTree>(paths, num_threads); });
+            profile("Register and check paths with lock-free tree ("+std::to_string(num_threads)+" threads)",[&](auto){
+                contend<LookAheadJobIdTree>(paths, num_threads); });
+        }
+    }
+
+    //! \brief Have \a num_threads threads register and check all the \a paths on the same tree, each starting from a different offset
+    template<class T> void contend(List<LookAheadJobPath> const& paths, SizeType const& num_threads) {
+        T tree;
+        List<std::thread> threads;
+        for (SizeType t=0; t<num_threads; ++t) {
+            threads.emplace_back([&tree,&paths,t,num_threads]{
+                auto offset = t*paths.size()/num_threads;
+                for (SizeType i=0; i<paths.size(); ++i) {
+                    auto const& path = paths.at((offset+i)%paths.size());
+                    if (not tree.has_registered(path)) tree.try_register(path);
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+    }
+};
+
+int main(int argc, const char* argv[]) {
+    return profile_main<ProfileLookAheadJobRegistry>(argc,argv);
+}
@@ -0,0 +1,316 @@
+/***************************************************************************
+ *            profile_barrier.hpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <map>
+#include <random>
+#include <numbers>
+#include "runtime.hpp"
+#include "memory.hpp"
+#include "record.hpp"
+#include "job_trace.hpp"
+#include "profile.hpp"
+
+using namespace Opera;
+
+//! \brief The parameters of the stream driving the runtime
+struct RuntimeProfileParameters {
+    SizeType num_humans = 2;
+    SizeType num_robots = 1;
+    SizeType num_segments = 4;
+    SizeType concurrency = std::thread::hardware_concurrency();
+    SizeType num_frames = 500;
+    SizeType frame_period_ms = 10;
+    //! \brief The log recorded by RecordingBrokerAccess to use in place of the synthetic stream
+    String replay_path;
+    //! \brief Whether to publish the recorded stream as fast as possible, instead of with the original timing
+    bool fast = false;
+    //! \brief The file where to write the trace of the lifecycle of jobs, if any
+    String trace_path;
+};
+
+//! \brief Drive a Runtime through the memory broker, measuring the latency from the publishing of a human state
+//! to the publishing of each collision notification for the jobs started from it
+struct ProfileRuntime : public Profiler {
+    using ClockType = std::chrono::steady_clock;
+
+    ProfileRuntime(RuntimeProfileParameters const& parameters) : Profiler(1), _p(parameters), _generator(ProfileSettings::instance().seed) { }
+
+    void run() {
+        MemoryBroker::instance().clear();
+        BrokerAccess access = MemoryBrokerAccess();
+        RuntimeConfiguration configuration;
+        configuration.set_concurrency(_p.concurrency);
+        if (not _p.trace_path.empty()) JobTracer::instance().enable();
+        Runtime runtime(access,configuration);
+
+        std::mutex latencies_mux;
+        List<NsCount> latencies;
+        auto cn_subscriber = access.make_collision_notification_subscriber([&](CollisionNotificationMessage const& msg){
+            auto now = ClockType::now();
+            std::lock_guard<std::mutex> lock(latencies_mux);
+            auto published = _published.find(msg.current_time());
+            if (published != _published.end())
+                latencies.push_back(static_cast<NsCount>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - published->second).count()));
+        });
+        _bp_publisher = access.make_body_presentation_publisher();
+        _hs_publisher = access.make_human_state_publisher();
+        _rs_publisher = access.make_robot_state_publisher();
+
+        SizeType num_samples = 0;
+        SizeType max_waiting = 0, max_sleeping = 0, max_pending = 0;
+        FloatType total_waiting = 0, total_sleeping = 0;
+        auto sample_queues = [&]{
+            auto waiting = runtime.num_waiting_jobs();
+            auto sleeping = runtime.num_sleeping_jobs();
+            auto pending = runtime.num_pending_human_robot_pairs();
+            max_waiting = std::max(max_waiting,waiting);
+            max_sleeping = std::max(max_sleeping,sleeping);
+            max_pending = std::max(max_pending,pending);
+            total_waiting += static_cast<FloatType>(waiting);
+            total_sleeping += static_cast<FloatType>(sleeping);
+            ++num_samples;
+        };
+
+        auto start = ClockType::now();
+        if (_p.replay_path.empty()) _publish_synthetic(latencies_mux,sample_queues);
+        else _publish_recorded(latencies_mux,sample_queues);
+        auto published = ClockType::now();
+        for (SizeType i=0; i<5000 and not runtime.__all_done(); ++i) {
+            sample_queues();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto end = ClockType::now();
+
+        auto publishing_seconds = std::chrono::duration<double>(published - start).count();
+        auto processing_seconds = std::chrono::duration<double>(end - start).count();
+        if (_p.replay_path.empty())
+            std::cout << "Runtime with " << _p.num_humans << " humans, " << _p.num_robots << " robots, " << _p.num_segments
+                      << " segments per body and concurrency " << _p.concurrency << std::endl;
+        else
+            std::cout << "Runtime replaying '" << _p.replay_path << "' with concurrency " << _p.concurrency << std::endl;
+        std::cout << "State messages published: " << _num_messages << " (" << static_cast<SizeType>(static_cast<double>(_num_messages)/publishing_seconds) << " msg/s)" << std::endl;
+        std::cout << "State messages received: " << runtime.__num_state_messages_received() << std::endl;
+        auto& broker = MemoryBroker::instance();
+        _num_skipped = broker.num_skipped<BodyPresentationMessage>() + broker.num_skipped<HumanStateMessage>() +
+                       broker.num_skipped<RobotStateMessage>() + broker.num_skipped<CollisionNotificationMessage>();
+        std::cout << "Messages skipped by subscribers falling behind the memory broker: " << _num_skipped << std::endl;
+        std::cout << "Jobs processed: " << runtime.__num_processed() << " (" << static_cast<SizeType>(static_cast<double>(runtime.__num_processed())/processing_seconds) << " jobs/s), "
+                  << runtime.__num_completed() << " completed" << std::endl;
+        std::cout << "Queue depths: waiting jobs " << total_waiting/static_cast<FloatType>(num_samples) << " on average (" << max_waiting << " max), sleeping jobs "
+                  << total_sleeping/static_cast<FloatType>(num_samples) << " on average (" << max_sleeping << " max), pending human-robot pairs " << max_pending << " max" << std::endl;
+
+        if (not _p.trace_path.empty()) {
+            JobTracer::instance().disable();
+            JobTracer::instance().write(_p.trace_path);
+            std::cout << "Job trace written to '" << _p.trace_path << "' with " << JobTracer::instance().num_entries() << " events ("
+                      << JobTracer::instance().num_dropped() << " dropped)" << std::endl;
+        }
+
+        delete cn_subscriber;
+        std::lock_guard<std::mutex> lock(latencies_mux);
+        std::cout << "Collision notifications: " << latencies.size() << std::endl;
+        if (not latencies.empty()) {
+            std::sort(latencies.begin(),latencies.end());
+            List<FloatType> samples;
+            for (auto const& l : latencies) samples.push_back(static_cast<FloatType>(l));
+            auto const& result = _record("Notification latency",1,samples);
+            std::cout << "Notification latency: p50 " << _pretty_print(_percentile(latencies,0.5)) << ", p99 " << _pretty_print(_percentile(latencies,0.99))
+                      << ", p999 " << _pretty_print(_percentile(latencies,0.999)) << ", max " << _pretty_print(latencies.back()) << _compare_with_baseline(result) << std::endl;
+        }
+
+        delete _bp_publisher;
+        delete _hs_publisher;
+        delete _rs_publisher;
+        MemoryBroker::instance().clear();
+    }
+
+    //! \brief The number of messages skipped by the subscribers during the run
+    SizeType num_skipped() const { return _num_skipped; }
+
+  private:
+
+    static NsCount _percentile(List<NsCount> const& sorted, double fraction) {
+        auto index = static_cast<SizeType>(fraction*static_cast<double>(sorted.size()-1));
+        return sorted.at(index);
+    }
+
+    //! \brief Save the publishing time of the human state with the given \a timestamp
+    void _mark_published(TimestampType const& timestamp, std::mutex& mux) {
+        std::lock_guard<std::mutex> lock(mux);
+        _published[timestamp] = ClockType::now();
+    }
+
+    void _publish_synthetic(std::mutex& mux, std::function<void()> const& sample_queues) {
+        const SizeType num_modes = 4;
+        const SizeType samples_per_mode = 10;
+        const SizeType cycle_length = num_modes*samples_per_mode;
+
+        for (SizeType r=0; r<_p.num_robots; ++r)
+            _bp_publisher->put(BodyPresentationMessage(_robot_id(r),static_cast<SizeType>(1000/_p.frame_period_ms),_segment_pairs(""),List<FloatType>(_p.num_segments,0.1)));
+        for (SizeType h=0; h<_p.num_humans; ++h)
+            _bp_publisher->put(BodyPresentationMessage(_human_id(h),_segment_pairs("k"),List<FloatType>(_p.num_segments,0.1)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        std::uniform_real_distribution<FloatType> noise(-0.05,0.05);
+        auto next = ClockType::now();
+        // A full cycle of robot states comes first, so that each mode has history to predict from
+        for (SizeType f=0; f<cycle_length+_p.num_frames; ++f) {
+            TimestampType timestamp = static_cast<TimestampType>((f+1)*_p.frame_period_ms);
+            auto phase = 2*std::numbers::pi*static_cast<FloatType>(f % cycle_length)/static_cast<FloatType>(cycle_length);
+            Mode mode({"phase",std::to_string((f / samples_per_mode) % num_modes)});
+            for (SizeType r=0; r<_p.num_robots; ++r) {
+                List<List<Point>> points;
+                for (SizeType j=0; j<=_p.num_segments; ++j) {
+                    auto reach = 0.5*static_cast<FloatType>(j);
+                    points.push_back({Point(_base(r)+reach*cos(phase),reach*sin(phase),1.0)});
+                }
+                _rs_publisher->put(RobotStateMessage(_robot_id(r),mode,points,timestamp));
+                ++_num_messages;
+            }
+            if (f >= cycle_length and _p.num_humans > 0) {
+                List<HumanStateMessageBodyType> bodies;
+                for (SizeType h=0; h<_p.num_humans; ++h) {
+                    Map<KeypointIdType,List<Point>> keypoints;
+                    for (SizeType k=0; k<=_p.num_segments; ++k)
+                        keypoints.insert(std::make_pair("k"+std::to_string(k),List<Point>({Point(_base(h % std::max<SizeType>(_p.num_robots,1))+1.0+noise(_generator),
+                                                                                                  0.5+noise(_generator),0.3*static_cast<FloatType>(k)+noise(_generator))})));
+                    bodies.push_back(HumanStateMessageBodyType(_human_id(h),keypoints));
+                }
+                _mark_published(timestamp,mux);
+                _hs_publisher->put(HumanStateMessage(bodies,timestamp));
+                ++_num_messages;
+            }
+            sample_queues();
+            next += std::chrono::milliseconds(_p.frame_period_ms);
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    void _publish_recorded(std::mutex& mux, std::function<void()> const& sample_queues) {
+        MessageLogReader reader(_p.replay_path);
+        auto start = ClockType::now();
+        SizeType offset = reader.begin();
+        MessageLogEntry entry;
+        while (reader.next(offset,entry)) {
+            if (not _p.fast) std::this_thread::sleep_until(start + entry.elapsed);
+            auto const* payload = entry.payload.data();
+            auto size = entry.payload.size();
+            if (entry.kind == BinaryMessageKind::BODY_PRESENTATION) {
+                _bp_publisher->put(decode<BodyPresentationMessage>(payload,size,reader.encoding()));
+            } else if (entry.kind == BinaryMessageKind::HUMAN_STATE) {
+                auto msg = decode<HumanStateMessage>(payload,size,reader.encoding());
+                _mark_published(msg.timestamp(),mux);
+                _hs_publisher->put(msg);
+                ++_num_messages;
+            } else if (entry.kind == BinaryMessageKind::ROBOT_STATE) {
+                _rs_publisher->put(decode<RobotStateMessage>(payload,size,reader.encoding()));
+                ++_num_messages;
+            }
+            sample_queues();
+        }
+    }
+
+    List<Pair<KeypointIdType,KeypointIdType>> _segment_pairs(String const& prefix) const {
+        List<Pair<KeypointIdType,KeypointIdType>> result;
+        for (SizeType i=0; i<_p.num_segments; ++i)
+            result.push_back(std::make_pair(prefix+std::to_string(i),prefix+std::to_string(i+1)));
+        return result;
+    }
+
+    static String _robot_id(SizeType const& i) { return "r" + std::to_string(i); }
+    static String _human_id(SizeType const& i) { return "h" + std::to_string(i); }
+    static FloatType _base(SizeType const& robot) { return 3.0*static_cast<FloatType>(robot); }
+
+  private:
+    RuntimeProfileParameters const _p;
+    std::mt19937 _generator;
+    std::map<TimestampType,ClockType::time_point> _published;
+    SizeType _num_messages = 0;
+    SizeType _num_skipped = 0;
+    PublisherInterface<BodyPresentationMessage>* _bp_publisher = nullptr;
+    PublisherInterface<HumanStateMessage>* _hs_publisher = nullptr;
+    PublisherInterface<RobotStateMessage>* _rs_publisher = nullptr;
+};
+
+//! \brief Print the arguments accepted on top of the profile settings
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--humans <n>] [--robots <n>] [--segments <n>] [--concurrency <n>] [--frames <n>] [--period <ms>]"
+              << " [--replay <log> [--fast]] [--trace <file>]" << std::endl;
+}
+
+//! \brief Run with optional arguments --humans, --robots, --segments, --concurrency, --frames, --period (in ms),
+//! or --replay <log> with an optional --fast to use a recorded stream, and --trace <file> to write the lifecycle of jobs;
+//! the profile settings also apply, with the notification latencies recorded as the samples of one result;
+//! the run fails if subscribers skipped messages, since the latencies would not account for them
+int main(int argc, const char* argv[]) {
+    RuntimeProfileParameters parameters;
+    List<String> args;
+    try {
+        args = acquire_profile_settings(argc,argv);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    for (SizeType i=0; i<args.size(); ++i) {
+        String arg = args.at(i);
+        if (arg == "--fast") { parameters.fast = true; continue; }
+        if (i+1 == args.size()) { std::cerr << "Missing value for argument '" << arg << "'" << std::endl; print_usage(argv[0]); return 1; }
+        String value = args.at(++i);
+        if (arg == "--replay") parameters.replay_path = value;
+        else if (arg == "--trace") parameters.trace_path = value;
+        else {
+            SizeType number = 0;
+            try {
+                std::size_t parsed = 0;
+                number = static_cast<SizeType>(std::stoul(value,&parsed));
+                if (parsed != value.size() or value.front() == '-') throw std::invalid_argument(value);
+            } catch (std::invalid_argument&) {
+                std::cerr << "Invalid value '" << value << "' for argument '" << arg << "'" << std::endl; print_usage(argv[0]); return 1;
+            } catch (std::out_of_range&) {
+                std::cerr << "Out of range value '" << value << "' for argument '" << arg << "'" << std::endl; print_usage(argv[0]); return 1;
+            }
+            if (arg == "--humans") parameters.num_humans = number;
+            else if (arg == "--robots") parameters.num_robots = number;
+            else if (arg == "--segments") parameters.num_segments = number;
+            else if (arg == "--concurrency") parameters.concurrency = number;
+            else if (arg == "--frames") parameters.num_frames = number;
+            else if (arg == "--period") parameters.frame_period_ms = number;
+            else { std::cerr << "Unrecognised argument '" << arg << "'" << std::endl; print_usage(argv[0]); return 1; }
+        }
+    }
+    if (parameters.frame_period_ms == 0) { std::cerr << "The period must be positive" << std::endl; return 1; }
+    ProfileRuntime profiler(parameters);
+    profiler.run();
+    auto result = profiler.conclude();
+    if (profiler.num_skipped() > 0) {
+        std::cerr << "The run is invalid since " << profiler.num_skipped() << " messages were skipped, consider a lower rate" << std::endl;
+        return 1;
+    }
+    return result;
+}
@@ -31,6 +31,7 @@
 #include "utility.hpp"
 #include "deserialisation.hpp"
 #include "serialisation.hpp"
+#include "binary_serialisation.hpp"
 
 using namespace Opera;
 
@@ -53,6 +54,11 @@ class ProfileSerialisation : public Profiler {
         profile("Serialisation of a BodyPresentationMessage into a human presentation JSON String",[&](SizeType i){
             Serialiser<BodyPresentationMessage>(messages.at(i)).to_string();
             });
+
+        profile("Serialisation of a BodyPresentationMessage into a binary payload",[&](SizeType i){
+            BinarySerialiser<BodyPresentationMessage>(messages.at(i)).to_string();
+        });
+        _print_sizes(Serialiser<BodyPresentationMessage>(messages.at(0)).to_string(),BinarySerialiser<BodyPresentationMessage>(messages.at(0)).to_string());
     }
 
     void profile_humanstatemessage() {
@@ -63,6 +69,15 @@ class ProfileSerialisation : public Profiler {
         profile("Serialisation of a HumanStateMessage into a human sample JSON String",[&](SizeType i){
             Serialiser<HumanStateMessage>(messages.at(i)).to_string();
         });
+
+        profile("Serialisation of a HumanStateMessage into the thread human sample JSON buffer",[&](SizeType i){
+            Serialiser<HumanStateMessage>(messages.at(i)).to_view();
+        });
+
+        profile("Serialisation of a HumanStateMessage into a binary payload",[&](SizeType i){
+            BinarySerialiser<HumanStateMessage>(messages.at(i)).to_string();
+        });
+        _print_sizes(Serialiser<HumanStateMessage>(messages.at(0)).to_string(),BinarySerialiser<HumanStateMessage>(messages.at(0)).to_string());
     }
 
     void profile_robotstatemessage() {
@@ -73,6 +88,15 @@ class ProfileSerialisation : public Profiler {
         profile("Serialisation of a RobotStateMessage into a robot sample JSON String",[&](SizeType i){
             Serialiser<RobotStateMessage>(messages.at(i)).to_string();
         });
+
+        profile("Serialisation of a RobotStateMessage into the thread robot sample JSON buffer",[&](SizeType i){
+            Serialiser<RobotStateMessage>(messages.at(i)).to_view();
+        });
+
+        profile("Serialisation of a RobotStateMessage into a binary payload",[&](SizeType i){
+            BinarySerialiser<RobotStateMessage>(messages.at(i)).to_string();
+        });
+        _print_sizes(Serialiser<RobotStateMessage>(messages.at(0)).to_string(),BinarySerialiser<RobotStateMessage>(messages.at(0)).to_string());
     }
 
     void profile_collisionnotificationmessage() {
@@ -83,9 +107,19 @@ class ProfileSerialisation : public Profiler {
         profile("Serialisation of a CollisionNotificationMessage into a human presentation JSON String",[&](SizeType i){
             Serialiser<CollisionNotificationMessage>(messages.at(i)).to_string();
             });
+
+        profile("Serialisation of a CollisionNotificationMessage into a binary payload",[&](SizeType i){
+            BinarySerialiser<CollisionNotificationMessage>(messages.at(i)).to_string();
+        });
+        _print_sizes(Serialiser<CollisionNotificationMessage>(messages.at(0)).to_string(),BinarySerialiser<CollisionNotificationMessage>(messages.at(0)).to_string());
+    }
+
+  private:
+    void _print_sizes(std::string const& json, std::string const& binary) const {
+        std::cout << "Payload size: " << json.size() << " bytes as JSON, " << binary.size() << " bytes as binary" << std::endl;
     }
 };
 
-int main() {
-    ProfileSerialisation().run();
+int main(int argc, const char* argv[]) {
+    return profile_main<ProfileSerialisation>(argc,argv);
 }
@@ -26,6 +26,7 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <algorithm>
 #include "state.hpp"
 #include "message.hpp"
 #include "profile.hpp"
@@ -53,6 +54,13 @@ struct ProfileState : public Profiler {
         }
 
         profile("Make human state instance from message fields",[&](SizeType i){ HumanStateInstance hsi(h,pkts.at(i).bodies().at(0).second,pkts.at(i).timestamp()); });
+
+        auto const& keypoint_ids = pkts.at(0).keypoint_ids(0);
+        auto index_of = [&](KeypointIdType const& id) { return static_cast<SizeType>(std::find(keypoint_ids.begin(),keypoint_ids.end(),id) - keypoint_ids.begin()); };
+        List<Pair<SizeType,SizeType>> segment_keypoints = {{index_of("nose"),index_of("neck")}};
+        profile("Make human state instance from message body",[&](SizeType i){ HumanStateInstance hsi(h,pkts.at(i),0,segment_keypoints); });
+
+        profile("Copy human state message",[&](SizeType i){ HumanStateMessage copy(pkts.at(i)); });
     }
 
     void profile_robot_history_acquirement_and_update() {
@@ -83,6 +91,6 @@ struct ProfileState : public Profiler {
     }
 };
 
-int main() {
-    ProfileState().run();
+int main(int argc, const char* argv[]) {
+    return profile_main<ProfileState>(argc,argv);
 }
@@ -36,6 +36,7 @@ namespace Opera {
 using Seconds = std::chrono::seconds;
 using Milliseconds = std::chrono::milliseconds;
 using Microseconds = std::chrono::microseconds;
+using Nanoseconds = std::chrono::nanoseconds;
 
 template<class D> class Stopwatch {
 public:
@@ -106,17 +106,17 @@ void MinimumDistanceBarrierSequenceSectionBase::remove_last_barrier() {
 }
 
 bool MinimumDistanceBarrierSequenceSectionBase::check_and_update(BodySegmentSample const& robot_sample, TraceSampleIndex const& index) {
-    CONCLOG_SCOPE_CREATE
+    OPERA_HOT_SCOPE_CREATE
     if (reaches_collision()) {
-        CONCLOG_PRINTLN("Distance already reached zero, do not do anything")
+        OPERA_HOT_PRINTLN("Distance already reached zero, do not do anything")
         return false;
     }
     auto current_distance = minimum_human_robot_distance(_human_sample, robot_sample);
     if (is_empty() or current_distance < current_minimum_distance()) {
-        CONCLOG_PRINTLN("Distance reduced (or section is empty), add barrier")
+        OPERA_HOT_PRINTLN("Distance reduced (or section is empty), add barrier")
         add_barrier(current_distance,index);
     } else if (current_distance >= current_minimum_distance()) {
-        CONCLOG_PRINTLN("Not empty and distance not reduced, update the index for the range")
+        OPERA_HOT_PRINTLN("Not empty and distance not reduced, update the index for the range")
         _barriers.back().update_with(index);
     }
     return (current_distance > 0);
@@ -306,12 +306,12 @@ MinimumDistanceBarrier const& MinimumDistanceBarrierSequence::last_barrier() con
 }
 
 MinimumDistanceBarrierSequenceSection& MinimumDistanceBarrierSequence::last_section() {
-    OPERA_PRECONDITION(not is_empty())
+    OPERA_HOT_PRECONDITION(not is_empty())
     return _sections.back();
 }
 
 MinimumDistanceBarrierSequenceSection const& MinimumDistanceBarrierSequence::last_section() const {
-    OPERA_PRECONDITION(not is_empty())
+    OPERA_HOT_PRECONDITION(not is_empty())
     return _sections.back();
 }
 
@@ -0,0 +1,349 @@
+/***************************************************************************
+ *            binary_serialisation.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <bit>
+#include "binary_serialisation.hpp"
+#include "mode.hpp"
+
+namespace Opera {
+
+namespace {
+
+void write_mode(BinaryWriter& writer, Mode const& mode) {
+    writer.write_size(mode.values().size());
+    for (auto const& v : mode.values()) {
+        writer.write_string(v.first);
+        writer.write_string(v.second);
+    }
+}
+
+Mode read_mode(BinaryReader& reader) {
+    Map<String,String> values;
+    auto num_values = reader.read_count(8);
+    for (SizeType i=0; i<num_values; ++i) {
+        auto key = reader.read_string();
+        values.insert(std::make_pair(key,reader.read_string()));
+    }
+    return Mode(values);
+}
+
+void write_segment(BinaryWriter& writer, Pair<KeypointIdType,KeypointIdType> const& segment) {
+    writer.write_string(segment.first);
+    writer.write_string(segment.second);
+}
+
+Pair<KeypointIdType,KeypointIdType> read_segment(BinaryReader& reader) {
+    auto first = reader.read_string();
+    return std::make_pair(first,reader.read_string());
+}
+
+}
+
+String& BinarySerialisationBuffer::acquire() {
+    thread_local String buffer;
+    buffer.clear();
+    return buffer;
+}
+
+BinaryWriter::BinaryWriter(String& buffer) : _buffer(buffer) { }
+
+void BinaryWriter::write_uint8(uint8_t const& value) {
+    _buffer.push_back(static_cast<char>(value));
+}
+
+void BinaryWriter::write_uint32(uint32_t const& value) {
+    for (SizeType i=0; i<4; ++i)
+        _buffer.push_back(static_cast<char>((value >> (8*i)) & 0xFF));
+}
+
+void BinaryWriter::write_uint64(uint64_t const& value) {
+    for (SizeType i=0; i<8; ++i)
+        _buffer.push_back(static_cast<char>((value >> (8*i)) & 0xFF));
+}
+
+void BinaryWriter::write_float(FloatType const& value) {
+    write_uint64(std::bit_cast<uint64_t>(value));
+}
+
+void BinaryWriter::write_size(SizeType const& value) {
+    OPERA_PRECONDITION(value <= UINT32_MAX)
+    write_uint32(static_cast<uint32_t>(value));
+}
+
+void BinaryWriter::write_string(String const& value) {
+    write_size(value.size());
+    _buffer.append(value);
+}
+
+void BinaryWriter::write_point(Point const& value) {
+    write_float(value.x);
+    write_float(value.y);
+    write_float(value.z);
+}
+
+void BinaryWriter::write_header(BinaryMessageKind const& kind) {
+    write_uint8('O');
+    write_uint8('P');
+    write_uint8(BINARY_ENCODING_VERSION);
+    write_uint8(static_cast<uint8_t>(kind));
+}
+
+BinaryReader::BinaryReader(const char* data, SizeType const& size) : _data(reinterpret_cast<const unsigned char*>(data)), _size(size), _position(0) { }
+
+const unsigned char* BinaryReader::_consume(SizeType const& num_bytes) {
+    OPERA_ASSERT_MSG(_position + num_bytes <= _size, "Binary payload of size " << _size << " overrun when reading " << num_bytes << " bytes at position " << _position)
+    auto result = _data + _position;
+    _position += num_bytes;
+    return result;
+}
+
+uint8_t BinaryReader::read_uint8() {
+    return *_consume(1);
+}
+
+uint32_t BinaryReader::read_uint32() {
+    auto bytes = _consume(4);
+    uint32_t result = 0;
+    for (SizeType i=0; i<4; ++i)
+        result |= static_cast<uint32_t>(bytes[i]) << (8*i);
+    return result;
+}
+
+uint64_t BinaryReader::read_uint64() {
+    auto bytes = _consume(8);
+    uint64_t result = 0;
+    for (SizeType i=0; i<8; ++i)
+        result |= static_cast<uint64_t>(bytes[i]) << (8*i);
+    return result;
+}
+
+FloatType BinaryReader::read_float() {
+    return std::bit_cast<FloatType>(read_uint64());
+}
+
+SizeType BinaryReader::read_size() {
+    return read_uint32();
+}
+
+SizeType BinaryReader::read_count(SizeType const& minimum_element_size) {
+    auto result = read_size();
+    OPERA_ASSERT_MSG(result*minimum_element_size <= _size - _position, "Binary payload of size " << _size << " cannot hold " << result << " elements at position " << _position)
+    return result;
+}
+
+String BinaryReader::read_string() {
+    return String(read_string_view());
+}
+
+std::string_view BinaryReader::read_string_view() {
+    auto size = read_size();
+    auto bytes = _consume(size);
+    return std::string_view(reinterpret_cast<const char*>(bytes),size);
+}
+
+void BinaryReader::skip(SizeType const& num_bytes) {
+    _consume(num_bytes);
+}
+
+Point BinaryReader::read_point() {
+    auto x = read_float();
+    auto y = read_float();
+    return Point(x,y,read_float());
+}
+
+void BinaryReader::read_header(BinaryMessageKind const& kind) {
+    auto m1 = read_uint8();
+    auto m2 = read_uint8();
+    OPERA_ASSERT_MSG(m1 == 'O' and m2 == 'P', "The payload is not a binary message.")
+    auto version = read_uint8();
+    OPERA_ASSERT_MSG(version > 0 and version <= BINARY_ENCODING_VERSION, "Unsupported binary encoding version " << static_cast<unsigned int>(version))
+    auto read_kind = read_uint8();
+    OPERA_ASSERT_MSG(read_kind == static_cast<uint8_t>(kind), "Expected binary message kind " << static_cast<unsigned int>(kind) << ", found " << static_cast<unsigned int>(read_kind))
+}
+
+bool BinaryReader::at_end() const {
+    return _position == _size;
+}
+
+void BinarySerialiser<BodyPresentationMessage>::write(BinaryWriter& writer) const {
+    writer.write_header(BinaryMessageKind::BODY_PRESENTATION);
+    writer.write_string(obj.id());
+    writer.write_uint8(obj.is_human() ? 1 : 0);
+    if (not obj.is_human()) writer.write_uint64(obj.message_frequency());
+    writer.write_size(obj.segment_pairs().size());
+    for (SizeType i=0; i<obj.segment_pairs().size(); ++i) {
+        write_segment(writer,obj.segment_pairs().at(i));
+        writer.write_float(obj.thicknesses().at(i));
+    }
+}
+
+void BinarySerialiser<HumanStateMessage>::write(BinaryWriter& writer) const {
+    writer.write_header(BinaryMessageKind::HUMAN_STATE);
+    writer.write_uint64(obj.timestamp());
+    writer.write_size(obj.num_bodies());
+    for (SizeType b=0; b<obj.num_bodies(); ++b) {
+        writer.write_string(obj.body_id(b));
+        auto const& keypoint_ids = obj.keypoint_ids(b);
+        writer.write_size(keypoint_ids.size());
+        for (SizeType k=0; k<keypoint_ids.size(); ++k) {
+            writer.write_string(keypoint_ids.at(k));
+            auto const samples = obj.samples(b,k);
+            writer.write_size(samples.size());
+            for (auto const& point : samples)
+                writer.write_point(point);
+        }
+    }
+}
+
+void BinarySerialiser<RobotStateMessage>::write(BinaryWriter& writer) const {
+    writer.write_header(BinaryMessageKind::ROBOT_STATE);
+    writer.write_string(obj.id());
+    writer.write_uint64(obj.timestamp());
+    write_mode(writer,obj.mode());
+    writer.write_size(obj.num_points());
+    for (SizeType i=0; i<obj.num_points(); ++i) {
+        auto const samples = obj.samples(i);
+        writer.write_size(samples.size());
+        for (auto const& point : samples)
+            writer.write_point(point);
+    }
+}
+
+void BinarySerialiser<CollisionNotificationMessage>::write(BinaryWriter& writer) const {
+    writer.write_header(BinaryMessageKind::COLLISION_NOTIFICATION);
+    writer.write_string(obj.human_id());
+    write_segment(writer,obj.human_segment());
+    writer.write_string(obj.robot_id());
+    write_segment(writer,obj.robot_segment());
+    writer.write_uint64(obj.current_time());
+    writer.write_uint64(obj.collision_distance().lower());
+    writer.write_uint64(obj.collision_distance().upper());
+    write_mode(writer,obj.collision_mode());
+    writer.write_float(obj.likelihood());
+}
+
+BodyPresentationMessage BinaryDeserialiser<BodyPresentationMessage>::make() const {
+    auto reader = _reader();
+    reader.read_header(BinaryMessageKind::BODY_PRESENTATION);
+    auto id = reader.read_string();
+    bool is_human = (reader.read_uint8() != 0);
+    SizeType message_frequency = (is_human ? 0 : reader.read_uint64());
+    auto num_segments = reader.read_count(16);
+    List<Pair<KeypointIdType,KeypointIdType>> segment_pairs;
+    List<FloatType> thicknesses;
+    for (SizeType i=0; i<num_segments; ++i) {
+        segment_pairs.push_back(read_segment(reader));
+        thicknesses.push_back(reader.read_float());
+    }
+    OPERA_ASSERT_MSG(reader.at_end(), "Unexpected trailing content in the binary payload.")
+    if (is_human) return BodyPresentationMessage(id,segment_pairs,thicknesses);
+    else return BodyPresentationMessage(id,message_frequency,segment_pairs,thicknesses);
+}
+
+HumanStateMessage BinaryDeserialiser<HumanStateMessage>::make() const {
+    auto reader = _reader();
+    reader.read_header(BinaryMessageKind::HUMAN_STATE);
+    auto timestamp = reader.read_uint64();
+    auto num_bodies = reader.read_count(8);
+    HumanStateMessageBuilder builder;
+    for (SizeType i=0; i<num_bodies; ++i) {
+        builder.add_body(reader.read_string());
+        auto num_keypoints = reader.read_count(8);
+        for (SizeType k=0; k<num_keypoints; ++k) {
+            builder.add_keypoint(reader.read_string_view());
+            auto num_samples = reader.read_count(24);
+            for (SizeType s=0; s<num_samples; ++s)
+                builder.add_sample(reader.read_point());
+        }
+    }
+    OPERA_ASSERT_MSG(reader.at_end(), "Unexpected trailing content in the binary payload.")
+    return builder.build(timestamp);
+}
+
+MessageHeader BinaryDeserialiser<HumanStateMessage>::peek() const {
+    auto reader = _reader();
+    reader.read_header(BinaryMessageKind::HUMAN_STATE);
+    MessageHeader result = {{},reader.read_uint64()};
+    auto num_bodies = reader.read_count(8);
+    result.body_ids.reserve(num_bodies);
+    for (SizeType i=0; i<num_bodies; ++i) {
+        result.body_ids.push_back(reader.read_string());
+        auto num_keypoints = reader.read_count(8);
+        for (SizeType k=0; k<num_keypoints; ++k) {
+            reader.skip(reader.read_size());
+            reader.skip(24*reader.read_count(24));
+        }
+    }
+    return result;
+}
+
+RobotStateMessage BinaryDeserialiser<RobotStateMessage>::make() const {
+    auto reader = _reader();
+    reader.read_header(BinaryMessageKind::ROBOT_STATE);
+    auto id = reader.read_string();
+    auto timestamp = reader.read_uint64();
+    auto mode = read_mode(reader);
+    auto num_points = reader.read_count(4);
+    List<Point> samples;
+    List<SizeType> offsets;
+    offsets.reserve(num_points+1);
+    for (SizeType i=0; i<num_points; ++i) {
+        offsets.push_back(samples.size());
+        auto num_samples = reader.read_count(24);
+        for (SizeType s=0; s<num_samples; ++s)
+            samples.push_back(reader.read_point());
+    }
+    offsets.push_back(samples.size());
+    OPERA_ASSERT_MSG(reader.at_end(), "Unexpected trailing content in the binary payload.")
+    return RobotStateMessage(id,mode,std::move(samples),std::move(offsets),timestamp);
+}
+
+MessageHeader BinaryDeserialiser<RobotStateMessage>::peek() const {
+    auto reader = _reader();
+    reader.read_header(BinaryMessageKind::ROBOT_STATE);
+    auto id = reader.read_string();
+    return {{id},reader.read_uint64()};
+}
+
+CollisionNotificationMessage BinaryDeserialiser<CollisionNotificationMessage>::make() const {
+    auto reader = _reader();
+    reader.read_header(BinaryMessageKind::COLLISION_NOTIFICATION);
+    auto human_id = reader.read_string();
+    auto human_segment = read_segment(reader);
+    auto robot_id = reader.read_string();
+    auto robot_segment = read_segment(reader);
+    auto current_time = reader.read_uint64();
+    auto lower = reader.read_uint64();
+    auto upper = reader.read_uint64();
+    auto collision_mode = read_mode(reader);
+    auto likelihood = reader.read_float();
+    OPERA_ASSERT_MSG(reader.at_end(), "Unexpected trailing content in the binary payload.")
+    return CollisionNotificationMessage(human_id,human_segment,robot_id,robot_segment,current_time,Interval<TimestampType>(lower,upper),collision_mode,likelihood);
+}
+
+}
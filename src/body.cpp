@@ -159,15 +159,19 @@ FloatType const& BodySegmentSample::thickness() const {
 }
 
 void BodySegmentSample::update(List<Point> const& heads, List<Point> const& tails) {
+    update(std::span<Point const>(heads),std::span<Point const>(tails));
+}
+
+void BodySegmentSample::update(std::span<Point const> const& heads, std::span<Point const> const& tails) {
     auto const hs = heads.size();
     auto const ts = tails.size();
     auto common_size = std::min(hs,ts);
     for (SizeType j=0; j<common_size; ++j)
-        _update(heads.at(j), tails.at(j));
+        _update(heads[j], tails[j]);
     for (SizeType j=common_size; j<hs; ++j)
-        _update_head(heads.at(j));
+        _update_head(heads[j]);
     for (SizeType j=common_size; j<ts; ++j)
-        _update_tail(tails.at(j));
+        _update_tail(tails[j]);
     if (_is_empty and (not _head_bounds.is_empty() and not _tail_bounds.is_empty()))
         _is_empty = false;
     if (not heads.empty())
@@ -26,6 +26,7 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <algorithm>
 #include "body_registry.hpp"
 #include "macros.hpp"
 
@@ -46,7 +47,7 @@ bool HumanRegistryEntry::has_instances_within(TimestampType const& timestamp) co
     return _history.has_instances_within(timestamp);
 }
 
-HumanStateInstance const& HumanRegistryEntry::latest_instance_within(TimestampType const& timestamp) const {
+SharedPointer<HumanStateInstance const> HumanRegistryEntry::latest_instance_within(TimestampType const& timestamp) const {
     return _history.latest_within(timestamp);
 }
 
@@ -58,7 +59,7 @@ SizeType HumanRegistryEntry::instance_number(TimestampType const& timestamp) con
     return _history.instance_number(timestamp);
 }
 
-HumanStateInstance const& HumanRegistryEntry::at(SizeType const& idx) const {
+SharedPointer<HumanStateInstance const> HumanRegistryEntry::at(SizeType const& idx) const {
         return _history.at(idx);
 }
 
@@ -66,13 +67,17 @@ void HumanRegistryEntry::add(Map<KeypointIdType,List<Point>> const& points, Time
     _history.acquire(points,timestamp);
 }
 
+void HumanRegistryEntry::add(HumanStateMessage const& message, SizeType const& body) {
+    _history.acquire(message,body);
+}
+
 SizeType HumanRegistryEntry::size() const {
     return _history.size();
 }
 
 TimestampType HumanRegistryEntry::latest_timestamp() const {
     OPERA_PRECONDITION(_history.size() > 0)
-    return _history.at(_history.size()-1).timestamp();
+    return _history.at(_history.size()-1)->timestamp();
 }
 
 RobotRegistryEntry::RobotRegistryEntry(BodyIdType const& id, SizeType const& message_frequency, List<Pair<KeypointIdType,KeypointIdType>> const& segment_pairs, List<FloatType> const& thicknesses)
@@ -86,122 +91,187 @@ RobotStateHistory& RobotRegistryEntry::history() {
     return _history;
 }
 
+BodyRegistry::Shard& BodyRegistry::_shard(BodyIdType const& id) {
+    return _shards[std::hash<BodyIdType>{}(id) % BODY_REGISTRY_NUM_SHARDS];
+}
+
+BodyRegistry::Shard const& BodyRegistry::_shard(BodyIdType const& id) const {
+    return _shards[std::hash<BodyIdType>{}(id) % BODY_REGISTRY_NUM_SHARDS];
+}
+
+HumanRegistryEntryHandle BodyRegistry::human_entry(BodyIdType const& id) const {
+    auto const& shard = _shard(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mux);
+    auto it = shard.humans.find(id);
+    if (it == shard.humans.end()) return nullptr;
+    return it->second;
+}
+
+RobotRegistryEntryHandle BodyRegistry::robot_entry(BodyIdType const& id) const {
+    auto const& shard = _shard(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mux);
+    auto it = shard.robots.find(id);
+    if (it == shard.robots.end()) return nullptr;
+    return it->second;
+}
+
 bool BodyRegistry::contains(BodyIdType const& id) const {
-    return (_humans.has_key(id) or _robots.has_key(id));
+    auto const& shard = _shard(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mux);
+    return (shard.humans.has_key(id) or shard.robots.has_key(id));
 }
 
 SizeType BodyRegistry::num_robots() const {
-    return _robots.size();
+    SizeType result = 0;
+    for (auto const& shard : _shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mux);
+        result += shard.robots.size();
+    }
+    return result;
 }
 
 SizeType BodyRegistry::num_humans() const {
-    return _humans.size();
+    SizeType result = 0;
+    for (auto const& shard : _shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mux);
+        result += shard.humans.size();
+    }
+    return result;
 }
 
 SizeType BodyRegistry::num_segment_pairs() const {
     SizeType num_human_segments = 0;
     SizeType num_robot_segments = 0;
 
-    for (auto const& r : _robots)
-        num_robot_segments += r.second->body().num_segments();
-    for (auto const& h : _humans)
-        num_human_segments += h.second->body().num_segments();
+    for (auto const& shard : _shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mux);
+        for (auto const& r : shard.robots)
+            num_robot_segments += r.second->body().num_segments();
+        for (auto const& h : shard.humans)
+            num_human_segments += h.second->body().num_segments();
+    }
 
     return num_human_segments * num_robot_segments;
 }
 
-
 List<BodyIdType> BodyRegistry::robot_ids() const {
     List<BodyIdType> result;
-    for (auto const& e : _robots)
-        result.emplace_back(e.first);
+    for (auto const& shard : _shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mux);
+        for (auto const& e : shard.robots)
+            result.emplace_back(e.first);
+    }
+    std::sort(result.begin(),result.end());
     return result;
 }
 
 List<BodyIdType> BodyRegistry::human_ids() const {
     List<BodyIdType> result;
-    for (auto const& e : _humans)
-        result.emplace_back(e.first);
+    for (auto const& shard : _shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mux);
+        for (auto const& e : shard.humans)
+            result.emplace_back(e.first);
+    }
+    std::sort(result.begin(),result.end());
     return result;
 }
 
-Robot const& BodyRegistry::robot(BodyIdType const& id) const {
-    OPERA_PRECONDITION(contains(id))
-    return _robots.at(id)->body();
+SharedPointer<Robot const> BodyRegistry::robot(BodyIdType const& id) const {
+    auto entry = robot_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return SharedPointer<Robot const>(entry,&entry->body());
 }
 
-Human const& BodyRegistry::human(BodyIdType const& id) const {
-    OPERA_PRECONDITION(contains(id))
-    return _humans.at(id)->body();
+SharedPointer<Human const> BodyRegistry::human(BodyIdType const& id) const {
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return SharedPointer<Human const>(entry,&entry->body());
 }
 
-RobotStateHistory& BodyRegistry::robot_history(BodyIdType const& id) {
-    OPERA_PRECONDITION(contains(id))
-    return _robots.at(id)->history();
+SharedPointer<RobotStateHistory> BodyRegistry::robot_history(BodyIdType const& id) {
+    auto entry = robot_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return SharedPointer<RobotStateHistory>(entry,&entry->history());
 }
 
-RobotStateHistory const& BodyRegistry::robot_history(BodyIdType const& id) const {
-    OPERA_PRECONDITION(contains(id))
-    return _robots.at(id)->history();
+SharedPointer<RobotStateHistory const> BodyRegistry::robot_history(BodyIdType const& id) const {
+    auto entry = robot_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return SharedPointer<RobotStateHistory const>(entry,&entry->history());
 }
 
-HumanStateHistory& BodyRegistry::human_history(BodyIdType const& id) {
-    OPERA_PRECONDITION(contains(id))
-    return _humans.at(id)->history();
+SharedPointer<HumanStateHistory> BodyRegistry::human_history(BodyIdType const& id) {
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return SharedPointer<HumanStateHistory>(entry,&entry->history());
 }
 
-    HumanStateHistory const& BodyRegistry::human_history(BodyIdType const& id) const {
-    OPERA_PRECONDITION(contains(id))
-    return _humans.at(id)->history();
+SharedPointer<HumanStateHistory const> BodyRegistry::human_history(BodyIdType const& id) const {
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return SharedPointer<HumanStateHistory const>(entry,&entry->history());
 }
 
 SizeType BodyRegistry::human_history_size(BodyIdType const& id) const {
-    OPERA_PRECONDITION(contains(id))
-    return _humans.at(id)->size();
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return entry->size();
 }
 
 bool BodyRegistry::has_human_instances_within(BodyIdType const& id, TimestampType const& timestamp) const {
-    OPERA_PRECONDITION(contains(id))
-    return _humans.at(id)->has_instances_within(timestamp);
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return entry->has_instances_within(timestamp);
 }
 
-HumanStateInstance const& BodyRegistry::latest_human_instance_within(BodyIdType const& id, TimestampType const& timestamp) const {
-    return _humans.at(id)->latest_instance_within(timestamp);
+SharedPointer<HumanStateInstance const> BodyRegistry::latest_human_instance_within(BodyIdType const& id, TimestampType const& timestamp) const {
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return entry->latest_instance_within(timestamp);
 }
 
 TimestampType BodyRegistry::latest_human_timestamp(BodyIdType const& id) const {
-    OPERA_PRECONDITION(contains(id))
-    return _humans.at(id)->latest_timestamp();
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return entry->latest_timestamp();
 }
 
 SizeType BodyRegistry::instance_distance(BodyIdType const& id, TimestampType const& lower, TimestampType const& upper) const {
-    return _humans.at(id)->instance_distance(lower,upper);
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return entry->instance_distance(lower,upper);
 }
 
 SizeType BodyRegistry::instance_number(BodyIdType const& id, TimestampType const& timestamp) const {
-    return _humans.at(id)->instance_number(timestamp);
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return entry->instance_number(timestamp);
 }
 
-HumanStateInstance const& BodyRegistry::instance_at(BodyIdType const& id, SizeType const& idx) const {
-    return _humans.at(id)-> at(idx);
+SharedPointer<HumanStateInstance const> BodyRegistry::instance_at(BodyIdType const& id, SizeType const& idx) const {
+    auto entry = human_entry(id);
+    OPERA_PRECONDITION(entry != nullptr)
+    return entry->at(idx);
 }
 
-void BodyRegistry::_add_human_instance(BodyIdType const& id, Map<KeypointIdType,List<Point>> const& points, TimestampType const& timestamp) {
-    OPERA_PRECONDITION(contains(id))
-    if (_humans.at(id)->size() == 0 or timestamp > latest_human_timestamp(id))
-        _humans.at(id)->add(points,timestamp);
+void BodyRegistry::_add_human_instance(HumanStateMessage const& msg, SizeType const& body) {
+    auto entry = human_entry(msg.body_id(body));
+    OPERA_PRECONDITION(entry != nullptr)
+    if (entry->size() == 0 or msg.timestamp() > entry->latest_timestamp())
+        entry->add(msg,body);
 }
 
 void BodyRegistry::acquire_state(HumanStateMessage const& msg) {
-    for (auto const& bd : msg.bodies())
-        _add_human_instance(bd.first, bd.second, msg.timestamp());
+    for (SizeType b=0; b<msg.num_bodies(); ++b)
+        _add_human_instance(msg, b);
+}
+
+void BodyRegistry::acquire_state(HumanStateMessage const& msg, SizeType const& body) {
+    _add_human_instance(msg, body);
 }
 
 void BodyRegistry::acquire_state(RobotStateMessage const& msg) {
-    Map<KeypointIdType,List<Point>> points;
-    for (SizeType i=0; i<msg.points().size(); ++i)
-        points.insert(std::make_pair(to_string(i),msg.points().at(i)));
-    robot_history(msg.id()).acquire(msg.mode(), points, msg.timestamp());
+    robot_history(msg.id())->acquire(msg);
 }
 
 void BodyRegistry::insert(BodyPresentationMessage const& presentation) {
@@ -212,43 +282,69 @@ void BodyRegistry::insert(BodyPresentationMessage const& presentation) {
 }
 
 void BodyRegistry::insert_human(BodyIdType const& id, List<Pair<KeypointIdType,KeypointIdType>> const& segment_pairs, List<FloatType> const& thicknesses) {
-    _humans.insert(std::make_pair(id,new HumanRegistryEntry(id,segment_pairs,thicknesses)));
+    auto entry = std::make_shared<HumanRegistryEntry>(id,segment_pairs,thicknesses);
+    auto& shard = _shard(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mux);
+    if (not shard.humans.has_key(id)) shard.humans.insert(std::make_pair(id,entry));
 }
 
 void BodyRegistry::insert_robot(BodyIdType const& id, SizeType const& message_frequency, List<Pair<KeypointIdType,KeypointIdType>> const& segment_pairs, List<FloatType> const& thicknesses) {
-    _robots.insert(std::make_pair(id,new RobotRegistryEntry(id,message_frequency,segment_pairs,thicknesses)));
+    auto entry = std::make_shared<RobotRegistryEntry>(id,message_frequency,segment_pairs,thicknesses);
+    auto& shard = _shard(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mux);
+    if (not shard.robots.has_key(id)) shard.robots.insert(std::make_pair(id,entry));
 }
 
 std::tuple<bool,KeypointIdType, KeypointIdType> BodyRegistry::get_human_keypoint_ids(BodyIdType const& human_id, IdType const& segment_id) const {
-    std::lock_guard<std::mutex> lock(_content_mux);
-    if (_humans.has_key(human_id)) {
-        auto const& segment = _humans.at(human_id)->body().segment(segment_id);
+    auto entry = human_entry(human_id);
+    if (entry != nullptr) {
+        auto const& segment = entry->body().segment(segment_id);
         return std::make_tuple(true,segment.head_id(),segment.tail_id());
     } else return std::make_tuple(false,std::string(),std::string());
 }
 
 bool BodyRegistry::has_human(BodyIdType const& id) const {
-    std::lock_guard<std::mutex> lock(_content_mux);
-    return _humans.has_key(id);
+    auto const& shard = _shard(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mux);
+    return shard.humans.has_key(id);
 }
 
 bool BodyRegistry::has_robot(BodyIdType const& id) const {
-    std::lock_guard<std::mutex> lock(_content_mux);
-    return _robots.has_key(id);
+    auto const& shard = _shard(id);
+    std::shared_lock<std::shared_mutex> lock(shard.mux);
+    return shard.robots.has_key(id);
 }
 
 void BodyRegistry::remove(BodyIdType const& id) {
-    std::lock_guard<std::mutex> lock(_content_mux);
-    if (_humans.has_key(id)) _humans.erase(id);
-    else if (_robots.has_key(id)) _robots.erase(id);
-    else {
-        OPERA_THROW_RTE("Body with id '" << id << "' is not present in the registry.")
+    // Declared before the lock, so that a removed entry is destroyed after unlocking
+    HumanRegistryEntryHandle removed_human;
+    RobotRegistryEntryHandle removed_robot;
+    auto& shard = _shard(id);
+    std::unique_lock<std::shared_mutex> lock(shard.mux);
+    auto human_it = shard.humans.find(id);
+    if (human_it != shard.humans.end()) {
+        removed_human = human_it->second;
+        shard.humans.erase(human_it);
+        return;
     }
+    auto robot_it = shard.robots.find(id);
+    if (robot_it != shard.robots.end()) {
+        removed_robot = robot_it->second;
+        shard.robots.erase(robot_it);
+        return;
+    }
+    OPERA_THROW_RTE("Body with id '" << id << "' is not present in the registry.")
 }
 
 void BodyRegistry::clear() {
-    _humans.clear();
-    _robots.clear();
+    for (auto& shard : _shards) {
+        // Declared before the lock, so that the removed entries are destroyed after unlocking
+        Map<BodyIdType,HumanRegistryEntryHandle> humans;
+        Map<BodyIdType,RobotRegistryEntryHandle> robots;
+        std::unique_lock<std::shared_mutex> lock(shard.mux);
+        humans.swap(shard.humans);
+        robots.swap(shard.robots);
+    }
 }
 
 }
@@ -28,6 +28,9 @@
 
 #include "conclog/include/logging.hpp"
 #include "command_line_interface.hpp"
+#include "broker_access_manager.hpp"
+#include "metrics.hpp"
+#include "job_trace.hpp"
 
 using namespace ConcLog;
 
@@ -211,8 +214,73 @@ class VerbosityArgumentParser : public ValuedArgumentParserBase {
     }
 };
 
+class BrokerArgumentParser : public ValuedArgumentParserBase {
+  public:
+    BrokerArgumentParser() : ValuedArgumentParserBase(
+            "b","broker","Choose the broker as a <value> in [ memory | shm[:prefix] | mqtt[:hostname[:port]] ] (default: mqtt:localhost:1883)") { }
+
+    VoidFunction _create_processor(ArgumentStream& stream) const override {
+        std::string val = stream.pop();
+        auto separator = val.find(':');
+        std::string type = val.substr(0,separator);
+        std::string address = (separator == std::string::npos ? std::string() : val.substr(separator+1));
+        if (type == "memory") {
+            if (not address.empty()) throw std::exception();
+            return []{ BrokerAccessManager::instance().configure("memory","",0); };
+        } else if (type == "shm") {
+            if (separator != std::string::npos and address.empty()) throw std::exception();
+            if (address.empty()) address = "opera";
+            return [address]{ BrokerAccessManager::instance().configure("shm",address,0); };
+        } else if (type == "mqtt") {
+            int port = 1883;
+            auto port_separator = address.find(':');
+            if (port_separator != std::string::npos) {
+                port = std::stoi(address.substr(port_separator+1));
+                if (port <= 0) throw std::exception();
+                address = address.substr(0,port_separator);
+            }
+            if (address.empty()) address = "localhost";
+            return [address,port]{ BrokerAccessManager::instance().configure("mqtt",address,port); };
+        } else throw std::exception();
+    }
+};
+
+class MetricsArgumentParser : public ValuedArgumentParserBase {
+  public:
+    MetricsArgumentParser() : ValuedArgumentParserBase(
+            "m","metrics","Export the runtime metrics as a <value> in [ file:path | http:port ] (default: none)") { }
+
+    VoidFunction _create_processor(ArgumentStream& stream) const override {
+        std::string val = stream.pop();
+        auto separator = val.find(':');
+        if (separator == std::string::npos or separator+1 == val.size()) throw std::exception();
+        std::string type = val.substr(0,separator);
+        std::string target = val.substr(separator+1);
+        if (type == "file") {
+            return [target]{ MetricsRegistry::instance().export_to_file(target); };
+        } else if (type == "http") {
+            int port = std::stoi(target);
+            if (port <= 0) throw std::exception();
+            return [port]{ MetricsRegistry::instance().serve(port); };
+        } else throw std::exception();
+    }
+};
+
+class JobTraceArgumentParser : public ValuedArgumentParserBase {
+  public:
+    JobTraceArgumentParser() : ValuedArgumentParserBase(
+            "j","job-trace","Trace the lifecycle of jobs into the Chrome trace-event file at <value> (default: none)") { }
+
+    VoidFunction _create_processor(ArgumentStream& stream) const override {
+        std::string path = stream.pop();
+        if (path.empty()) throw std::exception();
+        return [path]{ JobTracer::instance().enable(); JobTracer::instance().export_to_file(path); };
+    }
+};
+
 CommandLineInterface::CommandLineInterface() : _parsers({
-    HelpArgumentParser(),SchedulerArgumentParser(),ThemeArgumentParser(),VerbosityArgumentParser()
+    HelpArgumentParser(),SchedulerArgumentParser(),ThemeArgumentParser(),VerbosityArgumentParser(),BrokerArgumentParser(),MetricsArgumentParser(),
+    JobTraceArgumentParser()
     }) { }
 
 bool CommandLineInterface::acquire(int argc, const char* argv[]) const {
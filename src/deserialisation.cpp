@@ -26,6 +26,8 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <array>
+#include <string_view>
 #include "deserialisation.hpp"
 #include "mode.hpp"
 
@@ -33,6 +35,548 @@ namespace Opera {
 
 using namespace rapidjson;
 
+namespace {
+
+//! \brief Track the value of an unrecognised key, in order to skip it
+class SkippedValue {
+  public:
+    //! \brief Start skipping a value
+    void start() { _active = true; _depth = 0; }
+    //! \brief Whether a value is being skipped
+    bool active() const { return _active; }
+    //! \brief Account for a scalar
+    bool scalar() { if (_depth == 0) _active = false; return true; }
+    //! \brief Account for the start of an object or array
+    bool open() { ++_depth; return true; }
+    //! \brief Account for the end of an object or array
+    bool close() { if (--_depth == 0) _active = false; return true; }
+  private:
+    bool _active = false;
+    SizeType _depth = 0;
+};
+
+//! \brief Handler filling the content of a HumanStateMessage from the events of a JSON description
+class HumanStateMessageHandler : public BaseReaderHandler<UTF8<>,HumanStateMessageHandler> {
+    enum class Expected { ROOT, ROOT_KEY, BODIES, BODY, BODY_KEY, BODY_ID, KEYPOINTS, KEYPOINT_KEY, SAMPLES, SAMPLE, COORDINATE_KEY, COORDINATE, TIMESTAMP, NOTHING };
+  public:
+    bool Null() {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::COORDINATE) return false;
+        _expected = Expected::COORDINATE_KEY;
+        return true;
+    }
+    bool Bool(bool) { return _skipped.active() ? _skipped.scalar() : false; }
+    bool Int(int i) { return _coordinate(i); }
+    bool Int64(int64_t i) { return _coordinate(static_cast<FloatType>(i)); }
+    bool Uint(unsigned u) { return _unsigned(u); }
+    bool Uint64(uint64_t u) { return _unsigned(u); }
+    bool Double(double d) { return _coordinate(d); }
+
+    bool String(const char* str, rapidjson::SizeType length, bool) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::BODY_ID) return false;
+        _builder.set_body_id(BodyIdType(str,length));
+        _has_body_id = true;
+        _expected = Expected::BODY_KEY;
+        return true;
+    }
+
+    bool Key(const char* str, rapidjson::SizeType length, bool) {
+        if (_skipped.active()) return true;
+        std::string_view key(str,length);
+        switch (_expected) {
+            case Expected::ROOT_KEY:
+                if (key == "bodies") _expected = Expected::BODIES;
+                else if (key == "timestamp") _expected = Expected::TIMESTAMP;
+                else _skipped.start();
+                return true;
+            case Expected::BODY_KEY:
+                if (key == "body_id") _expected = Expected::BODY_ID;
+                else if (key == "keypoints") _expected = Expected::KEYPOINTS;
+                else _skipped.start();
+                return true;
+            case Expected::KEYPOINT_KEY:
+                _builder.add_keypoint(key);
+                _expected = Expected::SAMPLES;
+                return true;
+            case Expected::COORDINATE_KEY:
+                if (key == "x") _coordinate_index = 0;
+                else if (key == "y") _coordinate_index = 1;
+                else if (key == "z") _coordinate_index = 2;
+                else { _skipped.start(); return true; }
+                _expected = Expected::COORDINATE;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool StartObject() {
+        if (_skipped.active()) return _skipped.open();
+        switch (_expected) {
+            case Expected::ROOT:
+                _expected = Expected::ROOT_KEY;
+                return true;
+            case Expected::BODY:
+                _builder.add_body(BodyIdType());
+                _has_body_id = false;
+                _expected = Expected::BODY_KEY;
+                return true;
+            case Expected::KEYPOINTS:
+                _expected = Expected::KEYPOINT_KEY;
+                return true;
+            case Expected::SAMPLE:
+                _has_coordinate.fill(false);
+                _expected = Expected::COORDINATE_KEY;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool EndObject(rapidjson::SizeType) {
+        if (_skipped.active()) return _skipped.close();
+        switch (_expected) {
+            case Expected::ROOT_KEY:
+                _expected = Expected::NOTHING;
+                return true;
+            case Expected::BODY_KEY:
+                if (not _has_body_id) return false;
+                _expected = Expected::BODY;
+                return true;
+            case Expected::KEYPOINT_KEY:
+                _expected = Expected::BODY_KEY;
+                return true;
+            case Expected::COORDINATE_KEY:
+                if (_has_coordinate[0] and _has_coordinate[1] and _has_coordinate[2])
+                    _builder.add_sample(Point(_coordinates[0],_coordinates[1],_coordinates[2]));
+                _expected = Expected::SAMPLE;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool StartArray() {
+        if (_skipped.active()) return _skipped.open();
+        switch (_expected) {
+            case Expected::BODIES:
+                _expected = Expected::BODY;
+                return true;
+            case Expected::SAMPLES:
+                _expected = Expected::SAMPLE;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool EndArray(rapidjson::SizeType) {
+        if (_skipped.active()) return _skipped.close();
+        switch (_expected) {
+            case Expected::BODY:
+                _expected = Expected::ROOT_KEY;
+                return true;
+            case Expected::SAMPLE:
+                _expected = Expected::KEYPOINT_KEY;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    //! \brief Whether the description was complete
+    bool complete() const { return _expected == Expected::NOTHING and _has_timestamp; }
+
+    //! \brief Make the message, consuming the content
+    HumanStateMessage message() { return _builder.build(_timestamp); }
+
+  private:
+    bool _unsigned(uint64_t value) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::TIMESTAMP) return _coordinate(static_cast<FloatType>(value));
+        _timestamp = value;
+        _has_timestamp = true;
+        _expected = Expected::ROOT_KEY;
+        return true;
+    }
+
+    bool _coordinate(FloatType value) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::COORDINATE) return false;
+        _coordinates[_coordinate_index] = value;
+        _has_coordinate[_coordinate_index] = true;
+        _expected = Expected::COORDINATE_KEY;
+        return true;
+    }
+
+  private:
+    Expected _expected = Expected::ROOT;
+    SkippedValue _skipped;
+    HumanStateMessageBuilder _builder;
+    bool _has_body_id = false;
+    std::array<FloatType,3> _coordinates = {0,0,0};
+    std::array<bool,3> _has_coordinate = {false,false,false};
+    SizeType _coordinate_index = 0;
+    TimestampType _timestamp = 0;
+    bool _has_timestamp = false;
+};
+
+//! \brief Handler filling the content of a RobotStateMessage from the events of a JSON description
+class RobotStateMessageHandler : public BaseReaderHandler<UTF8<>,RobotStateMessageHandler> {
+    enum class Expected { ROOT, ROOT_KEY, BODY_ID, MODE, MODE_KEY, MODE_VALUE, CONTINUOUS_STATE, POINT_SAMPLES, SAMPLE, COORDINATE, TIMESTAMP, NOTHING };
+  public:
+    bool Null() { return _skipped.active() ? _skipped.scalar() : false; }
+    bool Bool(bool) { return _skipped.active() ? _skipped.scalar() : false; }
+    bool Int(int i) { return _coordinate(i); }
+    bool Int64(int64_t i) { return _coordinate(static_cast<FloatType>(i)); }
+    bool Uint(unsigned u) { return _unsigned(u); }
+    bool Uint64(uint64_t u) { return _unsigned(u); }
+    bool Double(double d) { return _coordinate(d); }
+
+    bool String(const char* str, rapidjson::SizeType length, bool) {
+        if (_skipped.active()) return _skipped.scalar();
+        switch (_expected) {
+            case Expected::BODY_ID:
+                _id.assign(str,length);
+                _has_id = true;
+                _expected = Expected::ROOT_KEY;
+                return true;
+            case Expected::MODE_VALUE:
+                _mode_values.insert(std::make_pair(std::move(_mode_key),Opera::String(str,length)));
+                _expected = Expected::MODE_KEY;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool Key(const char* str, rapidjson::SizeType length, bool) {
+        if (_skipped.active()) return true;
+        std::string_view key(str,length);
+        switch (_expected) {
+            case Expected::ROOT_KEY:
+                if (key == "bodyId") _expected = Expected::BODY_ID;
+                else if (key == "mode") _expected = Expected::MODE;
+                else if (key == "continuousState") _expected = Expected::CONTINUOUS_STATE;
+                else if (key == "timestamp") _expected = Expected::TIMESTAMP;
+                else _skipped.start();
+                return true;
+            case Expected::MODE_KEY:
+                _mode_key.assign(str,length);
+                _expected = Expected::MODE_VALUE;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool StartObject() {
+        if (_skipped.active()) return _skipped.open();
+        switch (_expected) {
+            case Expected::ROOT:
+                _expected = Expected::ROOT_KEY;
+                return true;
+            case Expected::MODE:
+                _mode_values.clear();
+                _expected = Expected::MODE_KEY;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool EndObject(rapidjson::SizeType) {
+        if (_skipped.active()) return _skipped.close();
+        switch (_expected) {
+            case Expected::ROOT_KEY:
+                _expected = Expected::NOTHING;
+                return true;
+            case Expected::MODE_KEY:
+                _has_mode = true;
+                _expected = Expected::ROOT_KEY;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool StartArray() {
+        if (_skipped.active()) return _skipped.open();
+        switch (_expected) {
+            case Expected::CONTINUOUS_STATE:
+                _samples.clear();
+                _offsets.clear();
+                _expected = Expected::POINT_SAMPLES;
+                return true;
+            case Expected::POINT_SAMPLES:
+                _offsets.push_back(_samples.size());
+                _expected = Expected::SAMPLE;
+                return true;
+            case Expected::SAMPLE:
+                _num_coordinates = 0;
+                _expected = Expected::COORDINATE;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool EndArray(rapidjson::SizeType) {
+        if (_skipped.active()) return _skipped.close();
+        switch (_expected) {
+            case Expected::COORDINATE:
+                if (_num_coordinates < 3) return false;
+                _samples.emplace_back(_coordinates[0],_coordinates[1],_coordinates[2]);
+                _expected = Expected::SAMPLE;
+                return true;
+            case Expected::SAMPLE:
+                _expected = Expected::POINT_SAMPLES;
+                return true;
+            case Expected::POINT_SAMPLES:
+                _offsets.push_back(_samples.size());
+                _has_points = true;
+                _expected = Expected::ROOT_KEY;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    //! \brief Whether the description was complete
+    bool complete() const { return _expected == Expected::NOTHING and _has_id and _has_mode and _has_points and _has_timestamp; }
+
+    //! \brief Make the message, consuming the content
+    RobotStateMessage message() { return RobotStateMessage(_id,Mode(_mode_values),std::move(_samples),std::move(_offsets),_timestamp); }
+
+  private:
+    bool _unsigned(uint64_t value) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::TIMESTAMP) return _coordinate(static_cast<FloatType>(value));
+        _timestamp = value;
+        _has_timestamp = true;
+        _expected = Expected::ROOT_KEY;
+        return true;
+    }
+
+    bool _coordinate(FloatType value) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::COORDINATE) return false;
+        if (_num_coordinates < 3) _coordinates[_num_coordinates] = value;
+        ++_num_coordinates;
+        return true;
+    }
+
+  private:
+    Expected _expected = Expected::ROOT;
+    SkippedValue _skipped;
+    BodyIdType _id;
+    bool _has_id = false;
+    Map<Opera::String,Opera::String> _mode_values;
+    Opera::String _mode_key;
+    bool _has_mode = false;
+    List<Point> _samples;
+    List<SizeType> _offsets;
+    bool _has_points = false;
+    std::array<FloatType,3> _coordinates = {0,0,0};
+    SizeType _num_coordinates = 0;
+    TimestampType _timestamp = 0;
+    bool _has_timestamp = false;
+};
+
+//! \brief Handler extracting the header of a HumanStateMessage from the events of a JSON description, skipping the keypoints
+class HumanStateHeaderHandler : public BaseReaderHandler<UTF8<>,HumanStateHeaderHandler> {
+    enum class Expected { ROOT, ROOT_KEY, BODIES, BODY, BODY_KEY, BODY_ID, TIMESTAMP, NOTHING };
+  public:
+    bool Null() { return _scalar(); }
+    bool Bool(bool) { return _scalar(); }
+    bool Int(int) { return _scalar(); }
+    bool Int64(int64_t) { return _scalar(); }
+    bool Uint(unsigned u) { return _unsigned(u); }
+    bool Uint64(uint64_t u) { return _unsigned(u); }
+    bool Double(double) { return _scalar(); }
+
+    bool String(const char* str, rapidjson::SizeType length, bool) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::BODY_ID) return false;
+        _header.body_ids.emplace_back(str,length);
+        _expected = Expected::BODY_KEY;
+        return true;
+    }
+
+    bool Key(const char* str, rapidjson::SizeType length, bool) {
+        if (_skipped.active()) return true;
+        std::string_view key(str,length);
+        switch (_expected) {
+            case Expected::ROOT_KEY:
+                if (key == "bodies") _expected = Expected::BODIES;
+                else if (key == "timestamp") _expected = Expected::TIMESTAMP;
+                else _skipped.start();
+                return true;
+            case Expected::BODY_KEY:
+                if (key == "body_id") _expected = Expected::BODY_ID;
+                else _skipped.start();
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool StartObject() {
+        if (_skipped.active()) return _skipped.open();
+        switch (_expected) {
+            case Expected::ROOT:
+                _expected = Expected::ROOT_KEY;
+                return true;
+            case Expected::BODY:
+                _expected = Expected::BODY_KEY;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool EndObject(rapidjson::SizeType) {
+        if (_skipped.active()) return _skipped.close();
+        switch (_expected) {
+            case Expected::ROOT_KEY:
+                _expected = Expected::NOTHING;
+                return true;
+            case Expected::BODY_KEY:
+                _expected = Expected::BODY;
+                return _header.body_ids.size() == ++_num_bodies;
+            default:
+                return false;
+        }
+    }
+
+    bool StartArray() {
+        if (_skipped.active()) return _skipped.open();
+        if (_expected != Expected::BODIES) return false;
+        _expected = Expected::BODY;
+        return true;
+    }
+
+    bool EndArray(rapidjson::SizeType) {
+        if (_skipped.active()) return _skipped.close();
+        if (_expected != Expected::BODY) return false;
+        _expected = Expected::ROOT_KEY;
+        return true;
+    }
+
+    //! \brief Whether the header was complete
+    bool complete() const { return _expected == Expected::NOTHING and _has_timestamp; }
+
+    //! \brief Make the header, consuming the content
+    MessageHeader header() { return std::move(_header); }
+
+  private:
+    bool _scalar() { return _skipped.active() ? _skipped.scalar() : false; }
+
+    bool _unsigned(uint64_t value) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::TIMESTAMP) return false;
+        _header.timestamp = value;
+        _has_timestamp = true;
+        _expected = Expected::ROOT_KEY;
+        return true;
+    }
+
+  private:
+    Expected _expected = Expected::ROOT;
+    SkippedValue _skipped;
+    MessageHeader _header = {{},0};
+    SizeType _num_bodies = 0;
+    bool _has_timestamp = false;
+};
+
+//! \brief Handler extracting the header of a RobotStateMessage from the events of a JSON description
+//! \details Parsing is terminated as soon as both the id and the timestamp are found, hence the samples are usually not even read
+class RobotStateHeaderHandler : public BaseReaderHandler<UTF8<>,RobotStateHeaderHandler> {
+    enum class Expected { ROOT, ROOT_KEY, BODY_ID, TIMESTAMP };
+  public:
+    bool Null() { return _scalar(); }
+    bool Bool(bool) { return _scalar(); }
+    bool Int(int) { return _scalar(); }
+    bool Int64(int64_t) { return _scalar(); }
+    bool Uint(unsigned u) { return _unsigned(u); }
+    bool Uint64(uint64_t u) { return _unsigned(u); }
+    bool Double(double) { return _scalar(); }
+
+    bool String(const char* str, rapidjson::SizeType length, bool) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::BODY_ID) return false;
+        _header.body_ids.emplace_back(str,length);
+        _has_id = true;
+        _expected = Expected::ROOT_KEY;
+        return not complete();
+    }
+
+    bool Key(const char* str, rapidjson::SizeType length, bool) {
+        if (_skipped.active()) return true;
+        if (_expected != Expected::ROOT_KEY) return false;
+        std::string_view key(str,length);
+        if (key == "bodyId") _expected = Expected::BODY_ID;
+        else if (key == "timestamp") _expected = Expected::TIMESTAMP;
+        else _skipped.start();
+        return true;
+    }
+
+    bool StartObject() {
+        if (_skipped.active()) return _skipped.open();
+        if (_expected != Expected::ROOT) return false;
+        _expected = Expected::ROOT_KEY;
+        return true;
+    }
+
+    bool EndObject(rapidjson::SizeType) { return _skipped.active() ? _skipped.close() : true; }
+    bool StartArray() { return _skipped.active() ? _skipped.open() : false; }
+    bool EndArray(rapidjson::SizeType) { return _skipped.active() ? _skipped.close() : false; }
+
+    //! \brief Whether the header was complete
+    bool complete() const { return _has_id and _has_timestamp; }
+
+    //! \brief Make the header, consuming the content
+    MessageHeader header() { return std::move(_header); }
+
+  private:
+    bool _scalar() { return _skipped.active() ? _skipped.scalar() : false; }
+
+    bool _unsigned(uint64_t value) {
+        if (_skipped.active()) return _skipped.scalar();
+        if (_expected != Expected::TIMESTAMP) return false;
+        _header.timestamp = value;
+        _has_timestamp = true;
+        _expected = Expected::ROOT_KEY;
+        return not complete();
+    }
+
+  private:
+    Expected _expected = Expected::ROOT;
+    SkippedValue _skipped;
+    MessageHeader _header = {{},0};
+    bool _has_id = false;
+    bool _has_timestamp = false;
+};
+
+rapidjson::MemoryPoolAllocator<>& thread_deserialisation_allocator() {
+    alignas(std::max_align_t) thread_local char buffer[DeserialisationMemoryPool::BUFFER_SIZE];
+    thread_local rapidjson::MemoryPoolAllocator<> allocator(buffer, DeserialisationMemoryPool::BUFFER_SIZE);
+    return allocator;
+}
+
+}
+
+DeserialisationMemoryPool::DeserialisationMemoryPool() : _allocator(thread_deserialisation_allocator()) { }
+
+rapidjson::MemoryPoolAllocator<>& DeserialisationMemoryPool::allocator() {
+    return _allocator;
+}
+
+DeserialisationMemoryPool::~DeserialisationMemoryPool() {
+    _allocator.Clear();
+}
+
 BodyPresentationMessage Deserialiser<BodyPresentationMessage>::make() const {
     List<Pair<KeypointIdType,KeypointIdType>> point_ids;
     for (auto& pair : _document["segmentPairs"].GetArray())
@@ -49,34 +593,57 @@ BodyPresentationMessage Deserialiser<BodyPresentationMessage>::make() const {
 }
 
 HumanStateMessage Deserialiser<HumanStateMessage>::make() const {
-    List<HumanStateMessageBodyType> bodies;
+    HumanStateMessageBuilder builder;
     for (auto& body : _document["bodies"].GetArray()) {
-        Map<KeypointIdType,List<Point>> points;
+        builder.add_body(body["body_id"].GetString());
         for (auto& keypoint : body["keypoints"].GetObject()) {
-            List<Point> samples;
+            builder.add_keypoint(std::string_view(keypoint.name.GetString(),keypoint.name.GetStringLength()));
             for (auto& pt : keypoint.value.GetArray())
                 if ((not pt["x"].IsNull()) and (not pt["y"].IsNull()) and (not pt["z"].IsNull()))
-                    samples.emplace_back(pt["x"].GetDouble(),pt["y"].GetDouble(),pt["z"].GetDouble());
-            points.insert(std::make_pair(keypoint.name.GetString(), samples));
+                    builder.add_sample(Point(pt["x"].GetDouble(),pt["y"].GetDouble(),pt["z"].GetDouble()));
         }
-        bodies.push_back({body["body_id"].GetString(),points});
     }
-    return HumanStateMessage(bodies, _document["timestamp"].GetUint64());
+    return builder.build(_document["timestamp"].GetUint64());
 }
 
 RobotStateMessage Deserialiser<RobotStateMessage>::make() const {
     Map<String,String> mode_values;
     for (auto& v : _document["mode"].GetObject())
         mode_values.insert(std::make_pair(v.name.GetString(),v.value.GetString()));
-    List<List<Point>> points;
+    List<Point> samples;
+    List<SizeType> offsets;
     for (auto& point_samples : _document["continuousState"].GetArray()) {
-        List<Point> samples;
+        offsets.push_back(samples.size());
         for (auto& pt : point_samples.GetArray())
             samples.emplace_back(pt[0].GetDouble(),pt[1].GetDouble(),pt[2].GetDouble());
-        points.push_back(samples);
     }
+    offsets.push_back(samples.size());
+
+    return RobotStateMessage(_document["bodyId"].GetString(), Mode(mode_values), std::move(samples), std::move(offsets), _document["timestamp"].GetUint64());
+}
+
+HumanStateMessage StreamingDeserialiser<HumanStateMessage>::make() const {
+    HumanStateMessageHandler handler;
+    _parse(handler);
+    return handler.message();
+}
+
+RobotStateMessage StreamingDeserialiser<RobotStateMessage>::make() const {
+    RobotStateMessageHandler handler;
+    _parse(handler);
+    return handler.message();
+}
+
+MessageHeader StreamingDeserialiser<HumanStateMessage>::peek() const {
+    HumanStateHeaderHandler handler;
+    _peek(handler);
+    return handler.header();
+}
 
-    return RobotStateMessage(_document["bodyId"].GetString(), Mode(mode_values), points, _document["timestamp"].GetUint64());
+MessageHeader StreamingDeserialiser<RobotStateMessage>::peek() const {
+    RobotStateHeaderHandler handler;
+    _peek(handler);
+    return handler.header();
 }
 
 CollisionNotificationMessage Deserialiser<CollisionNotificationMessage>::make() const {
@@ -210,7 +210,7 @@ FloatType const& Box::zl() const { return _zl; }
 FloatType const& Box::zu() const { return _zu; }
 
 Point Box::centre() const {
-    OPERA_PRECONDITION(not is_empty())
+    OPERA_HOT_PRECONDITION(not is_empty())
     return {(_xl+_xu)/2,(_yl+_yu)/2,(_zl+_zu)/2};
 }
 
@@ -0,0 +1,247 @@
+/***************************************************************************
+ *            job_trace.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "job_trace.hpp"
+#include "conclog/include/logging.hpp"
+
+using namespace ConcLog;
+
+namespace Opera {
+
+namespace {
+
+int64_t steady_nanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string job_key(LookAheadJob const& job) {
+    std::ostringstream ss;
+    ss << job.id() << "|" << job.initial_time() << "|" << job.path();
+    return ss.str();
+}
+
+using WriterType = rapidjson::Writer<rapidjson::StringBuffer>;
+
+void write_string(WriterType& writer, std::string const& str) {
+    writer.String(str.c_str(),static_cast<rapidjson::SizeType>(str.length()));
+}
+
+//! \brief Write an event with the given \a name and \a phase, where \a job is an asynchronous identifier for phases 'b' and 'e', and an argument otherwise
+void write_event(WriterType& writer, const char* name, const char* phase, JobTraceEntry const& entry, SizeType const& thread_index, const char* value_name = nullptr) {
+    writer.StartObject();
+    writer.Key("name"); writer.String(name);
+    writer.Key("cat"); writer.String("job");
+    writer.Key("ph"); writer.String(phase);
+    writer.Key("ts"); writer.Double(static_cast<double>(entry.time)/1000);
+    writer.Key("pid"); writer.Int(1);
+    writer.Key("tid"); writer.Uint64(thread_index);
+    bool const is_async = (phase[0] == 'b' or phase[0] == 'e');
+    if (is_async) { writer.Key("id"); write_string(writer,entry.job); }
+    if (phase[0] == 'i') { writer.Key("s"); writer.String("t"); }
+    writer.Key("args");
+    writer.StartObject();
+    writer.Key("job"); write_string(writer,entry.job);
+    if (value_name != nullptr) { writer.Key(value_name); writer.Uint64(entry.value); }
+    writer.EndObject();
+    writer.EndObject();
+}
+
+void write_entry(WriterType& writer, JobTraceEntry const& entry, SizeType const& thread_index) {
+    switch (entry.event) {
+        case JobEvent::CREATED: write_event(writer,"created","i",entry,thread_index); break;
+        case JobEvent::ENQUEUED: write_event(writer,"waiting","b",entry,thread_index); break;
+        case JobEvent::RESERVED:
+            write_event(writer,"waiting","e",entry,thread_index);
+            write_event(writer,"processing","B",entry,thread_index);
+            break;
+        case JobEvent::PROCESSED: write_event(writer,"processing","E",entry,thread_index); break;
+        case JobEvent::SPLIT: write_event(writer,"split","i",entry,thread_index,"next_jobs"); break;
+        case JobEvent::SLEPT: write_event(writer,"sleeping","b",entry,thread_index); break;
+        case JobEvent::AWAKENED:
+            write_event(writer,"sleeping","e",entry,thread_index);
+            write_event(writer,"awakened","i",entry,thread_index,"woken_jobs");
+            break;
+        case JobEvent::NOTIFIED: write_event(writer,"notified","i",entry,thread_index); break;
+        default: OPERA_FAIL_MSG("Unhandled JobEvent value for writing")
+    }
+}
+
+}
+
+JobTraceBuffer::JobTraceBuffer(SizeType const& thread_index, std::string const& thread_name) :
+    _thread_index(thread_index), _thread_name(thread_name), _next(0), _num_recorded(0) { }
+
+void JobTraceBuffer::reset(SizeType const& capacity) {
+    OPERA_PRECONDITION(capacity > 0)
+    std::lock_guard<std::mutex> lock(_mux);
+    _entries.clear();
+    _entries.reserve(capacity);
+    _entries.resize(capacity);
+    _next = 0;
+    _num_recorded = 0;
+}
+
+void JobTraceBuffer::record(JobTraceEntry&& entry) {
+    std::lock_guard<std::mutex> lock(_mux);
+    _entries[_next] = std::move(entry);
+    _next = (_next + 1) % _entries.size();
+    ++_num_recorded;
+}
+
+List<JobTraceEntry> JobTraceBuffer::entries() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    List<JobTraceEntry> result;
+    if (_num_recorded < _entries.size()) {
+        result.assign(_entries.begin(),_entries.begin()+static_cast<std::ptrdiff_t>(_num_recorded));
+    } else {
+        result.assign(_entries.begin()+static_cast<std::ptrdiff_t>(_next),_entries.end());
+        result.insert(result.end(),_entries.begin(),_entries.begin()+static_cast<std::ptrdiff_t>(_next));
+    }
+    return result;
+}
+
+SizeType JobTraceBuffer::num_dropped() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    return (_num_recorded > _entries.size() ? _num_recorded - _entries.size() : 0);
+}
+
+SizeType const& JobTraceBuffer::thread_index() const {
+    return _thread_index;
+}
+
+std::string const& JobTraceBuffer::thread_name() const {
+    return _thread_name;
+}
+
+JobTracer::JobTracer() : _enabled(false), _capacity(JOB_TRACE_DEFAULT_CAPACITY), _start(steady_nanoseconds()) { }
+
+void JobTracer::enable(SizeType const& capacity) {
+    OPERA_PRECONDITION(capacity > 0)
+    std::lock_guard<std::mutex> lock(_mux);
+    _enabled = false;
+    _capacity = capacity;
+    for (auto& buffer : _buffers) buffer->reset(capacity);
+    _start = steady_nanoseconds();
+    _enabled = true;
+}
+
+void JobTracer::disable() {
+    _enabled = false;
+}
+
+JobTraceBuffer& JobTracer::_buffer() {
+    thread_local SharedPointer<JobTraceBuffer> buffer;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(_mux);
+        auto name = Logger::instance().current_thread_name();
+        if (name.empty()) name = "thread " + std::to_string(_buffers.size());
+        buffer = std::make_shared<JobTraceBuffer>(_buffers.size(),name);
+        buffer->reset(_capacity);
+        _buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void JobTracer::_record(JobEvent const& event, LookAheadJob const& job, SizeType const& value) {
+    auto const time = steady_nanoseconds() - _start.load(std::memory_order_relaxed);
+    _buffer().record({event,static_cast<uint64_t>(std::max<int64_t>(time,0)),job_key(job),value});
+}
+
+SizeType JobTracer::num_entries() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    SizeType result = 0;
+    for (auto const& buffer : _buffers) result += buffer->entries().size();
+    return result;
+}
+
+SizeType JobTracer::num_dropped() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    SizeType result = 0;
+    for (auto const& buffer : _buffers) result += buffer->num_dropped();
+    return result;
+}
+
+std::string JobTracer::to_json() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    rapidjson::StringBuffer buffer;
+    WriterType writer(buffer);
+    writer.StartObject();
+    writer.Key("displayTimeUnit"); writer.String("ms");
+    writer.Key("traceEvents");
+    writer.StartArray();
+    for (auto const& b : _buffers) {
+        writer.StartObject();
+        writer.Key("name"); writer.String("thread_name");
+        writer.Key("ph"); writer.String("M");
+        writer.Key("pid"); writer.Int(1);
+        writer.Key("tid"); writer.Uint64(b->thread_index());
+        writer.Key("args");
+        writer.StartObject();
+        writer.Key("name"); write_string(writer,b->thread_name());
+        writer.EndObject();
+        writer.EndObject();
+        for (auto const& entry : b->entries())
+            write_entry(writer,entry,b->thread_index());
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return std::string(buffer.GetString(),buffer.GetSize());
+}
+
+void JobTracer::write(std::string const& path) const {
+    auto const json = to_json();
+    std::string const temporary_path = path + ".tmp";
+    {
+        std::ofstream ofs(temporary_path, std::ios::trunc);
+        OPERA_ASSERT_MSG(ofs.is_open(), "Could not open '" << temporary_path << "' for writing the job trace")
+        ofs << json;
+    }
+    std::filesystem::rename(temporary_path,path);
+}
+
+void JobTracer::export_to_file(std::string const& path, SizeType const& period_ms) {
+    auto exporter = std::make_shared<PeriodicFileExporter>([](std::string const& p){ JobTracer::instance().write(p); },path,period_ms);
+    std::lock_guard<std::mutex> lock(_mux);
+    _exporter = exporter;
+}
+
+void JobTracer::stop_exporting() {
+    SharedPointer<PeriodicFileExporter> exporter;
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        std::swap(exporter,_exporter);
+    }
+}
+
+}
@@ -30,7 +30,8 @@
 
 namespace Opera {
 
-KafkaBrokerAccessBuilder::KafkaBrokerAccessBuilder(std::string const& brokers) : _brokers(brokers), _partition(0), _start_offset(RdKafka::Topic::OFFSET_END) { }
+KafkaBrokerAccessBuilder::KafkaBrokerAccessBuilder(std::string const& brokers) : _brokers(brokers), _partition(0), _start_offset(RdKafka::Topic::OFFSET_END),
+    _encoding(MessageEncoding::JSON), _group_options({"",64,0,0,0}) { }
 
 KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_partition(int partition) {
     _partition = partition;
@@ -67,50 +68,107 @@ KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_sasl_password(std::strin
     return *this;
 }
 
+KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_encoding(MessageEncoding const& encoding) {
+    _encoding = encoding;
+    return *this;
+}
+
+KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_consumer_group(std::string const& group_id) {
+    _group_options.group_id = group_id;
+    return *this;
+}
+
+KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_batch_size(SizeType const& batch_size) {
+    OPERA_PRECONDITION(batch_size > 0)
+    _group_options.batch_size = batch_size;
+    return *this;
+}
+
+KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_fetch_bytes(SizeType const& min_bytes, SizeType const& max_bytes) {
+    OPERA_PRECONDITION(max_bytes == 0 or min_bytes <= max_bytes)
+    _group_options.fetch_min_bytes = min_bytes;
+    _group_options.fetch_max_bytes = max_bytes;
+    return *this;
+}
+
+KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_num_decoding_workers(SizeType const& num_workers) {
+    _group_options.num_decoding_workers = num_workers;
+    return *this;
+}
+
+KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_batching(SizeType const& linger_ms, SizeType const& batch_num_messages) {
+    OPERA_PRECONDITION(batch_num_messages > 0)
+    _producer_options.linger_ms = linger_ms;
+    _producer_options.batch_num_messages = batch_num_messages;
+    return *this;
+}
+
+KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_compression(KafkaCompression const& compression) {
+    _producer_options.compression = compression;
+    return *this;
+}
+
+KafkaBrokerAccessBuilder& KafkaBrokerAccessBuilder::set_keyed(bool keyed) {
+    _producer_options.keyed = keyed;
+    return *this;
+}
+
 KafkaBrokerAccess KafkaBrokerAccessBuilder::build() const {
     if (_sasl_mechanism != "" or _security_protocol != "" or _sasl_username != "" or _sasl_password != "") {
         OPERA_ASSERT(_sasl_mechanism != "" and _security_protocol != "" and _sasl_username != "" and _sasl_password != "");
     }
-    return KafkaBrokerAccess(_brokers,_partition,_start_offset,_topic_prefix,_sasl_mechanism,_security_protocol,_sasl_username,_sasl_password);
+    return KafkaBrokerAccess(_brokers,_partition,_start_offset,_topic_prefix,_sasl_mechanism,_security_protocol,_sasl_username,_sasl_password,_encoding,_group_options,_producer_options);
 }
 
 KafkaBrokerAccess::KafkaBrokerAccess(std::string const& brokers, int partition, int64_t start_offset, std::string const& topic_prefix,
                                      std::string const& sasl_mechanism, std::string const& security_protocol,
-                                     std::string const& sasl_username, std::string const& sasl_password) :
+                                     std::string const& sasl_username, std::string const& sasl_password, MessageEncoding const& encoding,
+                                     KafkaConsumerGroupOptions const& group_options, KafkaProducerOptions const& producer_options) :
                                      _brokers(brokers), _partition(partition), _start_offset(start_offset), _topic_prefix(topic_prefix),
                                      _sasl_mechanism(sasl_mechanism), _security_protocol(security_protocol),
-                                     _sasl_username(sasl_username), _sasl_password(sasl_password) { }
+                                     _sasl_username(sasl_username), _sasl_password(sasl_password), _encoding(encoding), _group_options(group_options), _producer_options(producer_options) { }
+
+template<class T> PublisherInterface<T>* KafkaBrokerAccess::_make_publisher(std::string const& topic) const {
+    return new KafkaPublisher<T>(_topic_prefix+topic, _partition, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password, _encoding, _producer_options);
+}
+
+template<class T> SubscriberInterface<T>* KafkaBrokerAccess::_make_subscriber(std::string const& topic, CallbackFunction<T> const& callback, PayloadFilter const& filter) const {
+    if (_group_options.group_id.empty())
+        return new KafkaSubscriber<T>(_topic_prefix+topic, _partition, _start_offset, callback, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password, _encoding, filter);
+    else
+        return new KafkaGroupSubscriber<T>(_topic_prefix+topic, _start_offset, callback, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password, _group_options, _encoding, filter);
+}
 
 PublisherInterface<BodyPresentationMessage>* KafkaBrokerAccess::make_body_presentation_publisher(BodyPresentationTopic const& topic) const {
-    return new KafkaPublisher<BodyPresentationMessage>(_topic_prefix+topic, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password);
+    return _make_publisher<BodyPresentationMessage>(topic);
 }
 
 PublisherInterface<HumanStateMessage>* KafkaBrokerAccess::make_human_state_publisher(HumanStateTopic const& topic) const {
-    return new KafkaPublisher<HumanStateMessage>(_topic_prefix+topic, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password);
+    return _make_publisher<HumanStateMessage>(topic);
 }
 
 PublisherInterface<RobotStateMessage>* KafkaBrokerAccess::make_robot_state_publisher(RobotStateTopic const& topic) const {
-    return new KafkaPublisher<RobotStateMessage>(_topic_prefix+topic, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password);
+    return _make_publisher<RobotStateMessage>(topic);
 }
 
 PublisherInterface<CollisionNotificationMessage>* KafkaBrokerAccess::make_collision_notification_publisher(CollisionNotificationTopic const& topic) const {
-    return new KafkaPublisher<CollisionNotificationMessage>(_topic_prefix+topic, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password);
+    return _make_publisher<CollisionNotificationMessage>(topic);
 }
 
 SubscriberInterface<BodyPresentationMessage>* KafkaBrokerAccess::make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic) const {
-    return new KafkaSubscriber<BodyPresentationMessage>(_topic_prefix+topic, _partition, _start_offset, callback, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password);
+    return _make_subscriber<BodyPresentationMessage>(topic, callback);
 }
 
-SubscriberInterface<HumanStateMessage>* KafkaBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic) const {
-    return new KafkaSubscriber<HumanStateMessage>(_topic_prefix+topic, _partition, _start_offset, callback, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password);
+SubscriberInterface<HumanStateMessage>* KafkaBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic, MessageFilter const& filter) const {
+    return _make_subscriber<HumanStateMessage>(topic, callback, make_payload_filter<HumanStateMessage>(filter,_encoding));
 }
 
-SubscriberInterface<RobotStateMessage>* KafkaBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic) const {
-    return new KafkaSubscriber<RobotStateMessage>(_topic_prefix+topic, _partition, _start_offset, callback, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password);
+SubscriberInterface<RobotStateMessage>* KafkaBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic, MessageFilter const& filter) const {
+    return _make_subscriber<RobotStateMessage>(topic, callback, make_payload_filter<RobotStateMessage>(filter,_encoding));
 }
 
 SubscriberInterface<CollisionNotificationMessage>* KafkaBrokerAccess::make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic) const {
-    return new KafkaSubscriber<CollisionNotificationMessage>(_topic_prefix+topic, _partition, _start_offset, callback, _brokers, _sasl_mechanism, _security_protocol, _sasl_username, _sasl_password);
+    return _make_subscriber<CollisionNotificationMessage>(topic, callback);
 }
 
 }
@@ -151,6 +151,12 @@ LookAheadJobPath const& LookAheadJobBase::path() const {
     return _path;
 }
 
+void LookAheadJobBase::pin_snapshot_time(SharedPointer<RobotStateHistory const> const& robot_history) const {
+    if (_snapshot_time_pin.is_pinned()) return;
+    _pinned_history = robot_history;
+    _snapshot_time_pin = robot_history->pin_snapshot_time(_snapshot_time);
+}
+
 DiscardLookAheadJob::DiscardLookAheadJob(LookAheadJobIdentifier const& id, TimestampType const& initial_time, BodySegmentSample const& human_sample, ModeTrace const& prediction_trace, LookAheadJobPath const& path)
     : LookAheadJobBase(id, initial_time, initial_time, human_sample, prediction_trace, path) { }
 
@@ -159,7 +165,7 @@ int DiscardLookAheadJob::earliest_collision_index(RobotStateHistory const& robot
     auto robot_history_snapshot = robot_history.snapshot_at(_snapshot_time);
     auto const samples = robot_history_snapshot.samples(mode_to_look).at(id().robot_segment());
 
-    OPERA_ASSERT_MSG(samples.size() > 0, "Should not have empty samples when checking for collision index")
+    OPERA_HOT_ASSERT_MSG(samples.size() > 0, "Should not have empty samples when checking for collision index")
 
     SizeType lower = 0;
     SizeType upper = samples.size()-1;
@@ -180,21 +186,26 @@ int DiscardLookAheadJob::earliest_collision_index(RobotStateHistory const& robot
     return -1;
 }
 
-ReuseLookAheadJob::ReuseLookAheadJob(LookAheadJobIdentifier const& id, TimestampType const& initial_time, TimestampType const& snapshot_time, BodySegmentSample const& human_sample, ModeTrace const& prediction_trace, LookAheadJobPath const& path, MinimumDistanceBarrierSequence const& barrier_sequence)
-        : LookAheadJobBase(id, initial_time, snapshot_time, human_sample, prediction_trace, path), _barrier_sequence(barrier_sequence) { }
+ReuseLookAheadJob::ReuseLookAheadJob(LookAheadJobIdentifier const& id, TimestampType const& initial_time, TimestampType const& snapshot_time, BodySegmentSample const& human_sample, ModeTrace const& prediction_trace, LookAheadJobPath const& path, MinimumDistanceBarrierSequence const& barrier_sequence,
+                                     SharedPointer<LookAheadJobRegistryEntry> const& registry_entry)
+        : LookAheadJobBase(id, initial_time, snapshot_time, human_sample, prediction_trace, path), _barrier_sequence(barrier_sequence), _registry_entry(registry_entry) { }
 
 MinimumDistanceBarrierSequence const& ReuseLookAheadJob::barrier_sequence() const {
     return _barrier_sequence;
 }
 
+SharedPointer<LookAheadJobRegistryEntry> const& ReuseLookAheadJob::registry_entry() const {
+    return _registry_entry;
+}
+
 int ReuseLookAheadJob::earliest_collision_index(RobotStateHistory const& robot_history) const {
-    CONCLOG_SCOPE_CREATE
+    OPERA_HOT_SCOPE_CREATE
     auto const& mode_to_look = prediction_trace().ending_mode();
     auto const trace_index = prediction_trace().size()-1;
     auto robot_history_snapshot = robot_history.snapshot_at(_snapshot_time);
     auto const samples = robot_history_snapshot.samples(mode_to_look).at(id().robot_segment());
 
-    OPERA_ASSERT_MSG(samples.size() > 0, "Should not have empty samples when checking for collision index")
+    OPERA_HOT_ASSERT_MSG(samples.size() > 0, "Should not have empty samples when checking for collision index")
 
     SizeType lower = (_barrier_sequence.is_empty() or _barrier_sequence.last_upper_trace_index() != trace_index) ? 0 : _barrier_sequence.last_barrier().range().maximum_sample_index() + 1;
     SizeType upper = samples.size()-1;
@@ -207,7 +218,7 @@ int ReuseLookAheadJob::earliest_collision_index(RobotStateHistory const& robot_h
         }
     }
 
-    CONCLOG_PRINTLN("Checking earliest collision index for trace index " << trace_index << " in [" << lower << "," << upper << "]")
+    OPERA_HOT_PRINTLN("Checking earliest collision index for trace index " << trace_index << " in [" << lower << "," << upper << "]")
 
     for (SizeType i=lower; i<=upper; ++i) {
         auto const& robot_sample = samples.at(i);
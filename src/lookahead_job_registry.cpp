@@ -26,123 +26,161 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <limits>
 #include "macros.hpp"
 #include "lookahead_job_registry.hpp"
 
 namespace Opera {
 
-LookAheadJobTreeNode::LookAheadJobTreeNode(PriorityType const& priority) : _priority(priority), _registered(false) { }
+LookAheadJobTreeNode::LookAheadJobTreeNode(PriorityType const& priority) :
+    _priority(priority), _registered(false), _first_child(nullptr), _next_sibling(nullptr) { }
+
+LookAheadJobTreeNode::~LookAheadJobTreeNode() {
+    auto child = _first_child.load(std::memory_order_acquire);
+    while (child != nullptr) {
+        auto next = child->_next_sibling;
+        delete child;
+        child = next;
+    }
+}
+
+LookAheadJobTreeNode* LookAheadJobTreeNode::_find_child(PriorityType const& priority, LookAheadJobTreeNode* from, LookAheadJobTreeNode const* until) const {
+    for (auto child = from; child != until; child = child->_next_sibling)
+        if (child->_priority == priority) return child;
+    return nullptr;
+}
+
+LookAheadJobTreeNode* LookAheadJobTreeNode::_find_or_insert_child(PriorityType const& priority) {
+    auto head = _first_child.load(std::memory_order_acquire);
+    auto found = _find_child(priority, head, nullptr);
+    if (found != nullptr) return found;
+    auto inserted = new LookAheadJobTreeNode(priority);
+    while (true) {
+        inserted->_next_sibling = head;
+        if (_first_child.compare_exchange_weak(head, inserted, std::memory_order_acq_rel, std::memory_order_acquire))
+            return inserted;
+        found = _find_child(priority, head, inserted->_next_sibling);
+        if (found != nullptr) {
+            delete inserted;
+            return found;
+        }
+    }
+}
 
 bool LookAheadJobTreeNode::has_registered(SizeType const& depth, LookAheadJobPath const& path) const {
-    if (depth == 0) return _registered;
-    auto priority = path.priority(path.size() - depth);
-    auto child_it = _children.find(priority);
-    if (child_it == _children.end()) return false;
-    auto& child = const_cast<LookAheadJobTreeNode&>(*child_it);
-    return child.has_registered(depth - 1, path);
+    auto node = this;
+    for (SizeType d = depth; d > 0; --d) {
+        node = node->_find_child(path.priority(path.size() - d), node->_first_child.load(std::memory_order_acquire), nullptr);
+        if (node == nullptr) return false;
+    }
+    return node->_registered.load(std::memory_order_acquire);
 }
 
 bool LookAheadJobTreeNode::try_register(SizeType const& depth, LookAheadJobPath const& path) {
-    if (_registered) return false;
-    if (depth == 0) {
-        _registered = true;
-        return true;
+    auto node = this;
+    for (SizeType d = depth; d > 0; --d) {
+        if (node->_registered.load(std::memory_order_acquire)) return false;
+        node = node->_find_or_insert_child(path.priority(path.size() - d));
     }
-    auto priority = path.priority(path.size() - depth);
-    auto child_it = _children.find(priority);
-    if (child_it == _children.end()) {
-        auto item = _children.emplace(priority);
-        child_it = item.first;
-    }
-    auto& child = const_cast<LookAheadJobTreeNode&>(*child_it);
-    return child.try_register(depth - 1, path);
+    return not node->_registered.exchange(true, std::memory_order_acq_rel);
 }
 
 auto LookAheadJobTreeNode::priority() const -> PriorityType {
     return _priority;
 }
 
-bool operator<(LookAheadJobTreeNode const& first, LookAheadJobTreeNode const& second) {
-    return first.priority() < second.priority();
-}
-
-LookAheadJobIdTree::LookAheadJobIdTree() : _root(LookAheadJobTreeNode(0)) { }
+LookAheadJobIdTree::LookAheadJobIdTree() : _root(0) { }
 
 bool LookAheadJobIdTree::try_register(LookAheadJobPath const& path) {
-    std::lock_guard<std::mutex> lock(_mux);
     return _root.try_register(path.size(), path);
 }
 
 bool LookAheadJobIdTree::has_registered(LookAheadJobPath const& path) const {
-    std::lock_guard<std::mutex> lock(_mux);
     return _root.has_registered(path.size(), path);
 }
 
-LookAheadJobRegistryEntry::LookAheadJobRegistryEntry(TimestampType const& timestamp) : _timestamp(timestamp) { }
+LookAheadJobRegistryEntry::LookAheadJobRegistryEntry(TimestampType const& timestamp) :
+    _timestamp(timestamp) { }
 
 TimestampType const& LookAheadJobRegistryEntry::timestamp() const {
     return _timestamp;
 }
 
+SharedPointer<LookAheadJobIdTree> LookAheadJobRegistryEntry::_find_tree(LookAheadJobIdentifier const& id) const {
+    std::shared_lock<std::shared_mutex> lock(_mux);
+    auto it = _id_trees.find(id);
+    if (it == _id_trees.end()) return nullptr;
+    return it->second;
+}
+
 bool LookAheadJobRegistryEntry::try_register(LookAheadJobIdentifier const& id, LookAheadJobPath const& path) {
-    SharedPointer<LookAheadJobIdTree> tree = nullptr;
-    {
-        std::lock_guard<std::mutex> lock(_mux);
+    auto tree = _find_tree(id);
+    if (tree == nullptr) {
+        std::lock_guard<std::shared_mutex> lock(_mux);
         auto it = _id_trees.find(id);
-        if (it == _id_trees.end()) {
-            auto res = _id_trees.insert({id,std::make_shared<LookAheadJobIdTree>()});
-            it = res.first;
+        if (it != _id_trees.end()) tree = it->second;
+        else {
+            tree = std::make_shared<LookAheadJobIdTree>();
+            _id_trees.insert({id,tree});
         }
-        tree = it->second;
     }
     return tree->try_register(path);
 }
 
 bool LookAheadJobRegistryEntry::has_registered(LookAheadJobIdentifier const& id, LookAheadJobPath const& path) const {
-    SharedPointer<LookAheadJobIdTree> tree = nullptr;
-    {
-        std::lock_guard<std::mutex> lock(_mux);
-        auto it = _id_trees.find(id);
-        if (it == _id_trees.end()) return false;
-        else tree = it->second;
-    }
+    auto tree = _find_tree(id);
+    if (tree == nullptr) return false;
     return tree->has_registered(path);
 }
 
-bool LookAheadJobRegistry::try_register(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path) {
-    LookAheadJobRegistryEntry* entry = nullptr;
-    {
-        std::lock_guard<std::mutex> lock(_mux);
-        if (_entries.empty() or _entries.back().timestamp() < timestamp) {
-            _entries.emplace_back(timestamp);
-            entry = &_entries.back();
-        } else {
-            bool found = false;
-            for (auto it = _entries.rbegin(); it != _entries.rend(); ++it)
-                if (it->timestamp() == timestamp) {
-                    found = true;
-                    entry = &*it;
-                }
-            OPERA_ASSERT_MSG(found,"Timestamp " << timestamp << " not found in the job registry.")
-        }
+LookAheadJobRegistry::LookAheadJobRegistry() : _latest_timestamp(0), _evicted_before(0), _eviction_size(LOOKAHEAD_JOB_REGISTRY_MIN_EVICTION_SIZE) { }
+
+SharedPointer<LookAheadJobRegistryEntry> LookAheadJobRegistry::entry(TimestampType const& timestamp) {
+    std::lock_guard<std::mutex> lock(_mux);
+    auto it = _entries.find(timestamp);
+    if (it != _entries.end()) return it->second;
+    OPERA_ASSERT_MSG(_entries.empty() or timestamp > _latest_timestamp or timestamp < _evicted_before,"Timestamp " << timestamp << " not found in the job registry.")
+    if (_entries.size() >= _eviction_size) {
+        _evict_unused_entries();
+        _eviction_size = std::max(LOOKAHEAD_JOB_REGISTRY_MIN_EVICTION_SIZE,2*_entries.size());
     }
-    return entry->try_register(id, path);
+    auto result = std::make_shared<LookAheadJobRegistryEntry>(timestamp);
+    _entries.insert({timestamp,result});
+    _latest_timestamp = std::max(_latest_timestamp,timestamp);
+    return result;
+}
+
+void LookAheadJobRegistry::_evict_unused_entries() {
+    TimestampType oldest_shared = std::numeric_limits<TimestampType>::max();
+    for (auto const& e : _entries)
+        if (e.second.use_count() > 1) oldest_shared = std::min(oldest_shared,e.first);
+    if (oldest_shared == std::numeric_limits<TimestampType>::max()) oldest_shared = _latest_timestamp;
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        if (it->first < oldest_shared) it = _entries.erase(it);
+        else ++it;
+    }
+    _evicted_before = std::max(_evicted_before,oldest_shared);
+}
+
+bool LookAheadJobRegistry::try_register(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path) {
+    return entry(timestamp)->try_register(id, path);
 }
 
 bool LookAheadJobRegistry::has_registered(TimestampType const& timestamp, LookAheadJobIdentifier const& id, LookAheadJobPath const& path) const {
-    LookAheadJobRegistryEntry const* entry = nullptr;
+    SharedPointer<LookAheadJobRegistryEntry> entry = nullptr;
     {
         std::lock_guard<std::mutex> lock(_mux);
-        bool found = false;
-        for (auto it = _entries.crbegin(); it != _entries.crend(); ++it)
-            if (it->timestamp() == timestamp) {
-                found = true;
-                entry = &*it;
-                break;
-            }
-        if (not found) return false;
+        auto it = _entries.find(timestamp);
+        if (it == _entries.end()) return false;
+        entry = it->second;
     }
     return entry->has_registered(id, path);
 }
 
-}
\ No newline at end of file
+SizeType LookAheadJobRegistry::size() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    return _entries.size();
+}
+
+}
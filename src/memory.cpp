@@ -30,6 +30,10 @@
 
 namespace Opera {
 
+MemoryBroker::MemoryBroker() :
+    _body_presentations(MEMORY_BROKER_DEFAULT_CAPACITY), _human_states(MEMORY_BROKER_DEFAULT_CAPACITY),
+    _robot_states(MEMORY_BROKER_DEFAULT_CAPACITY), _collision_notifications(MEMORY_BROKER_DEFAULT_CAPACITY) { }
+
 void MemoryBroker::clear() {
     _body_presentations.clear();
     _human_states.clear();
@@ -37,6 +41,13 @@ void MemoryBroker::clear() {
     _collision_notifications.clear();
 }
 
+void MemoryBroker::set_capacity(SizeType const& capacity) {
+    _body_presentations.set_capacity(capacity);
+    _human_states.set_capacity(capacity);
+    _robot_states.set_capacity(capacity);
+    _collision_notifications.set_capacity(capacity);
+}
+
 PublisherInterface<BodyPresentationMessage>* MemoryBrokerAccess::make_body_presentation_publisher(BodyPresentationTopic const&) const {
     return new MemoryPublisher<BodyPresentationMessage>();
 }
@@ -57,12 +68,14 @@ SubscriberInterface<BodyPresentationMessage>* MemoryBrokerAccess::make_body_pres
     return new MemorySubscriber<BodyPresentationMessage>(callback);
 }
 
-SubscriberInterface<HumanStateMessage>* MemoryBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const&) const {
-    return new MemorySubscriber<HumanStateMessage>(callback);
+SubscriberInterface<HumanStateMessage>* MemoryBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const&, MessageFilter const& filter) const {
+    if (not filter) return new MemorySubscriber<HumanStateMessage>(callback);
+    return new MemorySubscriber<HumanStateMessage>(callback,[filter](HumanStateMessage const& msg) { return filter(msg.header()); });
 }
 
-SubscriberInterface<RobotStateMessage>* MemoryBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const&) const {
-    return new MemorySubscriber<RobotStateMessage>(callback);
+SubscriberInterface<RobotStateMessage>* MemoryBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const&, MessageFilter const& filter) const {
+    if (not filter) return new MemorySubscriber<RobotStateMessage>(callback);
+    return new MemorySubscriber<RobotStateMessage>(callback,[filter](RobotStateMessage const& msg) { return filter(msg.header()); });
 }
 
 SubscriberInterface<CollisionNotificationMessage>* MemoryBrokerAccess::make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const&) const {
@@ -27,6 +27,7 @@
  */
 
 #include "handle.hpp"
+#include "macros.hpp"
 #include "message.hpp"
 
 namespace Opera {
@@ -57,19 +58,178 @@ List<FloatType> const& BodyPresentationMessage::thicknesses() const {
     return _thicknesses;
 }
 
+namespace {
+
+//! \brief The number of keypoint templates remembered by each thread
+const SizeType KEYPOINT_IDS_CACHE_CAPACITY = 8;
+
+//! \brief Get shared keypoint ids equal to \a ids, reusing those of the recent templates of the current thread
+//! \details The cache is per thread and bounded, evicting the least recently used template
+KeypointIdsType intern_keypoint_ids(List<KeypointIdType> const& ids) {
+    thread_local Deque<KeypointIdsType> recent;
+    for (auto it = recent.begin(); it != recent.end(); ++it) {
+        if (**it == ids) {
+            auto result = *it;
+            recent.erase(it);
+            recent.push_front(result);
+            return result;
+        }
+    }
+    auto result = std::make_shared<List<KeypointIdType> const>(ids);
+    recent.push_front(result);
+    if (recent.size() > KEYPOINT_IDS_CACHE_CAPACITY) recent.pop_back();
+    return result;
+}
+
+//! \brief The keypoint ids of the latest body built in the current thread, as a first guess for the next body
+KeypointIdsType& latest_keypoint_ids() {
+    thread_local KeypointIdsType ids;
+    return ids;
+}
+
+HumanStateMessage build_human_state_message(List<HumanStateMessageBodyType> const& bodies, TimestampType const& timestamp) {
+    HumanStateMessageBuilder builder;
+    for (auto const& bd : bodies) {
+        builder.add_body(bd.first);
+        for (auto const& kp : bd.second) {
+            builder.add_keypoint(kp.first);
+            for (auto const& pt : kp.second)
+                builder.add_sample(pt);
+        }
+    }
+    return builder.build(timestamp);
+}
+
+}
+
 HumanStateMessage::HumanStateMessage(List<HumanStateMessageBodyType> const& bodies, TimestampType const& timestamp) :
-        _bodies(bodies), _timestamp(timestamp) { }
+        HumanStateMessage(build_human_state_message(bodies,timestamp)) { }
+
+HumanStateMessage::HumanStateMessage(List<BodyIdType>&& body_ids, List<KeypointIdsType>&& keypoint_ids, List<SizeType>&& keypoint_offsets,
+                                     List<SizeType>&& sample_offsets, List<Point>&& samples, TimestampType const& timestamp) :
+        _body_ids(std::move(body_ids)), _keypoint_ids(std::move(keypoint_ids)), _keypoint_offsets(std::move(keypoint_offsets)),
+        _sample_offsets(std::move(sample_offsets)), _samples(std::move(samples)), _timestamp(timestamp) { }
 
-List<HumanStateMessageBodyType> const& HumanStateMessage::bodies() const {
-    return _bodies;
+SizeType HumanStateMessage::num_bodies() const {
+    return _body_ids.size();
+}
+
+BodyIdType const& HumanStateMessage::body_id(SizeType const& body) const {
+    return _body_ids.at(body);
+}
+
+List<KeypointIdType> const& HumanStateMessage::keypoint_ids(SizeType const& body) const {
+    return *_keypoint_ids.at(body);
+}
+
+KeypointIdsType const& HumanStateMessage::shared_keypoint_ids(SizeType const& body) const {
+    return _keypoint_ids.at(body);
+}
+
+std::span<Point const> HumanStateMessage::samples(SizeType const& body, SizeType const& keypoint) const {
+    OPERA_PRECONDITION(keypoint < _keypoint_ids.at(body)->size())
+    auto const idx = _keypoint_offsets.at(body) + keypoint;
+    auto const begin = _sample_offsets.at(idx);
+    return {_samples.data() + begin, _sample_offsets.at(idx+1) - begin};
+}
+
+List<HumanStateMessageBodyType> HumanStateMessage::bodies() const {
+    List<HumanStateMessageBodyType> result;
+    for (SizeType b=0; b<num_bodies(); ++b) {
+        Map<KeypointIdType,List<Point>> keypoints;
+        auto const& ids = keypoint_ids(b);
+        for (SizeType k=0; k<ids.size(); ++k) {
+            auto const pts = samples(b,k);
+            keypoints.insert(std::make_pair(ids.at(k),List<Point>(pts.begin(),pts.end())));
+        }
+        result.emplace_back(_body_ids.at(b),keypoints);
+    }
+    return result;
 }
 
 TimestampType const& HumanStateMessage::timestamp() const {
     return _timestamp;
 }
 
+MessageHeader HumanStateMessage::header() const {
+    return {_body_ids,_timestamp};
+}
+
+HumanStateMessageBuilder::HumanStateMessageBuilder() :
+        _candidate_keypoint_ids(latest_keypoint_ids()), _num_body_keypoints(0), _candidate_matches(true) { }
+
+void HumanStateMessageBuilder::add_body(BodyIdType const& id) {
+    if (not _body_ids.empty()) _close_body();
+    _body_ids.push_back(id);
+    _keypoint_offsets.push_back(_sample_offsets.size());
+    _num_body_keypoints = 0;
+    _candidate_matches = true;
+}
+
+void HumanStateMessageBuilder::set_body_id(BodyIdType const& id) {
+    OPERA_PRECONDITION(not _body_ids.empty())
+    _body_ids.back() = id;
+}
+
+void HumanStateMessageBuilder::add_keypoint(std::string_view const& id) {
+    OPERA_PRECONDITION(not _body_ids.empty())
+    if (_candidate_matches) {
+        if (_candidate_keypoint_ids != nullptr and _num_body_keypoints < _candidate_keypoint_ids->size() and _candidate_keypoint_ids->at(_num_body_keypoints) == id) {
+            ++_num_body_keypoints;
+            _sample_offsets.push_back(_samples.size());
+            return;
+        }
+        _candidate_matches = false;
+        _body_keypoint_ids.clear();
+        if (_candidate_keypoint_ids != nullptr)
+            _body_keypoint_ids.assign(_candidate_keypoint_ids->begin(),_candidate_keypoint_ids->begin()+static_cast<long>(_num_body_keypoints));
+    }
+    _body_keypoint_ids.emplace_back(id);
+    ++_num_body_keypoints;
+    _sample_offsets.push_back(_samples.size());
+}
+
+void HumanStateMessageBuilder::add_sample(Point const& point) {
+    OPERA_PRECONDITION(not _sample_offsets.empty())
+    _samples.push_back(point);
+}
+
+void HumanStateMessageBuilder::_close_body() {
+    if (_candidate_matches) {
+        if (_candidate_keypoint_ids != nullptr and _num_body_keypoints == _candidate_keypoint_ids->size()) {
+            _keypoint_ids.push_back(_candidate_keypoint_ids);
+            return;
+        }
+        _body_keypoint_ids.clear();
+        if (_candidate_keypoint_ids != nullptr)
+            _body_keypoint_ids.assign(_candidate_keypoint_ids->begin(),_candidate_keypoint_ids->begin()+static_cast<long>(_num_body_keypoints));
+    }
+    _candidate_keypoint_ids = intern_keypoint_ids(_body_keypoint_ids);
+    _keypoint_ids.push_back(_candidate_keypoint_ids);
+}
+
+HumanStateMessage HumanStateMessageBuilder::build(TimestampType const& timestamp) {
+    if (not _body_ids.empty()) _close_body();
+    _keypoint_offsets.push_back(_sample_offsets.size());
+    _sample_offsets.push_back(_samples.size());
+    latest_keypoint_ids() = _candidate_keypoint_ids;
+    return HumanStateMessage(std::move(_body_ids),std::move(_keypoint_ids),std::move(_keypoint_offsets),std::move(_sample_offsets),std::move(_samples),timestamp);
+}
+
 RobotStateMessage::RobotStateMessage(BodyIdType const& id, Mode const& mode, List<List<Point>> const& points, TimestampType const& timestamp) :
-    _id(id), _mode(mode), _points(points), _timestamp(timestamp) { }
+    _id(id), _mode(mode), _timestamp(timestamp) {
+    _offsets.reserve(points.size()+1);
+    for (auto const& pts : points) {
+        _offsets.push_back(_samples.size());
+        _samples.insert(_samples.end(),pts.begin(),pts.end());
+    }
+    _offsets.push_back(_samples.size());
+}
+
+RobotStateMessage::RobotStateMessage(BodyIdType const& id, Mode const& mode, List<Point>&& samples, List<SizeType>&& offsets, TimestampType const& timestamp) :
+    _id(id), _mode(mode), _samples(std::move(samples)), _offsets(std::move(offsets)), _timestamp(timestamp) {
+    OPERA_PRECONDITION(not _offsets.empty() and _offsets.back() == _samples.size())
+}
 
 BodyIdType const& RobotStateMessage::id() const {
     return _id;
@@ -79,8 +239,27 @@ Mode const& RobotStateMessage::mode() const {
     return _mode;
 }
 
-List<List<Point>> const& RobotStateMessage::points() const {
-    return _points;
+SizeType RobotStateMessage::num_points() const {
+    return _offsets.size()-1;
+}
+
+std::span<Point const> RobotStateMessage::samples(SizeType const& point) const {
+    auto const begin = _offsets.at(point);
+    return {_samples.data() + begin, _offsets.at(point+1) - begin};
+}
+
+MessageHeader RobotStateMessage::header() const {
+    return {{_id},_timestamp};
+}
+
+List<List<Point>> RobotStateMessage::points() const {
+    List<List<Point>> result;
+    result.reserve(num_points());
+    for (SizeType i=0; i<num_points(); ++i) {
+        auto const pts = samples(i);
+        result.emplace_back(pts.begin(),pts.end());
+    }
+    return result;
 }
 
 TimestampType const& RobotStateMessage::timestamp() const {
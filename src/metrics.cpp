@@ -0,0 +1,334 @@
+/***************************************************************************
+ *            metrics.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#include "metrics.hpp"
+#include "macros.hpp"
+#include "conclog/include/logging.hpp"
+
+using namespace ConcLog;
+
+namespace Opera {
+
+namespace {
+
+//! \brief The maximum time waited for a connection before checking whether the endpoint is stopped
+constexpr int METRICS_ACCEPT_TIMEOUT_MS = 100;
+
+std::string format_value(FloatType const& value) {
+    if (std::isinf(value)) return (value > 0 ? "+Inf" : "-Inf");
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer+sizeof(buffer), value);
+    return std::string(buffer, result.ptr);
+}
+
+std::string with_labels(std::string const& name, std::string const& labels, std::string const& extra = std::string()) {
+    if (labels.empty() and extra.empty()) return name;
+    if (labels.empty()) return name + "{" + extra + "}";
+    if (extra.empty()) return name + "{" + labels + "}";
+    return name + "{" + labels + "," + extra + "}";
+}
+
+}
+
+SizeType metrics_shard_index() {
+    static std::atomic<SizeType> next_index = 0;
+    thread_local SizeType const index = next_index.fetch_add(1,std::memory_order_relaxed) % METRICS_NUM_SHARDS;
+    return index;
+}
+
+uint64_t MetricsCounter::value() const {
+    uint64_t result = 0;
+    for (auto const& shard : _shards) result += shard.value.load(std::memory_order_relaxed);
+    return result;
+}
+
+MetricsHistogram::Shard::Shard(SizeType const& num_buckets) : counts(new std::atomic<uint64_t>[num_buckets]), sum(0.0) {
+    for (SizeType i=0; i<num_buckets; ++i) counts[i].store(0,std::memory_order_relaxed);
+}
+
+MetricsHistogram::MetricsHistogram(List<FloatType> const& bounds) : _bounds(bounds) {
+    OPERA_PRECONDITION(std::is_sorted(bounds.begin(),bounds.end()))
+    for (SizeType i=0; i<METRICS_NUM_SHARDS; ++i) _shards.emplace_back(new Shard(bounds.size()+1));
+}
+
+void MetricsHistogram::observe(FloatType const& value) {
+    SizeType const bucket = static_cast<SizeType>(std::lower_bound(_bounds.begin(),_bounds.end(),value) - _bounds.begin());
+    auto& shard = *_shards[metrics_shard_index()];
+    shard.counts[bucket].fetch_add(1,std::memory_order_relaxed);
+    shard.sum.fetch_add(value,std::memory_order_relaxed);
+}
+
+List<FloatType> const& MetricsHistogram::bounds() const {
+    return _bounds;
+}
+
+List<uint64_t> MetricsHistogram::cumulative_counts() const {
+    List<uint64_t> result(_bounds.size()+1,0);
+    for (auto const& shard : _shards)
+        for (SizeType i=0; i<result.size(); ++i)
+            result[i] += shard->counts[i].load(std::memory_order_relaxed);
+    for (SizeType i=1; i<result.size(); ++i) result[i] += result[i-1];
+    return result;
+}
+
+FloatType MetricsHistogram::sum() const {
+    FloatType result = 0.0;
+    for (auto const& shard : _shards) result += shard->sum.load(std::memory_order_relaxed);
+    return result;
+}
+
+MetricsRegistry::Family& MetricsRegistry::_family(std::string const& name, std::string const& help, std::string const& type) {
+    auto family = _families.find(name);
+    if (family == _families.end()) {
+        family = _families.emplace(name,Family()).first;
+        family->second.help = help;
+        family->second.type = type;
+    }
+    OPERA_ASSERT_MSG(family->second.type == type, "Metric '" << name << "' is already registered as a " << family->second.type)
+    return family->second;
+}
+
+MetricsCounter& MetricsRegistry::counter(std::string const& name, std::string const& help, std::string const& labels) {
+    std::lock_guard<std::mutex> lock(_mux);
+    auto& family = _family(name,help,"counter");
+    if (not family.counters.has_key(labels)) family.counters.insert(std::make_pair(labels,std::make_shared<MetricsCounter>()));
+    return *family.counters.at(labels);
+}
+
+MetricsHistogram& MetricsRegistry::histogram(std::string const& name, std::string const& help, List<FloatType> const& bounds, std::string const& labels) {
+    std::lock_guard<std::mutex> lock(_mux);
+    auto& family = _family(name,help,"histogram");
+    if (not family.histograms.has_key(labels)) family.histograms.insert(std::make_pair(labels,std::make_shared<MetricsHistogram>(bounds)));
+    return *family.histograms.at(labels);
+}
+
+SizeType MetricsRegistry::add_gauge(std::string const& name, std::string const& help, std::function<FloatType()> const& sampler, std::string const& labels) {
+    std::lock_guard<std::mutex> lock(_mux);
+    auto& family = _family(name,help,"gauge");
+    auto const identifier = _next_gauge_identifier++;
+    family.gauges.insert(std::make_pair(identifier,std::make_pair(labels,sampler)));
+    return identifier;
+}
+
+void MetricsRegistry::remove_gauge(SizeType const& identifier) {
+    std::unique_lock<std::mutex> lock(_mux);
+    for (auto& family : _families) family.second.gauges.erase(identifier);
+    _sampling_condition.wait(lock, [this]{ return _num_samplings == 0; });
+}
+
+std::string MetricsRegistry::to_text() const {
+    Map<std::string,Family> families;
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        families = _families;
+        ++_num_samplings;
+    }
+    auto end_sampling = [this]{
+        {
+            std::lock_guard<std::mutex> lock(_mux);
+            --_num_samplings;
+        }
+        _sampling_condition.notify_all();
+    };
+    // Samplers may lock the owner of the gauge, which in turn may resolve metrics under that lock
+    Map<SizeType,FloatType> gauge_values;
+    try {
+        for (auto const& entry : families)
+            for (auto const& gauge : entry.second.gauges)
+                gauge_values.insert(std::make_pair(gauge.first,gauge.second.second()));
+    } catch (...) {
+        end_sampling();
+        throw;
+    }
+    end_sampling();
+
+    std::ostringstream ss;
+    for (auto const& entry : families) {
+        auto const& name = entry.first;
+        auto const& family = entry.second;
+        if (family.counters.empty() and family.histograms.empty() and family.gauges.empty()) continue;
+        ss << "# HELP " << name << " " << family.help << "\n";
+        ss << "# TYPE " << name << " " << family.type << "\n";
+        for (auto const& counter : family.counters)
+            ss << with_labels(name,counter.first) << " " << counter.second->value() << "\n";
+        for (auto const& gauge : family.gauges)
+            ss << with_labels(name,gauge.second.first) << " " << format_value(gauge_values.at(gauge.first)) << "\n";
+        for (auto const& histogram : family.histograms) {
+            auto const& labels = histogram.first;
+            auto const& bounds = histogram.second->bounds();
+            auto const counts = histogram.second->cumulative_counts();
+            for (SizeType i=0; i<bounds.size(); ++i)
+                ss << with_labels(name+"_bucket",labels,"le=\""+format_value(bounds[i])+"\"") << " " << counts[i] << "\n";
+            ss << with_labels(name+"_bucket",labels,"le=\"+Inf\"") << " " << counts.back() << "\n";
+            ss << with_labels(name+"_sum",labels) << " " << format_value(histogram.second->sum()) << "\n";
+            ss << with_labels(name+"_count",labels) << " " << counts.back() << "\n";
+        }
+    }
+    return ss.str();
+}
+
+void MetricsRegistry::write(std::string const& path) const {
+    auto const text = to_text();
+    std::string const temporary_path = path + ".tmp";
+    {
+        std::ofstream ofs(temporary_path, std::ios::trunc);
+        OPERA_ASSERT_MSG(ofs.is_open(), "Could not open '" << temporary_path << "' for writing metrics")
+        ofs << text;
+    }
+    std::filesystem::rename(temporary_path,path);
+}
+
+void MetricsRegistry::export_to_file(std::string const& path, SizeType const& period_ms) {
+    auto exporter = std::make_shared<PeriodicFileExporter>([](std::string const& p){ MetricsRegistry::instance().write(p); },path,period_ms);
+    std::lock_guard<std::mutex> lock(_mux);
+    _file_exporter = exporter;
+}
+
+void MetricsRegistry::serve(int port) {
+    auto endpoint = std::make_shared<MetricsHttpEndpoint>(port);
+    std::lock_guard<std::mutex> lock(_mux);
+    _http_endpoint = endpoint;
+}
+
+void MetricsRegistry::stop_exporting() {
+    SharedPointer<PeriodicFileExporter> file_exporter;
+    SharedPointer<MetricsHttpEndpoint> http_endpoint;
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        std::swap(file_exporter,_file_exporter);
+        std::swap(http_endpoint,_http_endpoint);
+    }
+    // The exporters are destroyed here, out of the lock since they may be exporting
+}
+
+List<FloatType> MetricsRegistry::duration_bounds() {
+    List<FloatType> result;
+    for (FloatType decade = 1e-6; decade < 10.0; decade *= 10)
+        for (FloatType multiplier : {1.0, 2.5, 5.0})
+            result.push_back(decade*multiplier);
+    result.push_back(10.0);
+    return result;
+}
+
+List<FloatType> MetricsRegistry::size_bounds() {
+    List<FloatType> result;
+    for (FloatType bound = 1; bound <= 1048576; bound *= 4)
+        result.push_back(bound);
+    return result;
+}
+
+PeriodicFileExporter::PeriodicFileExporter(std::function<void(std::string const&)> const& writer, std::string const& path, SizeType const& period_ms) : _stop(false), _thr([=,this]{
+    std::unique_lock<std::mutex> lock(_mux);
+    while (true) {
+        try {
+            writer(path);
+        } catch (std::exception& e) {
+            CONCLOG_PRINTLN("Could not export to '" << path << "': " << e.what())
+        }
+        if (_stop) return;
+        _stop_condition.wait_for(lock, std::chrono::milliseconds(period_ms), [this]{ return _stop; });
+    }
+}, "file_exp") { }
+
+PeriodicFileExporter::~PeriodicFileExporter() {
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        _stop = true;
+    }
+    _stop_condition.notify_one();
+}
+
+namespace {
+
+int open_listening_socket(int port) {
+    int descriptor = socket(AF_INET, SOCK_STREAM, 0);
+    OPERA_ASSERT_MSG(descriptor >= 0, "Could not create the metrics socket: " << std::strerror(errno))
+    int reuse = 1;
+    setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(descriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 or listen(descriptor, 8) != 0) {
+        auto const error = errno;
+        close(descriptor);
+        OPERA_FAIL_MSG("Could not listen for metrics on port " << port << ": " << std::strerror(error))
+    }
+    return descriptor;
+}
+
+void respond(int connection) {
+    char request[1024];
+    [[maybe_unused]] auto const received = recv(connection, request, sizeof(request), 0);
+    auto const body = MetricsRegistry::instance().to_text();
+    std::string const response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    SizeType sent = 0;
+    while (sent < response.size()) {
+        auto const result = send(connection, response.data()+sent, response.size()-sent, MSG_NOSIGNAL);
+        if (result <= 0) break;
+        sent += static_cast<SizeType>(result);
+    }
+}
+
+}
+
+MetricsHttpEndpoint::MetricsHttpEndpoint(int port) : _descriptor(open_listening_socket(port)), _stop(false), _thr([this]{
+    struct pollfd listening = {_descriptor, POLLIN, 0};
+    while (not _stop) {
+        if (poll(&listening, 1, METRICS_ACCEPT_TIMEOUT_MS) <= 0) continue;
+        int connection = accept(_descriptor, nullptr, nullptr);
+        if (connection < 0) continue;
+        struct timeval timeout = {0, METRICS_ACCEPT_TIMEOUT_MS*1000};
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        respond(connection);
+        close(connection);
+    }
+    close(_descriptor);
+}, "met_http") { }
+
+MetricsHttpEndpoint::~MetricsHttpEndpoint() {
+    _stop = true;
+}
+
+}
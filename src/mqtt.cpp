@@ -30,42 +30,159 @@
 
 namespace Opera {
 
-MqttBrokerAccess::MqttBrokerAccess(std::string const& hostname, int port) : _hostname(hostname), _port(port) { }
+MqttConnection::MqttConnection(std::string const& hostname, int port) :
+    _next_subscription_id(0), _parent_logger_level(static_cast<int>(Logger::instance().current_level())),
+    _parent_thread_name(Logger::instance().current_thread_name()), _registered(false)
+{
+    int rc = mosquitto_lib_init();
+    OPERA_ASSERT_MSG(rc == MOSQ_ERR_SUCCESS, "Error initialising Mosquito library: " << mosquitto_strerror(rc))
 
-MqttBrokerAccess::~MqttBrokerAccess() {
+    _client = mosquitto_new(nullptr, true, this);
+    OPERA_ASSERT_MSG(_client != nullptr, "Error: Out of memory.")
+
+    mosquitto_connect_callback_set(_client, _on_connect);
+    mosquitto_message_callback_set(_client, _on_message);
+
+    rc = mosquitto_connect_bind_v5(_client, hostname.c_str(), port, 60, nullptr, nullptr);
+    if (rc != MOSQ_ERR_SUCCESS) {
+        mosquitto_destroy(_client);
+        mosquitto_lib_cleanup();
+        OPERA_THROW_RTE("Error connecting: " << mosquitto_strerror(rc))
+    }
+
+    mosquitto_loop_start(_client);
+}
+
+void MqttConnection::publish(std::string const& topic, std::string_view const& payload, int qos) {
+    int rc = mosquitto_publish_v5(_client, nullptr, topic.c_str(), static_cast<int>(payload.size()), payload.data(), qos, false, nullptr);
+    OPERA_ASSERT_MSG(rc == MOSQ_ERR_SUCCESS,"Error publishing: " << mosquitto_strerror(rc))
+}
+
+SizeType MqttConnection::subscribe(std::string const& topic, int qos, MqttPayloadHandler const& handler) {
+    std::lock_guard<std::mutex> lock(_mux);
+    auto id = _next_subscription_id++;
+    _subscriptions.insert(std::make_pair(id,Subscription({topic,qos,std::make_shared<MqttPayloadHandler const>(handler)})));
+    mosquitto_subscribe_v5(_client, nullptr, topic.c_str(), qos, 0, nullptr);
+    return id;
+}
+
+void MqttConnection::unsubscribe(SizeType const& id) {
+    std::unique_lock<std::mutex> lock(_mux);
+    auto it = _subscriptions.find(id);
+    if (it == _subscriptions.end()) return;
+    auto topic = it->second.topic;
+    _subscriptions.erase(it);
+    bool topic_used = false;
+    for (auto const& s : _subscriptions)
+        if (s.second.topic == topic) { topic_used = true; break; }
+    if (not topic_used) mosquitto_unsubscribe_v5(_client, nullptr, topic.c_str(), nullptr);
+    if (_dispatching_thread != std::this_thread::get_id())
+        _dispatch_condition.wait(lock, [this]{ return _dispatching_thread == std::thread::id(); });
+}
+
+void MqttConnection::_on_connect(struct mosquitto*, void* obj, int rc) {
+    if (rc != 0) return;
+    auto connection = static_cast<MqttConnection*>(obj);
+    std::lock_guard<std::mutex> lock(connection->_mux);
+    for (auto const& s : connection->_subscriptions)
+        mosquitto_subscribe_v5(connection->_client, nullptr, s.second.topic.c_str(), s.second.qos, 0, nullptr);
+}
+
+void MqttConnection::_on_message(struct mosquitto*, void* obj, const struct mosquitto_message* msg) {
+    auto connection = static_cast<MqttConnection*>(obj);
+    if (not connection->_registered) {
+        connection->_loop_thread_id = std::this_thread::get_id();
+        Logger::instance().register_self_thread(connection->_parent_thread_name, connection->_parent_logger_level);
+        connection->_registered = true;
+    }
+
+    auto payload = static_cast<const char*>(msg->payload);
+    auto size = static_cast<SizeType>(msg->payloadlen);
+    List<SharedPointer<MqttPayloadHandler const>> handlers;
+    {
+        std::lock_guard<std::mutex> lock(connection->_mux);
+        for (auto const& s : connection->_subscriptions) {
+            bool matches = false;
+            mosquitto_topic_matches_sub(s.second.topic.c_str(), msg->topic, &matches);
+            if (matches) handlers.push_back(s.second.handler);
+        }
+        if (handlers.empty()) return;
+        connection->_dispatching_thread = std::this_thread::get_id();
+    }
+    // Exceptions must not propagate through the frames of the mosquitto loop, which is C code
+    for (auto const& handler : handlers) {
+        try {
+            (*handler)(payload,size);
+        } catch (std::exception& e) {
+            CONCLOG_PRINTLN("Error handling MQTT message on topic '" << msg->topic << "': " << e.what())
+        } catch (...) {
+            CONCLOG_PRINTLN("Unknown error handling MQTT message on topic '" << msg->topic << "'")
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(connection->_mux);
+        connection->_dispatching_thread = std::thread::id();
+    }
+    connection->_dispatch_condition.notify_all();
+}
+
+MqttConnection::~MqttConnection() {
+    mosquitto_disconnect(_client);
+    mosquitto_loop_stop(_client,true);
+    mosquitto_destroy(_client);
     mosquitto_lib_cleanup();
+    if (_registered)
+        Logger::instance().unregister_thread(_loop_thread_id);
+}
+
+MqttConnectionPool::MqttConnectionPool(std::string const& hostname, int port, SizeType const& num_connections) :
+    _hostname(hostname), _port(port), _connections(num_connections) {
+    OPERA_PRECONDITION(num_connections > 0)
+}
+
+SharedPointer<MqttConnection> MqttConnectionPool::connection_for(std::string const& topic) {
+    std::lock_guard<std::mutex> lock(_mux);
+    auto& connection = _connections.at(std::hash<std::string>()(topic) % _connections.size());
+    if (connection == nullptr) connection = std::make_shared<MqttConnection>(_hostname,_port);
+    return connection;
+}
+
+MqttBrokerAccess::MqttBrokerAccess(std::string const& hostname, int port, MessageEncoding const& encoding, MqttQualityOfService const& qos, SizeType const& num_connections) :
+    _encoding(encoding), _qos(qos), _connections(std::make_shared<MqttConnectionPool>(hostname,port,num_connections)) {
+    for (auto q : {qos.body_presentation, qos.human_state, qos.robot_state, qos.collision_notification})
+        OPERA_PRECONDITION(q >= 0 and q <= 2)
 }
 
 PublisherInterface<BodyPresentationMessage>* MqttBrokerAccess::make_body_presentation_publisher(BodyPresentationTopic const& topic) const {
-    return new MqttPublisher<BodyPresentationMessage>(topic, _hostname, _port);
+    return new MqttPublisher<BodyPresentationMessage>(topic, _connections->connection_for(topic), _qos.body_presentation, _encoding);
 }
 
 PublisherInterface<HumanStateMessage>* MqttBrokerAccess::make_human_state_publisher(HumanStateTopic const& topic) const {
-    return new MqttPublisher<HumanStateMessage>(topic, _hostname, _port);
+    return new MqttPublisher<HumanStateMessage>(topic, _connections->connection_for(topic), _qos.human_state, _encoding);
 }
 
 PublisherInterface<RobotStateMessage>* MqttBrokerAccess::make_robot_state_publisher(RobotStateTopic const& topic) const {
-    return new MqttPublisher<RobotStateMessage>(topic, _hostname, _port);
+    return new MqttPublisher<RobotStateMessage>(topic, _connections->connection_for(topic), _qos.robot_state, _encoding);
 }
 
 PublisherInterface<CollisionNotificationMessage>* MqttBrokerAccess::make_collision_notification_publisher(CollisionNotificationTopic const& topic) const {
-    return new MqttPublisher<CollisionNotificationMessage>(topic, _hostname, _port);
+    return new MqttPublisher<CollisionNotificationMessage>(topic, _connections->connection_for(topic), _qos.collision_notification, _encoding);
 }
 
 SubscriberInterface<BodyPresentationMessage>* MqttBrokerAccess::make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic) const {
-    return new MqttSubscriber<BodyPresentationMessage>(topic, _hostname, _port, callback);
+    return new MqttSubscriber<BodyPresentationMessage>(topic, _connections->connection_for(topic), _qos.body_presentation, callback, _encoding);
 }
 
-SubscriberInterface<HumanStateMessage>* MqttBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic) const {
-    return new MqttSubscriber<HumanStateMessage>(topic, _hostname, _port, callback);
+SubscriberInterface<HumanStateMessage>* MqttBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic, MessageFilter const& filter) const {
+    return new MqttSubscriber<HumanStateMessage>(topic, _connections->connection_for(topic), _qos.human_state, callback, _encoding, make_payload_filter<HumanStateMessage>(filter,_encoding));
 }
 
-SubscriberInterface<RobotStateMessage>* MqttBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic) const {
-    return new MqttSubscriber<RobotStateMessage>(topic, _hostname, _port, callback);
+SubscriberInterface<RobotStateMessage>* MqttBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic, MessageFilter const& filter) const {
+    return new MqttSubscriber<RobotStateMessage>(topic, _connections->connection_for(topic), _qos.robot_state, callback, _encoding, make_payload_filter<RobotStateMessage>(filter,_encoding));
 }
 
 SubscriberInterface<CollisionNotificationMessage>* MqttBrokerAccess::make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic) const {
-    return new MqttSubscriber<CollisionNotificationMessage>(topic, _hostname, _port, callback);
+    return new MqttSubscriber<CollisionNotificationMessage>(topic, _connections->connection_for(topic), _qos.collision_notification, callback, _encoding);
 }
 
 }
@@ -35,8 +35,7 @@ using namespace Opera;
 int main(int argc, const char* argv[]) {
     if (not CommandLineInterface::instance().acquire(argc, argv)) return -1;
 
-    //BrokerAccess access = KafkaBrokerAccess(0,"localhost",RdKafka::Topic::OFFSET_END);
-    BrokerAccess access = MqttBrokerAccess("localhost",1883);
+    if (not BrokerAccessManager::instance().is_configured()) BrokerAccessManager::instance().configure("mqtt","localhost",1883);
     Runtime runtime(BrokerAccessManager::instance().get_access());
 
     std::this_thread::sleep_until(std::chrono::system_clock::now() + std::chrono::hours(std::numeric_limits<int>::max()));
@@ -0,0 +1,300 @@
+/***************************************************************************
+ *            record.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include "record.hpp"
+
+namespace Opera {
+
+namespace {
+
+//! \brief The identifier at the start of a message log
+constexpr char MESSAGE_LOG_MAGIC[8] = {'O','P','E','R','A','L','O','G'};
+//! \brief The size of the header of a message log, made of the identifier, the version, the encoding and padding
+constexpr SizeType MESSAGE_LOG_HEADER_SIZE = 16;
+//! \brief The size of the length prefix of an entry
+constexpr SizeType MESSAGE_LOG_LENGTH_SIZE = 4;
+//! \brief The minimum size of the mapping of a log being written
+constexpr SizeType MESSAGE_LOG_MINIMUM_CAPACITY = 1 << 20;
+
+}
+
+MessageLogWriter::MessageLogWriter(String const& path, MessageEncoding const& encoding) :
+    _path(path), _encoding(encoding), _start(std::chrono::steady_clock::now()), _descriptor(-1), _data(nullptr), _capacity(0), _size(0), _num_entries(0)
+{
+    _descriptor = open(_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    OPERA_ASSERT_MSG(_descriptor >= 0, "Could not create message log '" << _path << "': " << std::strerror(errno))
+    _reserve(MESSAGE_LOG_HEADER_SIZE);
+    std::memcpy(_data, MESSAGE_LOG_MAGIC, sizeof(MESSAGE_LOG_MAGIC));
+    _data[8] = static_cast<char>(MESSAGE_LOG_VERSION);
+    _data[9] = static_cast<char>(_encoding == MessageEncoding::BINARY ? 1 : 0);
+    _size = MESSAGE_LOG_HEADER_SIZE;
+}
+
+void MessageLogWriter::_reserve(SizeType const& num_bytes) {
+    // One more length is always available, so that the (zero) length after the last entry lies within the file
+    SizeType required = _size + num_bytes + MESSAGE_LOG_LENGTH_SIZE;
+    if (required <= _capacity) return;
+    SizeType capacity = std::max(_capacity,MESSAGE_LOG_MINIMUM_CAPACITY);
+    while (capacity < required) capacity *= 2;
+    if (_data != nullptr) munmap(_data, _capacity);
+    OPERA_ASSERT_MSG(ftruncate(_descriptor, static_cast<off_t>(capacity)) == 0, "Could not grow message log '" << _path << "': " << std::strerror(errno))
+    void* address = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _descriptor, 0);
+    OPERA_ASSERT_MSG(address != MAP_FAILED, "Could not map message log '" << _path << "': " << std::strerror(errno))
+    _data = static_cast<char*>(address);
+    _capacity = capacity;
+}
+
+void MessageLogWriter::append(BinaryMessageKind const& kind, String const& topic, std::string_view const& payload) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start);
+    thread_local String entry;
+    entry.clear();
+    BinaryWriter writer(entry);
+    writer.write_uint8(static_cast<uint8_t>(kind));
+    writer.write_string(topic);
+    writer.write_uint64(static_cast<uint64_t>(elapsed.count()));
+    writer.write_size(payload.size());
+    entry.append(payload);
+
+    String length;
+    BinaryWriter(length).write_size(entry.size());
+
+    std::lock_guard<std::mutex> lock(_mux);
+    _reserve(MESSAGE_LOG_LENGTH_SIZE + entry.size());
+    std::memcpy(_data + _size + MESSAGE_LOG_LENGTH_SIZE, entry.data(), entry.size());
+    std::memcpy(_data + _size, length.data(), MESSAGE_LOG_LENGTH_SIZE);
+    _size += MESSAGE_LOG_LENGTH_SIZE + entry.size();
+    ++_num_entries;
+}
+
+MessageEncoding const& MessageLogWriter::encoding() const {
+    return _encoding;
+}
+
+SizeType MessageLogWriter::num_entries() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    return _num_entries;
+}
+
+SizeType MessageLogWriter::size() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    return _size;
+}
+
+MessageLogWriter::~MessageLogWriter() {
+    munmap(_data, _capacity);
+    [[maybe_unused]] int truncated = ftruncate(_descriptor, static_cast<off_t>(_size));
+    close(_descriptor);
+}
+
+MessageLogReader::MessageLogReader(String const& path) : _path(path), _encoding(MessageEncoding::BINARY), _data(nullptr), _size(0) {
+    int descriptor = open(_path.c_str(), O_RDONLY);
+    OPERA_ASSERT_MSG(descriptor >= 0, "Could not open message log '" << _path << "': " << std::strerror(errno))
+    struct stat st;
+    fstat(descriptor, &st);
+    _size = static_cast<SizeType>(st.st_size);
+    if (_size >= MESSAGE_LOG_HEADER_SIZE) {
+        void* address = mmap(nullptr, _size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (address != MAP_FAILED) _data = static_cast<char*>(address);
+    }
+    close(descriptor);
+    OPERA_ASSERT_MSG(_data != nullptr, "Could not map message log '" << _path << "'")
+    if (std::memcmp(_data, MESSAGE_LOG_MAGIC, sizeof(MESSAGE_LOG_MAGIC)) != 0 or static_cast<uint8_t>(_data[8]) == 0 or static_cast<uint8_t>(_data[8]) > MESSAGE_LOG_VERSION) {
+        munmap(_data, _size);
+        OPERA_THROW_RTE("The file '" << _path << "' is not a supported message log.")
+    }
+    _encoding = (_data[9] == 1 ? MessageEncoding::BINARY : MessageEncoding::JSON);
+}
+
+MessageEncoding const& MessageLogReader::encoding() const {
+    return _encoding;
+}
+
+SizeType MessageLogReader::begin() const {
+    return MESSAGE_LOG_HEADER_SIZE;
+}
+
+bool MessageLogReader::next(SizeType& offset, MessageLogEntry& entry) const {
+    if (offset + MESSAGE_LOG_LENGTH_SIZE > _size) return false;
+    auto length = BinaryReader(_data + offset, MESSAGE_LOG_LENGTH_SIZE).read_size();
+    if (length == 0 or offset + MESSAGE_LOG_LENGTH_SIZE + length > _size) return false;
+    BinaryReader reader(_data + offset + MESSAGE_LOG_LENGTH_SIZE, length);
+    entry.kind = static_cast<BinaryMessageKind>(reader.read_uint8());
+    entry.topic = reader.read_string_view();
+    entry.elapsed = std::chrono::nanoseconds(static_cast<std::chrono::nanoseconds::rep>(reader.read_uint64()));
+    entry.payload = reader.read_string_view();
+    offset += MESSAGE_LOG_LENGTH_SIZE + length;
+    return true;
+}
+
+MessageLogReader::~MessageLogReader() {
+    munmap(_data, _size);
+}
+
+RecordingBrokerAccess::RecordingBrokerAccess(BrokerAccess const& access, String const& path, MessageEncoding const& encoding) :
+    _access(access), _writer(std::make_shared<MessageLogWriter>(path,encoding)) { }
+
+MessageLogWriter const& RecordingBrokerAccess::log() const {
+    return *_writer;
+}
+
+PublisherInterface<BodyPresentationMessage>* RecordingBrokerAccess::make_body_presentation_publisher(BodyPresentationTopic const& topic) const {
+    return _access.make_body_presentation_publisher(topic);
+}
+
+PublisherInterface<HumanStateMessage>* RecordingBrokerAccess::make_human_state_publisher(HumanStateTopic const& topic) const {
+    return _access.make_human_state_publisher(topic);
+}
+
+PublisherInterface<RobotStateMessage>* RecordingBrokerAccess::make_robot_state_publisher(RobotStateTopic const& topic) const {
+    return _access.make_robot_state_publisher(topic);
+}
+
+PublisherInterface<CollisionNotificationMessage>* RecordingBrokerAccess::make_collision_notification_publisher(CollisionNotificationTopic const& topic) const {
+    return _access.make_collision_notification_publisher(topic);
+}
+
+SubscriberInterface<BodyPresentationMessage>* RecordingBrokerAccess::make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic) const {
+    return _access.make_body_presentation_subscriber(_recording(callback,topic),topic);
+}
+
+SubscriberInterface<HumanStateMessage>* RecordingBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic, MessageFilter const& filter) const {
+    return _access.make_human_state_subscriber(_recording(callback,topic,filter),topic);
+}
+
+SubscriberInterface<RobotStateMessage>* RecordingBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic, MessageFilter const& filter) const {
+    return _access.make_robot_state_subscriber(_recording(callback,topic,filter),topic);
+}
+
+SubscriberInterface<CollisionNotificationMessage>* RecordingBrokerAccess::make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic) const {
+    return _access.make_collision_notification_subscriber(callback,topic);
+}
+
+MessageLogPlayer::MessageLogPlayer(String const& path) : _reader(path), _next_identifier(0) { }
+
+MessageEncoding const& MessageLogPlayer::encoding() const {
+    return _reader.encoding();
+}
+
+SizeType MessageLogPlayer::add(BinaryMessageKind const& kind, String const& topic, HandlerFunction const& handler) {
+    std::lock_guard<std::mutex> lock(_mux);
+    auto identifier = _next_identifier++;
+    _registrations.insert(std::make_pair(identifier,Registration({kind,topic,std::make_shared<HandlerFunction const>(handler)})));
+    return identifier;
+}
+
+void MessageLogPlayer::remove(SizeType const& identifier) {
+    std::unique_lock<std::mutex> lock(_mux);
+    _registrations.erase(identifier);
+    if (_dispatching_thread != std::this_thread::get_id())
+        _dispatch_condition.wait(lock, [this]{ return _dispatching_thread == std::thread::id(); });
+}
+
+SizeType MessageLogPlayer::play(ReplayTiming const& timing, DrainedFunction const& drained) {
+    SizeType result = 0;
+    auto start = std::chrono::steady_clock::now();
+    SizeType offset = _reader.begin();
+    MessageLogEntry entry;
+    auto end_dispatching = [this]{
+        {
+            std::lock_guard<std::mutex> lock(_mux);
+            _dispatching_thread = std::thread::id();
+        }
+        _dispatch_condition.notify_all();
+    };
+    while (_reader.next(offset,entry)) {
+        if (timing == ReplayTiming::ORIGINAL) std::this_thread::sleep_until(start + entry.elapsed);
+        else if (drained) while (not drained()) std::this_thread::yield();
+        List<SharedPointer<HandlerFunction const>> handlers;
+        {
+            std::lock_guard<std::mutex> lock(_mux);
+            for (auto const& r : _registrations)
+                if (r.second.kind == entry.kind and r.second.topic == entry.topic)
+                    handlers.push_back(r.second.handler);
+            if (handlers.empty()) continue;
+            _dispatching_thread = std::this_thread::get_id();
+        }
+        try {
+            for (auto const& handler : handlers) (*handler)(entry.payload.data(),entry.payload.size());
+        } catch (...) {
+            end_dispatching();
+            throw;
+        }
+        end_dispatching();
+        ++result;
+    }
+    if (timing == ReplayTiming::MAXIMUM and drained) while (not drained()) std::this_thread::yield();
+    return result;
+}
+
+ReplayBrokerAccess::ReplayBrokerAccess(String const& path) : _player(std::make_shared<MessageLogPlayer>(path)) { }
+
+SizeType ReplayBrokerAccess::play(ReplayTiming const& timing, MessageLogPlayer::DrainedFunction const& drained) const {
+    return _player->play(timing,drained);
+}
+
+PublisherInterface<BodyPresentationMessage>* ReplayBrokerAccess::make_body_presentation_publisher(BodyPresentationTopic const&) const {
+    return new MemoryPublisher<BodyPresentationMessage>();
+}
+
+PublisherInterface<HumanStateMessage>* ReplayBrokerAccess::make_human_state_publisher(HumanStateTopic const&) const {
+    return new MemoryPublisher<HumanStateMessage>();
+}
+
+PublisherInterface<RobotStateMessage>* ReplayBrokerAccess::make_robot_state_publisher(RobotStateTopic const&) const {
+    return new MemoryPublisher<RobotStateMessage>();
+}
+
+PublisherInterface<CollisionNotificationMessage>* ReplayBrokerAccess::make_collision_notification_publisher(CollisionNotificationTopic const&) const {
+    return new MemoryPublisher<CollisionNotificationMessage>();
+}
+
+SubscriberInterface<BodyPresentationMessage>* ReplayBrokerAccess::make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic) const {
+    return new ReplaySubscriber<BodyPresentationMessage>(_player,topic,callback);
+}
+
+SubscriberInterface<HumanStateMessage>* ReplayBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic, MessageFilter const& filter) const {
+    return new ReplaySubscriber<HumanStateMessage>(_player,topic,callback,make_payload_filter<HumanStateMessage>(filter,_player->encoding()));
+}
+
+SubscriberInterface<RobotStateMessage>* ReplayBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic, MessageFilter const& filter) const {
+    return new ReplaySubscriber<RobotStateMessage>(_player,topic,callback,make_payload_filter<RobotStateMessage>(filter,_player->encoding()));
+}
+
+SubscriberInterface<CollisionNotificationMessage>* ReplayBrokerAccess::make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const&) const {
+    return new MemorySubscriber<CollisionNotificationMessage>(callback);
+}
+
+}
@@ -28,12 +28,21 @@
 
 #include <cmath>
 #include "runtime.hpp"
+#include "job_trace.hpp"
 #include "conclog/include/logging.hpp"
 
 using namespace ConcLog;
 
 namespace Opera {
 
+namespace {
+
+MetricsCounter& jobs_total(const char* outcome) {
+    return MetricsRegistry::instance().counter("opera_jobs_total","Number of jobs processed, by outcome",std::string("outcome=\"")+outcome+"\"");
+}
+
+}
+
 String construct_thread_name(String prefix, SizeType number, SizeType max_number) {
     std::ostringstream ss;
     ss << prefix;
@@ -46,7 +55,8 @@ RuntimeConfiguration::RuntimeConfiguration() :
     _job_factory(ReuseLookAheadJobFactory(AddWhenDifferentMinimumDistanceBarrierSequenceUpdatePolicy(),ReuseEquivalence::STRONG)),
     _history_retention(3600),
     _history_purge_period(300),
-    _concurrency(std::thread::hardware_concurrency()) { }
+    _concurrency(std::thread::hardware_concurrency()),
+    _ingestion_concurrency(DEFAULT_INGESTION_CONCURRENCY) { }
 
 LookAheadJobFactory const& RuntimeConfiguration::get_job_factory() const {
     return _job_factory;
@@ -64,6 +74,10 @@ SizeType const& RuntimeConfiguration::get_concurrency() const {
     return _concurrency;
 }
 
+SizeType const& RuntimeConfiguration::get_ingestion_concurrency() const {
+    return _ingestion_concurrency;
+}
+
 RuntimeConfiguration& RuntimeConfiguration::set_job_factory(LookAheadJobFactory const& factory) {
     _job_factory = factory;
     return *this;
@@ -87,6 +101,12 @@ RuntimeConfiguration& RuntimeConfiguration::set_concurrency(SizeType const& conc
     return *this;
 }
 
+RuntimeConfiguration& RuntimeConfiguration::set_ingestion_concurrency(SizeType const& concurrency) {
+    OPERA_PRECONDITION(concurrency > 0)
+    _ingestion_concurrency = concurrency;
+    return *this;
+}
+
 Runtime::Runtime(BrokerAccess const& access, RuntimeConfiguration const& configuration) :
     Runtime({access,BodyPresentationTopic::DEFAULT},{access,HumanStateTopic::DEFAULT},{access,RobotStateTopic::DEFAULT},{access,CollisionNotificationTopic::DEFAULT},configuration) { }
 
@@ -98,7 +118,7 @@ Runtime::Runtime(Pair<BrokerAccess,BodyPresentationTopic> const& bp_subscriber,
     _stop(false),
     _receiver(bp_subscriber,hs_subscriber,rs_subscriber,
               configuration.get_job_factory(),configuration.get_history_retention(),configuration.get_history_purge_period(),
-              _registry,_waiting_jobs, _sleeping_jobs),
+              _registry,_waiting_jobs, _sleeping_jobs, configuration.get_ingestion_concurrency()),
     _sender(cn_publisher),
     _num_processing(0),
     _num_processed(0),
@@ -123,6 +143,10 @@ Runtime::Runtime(Pair<BrokerAccess,BodyPresentationTopic> const& bp_subscriber,
                 CONCLOG_SCOPE_PRINTHOLD("#w=" << _waiting_jobs.size() << ", #s=" << _sleeping_jobs.size())
             }
         }, construct_thread_name("la-",i,_configuration.get_concurrency())));
+
+    auto& metrics = MetricsRegistry::instance();
+    _gauges.push_back(metrics.add_gauge("opera_jobs_queued","Number of jobs in the queues",[this]{ return static_cast<FloatType>(num_waiting_jobs()); },"queue=\"waiting\""));
+    _gauges.push_back(metrics.add_gauge("opera_jobs_queued","Number of jobs in the queues",[this]{ return static_cast<FloatType>(num_sleeping_jobs()); },"queue=\"sleeping\""));
 }
 
 SizeType Runtime::num_segment_pairs() const {
@@ -133,6 +157,10 @@ SizeType Runtime::num_pending_human_robot_pairs() const {
     return _receiver.num_pending_human_robot_pairs();
 }
 
+bool Runtime::ingestion_drained() const {
+    return _receiver.ingestion_drained();
+}
+
 SizeType Runtime::num_waiting_jobs() const {
     std::unique_lock<std::mutex> lock(_availability_mutex);
     return _waiting_jobs.size();
@@ -149,17 +177,32 @@ void Runtime::__test__process_one_working_job() {
 
 void Runtime::_process_one_working_job() {
     CONCLOG_SCOPE_CREATE
+    static MetricsHistogram& service_seconds = MetricsRegistry::instance().histogram("opera_job_service_seconds","Time to process a working job",MetricsRegistry::duration_bounds());
+    static MetricsCounter& jobs_processed = jobs_total("processed");
+    static MetricsCounter& jobs_completed = jobs_total("completed");
+    static MetricsCounter& jobs_aborted = jobs_total("aborted");
+    MetricsTimer timer(service_seconds);
     auto job = _waiting_jobs.dequeue();
-    auto const& robot_history = _registry.robot_history(job.id().robot());
-    auto human_keypoint_data = _registry.get_human_keypoint_ids(job.id().human(),job.id().human_segment());
-    if (not get<0>(human_keypoint_data)) {
+    JobTraceScope trace_scope(job);
+    auto human_entry = _registry.human_entry(job.id().human());
+    if (human_entry == nullptr) {
         CONCLOG_PRINTLN("Aborting working job since human has been removed")
+        jobs_aborted.add();
+        return;
+    }
+    auto robot_entry = _registry.robot_entry(job.id().robot());
+    if (robot_entry == nullptr) {
+        CONCLOG_PRINTLN("Aborting working job since robot has been removed")
+        jobs_aborted.add();
         return;
     }
-    auto const& robot = _registry.robot(job.id().robot());
-    auto const& message_frequency = _registry.robot(job.id().robot()).message_frequency();
+    auto const& robot_history = robot_entry->history();
+    SharedPointer<RobotStateHistory const> const robot_history_handle(robot_entry,&robot_history);
+    auto const& robot = robot_entry->body();
+    auto const& message_frequency = robot.message_frequency();
 
     ++_num_processed;
+    jobs_processed.add();
 
     CONCLOG_PRINTLN("Processing job {" << job.id() << ":" << job.path() << "} at " << job.initial_time() << " with trace of size " << job.prediction_trace().size() <<
                                            " from " << job.prediction_trace().at(0).mode << " to " << job.prediction_trace().ending_mode())
@@ -180,9 +223,17 @@ void Runtime::_process_one_working_job() {
         auto lower_collision_distance = static_cast<TimestampType>(std::round(static_cast<FloatType>(1000*samples_between_modes.lower())/message_frequency));
         auto upper_collision_distance = static_cast<TimestampType>(std::round(static_cast<FloatType>(1000*samples_between_modes.upper())/message_frequency));
 
-        Pair<KeypointIdType,KeypointIdType> human_segment = {get<1>(human_keypoint_data),get<2>(human_keypoint_data)};
+        auto const& human_body_segment = human_entry->body().segment(job.id().human_segment());
+        Pair<KeypointIdType,KeypointIdType> human_segment = {human_body_segment.head_id(),human_body_segment.tail_id()};
         Pair<KeypointIdType,KeypointIdType> robot_segment = {robot.segment(job.id().robot_segment()).head_id(),robot.segment(job.id().robot_segment()).tail_id()};
 
+        auto const reception_time = _receiver.human_state_reception_time(job.initial_time());
+        if (reception_time.has_value()) {
+            static MetricsHistogram& notification_latency = MetricsRegistry::instance().histogram("opera_notification_latency_seconds",
+                "Time from the reception of a human state to the notification of a collision found from it",MetricsRegistry::duration_bounds());
+            notification_latency.observe(std::chrono::duration<FloatType>(std::chrono::steady_clock::now() - reception_time.value()).count());
+        }
+        JobTracer::instance().record(JobEvent::NOTIFIED,job);
         _sender.put(CollisionNotificationMessage(job.id().human(), human_segment, job.id().robot(), robot_segment, job.initial_time(), {lower_collision_distance,upper_collision_distance}, job.prediction_trace().ending_mode(), job.prediction_trace().likelihood()));
 
         std::ostringstream collision_ss;
@@ -194,21 +245,34 @@ void Runtime::_process_one_working_job() {
         CONCLOG_PRINTLN("Notification sent for {" << job.id() << ":" << job.path() << "} from " << job.initial_time() << collision_ss.str() << " (~" << job.prediction_trace().likelihood() << ")")
         ++_num_completed;
         ++_num_collisions;
-        if (_registry.has_human(job.id().human()))
+        jobs_completed.add();
+        static MetricsCounter& notifications_sent = MetricsRegistry::instance().counter("opera_collision_notifications_total","Number of collision notifications sent");
+        notifications_sent.add();
+        if (_registry.has_human(job.id().human())) {
+            JobTracer::instance().record(JobEvent::SLEPT,job);
+            job.pin_snapshot_time(robot_history_handle);
             _sleeping_jobs.enqueue(job);
+        }
     } else if (_registry.has_human(job.id().human())) {
         auto next_jobs = _receiver.factory().create_next_jobs(job, robot_history);
         CONCLOG_PRINTLN("No collision found, handling " << next_jobs.size() << " next jobs")
-        if (next_jobs.empty()) { ++_num_completed; _sleeping_jobs.enqueue(job); }
-        else for (auto const& nj : next_jobs) {
-            if (nj.path().size() <= job.path().size() or
-               (nj.path().size() > job.path().size() and not _receiver.factory().has_registered(nj.initial_time(),nj.id(),nj.path())))
+        if (next_jobs.empty()) { ++_num_completed; jobs_completed.add(); JobTracer::instance().record(JobEvent::SLEPT,job); job.pin_snapshot_time(robot_history_handle); _sleeping_jobs.enqueue(job); }
+        else {
+            JobTracer::instance().record(JobEvent::SPLIT,job,next_jobs.size());
+            for (auto const& nj : next_jobs) {
+                if (nj.path().size() <= job.path().size() or
+                   (nj.path().size() > job.path().size() and not _receiver.factory().has_registered(nj))) {
+                    JobTracer::instance().record(JobEvent::ENQUEUED,nj);
+                    nj.pin_snapshot_time(robot_history_handle);
                     _waiting_jobs.enqueue(nj);
+                }
+            }
         }
     }
 }
 
 Runtime::~Runtime() noexcept {
+    for (auto const& gauge : _gauges) MetricsRegistry::instance().remove_gauge(gauge);
     _stop = true;
     _availability_condition.notify_all();
 }
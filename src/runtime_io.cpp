@@ -28,65 +28,170 @@
 
 #include "runtime_io.tpl.hpp"
 #include "deserialisation.hpp"
+#include "job_trace.hpp"
 #include "conclog/include/logging.hpp"
 
 using namespace ConcLog;
 
 namespace Opera {
 
+namespace {
+
+MetricsCounter& state_messages_received(const char* kind) {
+    return MetricsRegistry::instance().counter("opera_state_messages_received_total","Number of state messages received for acquisition",std::string("kind=\"")+kind+"\"");
+}
+
+MetricsHistogram& history_size(const char* kind) {
+    return MetricsRegistry::instance().histogram("opera_history_size","Size of the history of a body after acquiring a state",
+                                                 MetricsRegistry::size_bounds(),std::string("kind=\"")+kind+"\"");
+}
+
+}
+
+IngestionShard::IngestionShard(std::string const& name) :
+    _num_unfinished(0),
+    _stop(false),
+    _thr([this]{
+        while (true) {
+            VoidFunction task;
+            {
+                std::unique_lock<std::mutex> lock(_mux);
+                _availability_condition.wait(lock, [this] { return _stop or not _tasks.empty(); });
+                if (_stop) return;
+                task = _tasks.front();
+                _tasks.pop();
+            }
+            task();
+            std::lock_guard<std::mutex> lock(_mux);
+            --_num_unfinished;
+        }
+    },name) { }
+
+void IngestionShard::enqueue(VoidFunction const& task) {
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        _tasks.push(task);
+        ++_num_unfinished;
+    }
+    _availability_condition.notify_one();
+}
+
+SizeType IngestionShard::num_pending() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    return _tasks.size();
+}
+
+SizeType IngestionShard::num_unfinished() const {
+    std::lock_guard<std::mutex> lock(_mux);
+    return _num_unfinished;
+}
+
+IngestionShard::~IngestionShard() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(_mux);
+        _stop = true;
+    }
+    _availability_condition.notify_one();
+}
+
 RuntimeReceiver::RuntimeReceiver(Pair<BrokerAccess,BodyPresentationTopic> const& bp_subscriber, Pair<BrokerAccess,HumanStateTopic> const& hs_subscriber, Pair<BrokerAccess,RobotStateTopic> const& rs_subscriber,
                                  LookAheadJobFactory const& factory, TimestampType const& history_retention, TimestampType  const& history_purge_period,
-                                 BodyRegistry& registry, SynchronisedQueue<LookAheadJob>& waiting_jobs, SynchronisedQueue<LookAheadJob>& sleeping_jobs) :
+                                 BodyRegistry& registry, SynchronisedQueue<LookAheadJob>& waiting_jobs, SynchronisedQueue<LookAheadJob>& sleeping_jobs,
+                                 SizeType const& num_ingestion_shards) :
     _factory(factory), _history_retention(history_retention), _history_purge_period(history_purge_period),
-    _bp_subscriber(bp_subscriber.first.make_body_presentation_subscriber([&](auto const& msg){
-        if (not registry.contains(msg.id())) {
+    _registry(registry), _waiting_jobs(waiting_jobs), _sleeping_jobs(sleeping_jobs),
+    _effects_requested(false), _effects_timestamp(0), _stop(false),
+    _human_messages_received(state_messages_received("human")), _robot_messages_received(state_messages_received("robot")),
+    _human_history_size(history_size("human")), _robot_history_size(history_size("robot")),
+    _awakening_seconds(MetricsRegistry::instance().histogram("opera_job_awakening_seconds","Time to awaken a sleeping job",MetricsRegistry::duration_bounds())),
+    _shards([num_ingestion_shards]{
+        OPERA_PRECONDITION(num_ingestion_shards > 0)
+        List<SharedPointer<IngestionShard>> result;
+        for (SizeType i=0; i<num_ingestion_shards; ++i)
+            result.push_back(std::make_shared<IngestionShard>("rt_in" + std::to_string(i)));
+        return result;
+    }()),
+    _bp_subscriber(bp_subscriber.first.make_body_presentation_subscriber([this](auto const& msg){
+        std::unique_lock<std::shared_mutex> lock(_ingestion_mux);
+        if (not _registry.contains(msg.id())) {
             CONCLOG_PRINTLN_AT(2,"Registering body " << msg.id())
-            if (msg.is_human()) for (auto const& rid : registry.robot_ids()) _pending_human_robot_pairs.push_back({msg.id(), rid});
-            else for (auto const& hid : registry.human_ids()) _pending_human_robot_pairs.push_back({msg.id(), hid});
-            registry.insert(msg);
+            {
+                std::lock_guard<std::mutex> pairs_lock(_pairs_mux);
+                if (msg.is_human()) for (auto const& rid : _registry.robot_ids()) _pending_human_robot_pairs.push_back({msg.id(), rid});
+                else for (auto const& hid : _registry.human_ids()) _pending_human_robot_pairs.push_back({hid, msg.id()});
+            }
+            _registry.insert(msg);
         }
     },bp_subscriber.second)),
-    _hs_subscriber(hs_subscriber.first.make_human_state_subscriber([&](auto const& msg){
-        std::lock_guard<std::mutex> lock(_state_received_mux);
-        for (auto const& bd : msg.bodies()) {
-            auto const& hid = bd.first;
-            if (registry.contains(hid)) {
-                CONCLOG_PRINTLN_AT(2,"Received human state for " << hid << " from message at " << msg.timestamp())
-            } else {
-                CONCLOG_PRINTLN_AT(2,"Received human state for unknown " << hid << " from message at " << msg.timestamp() << ", registering it using the default human")
-                for (auto const& rid : registry.robot_ids()) _pending_human_robot_pairs.push_back({hid, rid});
-                auto pr = Deserialiser<BodyPresentationMessage>(Resources::path("json/default_human.json")).make();
-                registry.insert_human(hid,pr.segment_pairs(),pr.thicknesses());
+    _hs_subscriber(hs_subscriber.first.make_human_state_subscriber([this](auto const& msg){
+        {
+            std::lock_guard<std::mutex> lock(_reception_times_mux);
+            _human_state_reception_times[msg.timestamp()] = std::chrono::steady_clock::now();
+            if (_human_state_reception_times.size() > HUMAN_STATE_RECEPTION_TIMES_CAPACITY)
+                _human_state_reception_times.erase(_human_state_reception_times.begin());
+        }
+        _register_unknown_humans(msg);
+        {
+            std::lock_guard<std::mutex> lock(_latest_human_timestamps_mux);
+            for (SizeType b=0; b<msg.num_bodies(); ++b) {
+                auto& latest = _latest_human_timestamps[msg.body_id(b)];
+                latest = std::max(latest,msg.timestamp());
             }
         }
-        registry.acquire_state(msg);
-        _remove_old_history(registry,msg);
-        _remove_unresponding_humans(msg.timestamp(),registry,sleeping_jobs);
-        _move_sleeping_jobs_to_waiting_jobs(registry, sleeping_jobs, waiting_jobs);
-        _promote_pairs_to_jobs(registry, sleeping_jobs, waiting_jobs);
+        auto const shared_msg = std::make_shared<HumanStateMessage const>(msg);
+        for (SizeType b=0; b<msg.num_bodies(); ++b)
+            _shard_for(msg.body_id(b)).enqueue([this,shared_msg,b]{ _acquire_human_state(*shared_msg,b); });
         ++_num_state_messages_received;
-    },hs_subscriber.second)),
-    _rs_subscriber(rs_subscriber.first.make_robot_state_subscriber([&](auto const& msg){
-        std::lock_guard<std::mutex> lock(_state_received_mux);
-        if (registry.contains(msg.id())) {
-            CONCLOG_PRINTLN_AT(2,"Received robot state for " << msg.id() << " from message at " << msg.timestamp())
-            registry.acquire_state(msg);
-            _remove_old_history(registry,msg);
-            _remove_unresponding_humans(msg.timestamp(),registry,sleeping_jobs);
-            _move_sleeping_jobs_to_waiting_jobs(registry, sleeping_jobs, waiting_jobs);
-            _promote_pairs_to_jobs(registry, sleeping_jobs, waiting_jobs);
-        } else {
-            CONCLOG_PRINTLN_AT(2,"Discarded robot state message for " << msg.id() << " since the body is not registered")
-        }
+        _human_messages_received.add();
+    },hs_subscriber.second,[this](MessageHeader const& header){ return _accepts_human_state(header); })),
+    _rs_subscriber(rs_subscriber.first.make_robot_state_subscriber([this](auto const& msg){
+        _shard_for(msg.id()).enqueue([this,msg]{ _acquire_robot_state(msg); });
         ++_num_state_messages_received;
-    },rs_subscriber.second))
+        _robot_messages_received.add();
+    },rs_subscriber.second,[this](MessageHeader const& header){ return _accepts_robot_state(header); })),
+    _effects_thr([this]{
+        while (true) {
+            TimestampType latest_msg_timestamp;
+            {
+                std::unique_lock<std::mutex> lock(_effects_mux);
+                _effects_condition.wait(lock, [this] { return _stop or _effects_requested; });
+                if (_stop) return;
+                _effects_requested = false;
+                latest_msg_timestamp = _effects_timestamp;
+            }
+            _apply_job_effects(latest_msg_timestamp);
+        }
+    },"rt_fx")
 {
+    auto& metrics = MetricsRegistry::instance();
+    _gauges.push_back(metrics.add_gauge("opera_pending_human_robot_pairs","Number of human-robot pairs not yet promoted to jobs",[this]{
+        return static_cast<FloatType>(num_pending_human_robot_pairs()); }));
+    _gauges.push_back(metrics.add_gauge("opera_ingestion_pending_tasks","Number of acquisitions not yet started by the ingestion shards",[this]{
+        SizeType result = 0;
+        for (auto const& shard : _shards) result += shard->num_pending();
+        return static_cast<FloatType>(result); }));
+    _gauges.push_back(metrics.add_gauge("opera_registered_bodies","Number of bodies in the registry",[this]{
+        std::shared_lock<std::shared_mutex> lock(_ingestion_mux);
+        return static_cast<FloatType>(_registry.num_humans()); },"kind=\"human\""));
+    _gauges.push_back(metrics.add_gauge("opera_registered_bodies","Number of bodies in the registry",[this]{
+        std::shared_lock<std::shared_mutex> lock(_ingestion_mux);
+        return static_cast<FloatType>(_registry.num_robots()); },"kind=\"robot\""));
+    _gauges.push_back(metrics.add_gauge("opera_segment_pairs","Number of human-robot segment pairs given the registered bodies",[this]{
+        std::shared_lock<std::shared_mutex> lock(_ingestion_mux);
+        return static_cast<FloatType>(_registry.num_segment_pairs()); }));
 }
 
 RuntimeReceiver::~RuntimeReceiver() noexcept {
+    for (auto const& gauge : _gauges) MetricsRegistry::instance().remove_gauge(gauge);
     delete _bp_subscriber;
     delete _hs_subscriber;
     delete _rs_subscriber;
+    _shards.clear();
+    {
+        std::lock_guard<std::mutex> lock(_effects_mux);
+        _stop = true;
+    }
+    _effects_condition.notify_one();
 }
 
 SizeType RuntimeReceiver::num_pending_human_robot_pairs() const {
@@ -98,61 +203,205 @@ TimestampType RuntimeReceiver::oldest_history_time() const {
     return _oldest_history_time;
 }
 
-void RuntimeReceiver::_remove_old_history(BodyRegistry& registry, HumanStateMessage const& msg) {
-    for (auto const& bd : msg.bodies()) {
-        auto& history = registry.human_history(bd.first);
-        if (msg.timestamp() - history.earliest_time() > 1000*(_history_retention+_history_purge_period)) {
-            history.remove_older_than(msg.timestamp()-_history_retention*1000);
-            _oldest_history_time = history.earliest_time();
+SizeType RuntimeReceiver::num_ingestion_shards() const {
+    return _shards.size();
+}
+
+bool RuntimeReceiver::ingestion_drained() const {
+    for (auto const& shard : _shards)
+        if (shard->num_unfinished() > 0) return false;
+    return true;
+}
+
+std::optional<std::chrono::steady_clock::time_point> RuntimeReceiver::human_state_reception_time(TimestampType const& timestamp) const {
+    std::lock_guard<std::mutex> lock(_reception_times_mux);
+    auto it = _human_state_reception_times.find(timestamp);
+    if (it == _human_state_reception_times.end()) return std::nullopt;
+    return it->second;
+}
+
+SizeType RuntimeReceiver::ingestion_shard_index(BodyIdType const& id) const {
+    return std::hash<BodyIdType>{}(id) % _shards.size();
+}
+
+IngestionShard& RuntimeReceiver::_shard_for(BodyIdType const& id) {
+    return *_shards.at(ingestion_shard_index(id));
+}
+
+bool RuntimeReceiver::_accepts_human_state(MessageHeader const& header) const {
+    std::lock_guard<std::mutex> lock(_latest_human_timestamps_mux);
+    for (auto const& hid : header.body_ids) {
+        auto it = _latest_human_timestamps.find(hid);
+        if (it == _latest_human_timestamps.end() or header.timestamp > it->second) return true;
+    }
+    CONCLOG_PRINTLN_AT(2,"Skipped human state message at " << header.timestamp << " since no human has a later state")
+    return false;
+}
+
+bool RuntimeReceiver::_accepts_robot_state(MessageHeader const& header) const {
+    for (auto const& rid : header.body_ids)
+        if (_registry.contains(rid)) return true;
+    CONCLOG_PRINTLN_AT(2,"Skipped robot state message at " << header.timestamp << " since the body is not registered")
+    return false;
+}
+
+void RuntimeReceiver::_register_unknown_humans(HumanStateMessage const& msg) {
+    {
+        std::shared_lock<std::shared_mutex> lock(_ingestion_mux);
+        bool all_known = true;
+        for (SizeType b=0; b<msg.num_bodies(); ++b)
+            if (not _registry.contains(msg.body_id(b))) { all_known = false; break; }
+        if (all_known) return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(_ingestion_mux);
+    for (SizeType b=0; b<msg.num_bodies(); ++b) {
+        auto const& hid = msg.body_id(b);
+        if (not _registry.contains(hid)) {
+            CONCLOG_PRINTLN_AT(2,"Received human state for unknown " << hid << " from message at " << msg.timestamp() << ", registering it using the default human")
+            {
+                std::lock_guard<std::mutex> pairs_lock(_pairs_mux);
+                for (auto const& rid : _registry.robot_ids()) _pending_human_robot_pairs.push_back({hid, rid});
+            }
+            auto pr = Deserialiser<BodyPresentationMessage>(Resources::path("json/default_human.json")).make();
+            _registry.insert_human(hid,pr.segment_pairs(),pr.thicknesses());
         }
     }
 }
 
-void RuntimeReceiver::_remove_old_history(BodyRegistry& registry, RobotStateMessage const& msg) {
-    auto& history = registry.robot_history(msg.id());
-    if (msg.timestamp() - history.earliest_time() > 1000*(_history_retention+_history_purge_period)) {
-        history.remove_older_than(msg.timestamp()-_history_retention*1000);
-        _oldest_history_time = history.earliest_time();
+void RuntimeReceiver::_acquire_human_state(HumanStateMessage const& msg, SizeType const& body) {
+    auto const& timestamp = msg.timestamp();
+    {
+        std::shared_lock<std::shared_mutex> lock(_ingestion_mux);
+        auto const& hid = msg.body_id(body);
+        if (not _registry.contains(hid)) {
+            CONCLOG_PRINTLN_AT(2,"Discarded human state for " << hid << " from message at " << timestamp << " since the body has been removed")
+            return;
+        }
+        CONCLOG_PRINTLN_AT(2,"Received human state for " << hid << " from message at " << timestamp)
+        _registry.acquire_state(msg,body);
+        _remove_old_human_history(hid,timestamp);
+        _human_history_size.observe(static_cast<FloatType>(_registry.human_history_size(hid)));
     }
+    _request_job_effects(timestamp);
 }
 
-void RuntimeReceiver::_promote_pairs_to_jobs(BodyRegistry const& registry, SynchronisedQueue<LookAheadJob>& sleeping_jobs, SynchronisedQueue<LookAheadJob>& waiting_jobs) {
-    List<HumanRobotIdPair> new_pairs;
+void RuntimeReceiver::_acquire_robot_state(RobotStateMessage const& msg) {
+    {
+        std::shared_lock<std::shared_mutex> lock(_ingestion_mux);
+        if (not _registry.contains(msg.id())) {
+            CONCLOG_PRINTLN_AT(2,"Discarded robot state message for " << msg.id() << " since the body is not registered")
+            return;
+        }
+        CONCLOG_PRINTLN_AT(2,"Received robot state for " << msg.id() << " from message at " << msg.timestamp())
+        _registry.acquire_state(msg);
+        _remove_old_robot_history(msg.id(),msg.timestamp());
+        _robot_history_size.observe(static_cast<FloatType>(_registry.robot_history(msg.id())->size()));
+    }
+    _request_job_effects(msg.timestamp());
+}
+
+void RuntimeReceiver::_request_job_effects(TimestampType const& timestamp) {
+    {
+        std::lock_guard<std::mutex> lock(_effects_mux);
+        _effects_requested = true;
+        if (timestamp > _effects_timestamp) _effects_timestamp = timestamp;
+    }
+    _effects_condition.notify_one();
+}
+
+void RuntimeReceiver::_apply_job_effects(TimestampType const& latest_msg_timestamp) {
+    List<SleepingJobState> sleeping_jobs;
+    List<PendingPairState> pairs;
+    {
+        // Histories are read only here, so that awakening and promotion do not stall acquisitions
+        std::unique_lock<std::shared_mutex> lock(_ingestion_mux);
+        _remove_unresponding_humans(latest_msg_timestamp);
+        sleeping_jobs = _take_sleeping_jobs();
+        pairs = _pending_pair_states();
+    }
+    _move_sleeping_jobs_to_waiting_jobs(sleeping_jobs);
+    _promote_pairs_to_jobs(pairs);
+}
+
+void RuntimeReceiver::_remove_old_human_history(BodyIdType const& id, TimestampType const& timestamp) {
+    auto history = _registry.human_history(id);
+    if (timestamp - history->earliest_time() > 1000*(_history_retention+_history_purge_period)) {
+        history->remove_older_than(timestamp-_history_retention*1000);
+        _oldest_history_time = history->earliest_time();
+    }
+}
+
+void RuntimeReceiver::_remove_old_robot_history(BodyIdType const& id, TimestampType const& timestamp) {
+    auto history = _registry.robot_history(id);
+    if (timestamp - history->earliest_time() > 1000*(_history_retention+_history_purge_period)) {
+        history->remove_older_than(timestamp-_history_retention*1000);
+        _oldest_history_time = history->earliest_time();
+    }
+}
+
+List<RuntimeReceiver::PendingPairState> RuntimeReceiver::_pending_pair_states() const {
+    List<PendingPairState> result;
     std::lock_guard<std::mutex> lock(_pairs_mux);
     for (auto const& p : _pending_human_robot_pairs) {
-        auto const& robot_latest_time = registry.robot_history(p.robot).latest_time();
-        if (registry.has_human_instances_within(p.human, robot_latest_time)) {
-            auto human_latest_instance = registry.latest_human_instance_within(p.human, robot_latest_time);
-            auto const& timestamp = human_latest_instance.timestamp();
-            auto robot_history_snapshot = registry.robot_history(p.robot).snapshot_at(timestamp);
-            if (robot_history_snapshot.can_look_ahead(timestamp)) {
-                auto const& human = registry.human(p.human);
-                auto const& robot = registry.robot(p.robot);
-                auto const& mode = registry.robot_history(p.robot).mode_at(timestamp);
-                for (SizeType i=0; i<human.num_segments(); ++i)
-                    for (SizeType j=0; j<robot.num_segments(); ++j) {
-                        auto job = _factory.create_new_job({human.id(), human.segment(i).index(), robot.id(),
-                                                            robot.segment(j).index()}, timestamp, human_latest_instance.samples().at(
-                                human.segment(i).index()), ModeTrace().push_back(mode), LookAheadJobPath());
-                        if (job.human_sample().is_empty()) sleeping_jobs.enqueue(job);
-                        else waiting_jobs.enqueue(job);
+        auto robot_history = _registry.robot_history(p.robot);
+        auto const robot_latest_time = robot_history->latest_time();
+        auto human_instance = (_registry.has_human_instances_within(p.human, robot_latest_time) ?
+                _registry.latest_human_instance_within(p.human, robot_latest_time) : SharedPointer<HumanStateInstance const>());
+        result.push_back({p, _registry.human(p.human), _registry.robot(p.robot), robot_history, human_instance});
+    }
+    return result;
+}
+
+void RuntimeReceiver::_promote_pairs_to_jobs(List<PendingPairState> const& pairs) {
+    List<HumanRobotIdPair> promoted_pairs;
+    for (auto const& p : pairs) {
+        if (p.human_instance == nullptr) continue;
+        auto const& timestamp = p.human_instance->timestamp();
+        auto robot_history_snapshot = p.robot_history->snapshot_at(timestamp);
+        if (robot_history_snapshot.can_look_ahead(timestamp)) {
+            auto const& human = p.human;
+            auto const& robot = p.robot;
+            auto const mode = p.robot_history->mode_at(timestamp);
+            for (SizeType i=0; i<human->num_segments(); ++i)
+                for (SizeType j=0; j<robot->num_segments(); ++j) {
+                    auto job = _factory.create_new_job({human->id(), human->segment(i).index(), robot->id(),
+                                                        robot->segment(j).index()}, timestamp, p.human_instance->samples().at(
+                            human->segment(i).index()), ModeTrace().push_back(mode), LookAheadJobPath());
+                    JobTracer::instance().record(JobEvent::CREATED,job);
+                    job.pin_snapshot_time(p.robot_history);
+                    if (job.human_sample().is_empty()) {
+                        JobTracer::instance().record(JobEvent::SLEPT,job);
+                        _sleeping_jobs.enqueue(job);
+                    } else {
+                        JobTracer::instance().record(JobEvent::ENQUEUED,job);
+                        _waiting_jobs.enqueue(job);
                     }
-                CONCLOG_PRINTLN("Human-robot pair {" << human.id() << "," << robot.id() << "} inserted as " << human.num_segments()*robot.num_segments() << " new jobs at " << timestamp)
-            } else new_pairs.emplace_back(p);
-        } else new_pairs.emplace_back(p);
+                }
+            CONCLOG_PRINTLN("Human-robot pair {" << human->id() << "," << robot->id() << "} inserted as " << human->num_segments()*robot->num_segments() << " new jobs at " << timestamp)
+            promoted_pairs.push_back(p.pair);
+        }
+    }
+    if (promoted_pairs.empty()) return;
+    std::lock_guard<std::mutex> lock(_pairs_mux);
+    List<HumanRobotIdPair> new_pairs;
+    for (auto const& p : _pending_human_robot_pairs) {
+        auto is_promoted = [&p](HumanRobotIdPair const& other){ return other.human == p.human and other.robot == p.robot; };
+        if (std::find_if(promoted_pairs.cbegin(),promoted_pairs.cend(),is_promoted) == promoted_pairs.cend())
+            new_pairs.emplace_back(p);
     }
     _pending_human_robot_pairs = new_pairs;
 }
 
-void RuntimeReceiver::_remove_unresponding_humans(TimestampType const& latest_msg_timestamp, BodyRegistry& registry, SynchronisedQueue<LookAheadJob>& sleeping_jobs) {
+void RuntimeReceiver::_remove_unresponding_humans(TimestampType const& latest_msg_timestamp) {
 
-    auto hids = registry.human_ids();
+    auto hids = _registry.human_ids();
     List<BodyIdType> hids_to_remove;
     for (auto const& hid : hids) {
-        if (registry.human_history_size(hid) > 0) {
-            const TimestampType latest_human_timestamp = registry.latest_human_timestamp(hid);
+        if (_registry.human_history_size(hid) > 0) {
+            const TimestampType latest_human_timestamp = _registry.latest_human_timestamp(hid);
             if (latest_msg_timestamp > latest_human_timestamp and (latest_msg_timestamp - latest_human_timestamp) > HUMAN_RETENTION_TIMEOUT) {
-                registry.remove(hid);
+                _registry.remove(hid);
                 CONCLOG_PRINTLN("Removed human " << hid << " due to no state messages received in the last " << HUMAN_RETENTION_TIMEOUT << " ms")
                 hids_to_remove.push_back(hid);
             }
@@ -160,6 +409,10 @@ void RuntimeReceiver::_remove_unresponding_humans(TimestampType const& latest_ms
     }
 
     if (not hids_to_remove.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(_latest_human_timestamps_mux);
+            for (auto const& hid : hids_to_remove) _latest_human_timestamps.erase(hid);
+        }
         {
             std::lock_guard<std::mutex> lock(_pairs_mux);
             List<HumanRobotIdPair> new_pending_human_robot_pairs;
@@ -171,38 +424,49 @@ void RuntimeReceiver::_remove_unresponding_humans(TimestampType const& latest_ms
         }
 
         List<LookAheadJob> new_jobs;
-        while (sleeping_jobs.size() > 0) {
-            sleeping_jobs.reserve();
-            auto job = sleeping_jobs.dequeue();
+        while (_sleeping_jobs.size() > 0) {
+            _sleeping_jobs.reserve();
+            auto job = _sleeping_jobs.dequeue();
             if (find(hids_to_remove.cbegin(),hids_to_remove.cend(),job.id().human()) == hids_to_remove.cend())
                 new_jobs.emplace_back(job);
         }
-        for (auto const& job : new_jobs) sleeping_jobs.enqueue(job);
+        for (auto const& job : new_jobs) _sleeping_jobs.enqueue(job);
+    }
+}
+
+List<RuntimeReceiver::SleepingJobState> RuntimeReceiver::_take_sleeping_jobs() {
+    List<SleepingJobState> result;
+    while(_sleeping_jobs.size() > 0) {
+        _sleeping_jobs.reserve();
+        auto job = _sleeping_jobs.dequeue();
+        auto robot_history = _registry.robot_history(job.id().robot());
+        auto human_instance = _registry.latest_human_instance_within(job.id().human(),robot_history->latest_time());
+        auto instance_distance = _registry.instance_distance(job.id().human(),job.initial_time(),human_instance->timestamp());
+        result.push_back({job,robot_history,human_instance,instance_distance});
     }
+    return result;
 }
 
-void RuntimeReceiver::_move_sleeping_jobs_to_waiting_jobs(BodyRegistry const& registry, SynchronisedQueue<LookAheadJob>& sleeping_jobs, SynchronisedQueue<LookAheadJob>& waiting_jobs) {
+void RuntimeReceiver::_move_sleeping_jobs_to_waiting_jobs(List<SleepingJobState> const& jobs) {
     List<LookAheadJob> jobs_to_keep, jobs_to_move;
-    while(sleeping_jobs.size() > 0) {
-        sleeping_jobs.reserve();
-        auto job = sleeping_jobs.dequeue();
-        auto const& robot_history = registry.robot_history(job.id().robot());
-        auto robot_latest_time = robot_history.latest_time();
-        auto human_latest_instance = registry.latest_human_instance_within(job.id().human(),robot_latest_time);
-        auto const& timestamp = human_latest_instance.timestamp();
-        auto instance_distance = registry.instance_distance(job.id().human(),job.initial_time(),timestamp);
-        auto robot_history_snapshot = robot_history.snapshot_at(job.snapshot_time());
-        if (instance_distance > 0 and robot_history_snapshot.can_look_ahead(timestamp)) {
-            auto woken = _factory.awaken(job, timestamp, human_latest_instance.samples().at(job.id().human_segment()),
-                                         robot_history);
+    for (auto const& s : jobs) {
+        auto const& job = s.job;
+        auto const& timestamp = s.human_instance->timestamp();
+        auto robot_history_snapshot = s.robot_history->snapshot_at(job.snapshot_time());
+        if (s.instance_distance > 0 and robot_history_snapshot.can_look_ahead(timestamp)) {
+            MetricsTimer timer(_awakening_seconds);
+            auto woken = _factory.awaken(job, timestamp, s.human_instance->samples().at(job.id().human_segment()),
+                                         *s.robot_history);
+            JobTracer::instance().record(JobEvent::AWAKENED,job,woken.size());
             for (auto const& wj : woken) {
+                wj.first.pin_snapshot_time(s.robot_history);
                 if (wj.second == JobAwakeningResult::DIFFERENT) { jobs_to_move.emplace_back(wj.first); }
-                else { jobs_to_keep.emplace_back(wj.first); }
+                else { JobTracer::instance().record(JobEvent::SLEPT,wj.first); jobs_to_keep.emplace_back(wj.first); }
             }
         } else { jobs_to_keep.emplace_back(job); }
     }
-    for (auto const& job : jobs_to_keep) { sleeping_jobs.enqueue(std::move(job)); }
-    for (auto const& job : jobs_to_move) { waiting_jobs.enqueue(std::move(job)); }
+    for (auto const& job : jobs_to_keep) { _sleeping_jobs.enqueue(std::move(job)); }
+    for (auto const& job : jobs_to_move) { JobTracer::instance().record(JobEvent::ENQUEUED,job); _waiting_jobs.enqueue(std::move(job)); }
 }
 
 RuntimeSender::RuntimeSender(Pair<BrokerAccess,CollisionNotificationTopic> const& publisher) :
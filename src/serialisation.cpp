@@ -33,163 +33,168 @@ namespace Opera {
 
 using namespace rapidjson;
 
-Document Serialiser<BodyPresentationMessage>::to_document() const {
-
-    Document document;
-    document.SetObject();
-    Document::AllocatorType& allocator = document.GetAllocator();
-
-    Value id;
-    id.SetString(obj.id().c_str(),static_cast<rapidjson::SizeType>(obj.id().length()));
-    document.AddMember("id",id,allocator);
-    document.AddMember("isHuman",Value().SetBool(obj.is_human()),allocator);
-    if (not obj.is_human()) document.AddMember("messageFrequency",Value().SetUint64(obj.message_frequency()),allocator);
-
-    Value thicknesses;
-    Value segment_pairs;
-    thicknesses.SetArray();
-    segment_pairs.SetArray();
-    for (SizeType i=0; i<obj.segment_pairs().size(); ++i) {
-        thicknesses.PushBack(Value().SetDouble(obj.thicknesses()[i]),allocator);
-        Value pair;
-        pair.SetArray();
-        pair.PushBack(Value().SetString(obj.segment_pairs()[i].first.c_str(),static_cast<rapidjson::SizeType>(obj.segment_pairs()[i].first.length())),allocator);
-        pair.PushBack(Value().SetString(obj.segment_pairs()[i].second.c_str(),static_cast<rapidjson::SizeType>(obj.segment_pairs()[i].second.length())),allocator);
-        segment_pairs.PushBack(pair,allocator);
-    }
-    document.AddMember("segmentPairs",segment_pairs,allocator);
-    document.AddMember("thicknesses",thicknesses,allocator);
+namespace {
 
-    return document;
+void write_string(SerialisationBuffer::WriterType& writer, String const& str) {
+    writer.String(str.c_str(),static_cast<rapidjson::SizeType>(str.length()));
 }
 
-Document Serialiser<HumanStateMessage>::to_document() const {
-
-    Document document;
-    document.SetObject();
-    Document::AllocatorType& allocator = document.GetAllocator();
-
-    Value bodies;
-    bodies.SetArray();
-    for (auto const& bd : obj.bodies()) {
-        Value entry;
-        entry.SetObject();
-
-        Value id;
-        id.SetString(bd.first.c_str(),static_cast<rapidjson::SizeType>(bd.first.length()));
-        entry.AddMember("body_id",id,allocator);
-
-        Value keypoints;
-        keypoints.SetObject();
-        for (auto const& keypoint_samples : bd.second) {
-            Value samples_array;
-            samples_array.SetArray();
-            for (auto const& point : keypoint_samples.second) {
-                Value coordinates;
-                coordinates.SetObject();
-                coordinates.AddMember(Value().SetString("x",static_cast<rapidjson::SizeType>(1),allocator),Value().SetDouble(point.x),allocator);
-                coordinates.AddMember(Value().SetString("y",static_cast<rapidjson::SizeType>(1),allocator),Value().SetDouble(point.y),allocator);
-                coordinates.AddMember(Value().SetString("z",static_cast<rapidjson::SizeType>(1),allocator),Value().SetDouble(point.z),allocator);
-                samples_array.PushBack(coordinates,allocator);
-            }
-            keypoints.AddMember(Value().SetString(keypoint_samples.first.c_str(),static_cast<rapidjson::SizeType>(keypoint_samples.first.length()),allocator),samples_array,allocator);
-        }
-        entry.AddMember("keypoints",keypoints,allocator);
-        bodies.PushBack(entry, allocator);
+void write_segment(SerialisationBuffer::WriterType& writer, Pair<KeypointIdType,KeypointIdType> const& segment) {
+    writer.StartArray();
+    write_string(writer,segment.first);
+    write_string(writer,segment.second);
+    writer.EndArray();
+}
+
+void write_mode(SerialisationBuffer::WriterType& writer, Mode const& mode) {
+    writer.StartObject();
+    for (auto const& v : mode.values()) {
+        writer.Key(v.first.c_str(),static_cast<rapidjson::SizeType>(v.first.length()));
+        write_string(writer,v.second);
     }
+    writer.EndObject();
+}
 
-    document.AddMember("bodies", bodies, allocator);
-    document.AddMember("timestamp",Value().SetUint64(obj.timestamp()),allocator);
+StringBuffer& thread_serialisation_buffer() {
+    thread_local StringBuffer buffer;
+    return buffer;
+}
 
-    return document;
+SerialisationBuffer::WriterType& thread_serialisation_writer() {
+    thread_local SerialisationBuffer::WriterType writer;
+    return writer;
 }
 
-Document Serialiser<RobotStateMessage>::to_document() const {
+}
 
-    Document document;
-    document.SetObject();
-    Document::AllocatorType& allocator = document.GetAllocator();
+SerialisationBuffer::SerialisationBuffer() : _buffer(thread_serialisation_buffer()), _writer(thread_serialisation_writer()) {
+    _buffer.Clear();
+    _writer.Reset(_buffer);
+}
+
+auto SerialisationBuffer::writer() -> WriterType& {
+    return _writer;
+}
 
-    Value id;
-    id.SetString(obj.id().c_str(),static_cast<rapidjson::SizeType>(obj.id().length()));
-    document.AddMember("bodyId",id,allocator);
+std::string_view SerialisationBuffer::view() const {
+    return std::string_view(_buffer.GetString(),_buffer.GetSize());
+}
 
-    Value mode;
-    mode.SetObject();
-    for (auto const& v : obj.mode().values()) {
-        mode.AddMember(Value().SetString(v.first.c_str(),static_cast<rapidjson::SizeType>(v.first.length()),allocator),
-                                Value().SetString(v.second.c_str(),static_cast<rapidjson::SizeType>(v.second.length()), allocator),allocator);
+void Serialiser<BodyPresentationMessage>::write(SerialisationBuffer::WriterType& writer) const {
+    writer.StartObject();
+    writer.Key("id");
+    write_string(writer,obj.id());
+    writer.Key("isHuman");
+    writer.Bool(obj.is_human());
+    if (not obj.is_human()) {
+        writer.Key("messageFrequency");
+        writer.Uint64(obj.message_frequency());
     }
-    document.AddMember("mode",mode,allocator);
-
-    Value continuous_state;
-    continuous_state.SetArray();
-    for (auto const& samples : obj.points()) {
-        Value samples_array;
-        samples_array.SetArray();
-        for (auto const& point : samples) {
-            Value coordinates;
-            coordinates.SetArray();
-            coordinates.PushBack(Value().SetDouble(point.x),allocator)
-            .PushBack(Value().SetDouble(point.y),allocator)
-            .PushBack(Value().SetDouble(point.z),allocator);
-            samples_array.PushBack(coordinates,allocator);
+    writer.Key("segmentPairs");
+    writer.StartArray();
+    for (auto const& segment : obj.segment_pairs())
+        write_segment(writer,segment);
+    writer.EndArray();
+    writer.Key("thicknesses");
+    writer.StartArray();
+    for (auto const& thickness : obj.thicknesses())
+        writer.Double(thickness);
+    writer.EndArray();
+    writer.EndObject();
+}
+
+void Serialiser<HumanStateMessage>::write(SerialisationBuffer::WriterType& writer) const {
+    writer.StartObject();
+    writer.Key("bodies");
+    writer.StartArray();
+    for (SizeType b=0; b<obj.num_bodies(); ++b) {
+        writer.StartObject();
+        writer.Key("body_id");
+        write_string(writer,obj.body_id(b));
+        writer.Key("keypoints");
+        writer.StartObject();
+        auto const& keypoint_ids = obj.keypoint_ids(b);
+        for (SizeType k=0; k<keypoint_ids.size(); ++k) {
+            writer.Key(keypoint_ids.at(k).c_str(),static_cast<rapidjson::SizeType>(keypoint_ids.at(k).length()));
+            writer.StartArray();
+            for (auto const& point : obj.samples(b,k)) {
+                writer.StartObject();
+                writer.Key("x");
+                writer.Double(point.x);
+                writer.Key("y");
+                writer.Double(point.y);
+                writer.Key("z");
+                writer.Double(point.z);
+                writer.EndObject();
+            }
+            writer.EndArray();
         }
-        continuous_state.PushBack(samples_array,allocator);
+        writer.EndObject();
+        writer.EndObject();
     }
-    document.AddMember("continuousState",continuous_state,allocator);
-    document.AddMember("timestamp",Value().SetUint64(obj.timestamp()),allocator);
-
-    return document;
+    writer.EndArray();
+    writer.Key("timestamp");
+    writer.Uint64(obj.timestamp());
+    writer.EndObject();
 }
 
-Document Serialiser<CollisionNotificationMessage>::to_document() const {
-
-    Document document;
-    document.SetObject();
-    Document::AllocatorType& allocator = document.GetAllocator();
-
-    Value human;
-    human.SetObject();
-    human.AddMember("bodyId",Value().SetString(obj.human_id().c_str(),static_cast<rapidjson::SizeType>(obj.human_id().length()),allocator),allocator);
-    Value human_segment_id;
-    human_segment_id.SetArray();
-    human_segment_id.PushBack(Value().SetString(obj.human_segment().first.c_str(), static_cast<rapidjson::SizeType>(obj.human_segment().first.length()), allocator), allocator);
-    human_segment_id.PushBack(Value().SetString(obj.human_segment().second.c_str(), static_cast<rapidjson::SizeType>(obj.human_segment().second.length()), allocator), allocator);
-    human.AddMember("segment",human_segment_id,allocator);
-    document.AddMember("human",human,allocator);
-
-    Value robot;
-    robot.SetObject();
-    robot.AddMember("bodyId",Value().SetString(obj.robot_id().c_str(),static_cast<rapidjson::SizeType>(obj.robot_id().length()),allocator),allocator);
-    Value robot_segment_id;
-    robot_segment_id.SetArray();
-    robot_segment_id.PushBack(Value().SetString(obj.robot_segment().first.c_str(), static_cast<rapidjson::SizeType>(obj.robot_segment().first.length()), allocator), allocator);
-    robot_segment_id.PushBack(Value().SetString(obj.robot_segment().second.c_str(), static_cast<rapidjson::SizeType>(obj.robot_segment().second.length()), allocator), allocator);
-    robot.AddMember("segment",robot_segment_id,allocator);
-    document.AddMember("robot",robot,allocator);
-
-    document.AddMember("currentTime", Value().SetUint64(obj.current_time()), allocator);
-
-    Value collision_distance;
-    collision_distance.SetObject();
-    collision_distance.AddMember("lower", Value().SetUint64(obj.collision_distance().lower()), allocator);
-    collision_distance.AddMember("upper", Value().SetUint64(obj.collision_distance().upper()), allocator);
-    document.AddMember("collisionDistance", collision_distance, allocator);
-
-    if (not obj.collision_mode().is_empty()) {
-        Value collisionMode;
-        collisionMode.SetObject();
-        for (auto const& v : obj.collision_mode().values()) {
-            collisionMode.AddMember(Value().SetString(v.first.c_str(), static_cast<rapidjson::SizeType>(v.first.length()), allocator),
-                                    Value().SetString(v.second.c_str(),static_cast<rapidjson::SizeType>(v.second.length()), allocator), allocator);
+void Serialiser<RobotStateMessage>::write(SerialisationBuffer::WriterType& writer) const {
+    writer.StartObject();
+    writer.Key("bodyId");
+    write_string(writer,obj.id());
+    writer.Key("mode");
+    write_mode(writer,obj.mode());
+    writer.Key("continuousState");
+    writer.StartArray();
+    for (SizeType i=0; i<obj.num_points(); ++i) {
+        writer.StartArray();
+        for (auto const& point : obj.samples(i)) {
+            writer.StartArray();
+            writer.Double(point.x);
+            writer.Double(point.y);
+            writer.Double(point.z);
+            writer.EndArray();
         }
-        document.AddMember("collisionMode", collisionMode, allocator);
+        writer.EndArray();
     }
+    writer.EndArray();
+    writer.Key("timestamp");
+    writer.Uint64(obj.timestamp());
+    writer.EndObject();
+}
 
-    document.AddMember("likelihood",Value().SetDouble(obj.likelihood()),allocator);
-
-    return document;
+void Serialiser<CollisionNotificationMessage>::write(SerialisationBuffer::WriterType& writer) const {
+    writer.StartObject();
+    writer.Key("human");
+    writer.StartObject();
+    writer.Key("bodyId");
+    write_string(writer,obj.human_id());
+    writer.Key("segment");
+    write_segment(writer,obj.human_segment());
+    writer.EndObject();
+    writer.Key("robot");
+    writer.StartObject();
+    writer.Key("bodyId");
+    write_string(writer,obj.robot_id());
+    writer.Key("segment");
+    write_segment(writer,obj.robot_segment());
+    writer.EndObject();
+    writer.Key("currentTime");
+    writer.Uint64(obj.current_time());
+    writer.Key("collisionDistance");
+    writer.StartObject();
+    writer.Key("lower");
+    writer.Uint64(obj.collision_distance().lower());
+    writer.Key("upper");
+    writer.Uint64(obj.collision_distance().upper());
+    writer.EndObject();
+    if (not obj.collision_mode().is_empty()) {
+        writer.Key("collisionMode");
+        write_mode(writer,obj.collision_mode());
+    }
+    writer.Key("likelihood");
+    writer.Double(obj.likelihood());
+    writer.EndObject();
 }
 
 }
@@ -0,0 +1,275 @@
+/***************************************************************************
+ *            shm.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <cstring>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "shm.hpp"
+
+namespace Opera {
+
+namespace {
+
+//! \brief The value identifying an initialised ring
+constexpr uint32_t SHM_RING_MAGIC = 0x4f505231;
+
+template<class V> std::atomic_ref<V> atomic(V& value) { return std::atomic_ref<V>(value); }
+
+SizeType slot_stride_for(SizeType const& slot_size) {
+    SizeType const alignment = alignof(uint64_t);
+    return (2*sizeof(uint64_t) + slot_size + alignment - 1) / alignment * alignment;
+}
+
+}
+
+ShmRing::ShmRing(std::string const& name, SizeType const& capacity, SizeType const& slot_size) :
+    _name(name), _mapped_size(sizeof(ShmRingHeader) + capacity*slot_stride_for(slot_size)), _header(nullptr), _slots(nullptr), _slot_stride(slot_stride_for(slot_size))
+{
+    OPERA_PRECONDITION(capacity > 0)
+    OPERA_PRECONDITION(slot_size > 0)
+    static_assert(std::atomic_ref<uint64_t>::is_always_lock_free and std::atomic_ref<uint32_t>::is_always_lock_free);
+
+    bool created = true;
+    int fd = shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd < 0 and errno == EEXIST) {
+        created = false;
+        fd = shm_open(_name.c_str(), O_RDWR, 0660);
+    }
+    OPERA_ASSERT_MSG(fd >= 0, "Could not open shared memory '" << _name << "': " << std::strerror(errno))
+
+    if (created) {
+        if (ftruncate(fd, static_cast<off_t>(_mapped_size)) != 0) {
+            close(fd);
+            shm_unlink(_name.c_str());
+            OPERA_THROW_RTE("Could not size shared memory '" << _name << "': " << std::strerror(errno))
+        }
+    } else {
+        struct stat st;
+        for (SizeType i=0; i<1000; ++i) {
+            if (fstat(fd, &st) == 0 and st.st_size > 0) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        if (static_cast<SizeType>(st.st_size) != _mapped_size) {
+            close(fd);
+            OPERA_THROW_RTE("Shared memory '" << _name << "' has a size of " << st.st_size << " bytes instead of " << _mapped_size <<
+                            ", remove it or use the same capacity and slot size")
+        }
+    }
+
+    void* address = mmap(nullptr, _mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    OPERA_ASSERT_MSG(address != MAP_FAILED, "Could not map shared memory '" << _name << "': " << std::strerror(errno))
+    _header = static_cast<ShmRingHeader*>(address);
+    _slots = static_cast<char*>(address) + sizeof(ShmRingHeader);
+
+    if (created) {
+        _header->capacity = capacity;
+        _header->slot_size = slot_size;
+        atomic(_header->magic).store(SHM_RING_MAGIC, std::memory_order_release);
+    } else {
+        for (SizeType i=0; i<1000 and atomic(_header->magic).load(std::memory_order_acquire) != SHM_RING_MAGIC; ++i)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        OPERA_ASSERT_MSG(atomic(_header->magic).load(std::memory_order_acquire) == SHM_RING_MAGIC, "Shared memory '" << _name << "' has not been initialised")
+        OPERA_ASSERT_MSG(_header->capacity == capacity and _header->slot_size == slot_size,
+                         "Shared memory '" << _name << "' has a different capacity or slot size, remove it or use the same values")
+    }
+}
+
+std::string const& ShmRing::name() const {
+    return _name;
+}
+
+SizeType ShmRing::end() const {
+    return atomic(_header->reserved_sequence).load(std::memory_order_acquire);
+}
+
+uint64_t& ShmRing::_slot_sequence(SizeType const& sequence) const {
+    return *reinterpret_cast<uint64_t*>(_slots + (sequence % _header->capacity)*_slot_stride);
+}
+
+uint64_t& ShmRing::_slot_payload_size(SizeType const& sequence) const {
+    return *reinterpret_cast<uint64_t*>(_slots + (sequence % _header->capacity)*_slot_stride + sizeof(uint64_t));
+}
+
+char* ShmRing::_slot_payload(SizeType const& sequence) const {
+    return _slots + (sequence % _header->capacity)*_slot_stride + 2*sizeof(uint64_t);
+}
+
+void ShmRing::put(std::string_view const& payload) {
+    OPERA_ASSERT_MSG(payload.size() <= _header->slot_size, "Payload of " << payload.size() << " bytes exceeds the slot size of " << _header->slot_size << " bytes")
+    auto sequence = atomic(_header->reserved_sequence).fetch_add(1, std::memory_order_acq_rel);
+    // An odd value marks the slot as being written, an even value as holding the message with sequence (value-2)/2:
+    // the slot is claimed only once the writer of an older message has finished, while a newer claim supersedes this message.
+    // A claim not completed within SHM_STALE_CLAIM_TIMEOUT_US is considered left by a dead publisher and is taken over
+    uint64_t const claimed = 2*sequence+1;
+    auto current = atomic(_slot_sequence(sequence)).load(std::memory_order_acquire);
+    auto const stale_deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(SHM_STALE_CLAIM_TIMEOUT_US);
+    while (true) {
+        if (current > claimed) return;
+        if (current % 2 == 1 and std::chrono::steady_clock::now() < stale_deadline) {
+            std::this_thread::yield();
+            current = atomic(_slot_sequence(sequence)).load(std::memory_order_acquire);
+            continue;
+        }
+        if (atomic(_slot_sequence(sequence)).compare_exchange_weak(current, claimed, std::memory_order_acq_rel, std::memory_order_acquire)) break;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    atomic(_slot_payload_size(sequence)).store(payload.size(), std::memory_order_relaxed);
+    std::memcpy(_slot_payload(sequence), payload.data(), payload.size());
+    // Publishing fails if the claim has been taken over in the meantime, so that the slot never goes back to an older message
+    uint64_t expected = claimed;
+    if (not atomic(_slot_sequence(sequence)).compare_exchange_strong(expected, 2*sequence+2, std::memory_order_release, std::memory_order_relaxed)) return;
+    // Sequentially consistent with the registration of a waiter in _wait, so that either the publisher sees the waiter
+    // or the waiter sees the new futex word
+    atomic(_header->futex_word).fetch_add(1, std::memory_order_seq_cst);
+    if (atomic(_header->num_waiters).load(std::memory_order_seq_cst) > 0) wake();
+}
+
+bool ShmRing::take(SizeType& cursor, String& payload, SizeType& num_skipped, SizeType const& timeout_us) {
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    while (true) {
+        auto futex_value = atomic(_header->futex_word).load(std::memory_order_acquire);
+        auto slot_value = atomic(_slot_sequence(cursor)).load(std::memory_order_acquire);
+        if (slot_value == 2*cursor+2) {
+            auto size = atomic(_slot_payload_size(cursor)).load(std::memory_order_relaxed);
+            if (size <= _header->slot_size) {
+                payload.assign(_slot_payload(cursor), size);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (atomic(_slot_sequence(cursor)).load(std::memory_order_relaxed) == slot_value) {
+                    ++cursor;
+                    return true;
+                }
+            }
+        }
+        auto reserved = end();
+        if (slot_value > 2*cursor+2 or reserved > cursor + _header->capacity) {
+            auto oldest = reserved - _header->capacity;
+            if (oldest > cursor) {
+                num_skipped += oldest - cursor;
+                cursor = oldest;
+                continue;
+            }
+        }
+        auto const now = std::chrono::steady_clock::now();
+        if (now >= deadline) return false;
+        if (slot_value == 2*cursor+1) {
+            std::this_thread::yield();
+            continue;
+        }
+        _wait(futex_value, static_cast<SizeType>(std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count()));
+        if (atomic(_header->futex_word).load(std::memory_order_acquire) == futex_value) return false;
+    }
+}
+
+void ShmRing::_wait(uint32_t value, SizeType const& timeout_us) {
+    atomic(_header->num_waiters).fetch_add(1, std::memory_order_seq_cst);
+#if defined(__linux__)
+    struct timespec timeout;
+    timeout.tv_sec = static_cast<time_t>(timeout_us / 1000000);
+    timeout.tv_nsec = static_cast<long>((timeout_us % 1000000) * 1000);
+    syscall(SYS_futex, &_header->futex_word, FUTEX_WAIT, value, &timeout, nullptr, 0);
+#else
+    if (atomic(_header->futex_word).load(std::memory_order_acquire) == value)
+        std::this_thread::sleep_for(std::chrono::microseconds(std::min<SizeType>(timeout_us,100)));
+#endif
+    atomic(_header->num_waiters).fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void ShmRing::wake() {
+#if defined(__linux__)
+    syscall(SYS_futex, &_header->futex_word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+void ShmRing::remove(std::string const& name) {
+    shm_unlink(name.c_str());
+}
+
+ShmRing::~ShmRing() {
+    munmap(_header, _mapped_size);
+}
+
+ShmBrokerAccess::ShmBrokerAccess(std::string const& prefix, SizeType const& capacity, SizeType const& slot_size, MessageEncoding const& encoding) :
+    _prefix(prefix), _capacity(capacity), _slot_size(slot_size), _encoding(encoding) {
+    OPERA_PRECONDITION(capacity > 0)
+    OPERA_PRECONDITION(slot_size > 0)
+}
+
+std::string ShmBrokerAccess::ring_name(std::string const& topic) const {
+    std::string result = "/" + _prefix + "_" + topic;
+    std::replace(result.begin()+1, result.end(), '/', '_');
+    return result;
+}
+
+SharedPointer<ShmRing> ShmBrokerAccess::_ring(std::string const& topic) const {
+    return std::make_shared<ShmRing>(ring_name(topic), _capacity, _slot_size);
+}
+
+PublisherInterface<BodyPresentationMessage>* ShmBrokerAccess::make_body_presentation_publisher(BodyPresentationTopic const& topic) const {
+    return new ShmPublisher<BodyPresentationMessage>(_ring(topic), _encoding);
+}
+
+PublisherInterface<HumanStateMessage>* ShmBrokerAccess::make_human_state_publisher(HumanStateTopic const& topic) const {
+    return new ShmPublisher<HumanStateMessage>(_ring(topic), _encoding);
+}
+
+PublisherInterface<RobotStateMessage>* ShmBrokerAccess::make_robot_state_publisher(RobotStateTopic const& topic) const {
+    return new ShmPublisher<RobotStateMessage>(_ring(topic), _encoding);
+}
+
+PublisherInterface<CollisionNotificationMessage>* ShmBrokerAccess::make_collision_notification_publisher(CollisionNotificationTopic const& topic) const {
+    return new ShmPublisher<CollisionNotificationMessage>(_ring(topic), _encoding);
+}
+
+SubscriberInterface<BodyPresentationMessage>* ShmBrokerAccess::make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const& callback, BodyPresentationTopic const& topic) const {
+    return new ShmSubscriber<BodyPresentationMessage>(_ring(topic), callback, _encoding);
+}
+
+SubscriberInterface<HumanStateMessage>* ShmBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const& topic, MessageFilter const& filter) const {
+    return new ShmSubscriber<HumanStateMessage>(_ring(topic), callback, _encoding, make_payload_filter<HumanStateMessage>(filter,_encoding));
+}
+
+SubscriberInterface<RobotStateMessage>* ShmBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const& callback, RobotStateTopic const& topic, MessageFilter const& filter) const {
+    return new ShmSubscriber<RobotStateMessage>(_ring(topic), callback, _encoding, make_payload_filter<RobotStateMessage>(filter,_encoding));
+}
+
+SubscriberInterface<CollisionNotificationMessage>* ShmBrokerAccess::make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const& callback, CollisionNotificationTopic const& topic) const {
+    return new ShmSubscriber<CollisionNotificationMessage>(_ring(topic), callback, _encoding);
+}
+
+}
@@ -27,6 +27,9 @@
  */
 
 #include <cmath>
+#include <algorithm>
+#include <charconv>
+#include <thread>
 #include "macros.hpp"
 #include "state.hpp"
 #include "conclog/include/logging.hpp"
@@ -49,6 +52,21 @@ HumanStateInstance::HumanStateInstance(Human const& human, Map<KeypointIdType,Li
     }
 }
 
+HumanStateInstance::HumanStateInstance(Human const& human, HumanStateMessage const& message, SizeType const& body, List<Pair<SizeType,SizeType>> const& segment_keypoints) :
+        _timestamp(message.timestamp()) {
+    OPERA_PRECONDITION(segment_keypoints.size() == human.num_segments())
+    auto const num_keypoints = message.keypoint_ids(body).size();
+    _samples.reserve(human.num_segments());
+    for (SizeType i=0; i<human.num_segments(); ++i) {
+        auto const& keypoints = segment_keypoints.at(i);
+        auto head_pts = (keypoints.first < num_keypoints ? message.samples(body,keypoints.first) : std::span<Point const>());
+        auto tail_pts = (keypoints.second < num_keypoints ? message.samples(body,keypoints.second) : std::span<Point const>());
+        BodySegmentSample sample = human.segment(i).create_sample();
+        sample.update(head_pts,tail_pts);
+        _samples.push_back(sample);
+    }
+}
+
 List<BodySegmentSample> const& HumanStateInstance::samples() const {
     return _samples;
 }
@@ -60,28 +78,43 @@ TimestampType const& HumanStateInstance::timestamp() const {
 HumanStateHistory::HumanStateHistory(Human const& human) : _human(human) { }
 
 void HumanStateHistory::acquire(Map<KeypointIdType,List<Point>> const& points, TimestampType const& timestamp) {
-    _instances.push_back({_human,points,timestamp});
+    _instances.push_back(std::make_shared<HumanStateInstance const>(_human,points,timestamp));
+}
+
+void HumanStateHistory::acquire(HumanStateMessage const& message, SizeType const& body) {
+    auto const& keypoint_ids = message.shared_keypoint_ids(body);
+    if (keypoint_ids != _resolved_keypoint_ids and (_resolved_keypoint_ids == nullptr or *keypoint_ids != *_resolved_keypoint_ids)) {
+        auto const& ids = *keypoint_ids;
+        auto index_of = [&ids](KeypointIdType const& id) {
+            return static_cast<SizeType>(std::find(ids.begin(),ids.end(),id) - ids.begin());
+        };
+        _segment_keypoints.clear();
+        for (SizeType i=0; i<_human.num_segments(); ++i)
+            _segment_keypoints.emplace_back(index_of(_human.segment(i).head_id()),index_of(_human.segment(i).tail_id()));
+    }
+    _resolved_keypoint_ids = keypoint_ids;
+    _instances.push_back(std::make_shared<HumanStateInstance const>(_human,message,body,_segment_keypoints));
 }
 
-HumanStateInstance const& HumanStateHistory::latest_within(TimestampType const& timestamp) const {
+SharedPointer<HumanStateInstance const> HumanStateHistory::latest_within(TimestampType const& timestamp) const {
     OPERA_PRECONDITION(not _instances.empty())
     for (auto it = _instances.crbegin(); it != _instances.crend(); ++it)
-        if (it->timestamp() <= timestamp) return *it;
+        if ((*it)->timestamp() <= timestamp) return *it;
     OPERA_FAIL_MSG("No human instance could be found for timestamp " << timestamp)
 }
 
 TimestampType const& HumanStateHistory::latest_time() const {
     OPERA_PRECONDITION(not _instances.empty())
-    return _instances.back().timestamp();
+    return _instances.back()->timestamp();
 }
 
 TimestampType const& HumanStateHistory::earliest_time() const {
     OPERA_PRECONDITION(not _instances.empty())
-    return _instances.front().timestamp();
+    return _instances.front()->timestamp();
 }
 
 bool HumanStateHistory::has_instances_within(TimestampType const& timestamp) const {
-    for (auto const& instance : _instances) if (instance.timestamp() <= timestamp) return true;
+    for (auto const& instance : _instances) if (instance->timestamp() <= timestamp) return true;
     return false;
 }
 
@@ -90,22 +123,22 @@ SizeType HumanStateHistory::instance_distance(TimestampType const& lower, Timest
     OPERA_PRECONDITION(lower <= upper)
     auto upper_it = _instances.crbegin();
     for (; upper_it != _instances.crend(); ++upper_it)
-        if (upper_it->timestamp() == upper) break;
+        if ((*upper_it)->timestamp() == upper) break;
     OPERA_ASSERT_MSG(upper_it != _instances.crend(), "Upper timestamp " << upper << " not found in the human instances.")
     auto lower_it = upper_it;
     for (; lower_it != _instances.crend(); ++lower_it)
-        if (lower_it->timestamp() == lower) break;
+        if ((*lower_it)->timestamp() == lower) break;
     OPERA_ASSERT_MSG(lower_it != _instances.crend(), "Lower timestamp " << lower << " not found in the human instances.")
     return static_cast<SizeType>(lower_it - upper_it);
 }
 
 SizeType HumanStateHistory::instance_number(TimestampType const& timestamp) const {
     for (auto it = _instances.crbegin(); it != _instances.crend(); ++it)
-        if (it->timestamp() == timestamp) return _instances.size()-1-static_cast<SizeType>(it-_instances.crbegin());
+        if ((*it)->timestamp() == timestamp) return _instances.size()-1-static_cast<SizeType>(it-_instances.crbegin());
     OPERA_FAIL_MSG("No instance found with timestamp " << timestamp)
 }
 
-HumanStateInstance const& HumanStateHistory::at(SizeType const& idx) const {
+SharedPointer<HumanStateInstance const> HumanStateHistory::at(SizeType const& idx) const {
     return _instances.at(idx);
 }
 
@@ -149,7 +182,7 @@ auto SamplesHistory::at(TimestampType const& timestamp) const -> BodySamplesType
         if (_entries.at(i).first > timestamp) break;
     }
     OPERA_ASSERT_MSG(i>0,"No samples history found at " << timestamp)
-    return _entries.at(i-1).second;
+    return *_entries.at(i-1).second;
 }
 
 bool SamplesHistory::has_samples_at(TimestampType const& timestamp) const {
@@ -160,64 +193,268 @@ bool SamplesHistory::has_samples_at(TimestampType const& timestamp) const {
 }
 
 void SamplesHistory::append(TimestampType const& timestamp, BodySamplesType const& samples) {
-    _entries.emplace_back(timestamp,samples);
+    _entries.emplace_back(timestamp,std::make_shared<BodySamplesType const>(samples));
 }
 
 SizeType SamplesHistory::size_at(TimestampType const& timestamp) const {
     return at(timestamp).at(0).size();
 }
 
-RobotStateHistory::RobotStateHistory(Robot const& robot) :
-    _latest_time(0), _current_mode_states_buffer(List<List<BodySegmentSample>>()), _mode_traces(), _robot(robot) {
-    for (SizeType i=0; i < _robot.num_segments(); ++i)
+SizeType SamplesHistory::num_entries() const {
+    return _entries.size();
+}
+
+bool SamplesHistory::has_superseded_entries(TimestampType const& timestamp) const {
+    return _entries.size() > 1 and _entries.at(1).first <= timestamp;
+}
+
+void SamplesHistory::remove_superseded_entries(TimestampType const& timestamp) {
+    while (_entries.size() > 1 and _entries.at(1).first <= timestamp) _entries.pop_front();
+}
+
+SnapshotTimePins::SnapshotTimePins() {
+    for (auto& slot : _slots) slot.store(std::numeric_limits<TimestampType>::max(),std::memory_order_relaxed);
+    for (auto& count : _counts) count.store(0,std::memory_order_relaxed);
+}
+
+bool SnapshotTimePins::_try_join(SizeType const& slot, TimestampType const& timestamp) {
+    if (_slots[slot].load(std::memory_order_acquire) != timestamp) return false;
+    auto count = _counts[slot].load(std::memory_order_acquire);
+    while (count > 0) {
+        if (_counts[slot].compare_exchange_weak(count,count+1,std::memory_order_acq_rel,std::memory_order_acquire)) {
+            // The slot may have been freed and claimed for another timestamp in the meantime
+            if (_slots[slot].load(std::memory_order_acquire) == timestamp) return true;
+            _leave(slot);
+            return false;
+        }
+    }
+    return false;
+}
+
+void SnapshotTimePins::_leave(SizeType const& slot) {
+    if (_counts[slot].fetch_sub(1,std::memory_order_acq_rel) == 1)
+        _slots[slot].store(std::numeric_limits<TimestampType>::max(),std::memory_order_release);
+}
+
+SizeType SnapshotTimePins::pin(TimestampType const& timestamp) {
+    OPERA_PRECONDITION(timestamp != std::numeric_limits<TimestampType>::max())
+    auto const start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % NUM_SNAPSHOT_TIME_PIN_SLOTS;
+    for (SizeType i=0; i<NUM_SNAPSHOT_TIME_PIN_SLOTS; ++i) {
+        auto const slot = (start+i) % NUM_SNAPSHOT_TIME_PIN_SLOTS;
+        if (_try_join(slot,timestamp)) return slot;
+    }
+    for (SizeType i=0; i<NUM_SNAPSHOT_TIME_PIN_SLOTS; ++i) {
+        auto const slot = (start+i) % NUM_SNAPSHOT_TIME_PIN_SLOTS;
+        TimestampType expected = std::numeric_limits<TimestampType>::max();
+        if (_slots[slot].compare_exchange_strong(expected,timestamp,std::memory_order_acq_rel)) {
+            _counts[slot].store(1,std::memory_order_release);
+            return slot;
+        }
+    }
+    std::lock_guard<std::mutex> lock(_overflow_mux);
+    ++_overflow[timestamp];
+    return NUM_SNAPSHOT_TIME_PIN_SLOTS;
+}
+
+void SnapshotTimePins::unpin(SizeType const& slot, TimestampType const& timestamp) {
+    if (slot < NUM_SNAPSHOT_TIME_PIN_SLOTS) {
+        _leave(slot);
+    } else {
+        std::lock_guard<std::mutex> lock(_overflow_mux);
+        auto it = _overflow.find(timestamp);
+        OPERA_ASSERT_MSG(it != _overflow.end(),"Snapshot time " << timestamp << " is not pinned.")
+        if (--it->second == 0) _overflow.erase(it);
+    }
+}
+
+TimestampType SnapshotTimePins::oldest() const {
+    TimestampType result = std::numeric_limits<TimestampType>::max();
+    for (auto const& slot : _slots)
+        result = std::min(result,slot.load(std::memory_order_acquire));
+    std::lock_guard<std::mutex> lock(_overflow_mux);
+    if (not _overflow.empty()) result = std::min(result,_overflow.begin()->first);
+    return result;
+}
+
+SnapshotTimePin::SnapshotTimePin() :
+    _pins(nullptr), _timestamp(0), _slot(NUM_SNAPSHOT_TIME_PIN_SLOTS) { }
+
+SnapshotTimePin::SnapshotTimePin(SnapshotTimePins& pins, TimestampType const& timestamp) :
+    _pins(&pins), _timestamp(timestamp), _slot(pins.pin(timestamp)) { }
+
+SnapshotTimePin::SnapshotTimePin(SnapshotTimePin const& other) :
+    _pins(other._pins), _timestamp(other._timestamp), _slot(other._pins != nullptr ? other._pins->pin(other._timestamp) : NUM_SNAPSHOT_TIME_PIN_SLOTS) { }
+
+SnapshotTimePin::SnapshotTimePin(SnapshotTimePin&& other) noexcept :
+    _pins(other._pins), _timestamp(other._timestamp), _slot(other._slot) {
+    other._pins = nullptr;
+}
+
+SnapshotTimePin& SnapshotTimePin::operator=(SnapshotTimePin const& other) {
+    if (this != &other) {
+        _release();
+        if (other._pins != nullptr) _slot = other._pins->pin(other._timestamp);
+        _pins = other._pins;
+        _timestamp = other._timestamp;
+    }
+    return *this;
+}
+
+SnapshotTimePin& SnapshotTimePin::operator=(SnapshotTimePin&& other) noexcept {
+    if (this != &other) {
+        _release();
+        _pins = other._pins;
+        _timestamp = other._timestamp;
+        _slot = other._slot;
+        other._pins = nullptr;
+    }
+    return *this;
+}
+
+SnapshotTimePin::~SnapshotTimePin() {
+    _release();
+}
+
+bool SnapshotTimePin::is_pinned() const {
+    return _pins != nullptr;
+}
+
+void SnapshotTimePin::_release() {
+    if (_pins != nullptr) {
+        _pins->unpin(_slot,_timestamp);
+        _pins = nullptr;
+    }
+}
+
+Mode const& RobotStateHistory::Version::mode_at(TimestampType const& time) const {
+    for (auto const& p : *mode_presences)
+        if (p.from() <= time and time < p.to())
+            return p.mode();
+    return latest_mode;
+}
+
+RobotStateHistory::RobotStateHistory(Robot const& robot) : _robot(robot) {
+    auto point_of = [](KeypointIdType const& id) {
+        SizeType result = 0;
+        auto const end = id.data()+id.size();
+        auto const [ptr, ec] = std::from_chars(id.data(),end,result);
+        OPERA_ASSERT_MSG(ec == std::errc() and ptr == end,"Robot keypoint id '" << id << "' is not a point index.")
+        return result;
+    };
+    for (SizeType i=0; i < _robot.num_segments(); ++i) {
         _current_mode_states_buffer.push_back(List<BodySegmentSample>());
-    _mode_traces.emplace_back(0,ModeTrace());
+        _segment_points.emplace_back(point_of(_robot.segment(i).head_id()),point_of(_robot.segment(i).tail_id()));
+    }
+    auto mode_traces = std::make_shared<ModeTracesType>();
+    mode_traces->emplace_back(0,ModeTrace());
+    auto version = std::make_shared<Version>();
+    version->mode_presences = std::make_shared<ModePresencesType const>();
+    version->mode_states = std::make_shared<ModeSamplesHistoryType const>();
+    version->mode_traces = mode_traces;
+    version->latest_time = 0;
+    _version = version;
+}
+
+SharedPointer<RobotStateHistory::Version const> RobotStateHistory::_current() const {
+    std::lock_guard<std::mutex> lock(_version_mux);
+    return _version;
 }
 
-TimestampType const& RobotStateHistory::latest_time() const {
-    return _latest_time;
+void RobotStateHistory::_publish(SharedPointer<Version const> const& version) {
+    auto previous = version;
+    {
+        std::lock_guard<std::mutex> lock(_version_mux);
+        std::swap(_version,previous);
+    }
 }
 
-TimestampType const& RobotStateHistory::earliest_time() const {
-    OPERA_PRECONDITION(not _mode_presences.empty())
-    return _mode_presences.front().from();
+TimestampType RobotStateHistory::latest_time() const {
+    return _current()->latest_time;
+}
+
+TimestampType RobotStateHistory::earliest_time() const {
+    auto version = _current();
+    OPERA_PRECONDITION(not version->mode_presences->empty())
+    return version->mode_presences->front().from();
 }
 
 void RobotStateHistory::remove_older_than(TimestampType const& timestamp) {
     OPERA_PRECONDITION(timestamp > 0)
-    while (not _mode_presences.empty() and _mode_presences.front().to() < timestamp) {
-        _mode_presences.pop_front();
-    }
-    while (not _mode_traces.empty() and _mode_traces.front().first < timestamp) {
-        _mode_traces.pop_front();
+    std::lock_guard<std::mutex> lock(_writing_mux);
+    auto current = _current();
+    auto mode_presences = std::make_shared<ModePresencesType>(*current->mode_presences);
+    while (not mode_presences->empty() and mode_presences->front().to() < timestamp) {
+        mode_presences->pop_front();
     }
+    auto const& current_traces = *current->mode_traces;
+    SizeType first_trace = 0;
+    while (first_trace+1 < current_traces.size() and current_traces.at(first_trace).first < timestamp) ++first_trace;
+    auto mode_traces = std::make_shared<ModeTracesType>();
     SizeType desired_size = 1;
-    SizeType current_size = _mode_traces.front().second.size();
-    for (auto& t : _mode_traces) {
+    SizeType current_size = current_traces.at(first_trace).second.size();
+    for (SizeType i=first_trace; i<current_traces.size(); ++i) {
+        auto t = current_traces.at(i);
         if (t.second.size() > current_size) {
             current_size = t.second.size();
             ++desired_size;
         }
         t.second.reduce_between(current_size-desired_size,current_size-1);
+        mode_traces->push_back(t);
     }
+    auto version = std::make_shared<Version>(*current);
+    version->mode_presences = mode_presences;
+    version->mode_traces = mode_traces;
+
+    auto const reclaim_time = std::min(timestamp,_snapshot_pins.oldest());
+    SharedPointer<ModeSamplesHistoryType> mode_states;
+    for (auto const& ms : *current->mode_states) {
+        if (ms.second->has_superseded_entries(reclaim_time)) {
+            if (mode_states == nullptr) mode_states = std::make_shared<ModeSamplesHistoryType>(*current->mode_states);
+            auto samples_history = std::make_shared<SamplesHistory>(*ms.second);
+            samples_history->remove_superseded_entries(reclaim_time);
+            (*mode_states)[ms.first] = samples_history;
+        }
+    }
+    if (mode_states != nullptr) version->mode_states = mode_states;
+
+    _publish(version);
+}
+
+TimestampType RobotStateHistory::oldest_pinned_snapshot_time() const {
+    return _snapshot_pins.oldest();
 }
 
 SizeType RobotStateHistory::size() const {
-    return _mode_presences.size();
+    return _current()->mode_presences->size();
 }
 
-Mode const& RobotStateHistory::latest_mode() const {
-    return _latest_mode;
+SizeType RobotStateHistory::__num_samples_entries(Mode const& mode) const {
+    auto version = _current();
+    if (not version->mode_states->has_key(mode)) return 0;
+    return version->mode_states->at(mode)->num_entries();
 }
 
-Mode const& RobotStateHistory::mode_at(TimestampType const& time) const {
-    for (auto const& p : _mode_presences)
-        if (p.from() <= time and time < p.to())
-            return p.mode();
-    return _latest_mode;
+Mode RobotStateHistory::latest_mode() const {
+    return _current()->latest_mode;
+}
+
+Mode RobotStateHistory::mode_at(TimestampType const& time) const {
+    return _current()->mode_at(time);
 }
 
 void RobotStateHistory::acquire(Mode const& mode, Map<KeypointIdType,List<Point>> const& points, TimestampType const& timestamp) {
+    _acquire(mode, points.size(), [&](SizeType const& i) {
+        return std::make_pair(std::span<Point const>(points.at(_robot.segment(i).head_id())),std::span<Point const>(points.at(_robot.segment(i).tail_id())));
+    }, timestamp);
+}
+
+void RobotStateHistory::acquire(RobotStateMessage const& message) {
+    _acquire(message.mode(), message.num_points(), [&](SizeType const& i) {
+        return std::make_pair(message.samples(_segment_points.at(i).first),message.samples(_segment_points.at(i).second));
+    }, message.timestamp());
+}
+
+template<class F> void RobotStateHistory::_acquire(Mode const& mode, SizeType const& num_points, F const& segment_points, TimestampType const& timestamp) {
     /*
      * 1) If the mode is different from the current one (including the first mode inserted)
      *   a) Save the buffered content
@@ -227,15 +464,19 @@ void RobotStateHistory::acquire(Mode const& mode, Map<KeypointIdType,List<Point>
      * 3) Check if the mode has a history
      *   a) If not, adding each segment sample to the buffer
      *   b) If it has, identify the index from the timestamp and update the sample on the corresponding entry, adding it to the buffer
+     * 4) Publish the resulting version
      */
-    OPERA_ASSERT(points.size() == _robot.num_points())
+    OPERA_ASSERT(num_points == _robot.num_points())
 
-    auto const& latest_time_snapshot = snapshot_at(timestamp);
+    std::lock_guard<std::mutex> lock(_writing_mux);
+    auto const current = _current();
+    auto version = std::make_shared<Version>(*current);
 
-    if (_latest_mode.is_empty() or _latest_mode != mode) {
-        if (not _latest_mode.is_empty()) {
-            std::lock_guard<std::mutex> lock(_states_mux);
-            auto unrounded_index = latest_time_snapshot.unrounded_sample_index(_latest_mode, timestamp);
+    if (current->latest_mode.is_empty() or current->latest_mode != mode) {
+        auto mode_states = std::make_shared<ModeSamplesHistoryType>(*current->mode_states);
+        if (not current->latest_mode.is_empty()) {
+            RobotStateHistorySnapshot latest_time_snapshot(*this, current, timestamp);
+            auto unrounded_index = latest_time_snapshot.unrounded_sample_index(current->latest_mode, timestamp);
             if (not _current_mode_states_buffer.empty()) {
                 auto last_state_idx = _current_mode_states_buffer.at(0).size() - 1;
                 if (unrounded_index > static_cast<FloatType>(last_state_idx+1)) {
@@ -247,83 +488,95 @@ void RobotStateHistory::acquire(Mode const& mode, Map<KeypointIdType,List<Point>
                     }
                 }
             }
-            _mode_states[_latest_mode].append(timestamp,_current_mode_states_buffer);
-            CONCLOG_PRINTLN_AT(1,"Added snapshot at " << timestamp << " for " << _latest_mode)
+            auto samples_history = (mode_states->has_key(current->latest_mode) ?
+                    std::make_shared<SamplesHistory>(*mode_states->at(current->latest_mode)) : std::make_shared<SamplesHistory>());
+            samples_history->append(timestamp,_current_mode_states_buffer);
+            (*mode_states)[current->latest_mode] = samples_history;
+            CONCLOG_PRINTLN_AT(1,"Added snapshot at " << timestamp << " for " << current->latest_mode)
         }
 
-        if (_mode_states.has_key(mode)) {
-            _current_mode_states_buffer = _mode_states[mode].at(timestamp);
+        if (mode_states->has_key(mode)) {
+            _current_mode_states_buffer = mode_states->at(mode)->at(timestamp);
         } else {
             _current_mode_states_buffer = List<List<BodySegmentSample>>();
             for (SizeType i=0; i < _robot.num_segments(); ++i)
                 _current_mode_states_buffer.push_back(List<BodySegmentSample>());
         }
 
-        TimestampType entrance_timestamp = (_mode_presences.empty() ? timestamp : _mode_presences.back().to());
-        {
-            std::lock_guard<std::mutex> lock(_presences_mux);
-            _mode_presences.emplace_back(RobotModePresence(_latest_mode, mode, entrance_timestamp, timestamp));
-            if (not _latest_mode.is_empty()) {
-                auto trace = _mode_traces.back().second;
-                trace.push_back(_latest_mode,1.0);
-                _mode_traces.emplace_back(timestamp,trace);
-            }
+        auto mode_presences = std::make_shared<ModePresencesType>(*current->mode_presences);
+        TimestampType entrance_timestamp = (mode_presences->empty() ? timestamp : mode_presences->back().to());
+        mode_presences->emplace_back(RobotModePresence(current->latest_mode, mode, entrance_timestamp, timestamp));
+        if (not current->latest_mode.is_empty()) {
+            auto mode_traces = std::make_shared<ModeTracesType>(*current->mode_traces);
+            auto trace = mode_traces->back().second;
+            trace.push_back(current->latest_mode,1.0);
+            mode_traces->emplace_back(timestamp,trace);
+            version->mode_traces = mode_traces;
         }
 
-        _latest_mode = mode;
+        version->mode_presences = mode_presences;
+        version->mode_states = mode_states;
+        version->latest_mode = mode;
     }
-    _latest_time = timestamp;
+    version->latest_time = timestamp;
 
     SizeType update_idx = _current_mode_states_buffer.at(0).size();
     int idx_distance = 1;
-    if (_mode_states.has_key(_latest_mode)) {
-        update_idx = latest_time_snapshot.sample_index(_latest_mode, timestamp);
-        idx_distance = static_cast<int>(floor(update_idx)) - static_cast<int>((_mode_states[_latest_mode].size_at(timestamp)-1));
+    if (version->mode_states->has_key(version->latest_mode)) {
+        RobotStateHistorySnapshot updated_snapshot(*this, version, timestamp);
+        update_idx = updated_snapshot.sample_index(version->latest_mode, timestamp);
+        idx_distance = static_cast<int>(floor(update_idx)) - static_cast<int>((version->mode_states->at(version->latest_mode)->size_at(timestamp)-1));
     }
 
     for (SizeType i=0; i<_robot.num_segments(); ++i) {
-        auto const& head_pts = points.at(_robot.segment(i).head_id());
-        auto const& tail_pts = points.at(_robot.segment(i).tail_id());
+        auto const pts = segment_points(i);
         for (int j=0; j<idx_distance-1; ++j)
             _current_mode_states_buffer.at(i).push_back(_current_mode_states_buffer.at(i).at(_current_mode_states_buffer.at(i).size()-1));
         if (idx_distance > 0) _current_mode_states_buffer.at(i).push_back(_robot.segment(i).create_sample());
-        _current_mode_states_buffer.at(i).at(update_idx).update(head_pts,tail_pts);
+        _current_mode_states_buffer.at(i).at(update_idx).update(pts.first,pts.second);
     }
+
+    _publish(version);
 }
 
 RobotStateHistorySnapshot RobotStateHistory::snapshot_at(TimestampType const& timestamp) const {
     return RobotStateHistorySnapshot(*this,timestamp);
 }
 
+SnapshotTimePin RobotStateHistory::pin_snapshot_time(TimestampType const& timestamp) const {
+    return SnapshotTimePin(_snapshot_pins,timestamp);
+}
+
 RobotStateHistorySnapshot::RobotStateHistorySnapshot(RobotStateHistory const& history, TimestampType const& timestamp) :
-        _history(history), _snapshot_time(timestamp) { }
+        _history(history), _version(history._current()), _snapshot_time(timestamp),
+        _pin(history._snapshot_pins,timestamp) { }
+
+RobotStateHistorySnapshot::RobotStateHistorySnapshot(RobotStateHistory const& history, SharedPointer<RobotStateHistory::Version const> const& version, TimestampType const& timestamp) :
+        _history(history), _version(version), _snapshot_time(timestamp) { }
 
 ModeTrace const& RobotStateHistorySnapshot::mode_trace() const {
-    std::lock_guard<std::mutex> lock(_history._presences_mux);
+    auto const& mode_traces = *_version->mode_traces;
     SizeType i=0;
-    for (; i<_history._mode_traces.size(); ++i) {
-        if (_history._mode_traces.at(i).first > _snapshot_time) break;
+    for (; i<mode_traces.size(); ++i) {
+        if (mode_traces.at(i).first > _snapshot_time) break;
     }
-    return _history._mode_traces.at(i-1).second;
+    return mode_traces.at(i-1).second;
 }
 
 Set<Mode> RobotStateHistorySnapshot::modes_with_samples() const {
     Set<Mode> result;
-    {
-        std::lock_guard<std::mutex> lock(_history._states_mux);
-        for (auto const& m : _history._mode_states)
-            if (m.second.has_samples_at(_snapshot_time)) result.insert(m.first);
-    }
+    for (auto const& m : *_version->mode_states)
+        if (m.second->has_samples_at(_snapshot_time)) result.insert(m.first);
     return result;
 }
 
 bool RobotStateHistorySnapshot::can_look_ahead(TimestampType const& time) const {
-    if (time > _history.latest_time()) return false;
-    auto const& mode = _history.mode_at(time);
-    if (not _history._mode_states.has_key(mode)) return false;
-    if (not _history._mode_states.at(mode).has_samples_at(time)) return false;
+    if (time > _version->latest_time) return false;
+    auto const& mode = _version->mode_at(time);
+    if (not _version->mode_states->has_key(mode)) return false;
+    if (not _version->mode_states->at(mode)->has_samples_at(time)) return false;
     if (unrounded_sample_index(mode, time) >= range_of_num_samples_in(mode).upper()) return false;
-    for (auto const& p : _history._mode_presences) {
+    for (auto const& p : *_version->mode_presences) {
         if (p.from() >= _snapshot_time) break;
         if ((not p.mode().is_empty()) and p.mode() == mode and time > p.to()) return true;
     }
@@ -331,18 +584,16 @@ bool RobotStateHistorySnapshot::can_look_ahead(TimestampType const& time) const
 }
 
 auto RobotStateHistorySnapshot::samples(Mode const& mode) const -> BodySamplesType const& {
-    std::lock_guard<std::mutex> lock(_history._states_mux);
-    return _history._mode_states.at(mode).at(_snapshot_time);
+    return _version->mode_states->at(mode)->at(_snapshot_time);
 }
 
 SizeType RobotStateHistorySnapshot::maximum_number_of_samples(Mode const& mode) const {
-    std::lock_guard<std::mutex> lock(_history._states_mux);
-    return _history._mode_states.at(mode).size_at(_snapshot_time);
+    return _version->mode_states->at(mode)->size_at(_snapshot_time);
 }
 
 List<RobotModePresence> RobotStateHistorySnapshot::presences_in(Mode const& mode) const {
     List<RobotModePresence> result;
-    for (auto const& p : _history._mode_presences)
+    for (auto const& p : *_version->mode_presences)
         if ((not p.mode().is_empty()) and p.mode() == mode and p.to() <= _snapshot_time)
             result.push_back(p);
     return result;
@@ -350,7 +601,7 @@ List<RobotModePresence> RobotStateHistorySnapshot::presences_in(Mode const& mode
 
 List<RobotModePresence> RobotStateHistorySnapshot::presences_between(Mode const& source, Mode const& destination) const {
     List<RobotModePresence> result;
-    for (auto const& p : _history._mode_presences)
+    for (auto const& p : *_version->mode_presences)
         if ((not p.mode().is_empty()) and p.mode() == source and p.exit_destination() == destination and p.to() <= _snapshot_time)
             result.push_back(p);
     return result;
@@ -358,7 +609,7 @@ List<RobotModePresence> RobotStateHistorySnapshot::presences_between(Mode const&
 
 List<RobotModePresence> RobotStateHistorySnapshot::presences_exiting_into(Mode const& mode) const {
     List<RobotModePresence> result;
-    for (auto const& p : _history._mode_presences)
+    for (auto const& p : *_version->mode_presences)
         if (p.exit_destination() == mode and p.to() <= _snapshot_time)
             result.push_back(p);
     return result;
@@ -388,13 +639,14 @@ Interval<SizeType> RobotStateHistorySnapshot::range_of_num_samples_in(Mode const
 
 FloatType RobotStateHistorySnapshot::unrounded_sample_index(Mode const& mode, TimestampType const& timestamp) const {
     TimestampType entry_time = timestamp + 1;
-    auto it = _history._mode_presences.crbegin();
-    if (timestamp >= it->to()) {
-        entry_time = it->to();
+    auto const& mode_presences = *_version->mode_presences;
+    if (timestamp >= mode_presences.back().to()) {
+        entry_time = mode_presences.back().to();
     } else {
-        for (; it != _history._mode_presences.crend() - 1; ++it) {
-            if (it->mode() == mode and it->from() <= timestamp and it->to() > timestamp) {
-                entry_time = it->from();
+        for (SizeType i=mode_presences.size()-1; i>0; --i) {
+            auto const& p = mode_presences.at(i);
+            if (p.mode() == mode and p.from() <= timestamp and p.to() > timestamp) {
+                entry_time = p.from();
                 break;
             }
         }
@@ -0,0 +1,266 @@
+/***************************************************************************
+ *            udp.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+
+#include "udp.hpp"
+#include "conclog/include/logging.hpp"
+
+using namespace ConcLog;
+
+namespace Opera {
+
+namespace {
+
+//! \brief The maximum time waited for a datagram before checking whether the subscriber is stopped
+constexpr SizeType UDP_RECEIVE_TIMEOUT_MS = 100;
+
+//! \brief The size requested for the receive buffer of the socket, to absorb bursts from the trackers
+constexpr SizeType UDP_RECEIVE_BUFFER_SIZE = 4*1024*1024;
+
+//! \brief How long the latest timestamp of a body is kept since the newest timestamp received
+constexpr TimestampType UDP_LATEST_TIMESTAMP_RETENTION_MS = 60000;
+
+//! \brief The minimum number of latest timestamps for which pruning is attempted
+constexpr SizeType UDP_MIN_PRUNING_SIZE = 64;
+
+SizeType checked_batch_size(SizeType const& batch_size) {
+    OPERA_PRECONDITION(batch_size > 0)
+    return batch_size;
+}
+
+struct sockaddr_in resolve(std::string const& address, int port) {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* info = nullptr;
+    int error = getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &info);
+    OPERA_ASSERT_MSG(error == 0 and info != nullptr, "Could not resolve '" << address << "': " << gai_strerror(error))
+    struct sockaddr_in result;
+    std::memcpy(&result, info->ai_addr, sizeof(result));
+    freeaddrinfo(info);
+    return result;
+}
+
+}
+
+UdpSocket::UdpSocket() : _descriptor(socket(AF_INET, SOCK_DGRAM, 0)) {
+    OPERA_ASSERT_MSG(_descriptor >= 0, "Could not open UDP socket: " << std::strerror(errno))
+}
+
+UdpSocket::UdpSocket(std::string const& address, int port, SizeType const& receive_buffer_size, SizeType const& timeout_ms) : UdpSocket() {
+    int enable = 1;
+    setsockopt(_descriptor, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    int buffer_size = static_cast<int>(receive_buffer_size);
+    setsockopt(_descriptor, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    struct timeval timeout;
+    timeout.tv_sec = static_cast<time_t>(timeout_ms / 1000);
+    timeout.tv_usec = static_cast<suseconds_t>((timeout_ms % 1000) * 1000);
+    setsockopt(_descriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    auto endpoint = resolve(address, port);
+    if (bind(_descriptor, reinterpret_cast<struct sockaddr*>(&endpoint), sizeof(endpoint)) != 0) {
+        // The destructor closes the descriptor, since the delegated constructor completed
+        auto error = errno;
+        OPERA_THROW_RTE("Could not bind UDP socket to " << address << ":" << port << ": " << std::strerror(error))
+    }
+}
+
+int UdpSocket::descriptor() const {
+    return _descriptor;
+}
+
+void UdpSocket::shutdown() {
+    ::shutdown(_descriptor, SHUT_RDWR);
+}
+
+UdpSocket::~UdpSocket() {
+    close(_descriptor);
+}
+
+UdpHumanStatePublisher::UdpHumanStatePublisher(std::string const& address, int port, MessageEncoding const& encoding) :
+    _encoding(encoding), _destination(resolve(address, port)) { }
+
+void UdpHumanStatePublisher::put(HumanStateMessage const& obj) {
+    auto payload = encode(obj, _encoding);
+    OPERA_ASSERT_MSG(payload.size() <= UDP_MAX_PAYLOAD_SIZE, "Payload of " << payload.size() << " bytes exceeds the maximum datagram size")
+    sendto(_socket.descriptor(), payload.data(), payload.size(), 0, reinterpret_cast<struct sockaddr const*>(&_destination), sizeof(_destination));
+}
+
+UdpHumanStateSubscriber::UdpHumanStateSubscriber(std::string const& address, int port, CallbackFunction<HumanStateMessage> const& callback, MessageEncoding const& encoding,
+                                                 MessageFilter const& filter, SizeType const& batch_size) :
+    _callback(callback), _encoding(encoding), _filter(filter), _buffers(checked_batch_size(batch_size), List<char>(UDP_MAX_PAYLOAD_SIZE)), _sizes(batch_size),
+    _newest_timestamp(0), _pruned_before(0), _pruning_size(UDP_MIN_PRUNING_SIZE), _num_received(0), _num_stale(0), _num_invalid(0), _stopped(false),
+    _socket(address, port, UDP_RECEIVE_BUFFER_SIZE, UDP_RECEIVE_TIMEOUT_MS), _thr([this]{
+        while (not _stopped) {
+            auto const num_datagrams = _receive_batch();
+            for (SizeType i=0; i<num_datagrams; ++i) {
+                _handle(_buffers.at(i).data(), _sizes.at(i));
+                ++_num_received;
+            }
+        }
+    }, "udp_sub") { }
+
+SizeType UdpHumanStateSubscriber::_receive_batch() {
+    SizeType result = 0;
+#if defined(__linux__)
+    if (_messages.empty()) {
+        _messages.resize(_buffers.size());
+        _vectors.resize(_buffers.size());
+        for (SizeType i=0; i<_buffers.size(); ++i) {
+            _vectors[i].iov_base = _buffers[i].data();
+            _vectors[i].iov_len = _buffers[i].size();
+            std::memset(&_messages[i], 0, sizeof(struct mmsghdr));
+            _messages[i].msg_hdr.msg_iov = &_vectors[i];
+            _messages[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+    // Block for the first datagram only, then take those already queued
+    int num_messages = recvmmsg(_socket.descriptor(), _messages.data(), static_cast<unsigned int>(_messages.size()), MSG_WAITFORONE, nullptr);
+    for (; static_cast<int>(result)<num_messages; ++result)
+        _sizes[result] = _messages[result].msg_len;
+#else
+    for (; result<_buffers.size(); ++result) {
+        auto size = recv(_socket.descriptor(), _buffers[result].data(), _buffers[result].size(), result == 0 ? 0 : MSG_DONTWAIT);
+        if (size < 0) break;
+        _sizes[result] = static_cast<SizeType>(size);
+    }
+#endif
+    return result;
+}
+
+void UdpHumanStateSubscriber::_handle(const char* payload, SizeType const& size) {
+    MessageHeader header;
+    try {
+        header = peek<HumanStateMessage>(payload, size, _encoding);
+    } catch (std::exception&) {
+        ++_num_invalid;
+        return;
+    }
+    bool is_newer = false;
+    for (auto const& id : header.body_ids) {
+        auto latest = _latest_timestamps.find(id);
+        if ((latest == _latest_timestamps.end() and header.timestamp >= _pruned_before) or
+            (latest != _latest_timestamps.end() and latest->second < header.timestamp)) {
+            is_newer = true;
+            break;
+        }
+    }
+    if (not is_newer) { ++_num_stale; return; }
+    if (_filter and not _filter(header)) return;
+    std::optional<HumanStateMessage> message;
+    try {
+        message.emplace(decode<HumanStateMessage>(payload, size, _encoding));
+    } catch (std::exception&) {
+        ++_num_invalid;
+        return;
+    }
+    for (auto const& id : header.body_ids) {
+        auto& latest = _latest_timestamps[id];
+        if (latest < header.timestamp) latest = header.timestamp;
+    }
+    _newest_timestamp = std::max(_newest_timestamp,header.timestamp);
+    if (_latest_timestamps.size() >= _pruning_size) _prune_latest_timestamps();
+    try {
+        _callback(*message);
+    } catch (std::exception& e) {
+        CONCLOG_PRINTLN("Error handling human state message at " << header.timestamp << ": " << e.what())
+    }
+}
+
+void UdpHumanStateSubscriber::_prune_latest_timestamps() {
+    if (_newest_timestamp > UDP_LATEST_TIMESTAMP_RETENTION_MS)
+        _pruned_before = std::max(_pruned_before,_newest_timestamp - UDP_LATEST_TIMESTAMP_RETENTION_MS);
+    for (auto it = _latest_timestamps.begin(); it != _latest_timestamps.end();) {
+        if (it->second < _pruned_before) it = _latest_timestamps.erase(it);
+        else ++it;
+    }
+    _pruning_size = std::max(UDP_MIN_PRUNING_SIZE,2*_latest_timestamps.size());
+}
+
+SizeType UdpHumanStateSubscriber::num_received() const {
+    return _num_received;
+}
+
+SizeType UdpHumanStateSubscriber::num_stale() const {
+    return _num_stale;
+}
+
+SizeType UdpHumanStateSubscriber::num_invalid() const {
+    return _num_invalid;
+}
+
+UdpHumanStateSubscriber::~UdpHumanStateSubscriber() {
+    _stopped = true;
+    _socket.shutdown();
+}
+
+UdpBrokerAccess::UdpBrokerAccess(std::string const& address, int port, MessageEncoding const& encoding, SizeType const& batch_size) :
+    _address(address), _port(port), _encoding(encoding), _batch_size(batch_size) {
+    OPERA_PRECONDITION(batch_size > 0)
+}
+
+PublisherInterface<BodyPresentationMessage>* UdpBrokerAccess::make_body_presentation_publisher(BodyPresentationTopic const&) const {
+    OPERA_FAIL_MSG("UDP access supports human states only")
+}
+
+PublisherInterface<HumanStateMessage>* UdpBrokerAccess::make_human_state_publisher(HumanStateTopic const&) const {
+    return new UdpHumanStatePublisher(_address, _port, _encoding);
+}
+
+PublisherInterface<RobotStateMessage>* UdpBrokerAccess::make_robot_state_publisher(RobotStateTopic const&) const {
+    OPERA_FAIL_MSG("UDP access supports human states only")
+}
+
+PublisherInterface<CollisionNotificationMessage>* UdpBrokerAccess::make_collision_notification_publisher(CollisionNotificationTopic const&) const {
+    OPERA_FAIL_MSG("UDP access supports human states only")
+}
+
+SubscriberInterface<BodyPresentationMessage>* UdpBrokerAccess::make_body_presentation_subscriber(CallbackFunction<BodyPresentationMessage> const&, BodyPresentationTopic const&) const {
+    OPERA_FAIL_MSG("UDP access supports human states only")
+}
+
+SubscriberInterface<HumanStateMessage>* UdpBrokerAccess::make_human_state_subscriber(CallbackFunction<HumanStateMessage> const& callback, HumanStateTopic const&, MessageFilter const& filter) const {
+    return new UdpHumanStateSubscriber(_address, _port, callback, _encoding, filter, _batch_size);
+}
+
+SubscriberInterface<RobotStateMessage>* UdpBrokerAccess::make_robot_state_subscriber(CallbackFunction<RobotStateMessage> const&, RobotStateTopic const&, MessageFilter const&) const {
+    OPERA_FAIL_MSG("UDP access supports human states only")
+}
+
+SubscriberInterface<CollisionNotificationMessage>* UdpBrokerAccess::make_collision_notification_subscriber(CallbackFunction<CollisionNotificationMessage> const&, CollisionNotificationTopic const&) const {
+    OPERA_FAIL_MSG("UDP access supports human states only")
+}
+
+}
@@ -0,0 +1,184 @@
+/***************************************************************************
+ *            test_binary_serialisation.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.hpp"
+#include "codec.hpp"
+
+using namespace Opera;
+
+class TestBinarySerialisation {
+public:
+    void test() {
+        OPERA_TEST_CALL(test_writer_reader())
+        OPERA_TEST_CALL(test_bodypresentationmessage())
+        OPERA_TEST_CALL(test_humanstatemessage())
+        OPERA_TEST_CALL(test_robotstatemessage())
+        OPERA_TEST_CALL(test_peek_header())
+        OPERA_TEST_CALL(test_collisionnotificationmessage())
+        OPERA_TEST_CALL(test_invalid_payloads())
+        OPERA_TEST_CALL(test_codec())
+    }
+
+    void test_writer_reader() {
+        String buffer;
+        BinaryWriter writer(buffer);
+        writer.write_uint8(200);
+        writer.write_uint32(0x01020304);
+        writer.write_uint64(0x0102030405060708);
+        writer.write_float(-1.25);
+        writer.write_string("nose");
+        writer.write_point(Point(0.1,-2,3e10));
+        OPERA_TEST_EQUALS(buffer.size(),1+4+8+8+4+4+24)
+        OPERA_TEST_EQUALS(static_cast<int>(buffer.at(1)),4)
+        OPERA_TEST_EQUALS(static_cast<int>(buffer.at(4)),1)
+
+        BinaryReader reader(buffer.data(),buffer.size());
+        OPERA_TEST_EQUALS(static_cast<int>(reader.read_uint8()),200)
+        OPERA_TEST_EQUALS(reader.read_uint32(),0x01020304)
+        OPERA_TEST_EQUALS(reader.read_uint64(),0x0102030405060708)
+        OPERA_TEST_EQUALS(reader.read_float(),-1.25)
+        OPERA_TEST_EQUALS(reader.read_string(),"nose")
+        OPERA_TEST_EQUALS(reader.read_point(),Point(0.1,-2,3e10))
+        OPERA_TEST_ASSERT(reader.at_end())
+        OPERA_TEST_FAIL(reader.read_uint8())
+    }
+
+    void test_bodypresentationmessage() {
+        BodyPresentationMessage h("human1", {{"nose","neck"},{"left_shoulder","right_shoulder"}}, {1.0,0.5});
+        auto payload = BinarySerialiser<BodyPresentationMessage>(h).to_string();
+        auto hd = BinaryDeserialiser<BodyPresentationMessage>(payload.data(),payload.size()).make();
+        OPERA_TEST_EQUALS(hd.id(),h.id())
+        OPERA_TEST_ASSERT(hd.is_human())
+        OPERA_TEST_ASSERT(hd.segment_pairs() == h.segment_pairs())
+        OPERA_TEST_EQUALS(hd.thicknesses(),h.thicknesses())
+
+        BodyPresentationMessage r("robot1", 30, {{"0", "1"},{"3", "2"},{"4", "2"}}, {1.0,0.5, 0.5});
+        payload = BinarySerialiser<BodyPresentationMessage>(r).to_string();
+        auto rd = BinaryDeserialiser<BodyPresentationMessage>(payload.data(),payload.size()).make();
+        OPERA_TEST_EQUALS(rd.id(),r.id())
+        OPERA_TEST_ASSERT(not rd.is_human())
+        OPERA_TEST_EQUALS(rd.message_frequency(),30)
+        OPERA_TEST_ASSERT(rd.segment_pairs() == r.segment_pairs())
+        OPERA_TEST_EQUALS(rd.thicknesses(),r.thicknesses())
+    }
+
+    void test_humanstatemessage() {
+        HumanStateMessage p({{"human0",{{{"nose",{Point(0.4,2.1,0.2)}},{"neck",{Point(0,-1,0.1),Point(0.3,3.1,-1.2)}},{"left_shoulder",{}}}}},
+                             {"human1",{{{"nose",{Point(1,2,3)}}}}}},3423235);
+        auto payload = BinarySerialiser<HumanStateMessage>(p).to_string();
+        OPERA_TEST_ASSERT(payload.size() < Serialiser<HumanStateMessage>(p).to_string().size())
+        auto d = BinaryDeserialiser<HumanStateMessage>(payload.data(),payload.size()).make();
+        OPERA_TEST_EQUALS(d.timestamp(),p.timestamp())
+        auto d_bodies = d.bodies();
+        auto p_bodies = p.bodies();
+        OPERA_TEST_EQUALS(d_bodies.size(),2)
+        for (SizeType i=0; i<2; ++i) {
+            OPERA_TEST_EQUALS(d_bodies.at(i).first,p_bodies.at(i).first)
+            OPERA_TEST_EQUALS(d_bodies.at(i).second.size(),p_bodies.at(i).second.size())
+            for (auto const& kp : p_bodies.at(i).second)
+                OPERA_TEST_EQUALS(d_bodies.at(i).second.at(kp.first),kp.second)
+        }
+    }
+
+    void test_robotstatemessage() {
+        RobotStateMessage p("robot0", Mode({{"origin", "3"}, {"destination", "2"}, {"phase", "pre"}}), {{}, {Point(0, -1, 0.1), Point(0.3, 3.1, -1.2)}, {}}, 93249);
+        auto payload = BinarySerialiser<RobotStateMessage>(p).to_string();
+        auto d = BinaryDeserialiser<RobotStateMessage>(payload.data(),payload.size()).make();
+        OPERA_TEST_EQUALS(d.id(),p.id())
+        OPERA_TEST_EQUALS(d.mode(),p.mode())
+        OPERA_TEST_EQUALS(d.points(),p.points())
+        OPERA_TEST_EQUALS(d.timestamp(),p.timestamp())
+    }
+
+    void test_peek_header() {
+        HumanStateMessage hp({{"human0",{{{"nose",{Point(0.4,2.1,0.2)}}}}},{"human1",{{{"neck",{}}}}}},3423235);
+        auto human_payload = BinarySerialiser<HumanStateMessage>(hp).to_string();
+        auto h = BinaryDeserialiser<HumanStateMessage>(human_payload.data(),human_payload.size()).peek();
+        OPERA_TEST_EQUALS(h.body_ids.size(),2)
+        OPERA_TEST_EQUALS(h.body_ids.at(1),"human1")
+        OPERA_TEST_EQUALS(h.timestamp,3423235)
+        RobotStateMessage rp("r0",Mode({{"origin","3"}}),{{},{Point(0,-1,0.1)}},93249);
+        auto robot_payload = BinarySerialiser<RobotStateMessage>(rp).to_string();
+        auto r = peek<RobotStateMessage>(robot_payload.data(),robot_payload.size(),MessageEncoding::BINARY);
+        OPERA_TEST_EQUALS(r.body_ids.at(0),"r0")
+        OPERA_TEST_EQUALS(r.timestamp,93249)
+        auto filter = make_payload_filter<RobotStateMessage>([](MessageHeader const& header){ return header.timestamp > 100000; },MessageEncoding::BINARY);
+        OPERA_TEST_ASSERT(not filter(robot_payload.data(),robot_payload.size()))
+        OPERA_TEST_ASSERT(not make_payload_filter<RobotStateMessage>(MessageFilter(),MessageEncoding::BINARY))
+    }
+
+    void test_collisionnotificationmessage() {
+        CollisionNotificationMessage p("h0", {"nose","neck"}, "r0", {"0","1"}, 32890, Interval<TimestampType>(72, 123), Mode({{"origin", "3"}, {"destination", "2"}, {"phase", "pre"}}), 0.5);
+        auto payload = BinarySerialiser<CollisionNotificationMessage>(p).to_string();
+        auto d = BinaryDeserialiser<CollisionNotificationMessage>(payload.data(),payload.size()).make();
+        OPERA_TEST_EQUALS(d.human_id(),p.human_id())
+        OPERA_TEST_ASSERT(d.human_segment() == p.human_segment())
+        OPERA_TEST_EQUALS(d.robot_id(),p.robot_id())
+        OPERA_TEST_ASSERT(d.robot_segment() == p.robot_segment())
+        OPERA_TEST_EQUALS(d.current_time(),p.current_time())
+        OPERA_TEST_EQUALS(d.collision_distance().lower(),p.collision_distance().lower())
+        OPERA_TEST_EQUALS(d.collision_distance().upper(),p.collision_distance().upper())
+        OPERA_TEST_EQUALS(d.collision_mode(),p.collision_mode())
+        OPERA_TEST_EQUALS(d.likelihood(),p.likelihood())
+    }
+
+    void test_invalid_payloads() {
+        RobotStateMessage p("robot0", Mode({{"phase", "pre"}}), {{Point(0, -1, 0.1)}}, 93249);
+        auto payload = BinarySerialiser<RobotStateMessage>(p).to_string();
+        OPERA_TEST_FAIL(BinaryDeserialiser<HumanStateMessage>(payload.data(),payload.size()).make())
+        OPERA_TEST_FAIL(BinaryDeserialiser<RobotStateMessage>(payload.data(),payload.size()-1).make())
+        auto trailing = payload + "x";
+        OPERA_TEST_FAIL(BinaryDeserialiser<RobotStateMessage>(trailing.data(),trailing.size()).make())
+        auto future_version = payload;
+        future_version[2] = static_cast<char>(BINARY_ENCODING_VERSION+1);
+        OPERA_TEST_FAIL(BinaryDeserialiser<RobotStateMessage>(future_version.data(),future_version.size()).make())
+        auto oversized_count = payload;
+        oversized_count[payload.size()-24-1] = static_cast<char>(0x7F);
+        OPERA_TEST_FAIL(BinaryDeserialiser<RobotStateMessage>(oversized_count.data(),oversized_count.size()).make())
+        auto json = Serialiser<RobotStateMessage>(p).to_string();
+        OPERA_TEST_FAIL(BinaryDeserialiser<RobotStateMessage>(json.data(),json.size()).make())
+    }
+
+    void test_codec() {
+        RobotStateMessage p("robot0", Mode({{"phase", "pre"}}), {{Point(0, -1, 0.1)}, {Point(2, 3, 4)}}, 93249);
+        for (auto encoding : {MessageEncoding::JSON, MessageEncoding::BINARY}) {
+            OPERA_TEST_PRINT(encoding)
+            auto payload = encode(p,encoding);
+            auto d = decode<RobotStateMessage>(payload.data(),payload.size(),encoding);
+            OPERA_TEST_EQUALS(d.id(),p.id())
+            OPERA_TEST_EQUALS(d.mode(),p.mode())
+            OPERA_TEST_EQUALS(d.points(),p.points())
+            OPERA_TEST_EQUALS(d.timestamp(),p.timestamp())
+        }
+    }
+};
+
+int main() {
+    TestBinarySerialisation().test();
+    return OPERA_TEST_FAILURES;
+}
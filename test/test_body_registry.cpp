@@ -26,6 +26,7 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <algorithm>
 #include "body_registry.hpp"
 
 #include "test.hpp"
@@ -38,6 +39,8 @@ class TestBodyRegistry {
         OPERA_TEST_CALL(test_creation())
         OPERA_TEST_CALL(test_insert_remove_clear())
         OPERA_TEST_CALL(test_instance_distance())
+        OPERA_TEST_CALL(test_entry_handles())
+        OPERA_TEST_CALL(test_many_bodies())
     }
 
     void test_creation() {
@@ -67,29 +70,34 @@ class TestBodyRegistry {
         OPERA_TEST_FAIL(registry.latest_human_timestamp("h0"))
         OPERA_TEST_EQUALS(registry.human_history_size("h0"),0)
         OPERA_TEST_FAIL(registry.robot_history("r"))
-        auto const& human = registry.human(h.id());
-        auto const& robot = registry.robot(r.id());
-        OPERA_TEST_EQUAL(human.id(),h.id())
-        OPERA_TEST_EQUAL(robot.id(),r.id())
+        auto human = registry.human(h.id());
+        auto robot = registry.robot(r.id());
+        OPERA_TEST_EQUAL(human->id(),h.id())
+        OPERA_TEST_EQUAL(robot->id(),r.id())
         OPERA_TEST_FAIL(registry.latest_human_instance_within(h.id(),0))
-        auto& history = registry.robot_history(r.id());
-        OPERA_TEST_ASSERT(history.snapshot_at(0).modes_with_samples().empty())
+        auto history = registry.robot_history(r.id());
+        OPERA_TEST_ASSERT(history->snapshot_at(0).modes_with_samples().empty())
 
         OPERA_TEST_FAIL(registry.acquire_state(HumanStateMessage({{"h", {{}}}}, 0u)))
 
         registry.acquire_state({{{h.id(), {{{"nose",{Point(0,0,0)}},{"neck",{Point(4,4,4)}},{"mid_hip",{Point(0,2,0)}}}}}}, 34289023});
-        auto const& last_state = registry.latest_human_instance_within(h.id(),34289023);
-        OPERA_TEST_EQUALS(last_state.timestamp(),34289023)
+        auto last_state = registry.latest_human_instance_within(h.id(),34289023);
+        OPERA_TEST_EQUALS(last_state->timestamp(),34289023)
         OPERA_TEST_EQUALS(registry.instance_number(h.id(),34289023),0)
-        OPERA_TEST_EQUALS(registry.instance_at(h.id(),0).timestamp(),34289023)
+        OPERA_TEST_EQUALS(registry.instance_at(h.id(),0)->timestamp(),34289023)
 
         registry.acquire_state({{{h.id(), {{{"nose",{Point(0,0,0)}},{"neck",{Point(4,4,4)}},{"mid_hip",{Point(0,2,0)}}}}}}, 34289022});
-        auto const& last_state2 = registry.latest_human_instance_within(h.id(),34289023);
-        OPERA_TEST_EQUALS(last_state2.timestamp(),34289023)
+        auto last_state2 = registry.latest_human_instance_within(h.id(),34289023);
+        OPERA_TEST_EQUALS(last_state2->timestamp(),34289023)
 
         registry.acquire_state({{{h.id(), {{{"nose",{Point(0,0,0)}},{"neck",{Point(4,4,4)}},{"mid_hip",{Point(0,2,0)}}}}}}, 34289024});
-        auto const& last_state3 = registry.latest_human_instance_within(h.id(),34289024);
-        OPERA_TEST_EQUALS(last_state3.timestamp(),34289024)
+        auto last_state3 = registry.latest_human_instance_within(h.id(),34289024);
+        OPERA_TEST_EQUALS(last_state3->timestamp(),34289024)
+
+        registry.human_history(h.id())->remove_older_than(34289025);
+        OPERA_TEST_EQUALS(registry.human_history_size(h.id()),0)
+        OPERA_TEST_EQUALS(last_state->timestamp(),34289023)
+        OPERA_TEST_EQUALS(last_state3->timestamp(),34289024)
 
         registry.insert(h);
         registry.insert(r);
@@ -130,6 +138,56 @@ class TestBodyRegistry {
         OPERA_TEST_FAIL(registry.instance_distance(h.id(),1000,1001))
         OPERA_TEST_FAIL(registry.instance_distance(h.id(),1001,2000))
     }
+
+    void test_entry_handles() {
+        BodyRegistry registry;
+        BodyPresentationMessage h("h0",{{"nose","neck"},{"neck","mid_hip"}},{1.0,0.5});
+        BodyPresentationMessage r("r0",10,{{"0","1"},{"1","2"}},{1.0,0.5});
+
+        OPERA_TEST_ASSERT(registry.human_entry(h.id()) == nullptr)
+        OPERA_TEST_ASSERT(registry.robot_entry(r.id()) == nullptr)
+        registry.insert(h);
+        registry.insert(r);
+        OPERA_TEST_ASSERT(registry.human_entry(r.id()) == nullptr)
+        OPERA_TEST_ASSERT(registry.robot_entry(h.id()) == nullptr)
+        registry.acquire_state({{{h.id(), {{{"nose",{Point(0,0,0)}},{"neck",{Point(4,4,4)}},{"mid_hip",{Point(0,2,0)}}}}}}, 1000});
+
+        auto human_entry = registry.human_entry(h.id());
+        auto robot_entry = registry.robot_entry(r.id());
+        auto human = registry.human(h.id());
+        auto latest_instance = registry.latest_human_instance_within(h.id(),1000);
+        OPERA_TEST_ASSERT(human_entry != nullptr)
+        OPERA_TEST_ASSERT(robot_entry != nullptr)
+        registry.remove(h.id());
+        registry.remove(r.id());
+        OPERA_TEST_ASSERT(not registry.contains(h.id()))
+        OPERA_TEST_ASSERT(registry.human_entry(h.id()) == nullptr)
+        OPERA_TEST_EQUALS(human_entry->body().id(),h.id())
+        OPERA_TEST_EQUALS(human_entry->latest_timestamp(),1000)
+        OPERA_TEST_EQUALS(human->id(),h.id())
+        OPERA_TEST_EQUALS(latest_instance->timestamp(),1000)
+        OPERA_TEST_EQUALS(robot_entry->body().id(),r.id())
+        OPERA_TEST_ASSERT(robot_entry->history().snapshot_at(0).modes_with_samples().empty())
+    }
+
+    void test_many_bodies() {
+        BodyRegistry registry;
+        SizeType const num_bodies = 3*BODY_REGISTRY_NUM_SHARDS;
+        for (SizeType i=0; i<num_bodies; ++i) {
+            registry.insert(BodyPresentationMessage("h"+std::to_string(i),{{"nose","neck"}},{1.0}));
+            registry.insert(BodyPresentationMessage("r"+std::to_string(i),10,{{"0","1"}},{1.0}));
+        }
+        OPERA_TEST_EQUALS(registry.num_humans(),num_bodies)
+        OPERA_TEST_EQUALS(registry.num_robots(),num_bodies)
+        OPERA_TEST_EQUALS(registry.num_segment_pairs(),num_bodies*num_bodies)
+        auto hids = registry.human_ids();
+        OPERA_TEST_EQUALS(hids.size(),num_bodies)
+        OPERA_TEST_ASSERT(std::is_sorted(hids.begin(),hids.end()))
+        for (SizeType i=0; i<num_bodies; ++i)
+            registry.remove("h"+std::to_string(i));
+        OPERA_TEST_EQUALS(registry.num_humans(),0)
+        OPERA_TEST_EQUALS(registry.num_robots(),num_bodies)
+    }
 };
 
 int main() {
@@ -26,7 +26,11 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <filesystem>
 #include "command_line_interface.hpp"
+#include "broker_access_manager.hpp"
+#include "metrics.hpp"
+#include "job_trace.hpp"
 #include "conclog/include/logging.hpp"
 #include "test.hpp"
 
@@ -44,6 +48,9 @@ class TestCommandLineInterface {
         OPERA_TEST_CALL(test_scheduler_parsing())
         OPERA_TEST_CALL(test_theme_parsing())
         OPERA_TEST_CALL(test_verbosity_parsing())
+        OPERA_TEST_CALL(test_broker_parsing())
+        OPERA_TEST_CALL(test_metrics_parsing())
+        OPERA_TEST_CALL(test_job_trace_parsing())
         OPERA_TEST_CALL(test_multiple_argument_parsing())
         OPERA_TEST_CALL(test_unrecognised_argument())
         OPERA_TEST_CALL(test_duplicate_argument())
@@ -126,6 +133,52 @@ class TestCommandLineInterface {
         OPERA_TEST_ASSERT(not success5)
     }
 
+    void test_broker_parsing() {
+        bool success1 = CommandLineInterface::instance().acquire({"", "-b", "memory"});
+        OPERA_TEST_ASSERT(success1)
+        OPERA_TEST_ASSERT(BrokerAccessManager::instance().is_configured())
+        bool success2 = CommandLineInterface::instance().acquire({"", "--broker", "shm"});
+        OPERA_TEST_ASSERT(success2)
+        bool success3 = CommandLineInterface::instance().acquire({"", "-b", "shm:opera_test"});
+        OPERA_TEST_ASSERT(success3)
+        bool success4 = CommandLineInterface::instance().acquire({"", "-b", "shm:"});
+        OPERA_TEST_ASSERT(not success4)
+        bool success5 = CommandLineInterface::instance().acquire({"", "-b", "mqtt:localhost:port"});
+        OPERA_TEST_ASSERT(not success5)
+        bool success6 = CommandLineInterface::instance().acquire({"", "-b", "wrong"});
+        OPERA_TEST_ASSERT(not success6)
+        bool success7 = CommandLineInterface::instance().acquire({"", "-b"});
+        OPERA_TEST_ASSERT(not success7)
+    }
+
+    void test_metrics_parsing() {
+        auto path = (std::filesystem::temp_directory_path() / "opera_test_cli.prom").string();
+        bool success1 = CommandLineInterface::instance().acquire({"", "-m", "file:" + path});
+        OPERA_TEST_ASSERT(success1)
+        MetricsRegistry::instance().stop_exporting();
+        OPERA_TEST_ASSERT(std::filesystem::exists(path))
+        std::filesystem::remove(path);
+        bool success2 = CommandLineInterface::instance().acquire({"", "--metrics", "http:port"});
+        OPERA_TEST_ASSERT(not success2)
+        bool success3 = CommandLineInterface::instance().acquire({"", "-m", "file:"});
+        OPERA_TEST_ASSERT(not success3)
+        bool success4 = CommandLineInterface::instance().acquire({"", "-m", "wrong"});
+        OPERA_TEST_ASSERT(not success4)
+    }
+
+    void test_job_trace_parsing() {
+        auto path = (std::filesystem::temp_directory_path() / "opera_test_cli_trace.json").string();
+        bool success1 = CommandLineInterface::instance().acquire({"", "--job-trace", path});
+        OPERA_TEST_ASSERT(success1)
+        OPERA_TEST_ASSERT(JobTracer::instance().is_enabled())
+        JobTracer::instance().stop_exporting();
+        JobTracer::instance().disable();
+        OPERA_TEST_ASSERT(std::filesystem::exists(path))
+        std::filesystem::remove(path);
+        bool success2 = CommandLineInterface::instance().acquire({"", "-j"});
+        OPERA_TEST_ASSERT(not success2)
+    }
+
     void test_multiple_argument_parsing() {
         bool success = CommandLineInterface::instance().acquire({"", "-t", "dark", "--verbosity", "4"});
         OPERA_TEST_ASSERT(success)
@@ -38,8 +38,12 @@ public:
         OPERA_TEST_CALL(test_bodypresentationmessage_make_human())
         OPERA_TEST_CALL(test_bodypresentationmessage_make_robot())
         OPERA_TEST_CALL(test_humanstatemessage_make())
+        OPERA_TEST_CALL(test_humanstatemessage_make_streaming())
         OPERA_TEST_CALL(test_robotstatemessage_make())
+        OPERA_TEST_CALL(test_robotstatemessage_make_streaming())
         OPERA_TEST_CALL(test_collisiondetectionmessage_make())
+        OPERA_TEST_CALL(test_make_from_bounded_text())
+        OPERA_TEST_CALL(test_peek_header())
     }
 
     void test_bodypresentationmessage_make_human() {
@@ -81,7 +85,7 @@ public:
         auto p = d.make();
         OPERA_TEST_EQUALS(p.bodies().size(),1)
         OPERA_TEST_EQUALS(p.timestamp(),328903)
-        auto const& bd = p.bodies().at(0);
+        auto bd = p.bodies().at(0);
         OPERA_TEST_EQUALS(bd.first,"h0")
         OPERA_TEST_EQUALS(bd.second.size(),8)
         OPERA_TEST_EQUALS(bd.second.at("hip").size(),0)
@@ -129,6 +133,90 @@ public:
         OPERA_TEST_EQUALS(p.collision_mode(), loc)
         OPERA_TEST_EQUALS(p.likelihood(),0.5)
     }
+
+    void test_humanstatemessage_make_streaming() {
+        auto p1 = Deserialiser<HumanStateMessage>(Resources::path("json/examples/state/humans.json")).make();
+        auto p2 = StreamingDeserialiser<HumanStateMessage>(Resources::path("json/examples/state/humans.json")).make();
+        OPERA_TEST_EQUALS(p2.timestamp(),p1.timestamp())
+        OPERA_TEST_EQUALS(p2.bodies().size(),p1.bodies().size())
+        auto bd1 = p1.bodies().at(0);
+        auto bd2 = p2.bodies().at(0);
+        OPERA_TEST_EQUALS(bd2.first,bd1.first)
+        OPERA_TEST_EQUALS(bd2.second.size(),bd1.second.size())
+        for (auto const& kp : bd1.second) {
+            OPERA_TEST_ASSERT(bd2.second.has_key(kp.first))
+            OPERA_TEST_EQUALS(bd2.second.at(kp.first).size(),kp.second.size())
+            for (SizeType i=0; i<kp.second.size(); ++i)
+                OPERA_TEST_EQUALS(bd2.second.at(kp.first).at(i),kp.second.at(i))
+        }
+
+        auto p3 = StreamingDeserialiser<HumanStateMessage>("{\"timestamp\": 10, \"source\": {\"camera\": [1,{\"a\":null}]}, \"bodies\": [{\"keypoints\": {\"nose\": [{\"x\": 1, \"w\": 0.5, \"y\": -2, \"z\": 3.5}]}, \"body_id\": \"h1\"}]}").make();
+        OPERA_TEST_EQUALS(p3.timestamp(),10)
+        OPERA_TEST_EQUALS(p3.bodies().size(),1)
+        OPERA_TEST_EQUALS(p3.bodies().at(0).first,"h1")
+        OPERA_TEST_EQUALS(p3.bodies().at(0).second.at("nose").at(0),Point(1,-2,3.5))
+
+        OPERA_TEST_FAIL(StreamingDeserialiser<HumanStateMessage>("{\"bodies\": [{\"keypoints\": {}}], \"timestamp\": 10}").make())
+        OPERA_TEST_FAIL(StreamingDeserialiser<HumanStateMessage>("{\"bodies\": []}").make())
+        OPERA_TEST_FAIL(StreamingDeserialiser<HumanStateMessage>("{\"bodies\": [}").make())
+    }
+
+    void test_robotstatemessage_make_streaming() {
+        auto p1 = Deserialiser<RobotStateMessage>(Resources::path("json/examples/state/robot0.json")).make();
+        auto p2 = StreamingDeserialiser<RobotStateMessage>(Resources::path("json/examples/state/robot0.json")).make();
+        OPERA_TEST_EQUALS(p2.id(),p1.id())
+        OPERA_TEST_EQUALS(p2.mode(),p1.mode())
+        OPERA_TEST_EQUALS(p2.timestamp(),p1.timestamp())
+        OPERA_TEST_EQUALS(p2.points().size(),p1.points().size())
+        for (SizeType i=0; i<p1.points().size(); ++i) {
+            OPERA_TEST_EQUALS(p2.points().at(i).size(),p1.points().at(i).size())
+            for (SizeType j=0; j<p1.points().at(i).size(); ++j)
+                OPERA_TEST_EQUALS(p2.points().at(i).at(j),p1.points().at(i).at(j))
+        }
+
+        auto p3 = StreamingDeserialiser<RobotStateMessage>("{\"timestamp\": 5, \"continuousState\": [[],[[1,2,3]]], \"extra\": [[0]], \"mode\": {}, \"bodyId\": \"r1\"}").make();
+        OPERA_TEST_EQUALS(p3.id(),"r1")
+        OPERA_TEST_EQUALS(p3.timestamp(),5)
+        OPERA_TEST_EQUALS(p3.points().size(),2)
+        OPERA_TEST_EQUALS(p3.points().at(0).size(),0)
+        OPERA_TEST_EQUALS(p3.points().at(1).at(0),Point(1,2,3))
+
+        OPERA_TEST_FAIL(StreamingDeserialiser<RobotStateMessage>("{\"bodyId\": \"r1\", \"mode\": {}, \"continuousState\": [[[1,2]]], \"timestamp\": 5}").make())
+        OPERA_TEST_FAIL(StreamingDeserialiser<RobotStateMessage>("{\"bodyId\": \"r1\", \"mode\": {}, \"timestamp\": 5}").make())
+    }
+
+    void test_make_from_bounded_text() {
+        String payload = "{\"bodyId\": \"r1\", \"mode\": {}, \"continuousState\": [[[1,2,3]]], \"timestamp\": 5}";
+        String buffer = payload + "trailing content";
+        auto p1 = StreamingDeserialiser<RobotStateMessage>(buffer.data(),payload.size()).make();
+        OPERA_TEST_EQUALS(p1.id(),"r1")
+        OPERA_TEST_EQUALS(p1.timestamp(),5)
+        OPERA_TEST_EQUALS(p1.points().at(0).at(0),Point(1,2,3))
+        auto p2 = Deserialiser<RobotStateMessage>(buffer.data(),payload.size()).make();
+        OPERA_TEST_EQUALS(p2.id(),"r1")
+        OPERA_TEST_EQUALS(p2.points().at(0).at(0),Point(1,2,3))
+        OPERA_TEST_FAIL(StreamingDeserialiser<RobotStateMessage>(buffer.data(),buffer.size()).make())
+        OPERA_TEST_FAIL(StreamingDeserialiser<RobotStateMessage>(buffer.data(),payload.size()-1).make())
+    }
+
+    void test_peek_header() {
+        String human_payload = "{\"bodies\": [{\"body_id\": \"h0\", \"keypoints\": {\"nose\": [{\"x\": 1, \"y\": 2, \"z\": 3}]}, \"extra\": [1,{}]},"
+                               "{\"keypoints\": {}, \"body_id\": \"h1\"}], \"timestamp\": 10}";
+        auto h = StreamingDeserialiser<HumanStateMessage>(human_payload.c_str()).peek();
+        OPERA_TEST_EQUALS(h.body_ids.size(),2)
+        OPERA_TEST_EQUALS(h.body_ids.at(0),"h0")
+        OPERA_TEST_EQUALS(h.body_ids.at(1),"h1")
+        OPERA_TEST_EQUALS(h.timestamp,10)
+        String robot_payload = "{\"bodyId\": \"r1\", \"timestamp\": 5, \"mode\": {}, \"continuousState\": [[[1,2,3]]]}";
+        auto r = StreamingDeserialiser<RobotStateMessage>(robot_payload.c_str()).peek();
+        OPERA_TEST_EQUALS(r.body_ids.size(),1)
+        OPERA_TEST_EQUALS(r.body_ids.at(0),"r1")
+        OPERA_TEST_EQUALS(r.timestamp,5)
+        String truncated_payload = "{\"bodyId\": \"r1\", \"timestamp\": 5, \"continuousState\": [[[1,2";
+        OPERA_TEST_EQUALS(StreamingDeserialiser<RobotStateMessage>(truncated_payload.c_str()).peek().timestamp,5)
+        OPERA_TEST_FAIL(StreamingDeserialiser<RobotStateMessage>("{\"bodyId\": \"r1\", \"mode\": {}}").peek())
+        OPERA_TEST_FAIL(StreamingDeserialiser<HumanStateMessage>("{\"bodies\": [{\"keypoints\": {}}], \"timestamp\": 10}").peek())
+    }
 };
 
 int main() {
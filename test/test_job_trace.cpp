@@ -0,0 +1,125 @@
+/***************************************************************************
+ *            test_job_trace.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <rapidjson/document.h>
+#include "job_trace.hpp"
+#include "body.hpp"
+#include "test.hpp"
+
+using namespace Opera;
+
+class TestJobTrace {
+  public:
+    void test() {
+        OPERA_TEST_CALL(test_disabled())
+        OPERA_TEST_CALL(test_record())
+        OPERA_TEST_CALL(test_ring())
+        OPERA_TEST_CALL(test_json())
+        OPERA_TEST_CALL(test_file())
+        JobTracer::instance().disable();
+    }
+
+    LookAheadJob make_job(TimestampType const& initial_time) {
+        Human h("h0", {{"nose", "neck"}}, {1.0});
+        auto sample = h.segment(0).create_sample({{-0.5, 1.0, 1.25}},{{}});
+        return DiscardLookAheadJob(LookAheadJobIdentifier("h0", 0u, "r0", 1u), initial_time, sample, ModeTrace().push_back({{"robot", "first"}}), LookAheadJobPath());
+    }
+
+    void test_disabled() {
+        JobTracer::instance().enable();
+        JobTracer::instance().disable();
+        OPERA_TEST_ASSERT(not JobTracer::instance().is_enabled())
+        JobTracer::instance().record(JobEvent::CREATED,make_job(10));
+        OPERA_TEST_EQUALS(JobTracer::instance().num_entries(),0)
+    }
+
+    void test_record() {
+        JobTracer::instance().enable();
+        auto job = make_job(10);
+        JobTracer::instance().record(JobEvent::CREATED,job);
+        JobTracer::instance().record(JobEvent::ENQUEUED,job);
+        std::thread worker([&job]{
+            JobTraceScope scope(job);
+            JobTracer::instance().record(JobEvent::SPLIT,job,2);
+        });
+        worker.join();
+        OPERA_TEST_EQUALS(JobTracer::instance().num_entries(),5)
+        OPERA_TEST_EQUALS(JobTracer::instance().num_dropped(),0)
+    }
+
+    void test_ring() {
+        JobTracer::instance().enable(4);
+        auto job = make_job(10);
+        for (SizeType i=0; i<10; ++i) JobTracer::instance().record(JobEvent::SLEPT,job);
+        OPERA_TEST_EQUALS(JobTracer::instance().num_entries(),4)
+        OPERA_TEST_EQUALS(JobTracer::instance().num_dropped(),6)
+    }
+
+    void test_json() {
+        JobTracer::instance().enable();
+        auto job = make_job(10);
+        JobTracer::instance().record(JobEvent::ENQUEUED,job);
+        JobTracer::instance().record(JobEvent::RESERVED,job);
+        JobTracer::instance().record(JobEvent::PROCESSED,job);
+        JobTracer::instance().record(JobEvent::AWAKENED,job,3);
+        auto json = JobTracer::instance().to_json();
+        OPERA_PRINT_TEST_COMMENT(json)
+
+        rapidjson::Document document;
+        document.Parse(json.c_str());
+        OPERA_TEST_ASSERT(not document.HasParseError())
+        auto const& events = document["traceEvents"];
+        List<std::string> phases;
+        for (auto const& event : events.GetArray()) {
+            if (std::string(event["ph"].GetString()) == "M") continue;
+            phases.push_back(std::string(event["name"].GetString()) + ":" + event["ph"].GetString());
+        }
+        OPERA_TEST_ASSERT(phases == List<std::string>({"waiting:b","waiting:e","processing:B","processing:E","sleeping:e","awakened:i"}))
+        OPERA_TEST_ASSERT(json.find("\"woken_jobs\":3") != std::string::npos)
+    }
+
+    void test_file() {
+        auto path = (std::filesystem::temp_directory_path() / "opera_test_job_trace.json").string();
+        JobTracer::instance().enable();
+        JobTracer::instance().record(JobEvent::NOTIFIED,make_job(20));
+        JobTracer::instance().export_to_file(path,10);
+        JobTracer::instance().stop_exporting();
+        std::ifstream ifs(path);
+        std::string content((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+        OPERA_TEST_ASSERT(content.find("\"notified\"") != std::string::npos)
+        std::filesystem::remove(path);
+    }
+};
+
+int main() {
+    TestJobTrace().test();
+    return OPERA_TEST_FAILURES;
+}
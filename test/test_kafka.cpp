@@ -33,8 +33,24 @@
 
 using namespace Opera;
 
+void test_publisher_delivery() {
+    KafkaPublisher<BodyPresentationMessage> publisher(std::string(Environment::get("KAFKA_TOPIC_PREFIX"))+"opera_test_delivery", 0, Environment::get("KAFKA_BROKER_URI"),
+                                                      Environment::get("KAFKA_SASL_MECHANISM"), Environment::get("KAFKA_SECURITY_PROTOCOL"),
+                                                      Environment::get("KAFKA_USERNAME"), Environment::get("KAFKA_PASSWORD"), MessageEncoding::BINARY);
+    SizeType const num_messages = 100;
+    for (SizeType i=0; i<num_messages; ++i)
+        publisher.put(BodyPresentationMessage("human"+std::to_string(i), {{"nose", "neck"}}, {1.0}));
+    for (SizeType i=0; i<100 and publisher.num_delivered() + publisher.num_failed() + publisher.num_dropped() < num_messages; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    OPERA_TEST_EQUALS(publisher.num_delivered(),num_messages)
+    OPERA_TEST_EQUALS(publisher.num_failed(),0)
+    OPERA_TEST_EQUALS(publisher.num_dropped(),0)
+}
+
 int main() {
 
+    OPERA_TEST_CALL(test_publisher_delivery())
+
     BrokerAccess access = KafkaBrokerAccessBuilder(Environment::get("KAFKA_BROKER_URI"))
                           .set_topic_prefix(Environment::get("KAFKA_TOPIC_PREFIX"))
                           .set_sasl_mechanism(Environment::get("KAFKA_SASL_MECHANISM"))
@@ -43,5 +59,20 @@ int main() {
                           .set_sasl_password(Environment::get("KAFKA_PASSWORD"))
                           .build();
     TestBrokerAccess(access,2500).test();
+
+    BrokerAccess group_access = KafkaBrokerAccessBuilder(Environment::get("KAFKA_BROKER_URI"))
+                          .set_topic_prefix(Environment::get("KAFKA_TOPIC_PREFIX"))
+                          .set_sasl_mechanism(Environment::get("KAFKA_SASL_MECHANISM"))
+                          .set_security_protocol(Environment::get("KAFKA_SECURITY_PROTOCOL"))
+                          .set_sasl_username(Environment::get("KAFKA_USERNAME"))
+                          .set_sasl_password(Environment::get("KAFKA_PASSWORD"))
+                          .set_consumer_group("opera_test")
+                          .set_batch_size(16)
+                          .set_num_decoding_workers(2)
+                          .set_batching(1,1000)
+                          .set_compression(KafkaCompression::LZ4)
+                          .set_keyed(true)
+                          .build();
+    TestBrokerAccess(group_access,5000).test();
     return OPERA_TEST_FAILURES;
 }
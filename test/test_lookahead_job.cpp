@@ -43,6 +43,7 @@ class TestLookAheadJob {
         OPERA_TEST_CALL(test_lookaheadjob_create_basic())
         OPERA_TEST_CALL(test_lookaheadjob_create_with_path())
         OPERA_TEST_CALL(test_lookaheadjob_earliest_collision_index())
+        OPERA_TEST_CALL(test_lookaheadjob_pin_snapshot_time())
     }
 
     void test_lookaheadjobid() {
@@ -206,6 +207,34 @@ class TestLookAheadJob {
         job = DiscardLookAheadJob(id, time, sample, ModeTrace().push_back(contract).push_back(endup).push_back(kneedown), LookAheadJobPath());
         OPERA_TEST_EQUALS(job.earliest_collision_index(h),2)
     }
+
+    void test_lookaheadjob_pin_snapshot_time() {
+        Human h0("h0", {{"nose","neck"}}, {0.1});
+        Robot r0("r0", 10, {{"0", "1"}}, {0.1});
+        Mode first({{"s", "first"}}), second({{"s", "second"}});
+        auto history = std::make_shared<RobotStateHistory>(r0);
+        TimestampType time = 0;
+        for (SizeType i=0; i<3; ++i) {
+            history->acquire(first, {{{"0",{Point(0,0,0)}},{"1",{Point(FloatType(i),0,0)}}}}, time); time += 100;
+            history->acquire(second, {{{"0",{Point(0,0,0)}},{"1",{Point(FloatType(i),1,0)}}}}, time); time += 100;
+        }
+        OPERA_TEST_EQUALS(history->__num_samples_entries(first),3)
+
+        LookAheadJobIdentifier id(h0.id(),0,r0.id(),0);
+        auto sample = h0.segment(0).create_sample({{2,0,1}},{{2,0,2}});
+        {
+            LookAheadJob job = DiscardLookAheadJob(id, 100, sample, ModeTrace().push_back(first), LookAheadJobPath());
+            job.pin_snapshot_time(history);
+            job.pin_snapshot_time(history);
+            OPERA_TEST_EQUALS(history->oldest_pinned_snapshot_time(),100)
+            history->remove_older_than(time);
+            OPERA_TEST_EQUALS(history->__num_samples_entries(first),3)
+            OPERA_TEST_EXECUTE(history->snapshot_at(job.snapshot_time()).samples(first))
+        }
+        OPERA_TEST_EQUALS(history->oldest_pinned_snapshot_time(),std::numeric_limits<TimestampType>::max())
+        history->remove_older_than(time);
+        OPERA_TEST_EQUALS(history->__num_samples_entries(first),1)
+    }
 };
 
 int main() {
@@ -280,6 +280,12 @@ class TestLookAheadJobFactory {
         OPERA_TEST_EQUALS(wj.initial_time(),5000)
         OPERA_TEST_EQUALS(wj.snapshot_time(),5000)
         OPERA_TEST_EQUALS(wj.prediction_trace().ending_mode(),updated_mode)
+        OPERA_TEST_EQUALS(factory.has_registered(woken.at(0).first),factory.has_registered(wj.initial_time(),wj.id(),wj.path()))
+
+        auto created = factory.create_new(id, 6000, sample, ModeTrace().push_back(final_mode), LookAheadJobPath());
+        OPERA_TEST_ASSERT(factory.has_registered(created))
+        OPERA_TEST_ASSERT(factory.has_registered(6000, id, LookAheadJobPath()))
+        OPERA_TEST_ASSERT(not factory.has_registered(job))
 
         auto factory2 = ReuseLookAheadJobFactory(KeepOneMinimumDistanceBarrierSequenceUpdatePolicy(),ReuseEquivalence::STRONG);
         ReuseLookAheadJob job2(id, 4000, 4000, sample, ModeTrace().push_back(original_mode).push_back(updated_mode), LookAheadJobPath().add(0, 1),
@@ -26,6 +26,8 @@
  * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#include <array>
+#include <thread>
 #include "lookahead_job_registry.hpp"
 
 #include "test.hpp"
@@ -37,7 +39,10 @@ class TestLookAheadJobRegistry {
     void test() {
         OPERA_TEST_CALL(test_lookaheadjob_treenode())
         OPERA_TEST_CALL(test_lookaheadjob_registry_entry())
+        OPERA_TEST_CALL(test_lookaheadjob_registry_entry_concurrent())
         OPERA_TEST_CALL(test_lookaheadjob_registry())
+        OPERA_TEST_CALL(test_lookaheadjob_registry_eviction())
+        OPERA_TEST_CALL(test_lookaheadjob_registry_eviction_unshared())
     }
 
     void test_lookaheadjob_treenode() {
@@ -109,6 +114,42 @@ class TestLookAheadJobRegistry {
         OPERA_TEST_ASSERT(not entry.has_registered(id, LookAheadJobPath().add(0, 2).add(0, 3)))
     }
 
+    void test_lookaheadjob_registry_entry_concurrent() {
+        SizeType const num_threads = 8;
+        SizeType const num_ids = 4;
+        SizeType const num_priorities = 6;
+        SizeType const num_paths = num_ids*num_priorities*num_priorities;
+        LookAheadJobRegistryEntry entry(1000);
+        List<LookAheadJobIdentifier> ids;
+        for (SizeType i=0; i<num_ids; ++i) ids.emplace_back("h" + std::to_string(i),0,"r0",1);
+        auto path_of = [&](SizeType const& k) { return LookAheadJobPath().add((k/num_priorities)%num_priorities,1).add(k%num_priorities,2); };
+
+        std::array<std::atomic<SizeType>,num_paths> registrations;
+        for (auto& r : registrations) r.store(0);
+        std::atomic<SizeType> lost(0);
+        List<std::thread> threads;
+        for (SizeType t=0; t<num_threads; ++t) {
+            threads.emplace_back([&,t]{
+                for (SizeType n=0; n<num_paths; ++n) {
+                    auto const k = (n + t*num_paths/num_threads) % num_paths;
+                    auto const& id = ids.at(k/(num_priorities*num_priorities));
+                    auto const path = path_of(k);
+                    if (entry.try_register(id,path)) ++registrations[k];
+                    if (not entry.has_registered(id,path)) ++lost;
+                }
+            });
+        }
+        for (auto& thr : threads) thr.join();
+
+        OPERA_TEST_EQUALS(lost.load(),0)
+        SizeType duplicated_or_missing = 0;
+        for (SizeType k=0; k<num_paths; ++k) {
+            if (registrations[k].load() != 1) ++duplicated_or_missing;
+            if (not entry.has_registered(ids.at(k/(num_priorities*num_priorities)),path_of(k))) ++duplicated_or_missing;
+        }
+        OPERA_TEST_EQUALS(duplicated_or_missing,0)
+    }
+
     void test_lookaheadjob_registry() {
         LookAheadJobRegistry registry;
         LookAheadJobIdentifier id1({"h0",0,"r0",1});
@@ -127,6 +168,37 @@ class TestLookAheadJobRegistry {
         OPERA_TEST_ASSERT(registry.try_register(2000,id2,LookAheadJobPath().add(0,1).add(0,2)))
         OPERA_TEST_ASSERT(registry.has_registered(2000, id2, LookAheadJobPath().add(0, 1).add(0, 2)))
     }
+
+    void test_lookaheadjob_registry_eviction() {
+        LookAheadJobRegistry registry;
+        LookAheadJobIdentifier id({"h0",0,"r0",1});
+        OPERA_TEST_ASSERT(registry.try_register(1000,id,LookAheadJobPath()))
+        auto entry2000 = registry.entry(2000);
+        OPERA_TEST_ASSERT(entry2000->try_register(id,LookAheadJobPath()))
+        OPERA_TEST_EQUALS(registry.size(),2)
+        auto entry3000 = registry.entry(3000);
+        OPERA_TEST_EQUALS(registry.size(),2)
+        OPERA_TEST_ASSERT(not registry.has_registered(1000,id,LookAheadJobPath()))
+        OPERA_TEST_ASSERT(registry.has_registered(2000,id,LookAheadJobPath()))
+        OPERA_TEST_ASSERT(registry.entry(3000) == entry3000)
+        entry2000 = nullptr;
+        OPERA_TEST_ASSERT(registry.try_register(4000,id,LookAheadJobPath()))
+        OPERA_TEST_EQUALS(registry.size(),2)
+        OPERA_TEST_ASSERT(not registry.has_registered(2000,id,LookAheadJobPath()))
+        OPERA_TEST_ASSERT(registry.try_register(1500,id,LookAheadJobPath()))
+        OPERA_TEST_FAIL(registry.entry(3500))
+    }
+
+    void test_lookaheadjob_registry_eviction_unshared() {
+        LookAheadJobRegistry registry;
+        LookAheadJobIdentifier id({"h0",0,"r0",1});
+        for (TimestampType t=1; t<=100; ++t) {
+            OPERA_TEST_ASSERT(registry.try_register(t*1000,id,LookAheadJobPath()))
+            OPERA_TEST_ASSERT(registry.size() <= LOOKAHEAD_JOB_REGISTRY_MIN_EVICTION_SIZE)
+        }
+        OPERA_TEST_ASSERT(registry.has_registered(100000,id,LookAheadJobPath()))
+        OPERA_TEST_ASSERT(not registry.has_registered(98000,id,LookAheadJobPath()))
+    }
 };
 
 int main() {
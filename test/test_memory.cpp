@@ -75,9 +75,63 @@ public:
     }
 };
 
+class TestMemoryRing {
+  public:
+    void test() {
+        OPERA_TEST_CALL(test_put_take())
+        OPERA_TEST_CALL(test_subscriber_skip())
+    }
+
+    void test_put_take() {
+        MemoryRing<SizeType> ring(3);
+        SizeType cursor = ring.end();
+        std::atomic<bool> stopped = false;
+        List<SharedPointer<SizeType const>> messages;
+        for (SizeType i=0; i<5; ++i) ring.put(std::make_shared<SizeType const>(i));
+        OPERA_TEST_EQUALS(ring.size(),3)
+        OPERA_TEST_EQUALS(ring.end(),5)
+        OPERA_TEST_EQUALS(ring.take(cursor,messages,stopped),2)
+        OPERA_TEST_EQUALS(cursor,5)
+        OPERA_TEST_EQUALS(messages.size(),3)
+        OPERA_TEST_EQUALS(*messages.at(0),2)
+        OPERA_TEST_EQUALS(*messages.at(2),4)
+        ring.clear();
+        OPERA_TEST_EQUALS(ring.size(),0)
+        OPERA_TEST_EQUALS(ring.end(),5)
+        stopped = true;
+        messages.clear();
+        OPERA_TEST_EQUALS(ring.take(cursor,messages,stopped),0)
+        OPERA_TEST_ASSERT(messages.empty())
+    }
+
+    void test_subscriber_skip() {
+        MemoryBroker::instance().set_capacity(4);
+        BodyPresentationMessage bp("human1", {{"nose", "neck"}}, {1.0});
+        std::promise<void> release_promise;
+        std::shared_future<void> release_future = release_promise.get_future().share();
+        std::atomic<SizeType> num_received = 0;
+        auto subscriber = new MemorySubscriber<BodyPresentationMessage>([&](auto const&){ release_future.wait(); ++num_received; });
+        MemoryPublisher<BodyPresentationMessage> publisher;
+        publisher.put(bp);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        for (SizeType i=0; i<10; ++i) publisher.put(bp);
+        OPERA_TEST_EQUALS(MemoryBroker::instance().size<BodyPresentationMessage>(),4)
+        release_promise.set_value();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        OPERA_TEST_EQUALS(num_received,5)
+        OPERA_TEST_EQUALS(subscriber->num_skipped(),6)
+        OPERA_TEST_EQUALS(MemoryBroker::instance().num_skipped<BodyPresentationMessage>(),6)
+        delete subscriber;
+        MemoryBroker::instance().clear();
+        OPERA_TEST_EQUALS(MemoryBroker::instance().num_skipped<BodyPresentationMessage>(),0)
+        MemoryBroker::instance().set_capacity(MEMORY_BROKER_DEFAULT_CAPACITY);
+    }
+};
+
 int main() {
     BrokerAccess access = MemoryBrokerAccess();
     TestBrokerAccess(access).test();
     TestBrokerClear().test();
+    TestMemoryRing().test();
     return OPERA_TEST_FAILURES;
 }
@@ -38,6 +38,7 @@ public:
         OPERA_TEST_CALL(test_human_presentation_message_create())
         OPERA_TEST_CALL(test_robot_presentation_message_create())
         OPERA_TEST_CALL(test_human_state_message_create())
+        OPERA_TEST_CALL(test_human_state_message_build())
         OPERA_TEST_CALL(test_robot_state_message_create())
         OPERA_TEST_CALL(test_notification_message_create())
     }
@@ -63,7 +64,7 @@ public:
         HumanStateMessage p({{"h0",{{{"nose",{Point(0,0,0)}},{"neck",{Point(0,2,0)}}}}}},300);
         OPERA_TEST_EQUALS(p.bodies().size(),1)
         OPERA_TEST_EQUALS(p.timestamp(),300)
-        auto const& bd = p.bodies().at(0);
+        auto bd = p.bodies().at(0);
         OPERA_TEST_EQUALS(bd.first,"h0")
         OPERA_TEST_EQUALS(bd.second.size(),2)
     }
@@ -74,6 +75,8 @@ public:
         OPERA_TEST_EQUALS(p.id(),"r0")
         OPERA_TEST_EQUALS(p.mode(),loc)
         OPERA_TEST_EQUALS(p.points().size(),3)
+        OPERA_TEST_EQUALS(p.num_points(),3)
+        OPERA_TEST_EQUALS(p.samples(2)[0],Point(0,4,0))
         OPERA_TEST_EQUALS(p.timestamp(),200)
     }
 
@@ -93,6 +96,39 @@ public:
         OPERA_TEST_EQUALS(p.collision_mode(), loc)
         OPERA_TEST_EQUALS(p.likelihood(),1.0)
     }
+
+    void test_human_state_message_build() {
+        HumanStateMessageBuilder builder;
+        builder.add_body("h0");
+        builder.add_keypoint("nose");
+        builder.add_sample(Point(0,0,0));
+        builder.add_sample(Point(0,1,0));
+        builder.add_keypoint("neck");
+        builder.add_body("h1");
+        builder.add_keypoint("nose");
+        builder.add_sample(Point(1,0,0));
+        builder.add_keypoint("neck");
+        builder.add_sample(Point(1,2,0));
+        builder.add_body("h2");
+        builder.add_keypoint("nose");
+        auto p = builder.build(300);
+        OPERA_TEST_EQUALS(p.timestamp(),300)
+        OPERA_TEST_EQUALS(p.num_bodies(),3)
+        OPERA_TEST_EQUALS(p.body_id(1),"h1")
+        OPERA_TEST_EQUALS(p.keypoint_ids(0).size(),2)
+        OPERA_TEST_EQUALS(p.keypoint_ids(0).at(1),"neck")
+        OPERA_TEST_EQUALS(p.samples(0,0).size(),2)
+        OPERA_TEST_EQUALS(p.samples(0,1).size(),0)
+        OPERA_TEST_EQUALS(p.samples(1,1)[0],Point(1,2,0))
+        OPERA_TEST_ASSERT(p.shared_keypoint_ids(0) == p.shared_keypoint_ids(1))
+        OPERA_TEST_ASSERT(p.shared_keypoint_ids(0) != p.shared_keypoint_ids(2))
+        OPERA_TEST_EQUALS(p.keypoint_ids(2).size(),1)
+        OPERA_TEST_FAIL(p.samples(2,1))
+
+        HumanStateMessage q({{"h0",{{{"neck",{}},{"nose",{Point(0,0,0)}}}}}},400);
+        HumanStateMessage r({{"h1",{{{"neck",{Point(0,2,0)}},{"nose",{}}}}}},500);
+        OPERA_TEST_ASSERT(q.shared_keypoint_ids(0) == r.shared_keypoint_ids(0))
+    }
 };
 
 
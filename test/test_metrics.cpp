@@ -0,0 +1,147 @@
+/***************************************************************************
+ *            test_metrics.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <filesystem>
+#include <fstream>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "test.hpp"
+#include "metrics.hpp"
+
+using namespace Opera;
+
+class TestMetrics {
+  public:
+    void test() {
+        OPERA_TEST_CALL(test_counter())
+        OPERA_TEST_CALL(test_histogram())
+        OPERA_TEST_CALL(test_registry())
+        OPERA_TEST_CALL(test_gauge())
+        OPERA_TEST_CALL(test_text())
+        OPERA_TEST_CALL(test_file())
+        OPERA_TEST_CALL(test_http())
+    }
+
+    void test_counter() {
+        MetricsCounter counter;
+        List<std::thread> threads;
+        for (SizeType i=0; i<4; ++i)
+            threads.emplace_back([&counter]{ for (SizeType j=0; j<1000; ++j) counter.add(); });
+        for (auto& t : threads) t.join();
+        counter.add(5);
+        OPERA_TEST_EQUALS(counter.value(),4005)
+    }
+
+    void test_histogram() {
+        MetricsHistogram histogram({1.0,2.0,4.0});
+        histogram.observe(0.5);
+        histogram.observe(1.0);
+        histogram.observe(3.0);
+        histogram.observe(10.0);
+        OPERA_TEST_ASSERT(histogram.cumulative_counts() == List<uint64_t>({2,2,3,4}))
+        OPERA_TEST_EQUALS(histogram.sum(),14.5)
+        OPERA_TEST_FAIL(MetricsHistogram({2.0,1.0}))
+    }
+
+    void test_registry() {
+        auto& metrics = MetricsRegistry::instance();
+        auto& counter1 = metrics.counter("test_registry_total","A counter");
+        auto& counter2 = metrics.counter("test_registry_total","A counter");
+        auto& counter3 = metrics.counter("test_registry_total","A counter","kind=\"other\"");
+        OPERA_TEST_ASSERT(&counter1 == &counter2)
+        OPERA_TEST_ASSERT(&counter1 != &counter3)
+        OPERA_TEST_FAIL(metrics.histogram("test_registry_total","A histogram",{1.0}))
+    }
+
+    void test_gauge() {
+        auto& metrics = MetricsRegistry::instance();
+        auto identifier = metrics.add_gauge("test_gauge","A gauge",[]{ return 3.5; });
+        OPERA_TEST_ASSERT(metrics.to_text().find("test_gauge 3.5\n") != std::string::npos)
+        metrics.remove_gauge(identifier);
+        OPERA_TEST_ASSERT(metrics.to_text().find("test_gauge") == std::string::npos)
+        auto resolving = metrics.add_gauge("test_resolving_gauge","A gauge resolving a metric when sampled",[&metrics]{
+            return static_cast<FloatType>(metrics.counter("test_resolved_total","Resolved counter").value()); });
+        OPERA_TEST_ASSERT(metrics.to_text().find("test_resolving_gauge 0\n") != std::string::npos)
+        metrics.remove_gauge(resolving);
+    }
+
+    void test_text() {
+        auto& metrics = MetricsRegistry::instance();
+        metrics.counter("test_text_total","Text counter","kind=\"a\"").add(2);
+        metrics.histogram("test_text_seconds","Text histogram",{0.5,1.0}).observe(0.75);
+        auto text = metrics.to_text();
+        OPERA_PRINT_TEST_COMMENT(text)
+        OPERA_TEST_ASSERT(text.find("# HELP test_text_total Text counter\n# TYPE test_text_total counter\ntest_text_total{kind=\"a\"} 2\n") != std::string::npos)
+        OPERA_TEST_ASSERT(text.find("# TYPE test_text_seconds histogram\n") != std::string::npos)
+        OPERA_TEST_ASSERT(text.find("test_text_seconds_bucket{le=\"0.5\"} 0\ntest_text_seconds_bucket{le=\"1\"} 1\ntest_text_seconds_bucket{le=\"+Inf\"} 1\n") != std::string::npos)
+        OPERA_TEST_ASSERT(text.find("test_text_seconds_sum 0.75\ntest_text_seconds_count 1\n") != std::string::npos)
+    }
+
+    void test_file() {
+        auto path = (std::filesystem::temp_directory_path() / "opera_test_metrics.prom").string();
+        MetricsRegistry::instance().counter("test_file_total","File counter").add();
+        MetricsRegistry::instance().export_to_file(path,10);
+        MetricsRegistry::instance().stop_exporting();
+        std::ifstream ifs(path);
+        std::string content((std::istreambuf_iterator<char>(ifs)),std::istreambuf_iterator<char>());
+        OPERA_TEST_ASSERT(content.find("test_file_total 1\n") != std::string::npos)
+        std::filesystem::remove(path);
+    }
+
+    void test_http() {
+        int const port = 47312;
+        MetricsRegistry::instance().counter("test_http_total","HTTP counter").add(3);
+        MetricsRegistry::instance().serve(port);
+
+        int descriptor = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        OPERA_TEST_EQUALS(connect(descriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)),0)
+        std::string request = "GET /metrics HTTP/1.0\r\n\r\n";
+        OPERA_TEST_ASSERT(send(descriptor, request.data(), request.size(), 0) > 0)
+        std::string response;
+        char buffer[4096];
+        ssize_t received;
+        while ((received = recv(descriptor, buffer, sizeof(buffer), 0)) > 0) response.append(buffer, static_cast<SizeType>(received));
+        close(descriptor);
+        MetricsRegistry::instance().stop_exporting();
+
+        OPERA_TEST_ASSERT(response.starts_with("HTTP/1.0 200 OK\r\n"))
+        OPERA_TEST_ASSERT(response.find("test_http_total 3\n") != std::string::npos)
+    }
+};
+
+int main() {
+    TestMetrics().test();
+    return OPERA_TEST_FAILURES;
+}
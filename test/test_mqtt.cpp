@@ -51,5 +51,11 @@ int main() {
 
     BrokerAccess access = MqttBrokerAccess(MQTT_HOST,1883);
     TestBrokerAccess(access).test();
+
+    MqttQualityOfService qos;
+    qos.human_state = 1;
+    qos.collision_notification = 2;
+    BrokerAccess pooled_access = MqttBrokerAccess(MQTT_HOST,1883,MessageEncoding::JSON,qos,2);
+    TestBrokerAccess(pooled_access).test();
     return OPERA_TEST_FAILURES;
 }
@@ -0,0 +1,227 @@
+/***************************************************************************
+ *            test_record.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <filesystem>
+#include <atomic>
+#include <thread>
+#include "test.hpp"
+#include "record.hpp"
+
+using namespace Opera;
+
+class TestRecord {
+  public:
+    void test() {
+        OPERA_TEST_CALL(test_log())
+        OPERA_TEST_CALL(test_log_growth())
+        OPERA_TEST_CALL(test_record_replay())
+        OPERA_TEST_CALL(test_replay_filter())
+        OPERA_TEST_CALL(test_replay_timing())
+        OPERA_TEST_CALL(test_replay_drained())
+        OPERA_TEST_CALL(test_replay_remove_from_handler())
+        std::filesystem::remove(_path);
+    }
+
+    HumanStateMessage make_human_state(BodyIdType const& id, TimestampType const& timestamp) {
+        Map<KeypointIdType,List<Point>> keypoints({{"head",{Point(0,0,0)}},{"neck",{Point(0,2,0)}}});
+        return HumanStateMessage({HumanStateMessageBodyType(id,keypoints)},timestamp);
+    }
+
+    void test_log() {
+        {
+            MessageLogWriter writer(_path,MessageEncoding::JSON);
+            writer.append(BinaryMessageKind::HUMAN_STATE,"hs","first");
+            writer.append(BinaryMessageKind::ROBOT_STATE,"rs","");
+            writer.append(BinaryMessageKind::HUMAN_STATE,"other","third");
+            OPERA_TEST_EQUALS(writer.num_entries(),3)
+        }
+        MessageLogReader reader(_path);
+        OPERA_TEST_EQUALS(reader.encoding(),MessageEncoding::JSON)
+        SizeType offset = reader.begin();
+        MessageLogEntry entry;
+        List<String> contents;
+        while (reader.next(offset,entry)) {
+            OPERA_TEST_ASSERT(entry.elapsed.count() >= 0)
+            contents.push_back(String(entry.topic) + ":" + String(entry.payload));
+        }
+        OPERA_TEST_ASSERT(contents == List<String>({"hs:first","rs:","other:third"}))
+        OPERA_TEST_EQUALS(offset,std::filesystem::file_size(_path))
+        OPERA_TEST_FAIL(MessageLogReader(Resources::path("json/examples/state/robot0.json")))
+    }
+
+    void test_log_growth() {
+        String payload(1000,'x');
+        {
+            MessageLogWriter writer(_path,MessageEncoding::BINARY);
+            for (SizeType i=0; i<3000; ++i) writer.append(BinaryMessageKind::ROBOT_STATE,"rs",payload);
+            OPERA_TEST_ASSERT(writer.size() > 3000000)
+        }
+        MessageLogReader reader(_path);
+        SizeType offset = reader.begin();
+        MessageLogEntry entry;
+        SizeType num_entries = 0;
+        while (reader.next(offset,entry)) if (entry.payload == payload) ++num_entries;
+        OPERA_TEST_EQUALS(num_entries,3000)
+    }
+
+    void test_record_replay() {
+        MemoryBroker::instance().clear();
+        BodyPresentationMessage bp("human1", {{"nose", "neck"}}, {1.0});
+        RobotStateMessage rs("robot0", Mode({{"origin", "3"}}), {{}, {Point(0, -1, 0.1)}}, 93249);
+        std::atomic<SizeType> num_received = 0;
+        {
+            RecordingBrokerAccess access(MemoryBrokerAccess(),_path);
+            auto bp_subscriber = access.make_body_presentation_subscriber([&](auto const&){ ++num_received; });
+            auto hs_subscriber = access.make_human_state_subscriber([&](auto const&){ ++num_received; });
+            auto rs_subscriber = access.make_robot_state_subscriber([&](auto const&){ ++num_received; });
+            auto bp_publisher = access.make_body_presentation_publisher();
+            auto hs_publisher = access.make_human_state_publisher();
+            auto rs_publisher = access.make_robot_state_publisher();
+            bp_publisher->put(bp);
+            for (TimestampType t=1; t<=10; ++t) {
+                hs_publisher->put(make_human_state("h0",t));
+                rs_publisher->put(rs);
+            }
+            for (SizeType i=0; i<200 and num_received < 21; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            OPERA_TEST_EQUALS(num_received,21)
+            OPERA_TEST_EQUALS(access.log().num_entries(),21)
+            delete bp_subscriber; delete hs_subscriber; delete rs_subscriber;
+            delete bp_publisher; delete hs_publisher; delete rs_publisher;
+        }
+
+        List<BinaryMessageKind> recorded_kinds;
+        {
+            MessageLogReader reader(_path);
+            SizeType offset = reader.begin();
+            MessageLogEntry entry;
+            while (reader.next(offset,entry)) recorded_kinds.push_back(entry.kind);
+        }
+
+        ReplayBrokerAccess access(_path);
+        List<BinaryMessageKind> replayed_kinds;
+        List<TimestampType> human_timestamps;
+        auto bp_subscriber = access.make_body_presentation_subscriber([&](auto const& msg){ replayed_kinds.push_back(BinaryMessageKind::BODY_PRESENTATION); OPERA_TEST_EQUALS(msg.id(),"human1") });
+        auto hs_subscriber = access.make_human_state_subscriber([&](auto const& msg){ replayed_kinds.push_back(BinaryMessageKind::HUMAN_STATE); human_timestamps.push_back(msg.timestamp()); });
+        auto rs_subscriber = access.make_robot_state_subscriber([&](auto const&){ replayed_kinds.push_back(BinaryMessageKind::ROBOT_STATE); });
+        auto other_subscriber = access.make_robot_state_subscriber([&](auto const&){ replayed_kinds.push_back(BinaryMessageKind::COLLISION_NOTIFICATION); },RobotStateTopic("other"));
+        ReplayBrokerAccess copy = access;
+        OPERA_TEST_EQUALS(copy.play(),21)
+        OPERA_TEST_ASSERT(replayed_kinds == recorded_kinds)
+        OPERA_TEST_ASSERT(human_timestamps == List<TimestampType>({1,2,3,4,5,6,7,8,9,10}))
+        replayed_kinds.clear();
+        delete rs_subscriber;
+        OPERA_TEST_EQUALS(access.play(),11)
+        OPERA_TEST_EQUALS(replayed_kinds.size(),11)
+        delete bp_subscriber; delete hs_subscriber; delete other_subscriber;
+    }
+
+    void test_replay_filter() {
+        {
+            MessageLogWriter writer(_path,MessageEncoding::JSON);
+            for (TimestampType t=1; t<=4; ++t)
+                writer.append(BinaryMessageKind::HUMAN_STATE,HumanStateTopic::DEFAULT,encode(make_human_state(t % 2 == 0 ? "h0" : "h1",t),MessageEncoding::JSON));
+        }
+        ReplayBrokerAccess access(_path);
+        List<TimestampType> timestamps;
+        auto subscriber = access.make_human_state_subscriber([&](auto const& msg){ timestamps.push_back(msg.timestamp()); },HumanStateTopic::DEFAULT,
+                                                             [](MessageHeader const& header){ return header.body_ids.at(0) == "h0"; });
+        access.play();
+        OPERA_TEST_ASSERT(timestamps == List<TimestampType>({2,4}))
+        delete subscriber;
+    }
+
+    void test_replay_timing() {
+        {
+            MessageLogWriter writer(_path,MessageEncoding::BINARY);
+            writer.append(BinaryMessageKind::HUMAN_STATE,HumanStateTopic::DEFAULT,encode(make_human_state("h0",1),MessageEncoding::BINARY));
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            writer.append(BinaryMessageKind::HUMAN_STATE,HumanStateTopic::DEFAULT,encode(make_human_state("h0",2),MessageEncoding::BINARY));
+        }
+        ReplayBrokerAccess access(_path);
+        SizeType num_received = 0;
+        auto subscriber = access.make_human_state_subscriber([&](auto const&){ ++num_received; });
+        auto start = std::chrono::steady_clock::now();
+        access.play(ReplayTiming::ORIGINAL);
+        auto original_duration = std::chrono::steady_clock::now() - start;
+        OPERA_TEST_ASSERT(original_duration >= std::chrono::milliseconds(50))
+        OPERA_TEST_EQUALS(num_received,2)
+        delete subscriber;
+    }
+
+    void test_replay_drained() {
+        {
+            MessageLogWriter writer(_path,MessageEncoding::BINARY);
+            for (TimestampType t=1; t<=5; ++t)
+                writer.append(BinaryMessageKind::HUMAN_STATE,HumanStateTopic::DEFAULT,encode(make_human_state("h0",t),MessageEncoding::BINARY));
+        }
+        ReplayBrokerAccess access(_path);
+        std::atomic<SizeType> num_unprocessed = 0;
+        std::atomic<SizeType> num_processed = 0;
+        SizeType num_overlapping = 0;
+        List<std::thread> workers;
+        auto subscriber = access.make_human_state_subscriber([&](auto const&){
+            if (num_unprocessed > 0) ++num_overlapping;
+            ++num_unprocessed;
+            workers.emplace_back([&]{
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                ++num_processed;
+                --num_unprocessed;
+            });
+        });
+        OPERA_TEST_EQUALS(access.play(ReplayTiming::MAXIMUM,[&]{ return num_unprocessed == 0; }),5)
+        OPERA_TEST_EQUALS(num_processed,5)
+        OPERA_TEST_EQUALS(num_overlapping,0)
+        for (auto& thr : workers) thr.join();
+        delete subscriber;
+    }
+
+    void test_replay_remove_from_handler() {
+        {
+            MessageLogWriter writer(_path,MessageEncoding::BINARY);
+            for (TimestampType t=1; t<=3; ++t)
+                writer.append(BinaryMessageKind::HUMAN_STATE,HumanStateTopic::DEFAULT,encode(make_human_state("h0",t),MessageEncoding::BINARY));
+        }
+        ReplayBrokerAccess access(_path);
+        SizeType num_received = 0;
+        SubscriberInterface<HumanStateMessage>* subscriber = nullptr;
+        subscriber = access.make_human_state_subscriber([&](auto const&){
+            ++num_received;
+            delete subscriber;
+        });
+        OPERA_TEST_EQUALS(access.play(),1)
+        OPERA_TEST_EQUALS(num_received,1)
+    }
+
+  private:
+    String const _path = (std::filesystem::temp_directory_path() / "opera_test_record.log").string();
+};
+
+int main() {
+    TestRecord().test();
+    return OPERA_TEST_FAILURES;
+}
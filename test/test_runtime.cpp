@@ -52,18 +52,22 @@ class TestRuntime {
         OPERA_TEST_EQUALS(configuration.get_history_retention(),3600)
         OPERA_TEST_EQUALS(configuration.get_history_purge_period(),300)
         OPERA_TEST_EQUALS(configuration.get_concurrency(),std::thread::hardware_concurrency())
+        OPERA_TEST_EQUALS(configuration.get_ingestion_concurrency(),DEFAULT_INGESTION_CONCURRENCY)
 
         OPERA_TEST_FAIL(configuration.set_history_purge_period(3600))
         OPERA_TEST_FAIL(configuration.set_history_retention(300))
         OPERA_TEST_FAIL(configuration.set_concurrency(std::thread::hardware_concurrency()+1))
+        OPERA_TEST_FAIL(configuration.set_ingestion_concurrency(0))
 
         configuration.set_history_retention(1000);
         configuration.set_history_purge_period(200);
         configuration.set_concurrency(1);
+        configuration.set_ingestion_concurrency(4);
 
         OPERA_TEST_EQUALS(configuration.get_history_retention(),1000)
         OPERA_TEST_EQUALS(configuration.get_history_purge_period(),200)
         OPERA_TEST_EQUALS(configuration.get_concurrency(),1)
+        OPERA_TEST_EQUALS(configuration.get_ingestion_concurrency(),4)
 
         OPERA_TEST_EXECUTE(configuration.set_job_factory(DiscardLookAheadJobFactory()))
     }
@@ -42,6 +42,10 @@ class TestRuntimeIO {
         OPERA_TEST_CALL(test_receiver_robot())
         OPERA_TEST_CALL(test_receiver_both())
         OPERA_TEST_CALL(test_receiver_remove_old())
+        OPERA_TEST_CALL(test_receiver_sharded_ordering())
+        OPERA_TEST_CALL(test_receiver_default_sharding())
+        OPERA_TEST_CALL(test_receiver_filtering())
+        OPERA_TEST_CALL(test_receiver_filtering_after_removal())
     }
 
     void test_sender() {
@@ -67,16 +71,16 @@ class TestRuntimeIO {
         HumanStateMessage hs({{id,{{{"nose",{Point(0,0,0)}},{"neck",{Point(0,2,0)}},{"mid_hip",{Point(0,4,0)}}}}}},300);
         auto bp_publisher = access.make_body_presentation_publisher();
         auto hs_publisher = access.make_human_state_publisher();
-        hs_publisher->put(hs);
         OPERA_TEST_ASSERT(not registry.contains(id))
         OPERA_TEST_FAIL(registry.latest_human_instance_within(id,0))
+        hs_publisher->put(hs);
         bp_publisher->put(hp);
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
         OPERA_TEST_ASSERT(registry.contains(id))
         hs_publisher->put(hs);
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        auto const& last_state = registry.latest_human_instance_within(id,300);
-        OPERA_TEST_EQUALS(last_state.timestamp(),300)
+        auto last_state = registry.latest_human_instance_within(id,300);
+        OPERA_TEST_EQUALS(last_state->timestamp(),300)
         delete bp_publisher;
         delete hs_publisher;
         MemoryBroker::instance().clear();
@@ -142,7 +146,7 @@ class TestRuntimeIO {
         RobotStateMessage rs2(rid,running,{{Point(0,0,0)},{Point(0,2,0)},{Point(0,4,0)}},3100);
         rs_publisher->put(rs2);
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        OPERA_TEST_EQUALS(registry.robot_history(rid).snapshot_at(3100).modes_with_samples().size(), 1)
+        OPERA_TEST_EQUALS(registry.robot_history(rid)->snapshot_at(3100).modes_with_samples().size(), 1)
 
         RobotStateMessage rs3(rid,waiting,{{Point(0,0,0)},{Point(0,2,0)},{Point(0,4,0)}},3200);
         rs_publisher->put(rs3);
@@ -206,8 +210,134 @@ class TestRuntimeIO {
         delete rs_publisher;
         MemoryBroker::instance().clear();
     }
+
+    void test_receiver_sharded_ordering() {
+        BrokerAccess access = MemoryBrokerAccess();
+        LookAheadJobFactory job_factory = DiscardLookAheadJobFactory();
+        BodyRegistry registry;
+        SynchronisedQueue<LookAheadJob> waiting_jobs, sleeping_jobs;
+        RuntimeReceiver receiver({access,BodyPresentationTopic::DEFAULT},{access,HumanStateTopic::DEFAULT},{access,RobotStateTopic::DEFAULT},
+                                 job_factory, 3600, 300, registry, waiting_jobs, sleeping_jobs, 3);
+        OPERA_TEST_EQUALS(receiver.num_ingestion_shards(),3)
+        SizeType const num_humans = 6;
+        SizeType const num_messages = 50;
+        auto bp_publisher = access.make_body_presentation_publisher();
+        auto hs_publisher = access.make_human_state_publisher();
+        for (SizeType h=0; h<num_humans; ++h)
+            bp_publisher->put(BodyPresentationMessage("h"+std::to_string(h),{{"nose","neck"}},{1.0}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        for (TimestampType t=1; t<=num_messages; ++t) {
+            List<HumanStateMessageBodyType> bodies;
+            for (SizeType h=0; h<num_humans; ++h) {
+                Map<KeypointIdType,List<Point>> points;
+                points.insert(std::make_pair("nose",List<Point>({Point(0,0,0)})));
+                points.insert(std::make_pair("neck",List<Point>({Point(0,2,0)})));
+                bodies.push_back(std::make_pair("h"+std::to_string(h),points));
+            }
+            hs_publisher->put(HumanStateMessage(bodies,t*10));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        OPERA_TEST_EQUALS(receiver.__num_state_messages_received(),num_messages)
+        for (SizeType h=0; h<num_humans; ++h) {
+            auto hid = "h"+std::to_string(h);
+            OPERA_TEST_EQUALS(registry.human_history_size(hid),num_messages)
+            OPERA_TEST_EQUALS(registry.latest_human_timestamp(hid),num_messages*10)
+        }
+        delete bp_publisher;
+        delete hs_publisher;
+        MemoryBroker::instance().clear();
+    }
+
+    void test_receiver_default_sharding() {
+        BrokerAccess access = MemoryBrokerAccess();
+        LookAheadJobFactory job_factory = DiscardLookAheadJobFactory();
+        BodyRegistry registry;
+        SynchronisedQueue<LookAheadJob> waiting_jobs, sleeping_jobs;
+        RuntimeReceiver receiver({access,BodyPresentationTopic::DEFAULT},{access,HumanStateTopic::DEFAULT},{access,RobotStateTopic::DEFAULT},
+                                 job_factory, 3600, 300, registry, waiting_jobs, sleeping_jobs);
+        OPERA_TEST_ASSERT(receiver.num_ingestion_shards() > 1)
+        String first = "h0";
+        String second;
+        for (SizeType i=1; second.empty(); ++i)
+            if (receiver.ingestion_shard_index("h"+std::to_string(i)) != receiver.ingestion_shard_index(first)) second = "h"+std::to_string(i);
+        auto bp_publisher = access.make_body_presentation_publisher();
+        auto hs_publisher = access.make_human_state_publisher();
+        for (auto const& id : {first,second}) bp_publisher->put(BodyPresentationMessage(id,{{"nose","neck"}},{1.0}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        Map<KeypointIdType,List<Point>> keypoints({{"nose",{Point(0,0,0)}},{"neck",{Point(0,2,0)}}});
+        hs_publisher->put(HumanStateMessage({HumanStateMessageBodyType(first,keypoints),HumanStateMessageBodyType(second,keypoints)},300));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        OPERA_TEST_ASSERT(receiver.ingestion_drained())
+        OPERA_TEST_EQUALS(registry.latest_human_timestamp(first),300)
+        OPERA_TEST_EQUALS(registry.latest_human_timestamp(second),300)
+        delete bp_publisher;
+        delete hs_publisher;
+        MemoryBroker::instance().clear();
+    }
+
+    void test_receiver_filtering() {
+        BrokerAccess access = MemoryBrokerAccess();
+        LookAheadJobFactory job_factory = DiscardLookAheadJobFactory();
+        BodyRegistry registry;
+        SynchronisedQueue<LookAheadJob> waiting_jobs, sleeping_jobs;
+        RuntimeReceiver receiver({access,BodyPresentationTopic::DEFAULT},{access,HumanStateTopic::DEFAULT},{access,RobotStateTopic::DEFAULT},
+                                 job_factory, 3600, 300, registry, waiting_jobs, sleeping_jobs);
+        auto bp_publisher = access.make_body_presentation_publisher();
+        auto hs_publisher = access.make_human_state_publisher();
+        auto rs_publisher = access.make_robot_state_publisher();
+        RobotStateMessage rs("r0",Mode({"phase", "waiting"}),{{Point(0,0,0)},{Point(0,2,0)}},300);
+        rs_publisher->put(rs);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        OPERA_TEST_EQUALS(receiver.__num_state_messages_received(),0)
+        bp_publisher->put(BodyPresentationMessage("r0",10,{{"0","1"}},{1.0}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        rs_publisher->put(rs);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        OPERA_TEST_EQUALS(receiver.__num_state_messages_received(),1)
+        bp_publisher->put(BodyPresentationMessage("h0",{{"nose","neck"}},{1.0}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        for (TimestampType t : List<TimestampType>({20,10,20,30}))
+            hs_publisher->put(HumanStateMessage({{"h0",{{{"nose",{Point(0,0,0)}},{"neck",{Point(0,2,0)}}}}}},t));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        OPERA_TEST_EQUALS(receiver.__num_state_messages_received(),3)
+        OPERA_TEST_EQUALS(registry.latest_human_timestamp("h0"),30)
+        delete bp_publisher;
+        delete hs_publisher;
+        delete rs_publisher;
+        MemoryBroker::instance().clear();
+    }
+
+    void test_receiver_filtering_after_removal() {
+        BrokerAccess access = MemoryBrokerAccess();
+        LookAheadJobFactory job_factory = DiscardLookAheadJobFactory();
+        BodyRegistry registry;
+        SynchronisedQueue<LookAheadJob> waiting_jobs, sleeping_jobs;
+        RuntimeReceiver receiver({access,BodyPresentationTopic::DEFAULT},{access,HumanStateTopic::DEFAULT},{access,RobotStateTopic::DEFAULT},
+                                 job_factory, 3600, 300, registry, waiting_jobs, sleeping_jobs);
+        auto bp_publisher = access.make_body_presentation_publisher();
+        auto hs_publisher = access.make_human_state_publisher();
+        auto rs_publisher = access.make_robot_state_publisher();
+        bp_publisher->put(BodyPresentationMessage("r0",10,{{"0","1"}},{1.0}));
+        bp_publisher->put(BodyPresentationMessage("h0",{{"nose","neck"}},{1.0}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        hs_publisher->put(HumanStateMessage({{"h0",{{{"nose",{Point(0,0,0)}},{"neck",{Point(0,2,0)}}}}}},30000));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        rs_publisher->put(RobotStateMessage("r0",Mode({"phase", "waiting"}),{{Point(0,0,0)},{Point(0,2,0)}},30000+2*HUMAN_RETENTION_TIMEOUT));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        OPERA_TEST_ASSERT(not registry.has_human("h0"))
+        bp_publisher->put(BodyPresentationMessage("h0",{{"nose","neck"}},{1.0}));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        hs_publisher->put(HumanStateMessage({{"h0",{{{"nose",{Point(0,0,0)}},{"neck",{Point(0,2,0)}}}}}},20000));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        OPERA_TEST_EQUALS(receiver.__num_state_messages_received(),3)
+        delete bp_publisher;
+        delete hs_publisher;
+        delete rs_publisher;
+        MemoryBroker::instance().clear();
+    }
 };
 
+
 int main() {
     TestRuntimeIO().test();
     return OPERA_TEST_FAILURES;
@@ -40,6 +40,7 @@ public:
         OPERA_TEST_CALL(test_humanstatemessage())
         OPERA_TEST_CALL(test_robotstatemessage())
         OPERA_TEST_CALL(test_collisionnotificationmessage())
+        OPERA_TEST_CALL(test_to_view())
     }
 
     void test_bodypresentationmessage_human() {
@@ -76,6 +77,19 @@ public:
         serialiser.to_file(Resources::path("json/examples/notification/notification0.tmp.json"));
         OPERA_TEST_EQUALS(serialiser.to_string(),"{\"human\":{\"bodyId\":\"h0\",\"segment\":[\"nose\",\"neck\"]},\"robot\":{\"bodyId\":\"r0\",\"segment\":[\"0\",\"1\"]},\"currentTime\":32890,\"collisionDistance\":{\"lower\":72,\"upper\":123},\"collisionMode\":{\"destination\":\"2\",\"origin\":\"3\",\"phase\":\"pre\"},\"likelihood\":0.5}")
     }
+
+    void test_to_view() {
+        RobotStateMessage p1("robot0", Mode({{"phase", "pre"}}), {{Point(1,2,3)}}, 10);
+        RobotStateMessage p2("robot1", Mode({{"phase", "post"}}), {{}}, 20);
+        Serialiser<RobotStateMessage> serialiser1(p1);
+        Serialiser<RobotStateMessage> serialiser2(p2);
+        auto expected1 = serialiser1.to_string();
+        auto expected2 = serialiser2.to_string();
+        OPERA_TEST_EQUALS(String(serialiser1.to_view()),expected1)
+        auto view = serialiser2.to_view();
+        OPERA_TEST_EQUALS(String(view),expected2)
+        OPERA_TEST_EQUALS(String(serialiser1.to_view()),expected1)
+    }
 };
 
 
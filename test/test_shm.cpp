@@ -0,0 +1,168 @@
+/***************************************************************************
+ *            test_shm.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "test.hpp"
+#include "test_broker_access.hpp"
+#include "shm.hpp"
+
+using namespace Opera;
+
+class TestShmRing {
+  public:
+    void test() {
+        OPERA_TEST_CALL(test_put_take())
+        OPERA_TEST_CALL(test_overrun())
+        OPERA_TEST_CALL(test_shared())
+        OPERA_TEST_CALL(test_concurrent_writers())
+        OPERA_TEST_CALL(test_dead_writer())
+        OPERA_TEST_CALL(test_geometry_mismatch())
+    }
+
+    void test_put_take() {
+        ShmRing::remove("/opera_test_ring");
+        ShmRing ring("/opera_test_ring",4,16);
+        SizeType cursor = ring.end();
+        SizeType num_skipped = 0;
+        String payload;
+        OPERA_TEST_ASSERT(not ring.take(cursor,payload,num_skipped,0))
+        ring.put("first");
+        ring.put("second");
+        OPERA_TEST_ASSERT(ring.take(cursor,payload,num_skipped,0))
+        OPERA_TEST_EQUALS(payload,"first")
+        OPERA_TEST_ASSERT(ring.take(cursor,payload,num_skipped,0))
+        OPERA_TEST_EQUALS(payload,"second")
+        OPERA_TEST_EQUALS(cursor,2)
+        OPERA_TEST_EQUALS(num_skipped,0)
+        OPERA_TEST_FAIL(ring.put("a payload larger than the slot"))
+        ShmRing::remove("/opera_test_ring");
+    }
+
+    void test_overrun() {
+        ShmRing::remove("/opera_test_ring");
+        ShmRing ring("/opera_test_ring",3,16);
+        SizeType cursor = ring.end();
+        SizeType num_skipped = 0;
+        String payload;
+        for (SizeType i=0; i<5; ++i) ring.put(std::to_string(i));
+        OPERA_TEST_ASSERT(ring.take(cursor,payload,num_skipped,0))
+        OPERA_TEST_EQUALS(payload,"2")
+        OPERA_TEST_EQUALS(num_skipped,2)
+        OPERA_TEST_EQUALS(cursor,3)
+        ShmRing::remove("/opera_test_ring");
+    }
+
+    void test_shared() {
+        ShmRing::remove("/opera_test_ring");
+        ShmRing writer("/opera_test_ring",4,16);
+        ShmRing reader("/opera_test_ring",4,16);
+        SizeType cursor = reader.end();
+        SizeType num_skipped = 0;
+        String payload;
+        std::thread thr([&]{
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            writer.put("woken");
+        });
+        OPERA_TEST_ASSERT(reader.take(cursor,payload,num_skipped,1000000))
+        OPERA_TEST_EQUALS(payload,"woken")
+        thr.join();
+        ShmRing::remove("/opera_test_ring");
+    }
+
+    void test_concurrent_writers() {
+        ShmRing::remove("/opera_test_ring");
+        ShmRing ring("/opera_test_ring",4,16);
+        SizeType cursor = ring.end();
+        SizeType num_skipped = 0;
+        String payload;
+        SizeType const num_writers = 4;
+        SizeType const num_puts = 200;
+        List<std::thread> writers;
+        for (SizeType w=0; w<num_writers; ++w)
+            writers.emplace_back([&ring,w]{
+                for (SizeType i=0; i<num_puts; ++i) ring.put(String(8,static_cast<char>('a'+w)));
+            });
+        for (auto& thr : writers) thr.join();
+        SizeType num_taken = 0;
+        while (ring.take(cursor,payload,num_skipped,0)) {
+            ++num_taken;
+            OPERA_TEST_EQUALS(payload.size(),8)
+            OPERA_TEST_EQUALS(payload.find_first_not_of(payload[0]),String::npos)
+        }
+        OPERA_TEST_EQUALS(num_taken+num_skipped,num_writers*num_puts)
+        auto const start = std::chrono::steady_clock::now();
+        OPERA_TEST_ASSERT(not ring.take(cursor,payload,num_skipped,20000))
+        OPERA_TEST_ASSERT(std::chrono::steady_clock::now() - start < std::chrono::seconds(1))
+        ShmRing::remove("/opera_test_ring");
+    }
+
+    void test_dead_writer() {
+        ShmRing::remove("/opera_test_ring");
+        ShmRing ring("/opera_test_ring",1,16);
+        int fd = shm_open("/opera_test_ring", O_RDWR, 0660);
+        OPERA_TEST_ASSERT(fd >= 0)
+        auto const mapped_size = sizeof(ShmRingHeader)+sizeof(uint64_t);
+        void* address = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        OPERA_TEST_ASSERT(address != MAP_FAILED)
+        // A publisher that reserved sequence 0 and claimed its slot, then died before publishing
+        std::atomic_ref<uint64_t>(static_cast<ShmRingHeader*>(address)->reserved_sequence).store(1);
+        std::atomic_ref<uint64_t>(*reinterpret_cast<uint64_t*>(static_cast<char*>(address)+sizeof(ShmRingHeader))).store(1);
+        munmap(address, mapped_size);
+
+        SizeType cursor = ring.end();
+        SizeType num_skipped = 0;
+        String payload;
+        ring.put("alive");
+        OPERA_TEST_ASSERT(ring.take(cursor,payload,num_skipped,0))
+        OPERA_TEST_EQUALS(payload,"alive")
+        OPERA_TEST_EQUALS(cursor,2)
+        ShmRing::remove("/opera_test_ring");
+    }
+
+    void test_geometry_mismatch() {
+        ShmRing::remove("/opera_test_ring");
+        ShmRing ring("/opera_test_ring",4,16);
+        OPERA_TEST_FAIL(ShmRing("/opera_test_ring",8,16))
+        ShmRing::remove("/opera_test_ring");
+    }
+};
+
+int main() {
+    ShmBrokerAccess shm_access("opera_test",64,4096);
+    for (String const& topic : List<String>({BodyPresentationTopic::DEFAULT, HumanStateTopic::DEFAULT, RobotStateTopic::DEFAULT, CollisionNotificationTopic::DEFAULT}))
+        ShmRing::remove(shm_access.ring_name(topic));
+    BrokerAccess access = shm_access;
+    TestBrokerAccess(access).test();
+    TestShmRing().test();
+    for (String const& topic : List<String>({BodyPresentationTopic::DEFAULT, HumanStateTopic::DEFAULT, RobotStateTopic::DEFAULT, CollisionNotificationTopic::DEFAULT}))
+        ShmRing::remove(shm_access.ring_name(topic));
+    return OPERA_TEST_FAILURES;
+}
@@ -40,6 +40,11 @@ public:
         OPERA_TEST_CALL(test_robot_state_history_basics())
         OPERA_TEST_CALL(test_robot_state_history_analytics())
         OPERA_TEST_CALL(test_robot_state_history_can_look_ahead())
+        OPERA_TEST_CALL(test_robot_state_history_snapshot_pinning())
+        OPERA_TEST_CALL(test_snapshot_time_pins())
+        OPERA_TEST_CALL(test_snapshot_time_pin_copies())
+        OPERA_TEST_CALL(test_chunked_sequence())
+        OPERA_TEST_CALL(test_robot_state_history_reclaim())
     }
 
     void test_human_state_instance() {
@@ -87,6 +92,8 @@ public:
         Robot r("r0", 10, {{"3", "2"},{"1", "0"}}, {1.0, 0.5});
         RobotStateHistory history(r);
         Mode empty_mode, first({robot, "first"}), second({robot, "second"});
+        OPERA_TEST_FAIL(RobotStateHistory(Robot("r1", 10, {{"head", "2"}}, {1.0})))
+        OPERA_TEST_FAIL(RobotStateHistory(Robot("r1", 10, {{"3", "2a"}}, {1.0})))
 
         {
             auto snapshot = history.snapshot_at(0);
@@ -306,6 +313,149 @@ public:
             OPERA_TEST_ASSERT(not snapshot.can_look_ahead(ts))
         }
     }
+
+    void test_robot_state_history_snapshot_pinning() {
+        String robot("robot");
+        Robot r("r0", 10, {{"0","1"}}, {1.0});
+        RobotStateHistory history(r);
+        Mode first({robot, "first"}), second({robot, "second"});
+
+        history.acquire(first,{{{"0",{Point(0,0,0)}},{"1",{Point(4,4,4)}}}},0);
+        history.acquire(first,{{{"0",{Point(1,0,0)}},{"1",{Point(4,4,4)}}}},100);
+        history.acquire(second,{{{"0",{Point(1,1,0)}},{"1",{Point(4,4,4)}}}},200);
+
+        auto pinned = history.snapshot_at(1000);
+        OPERA_TEST_EQUALS(pinned.modes_with_samples().size(),1)
+        OPERA_TEST_EQUALS(pinned.presences_exiting_into(first).size(),1)
+        auto const& pinned_samples = pinned.samples(first);
+
+        history.acquire(second,{{{"0",{Point(1,2,0)}},{"1",{Point(4,4,4)}}}},300);
+        history.acquire(first,{{{"0",{Point(2,2,0)}},{"1",{Point(4,4,4)}}}},400);
+        history.acquire(second,{{{"0",{Point(3,2,0)}},{"1",{Point(4,4,4)}}}},500);
+        history.remove_older_than(250);
+
+        auto current = history.snapshot_at(1000);
+        OPERA_TEST_EQUALS(current.modes_with_samples().size(),2)
+        OPERA_TEST_EQUALS(current.presences_exiting_into(first).size(),1)
+        OPERA_TEST_EQUALS(pinned.modes_with_samples().size(),1)
+        OPERA_TEST_EQUALS(pinned.presences_exiting_into(first).size(),1)
+        OPERA_TEST_EQUALS(pinned.presences_exiting_into(first).back().to(),0)
+        OPERA_TEST_EQUALS(pinned_samples.at(0).size(),2)
+        OPERA_TEST_ASSERT(not pinned.can_look_ahead(400))
+    }
+
+    void test_snapshot_time_pins() {
+        SnapshotTimePins pins;
+        OPERA_TEST_EQUALS(pins.oldest(),std::numeric_limits<TimestampType>::max())
+        List<Pair<SizeType,TimestampType>> pinned;
+        for (TimestampType t=NUM_SNAPSHOT_TIME_PIN_SLOTS+10; t>0; --t)
+            pinned.emplace_back(pins.pin(t*10),t*10);
+        OPERA_TEST_EQUALS(pins.oldest(),10)
+        for (auto it = pinned.rbegin(); it != pinned.rend(); ++it) {
+            pins.unpin(it->first,it->second);
+            auto expected = (it->second == (NUM_SNAPSHOT_TIME_PIN_SLOTS+10)*10 ? std::numeric_limits<TimestampType>::max() : it->second+10);
+            OPERA_TEST_EQUALS(pins.oldest(),expected)
+        }
+
+        List<Pair<SizeType,TimestampType>> shared;
+        for (SizeType i=0; i<2*NUM_SNAPSHOT_TIME_PIN_SLOTS; ++i)
+            shared.emplace_back(pins.pin(100+(i%2)),100+(i%2));
+        for (auto const& p : shared)
+            OPERA_TEST_ASSERT(p.first < NUM_SNAPSHOT_TIME_PIN_SLOTS)
+        OPERA_TEST_EQUALS(pins.oldest(),100)
+        for (auto const& p : shared)
+            if (p.second == 100) pins.unpin(p.first,p.second);
+        OPERA_TEST_EQUALS(pins.oldest(),101)
+        for (auto const& p : shared)
+            if (p.second == 101) pins.unpin(p.first,p.second);
+        OPERA_TEST_EQUALS(pins.oldest(),std::numeric_limits<TimestampType>::max())
+    }
+
+    void test_snapshot_time_pin_copies() {
+        SnapshotTimePins pins;
+        auto const none = std::numeric_limits<TimestampType>::max();
+        SnapshotTimePin empty;
+        OPERA_TEST_ASSERT(not empty.is_pinned())
+        {
+            SnapshotTimePin pin(pins,100);
+            OPERA_TEST_ASSERT(pin.is_pinned())
+            {
+                SnapshotTimePin copy(pin);
+                SnapshotTimePin moved(std::move(pin));
+                OPERA_TEST_ASSERT(not pin.is_pinned())
+                OPERA_TEST_EQUALS(pins.oldest(),100)
+                moved = SnapshotTimePin();
+                OPERA_TEST_EQUALS(pins.oldest(),100)
+                empty = copy;
+            }
+            OPERA_TEST_EQUALS(pins.oldest(),100)
+            empty = SnapshotTimePin();
+            OPERA_TEST_EQUALS(pins.oldest(),none)
+        }
+        OPERA_TEST_EQUALS(pins.oldest(),none)
+    }
+
+    void test_chunked_sequence() {
+        ChunkedSequence<SizeType,4> sequence;
+        OPERA_TEST_ASSERT(sequence.empty())
+        OPERA_TEST_FAIL(sequence.pop_front())
+        for (SizeType i=0; i<10; ++i) sequence.push_back(i);
+        auto copy = sequence;
+        for (SizeType i=0; i<5; ++i) copy.pop_front();
+        copy.push_back(10);
+        OPERA_TEST_EQUALS(sequence.size(),10)
+        OPERA_TEST_EQUALS(sequence.back(),9)
+        OPERA_TEST_EQUALS(copy.size(),6)
+        OPERA_TEST_EQUALS(copy.front(),5)
+        OPERA_TEST_EQUALS(copy.back(),10)
+        OPERA_TEST_FAIL(copy.at(6))
+        SizeType expected = 5;
+        for (auto const& e : copy) OPERA_TEST_EQUALS(e,expected++)
+        while (not copy.empty()) copy.pop_front();
+        copy.push_back(11);
+        OPERA_TEST_EQUALS(copy.front(),11)
+        OPERA_TEST_EQUALS(sequence.at(4),4)
+    }
+
+    void test_robot_state_history_reclaim() {
+        String robot("robot");
+        Robot r("r0", 10, {{"0","1"}}, {1.0});
+        RobotStateHistory history(r);
+        Mode first({robot, "first"}), second({robot, "second"});
+
+        TimestampType ts = 0u;
+        for (SizeType i=0; i<5; ++i) {
+            history.acquire(first,{{{"0",{Point(FloatType(i),0,0)}},{"1",{Point(4,4,4)}}}},ts); ts+= 100;
+            history.acquire(first,{{{"0",{Point(FloatType(i),1,0)}},{"1",{Point(4,4,4)}}}},ts); ts+= 100;
+            history.acquire(second,{{{"0",{Point(FloatType(i),2,0)}},{"1",{Point(4,4,4)}}}},ts); ts+= 100;
+            history.acquire(second,{{{"0",{Point(FloatType(i),3,0)}},{"1",{Point(4,4,4)}}}},ts); ts+= 100;
+        }
+        OPERA_TEST_EQUALS(history.__num_samples_entries(first),5)
+        OPERA_TEST_EQUALS(history.__num_samples_entries(second),4)
+
+        {
+            auto snapshot = history.snapshot_at(500);
+            OPERA_TEST_EQUALS(history.oldest_pinned_snapshot_time(),500)
+            history.remove_older_than(1300);
+            OPERA_TEST_EQUALS(history.__num_samples_entries(first),5)
+            OPERA_TEST_EQUALS(history.__num_samples_entries(second),4)
+            OPERA_TEST_EQUALS(snapshot.samples(first).at(0).size(),2)
+        }
+
+        OPERA_TEST_EQUALS(history.oldest_pinned_snapshot_time(),std::numeric_limits<TimestampType>::max())
+        {
+            auto pin = history.pin_snapshot_time(700);
+            history.remove_older_than(1300);
+            OPERA_TEST_EQUALS(history.__num_samples_entries(first),4)
+            OPERA_TEST_EQUALS(history.__num_samples_entries(second),4)
+            OPERA_TEST_EQUALS(history.snapshot_at(700).samples(first).at(0).size(),2)
+        }
+        history.remove_older_than(1300);
+        OPERA_TEST_EQUALS(history.__num_samples_entries(first),3)
+        OPERA_TEST_EQUALS(history.__num_samples_entries(second),2)
+        OPERA_TEST_EQUALS(history.snapshot_at(1300).samples(first).at(0).size(),2)
+        OPERA_TEST_EQUALS(history.snapshot_at(ts).samples(second).at(0).size(),2)
+    }
 };
 
 
@@ -0,0 +1,151 @@
+/***************************************************************************
+ *            test_udp.cpp
+ *
+ *  Copyright  2021  Luca Geretti
+ *
+ ****************************************************************************/
+
+/*
+ * This file is part of Opera, under the MIT license.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.hpp"
+#include "udp.hpp"
+
+using namespace Opera;
+
+class TestUdp {
+  public:
+    void test() {
+        OPERA_TEST_CALL(test_unsupported())
+        OPERA_TEST_CALL(test_receive(MessageEncoding::JSON))
+        OPERA_TEST_CALL(test_receive(MessageEncoding::BINARY))
+        OPERA_TEST_CALL(test_batch())
+        OPERA_TEST_CALL(test_filter())
+        OPERA_TEST_CALL(test_pruning())
+        OPERA_TEST_CALL(test_empty_batch())
+        OPERA_TEST_CALL(test_invalid())
+        OPERA_TEST_CALL(test_callback_failure())
+    }
+
+    HumanStateMessage make_message(BodyIdType const& id, TimestampType const& timestamp) {
+        Map<KeypointIdType,List<Point>> keypoints({{"head",{Point(0,0,0)}},{"neck",{Point(0,2,0)}}});
+        return HumanStateMessage({HumanStateMessageBodyType(id,keypoints)},timestamp);
+    }
+
+    void wait_for(std::function<bool()> const& condition) {
+        for (SizeType i=0; i<200 and not condition(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    void test_unsupported() {
+        UdpBrokerAccess access("127.0.0.1",UDP_TEST_PORT);
+        OPERA_TEST_FAIL(access.make_robot_state_publisher())
+        OPERA_TEST_FAIL(access.make_body_presentation_subscriber([](auto const&){}))
+    }
+
+    void test_receive(MessageEncoding const& encoding) {
+        List<TimestampType> timestamps;
+        UdpHumanStateSubscriber subscriber("127.0.0.1",UDP_TEST_PORT,[&](HumanStateMessage const& msg){ timestamps.push_back(msg.timestamp()); },encoding,MessageFilter(),8);
+        UdpHumanStatePublisher publisher("127.0.0.1",UDP_TEST_PORT,encoding);
+        publisher.put(make_message("h0",10));
+        publisher.put(make_message("h0",30));
+        publisher.put(make_message("h0",20));
+        publisher.put(make_message("h1",20));
+        wait_for([&]{ return subscriber.num_received() == 4; });
+        OPERA_TEST_EQUALS(subscriber.num_received(),4)
+        OPERA_TEST_EQUALS(subscriber.num_stale(),1)
+        OPERA_TEST_ASSERT(timestamps == List<TimestampType>({10,30,20}))
+    }
+
+    void test_batch() {
+        BrokerAccess access = UdpBrokerAccess("127.0.0.1",UDP_TEST_PORT,MessageEncoding::BINARY,16);
+        std::atomic<SizeType> num_delivered = 0;
+        auto subscriber = access.make_human_state_subscriber([&](auto const&){ ++num_delivered; });
+        auto publisher = access.make_human_state_publisher();
+        for (TimestampType i=1; i<=100; ++i) publisher->put(make_message("h0",i));
+        wait_for([&]{ return num_delivered == 100; });
+        OPERA_TEST_EQUALS(num_delivered,100)
+        delete publisher;
+        delete subscriber;
+    }
+
+    void test_filter() {
+        std::atomic<SizeType> num_delivered = 0;
+        UdpHumanStateSubscriber subscriber("127.0.0.1",UDP_TEST_PORT,[&](auto const&){ ++num_delivered; },MessageEncoding::JSON,
+                                           [](MessageHeader const& header){ return header.body_ids.at(0) == "h0"; },8);
+        UdpHumanStatePublisher publisher("127.0.0.1",UDP_TEST_PORT,MessageEncoding::JSON);
+        publisher.put(make_message("h0",10));
+        publisher.put(make_message("h1",10));
+        wait_for([&]{ return subscriber.num_received() == 2; });
+        OPERA_TEST_EQUALS(subscriber.num_received(),2)
+        OPERA_TEST_EQUALS(num_delivered,1)
+    }
+
+    void test_pruning() {
+        std::atomic<SizeType> num_delivered = 0;
+        UdpHumanStateSubscriber subscriber("127.0.0.1",UDP_TEST_PORT,[&](auto const&){ ++num_delivered; },MessageEncoding::BINARY,MessageFilter(),8);
+        UdpHumanStatePublisher publisher("127.0.0.1",UDP_TEST_PORT,MessageEncoding::BINARY);
+        publisher.put(make_message("h0",100000));
+        for (TimestampType i=1; i<=63; ++i) publisher.put(make_message("b"+std::to_string(i),i));
+        wait_for([&]{ return subscriber.num_received() == 64; });
+        publisher.put(make_message("b1",50));
+        publisher.put(make_message("h0",100000));
+        publisher.put(make_message("b100",100001));
+        wait_for([&]{ return subscriber.num_received() == 67; });
+        OPERA_TEST_EQUALS(subscriber.num_received(),67)
+        OPERA_TEST_EQUALS(subscriber.num_stale(),2)
+        OPERA_TEST_EQUALS(num_delivered,65)
+    }
+
+    void test_empty_batch() {
+        OPERA_TEST_FAIL(UdpHumanStateSubscriber("127.0.0.1",UDP_TEST_PORT,[](auto const&){},MessageEncoding::JSON,MessageFilter(),0))
+    }
+
+    void test_invalid() {
+        std::atomic<SizeType> num_delivered = 0;
+        UdpHumanStateSubscriber subscriber("127.0.0.1",UDP_TEST_PORT,[&](auto const&){ ++num_delivered; },MessageEncoding::BINARY,MessageFilter(),8);
+        UdpHumanStatePublisher publisher("127.0.0.1",UDP_TEST_PORT,MessageEncoding::JSON);
+        publisher.put(make_message("h0",10));
+        wait_for([&]{ return subscriber.num_received() == 1; });
+        OPERA_TEST_EQUALS(subscriber.num_invalid(),1)
+        OPERA_TEST_EQUALS(num_delivered,0)
+    }
+
+    void test_callback_failure() {
+        std::atomic<SizeType> num_delivered = 0;
+        UdpHumanStateSubscriber subscriber("127.0.0.1",UDP_TEST_PORT,[&](auto const&){ ++num_delivered; throw std::runtime_error("callback failure"); },
+                                           MessageEncoding::JSON,MessageFilter(),8);
+        UdpHumanStatePublisher publisher("127.0.0.1",UDP_TEST_PORT,MessageEncoding::JSON);
+        publisher.put(make_message("h0",10));
+        publisher.put(make_message("h0",20));
+        wait_for([&]{ return subscriber.num_received() == 2; });
+        OPERA_TEST_EQUALS(num_delivered,2)
+        OPERA_TEST_EQUALS(subscriber.num_invalid(),0)
+    }
+
+  private:
+    static constexpr int UDP_TEST_PORT = 47311;
+};
+
+int main() {
+    TestUdp().test();
+    return OPERA_TEST_FAILURES;
+}